@@ -28,8 +28,8 @@ ws.onopen = function() {
     status.textContent = 'Connected';
     isConnected = true;
     terminal.textContent += 'WebSocket connected!\n';
-    // Initialize with channel 0 only after connection is established
-    selectChannel(0);
+    // Select this page's channel (0 at first) only after connection is established
+    selectChannel(currentChannel);
 };
 
 ws.onclose = function() {
@@ -47,6 +47,13 @@ ws.onerror = function(error) {
 
 ws.onmessage = function(event) {
     let data = event.data;
+
+    // TRIGGER:<channel>,<pattern> is a notice, not output
+    if (data.startsWith('TRIGGER:')) {
+        const comma = data.indexOf(',');
+        status.textContent = 'SBC' + (parseInt(data.slice(8, comma)) + 1) + ': ' + data.slice(comma + 1);
+        return;
+    }
     
     // Simple ANSI escape sequence handling
     // Remove common ANSI color and formatting codes for cleaner display
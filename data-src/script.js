@@ -76,7 +76,9 @@ class Logger {
 
 // Initialize WebSocket connection
 window.initWebSocket = function initWebSocket() {
-    let ws = new WebSocket('ws://' + window.location.hostname + ':81/');
+    // compress=lz: larger output frames arrive compressed (see unpackFrame)
+    let ws = new WebSocket('ws://' + window.location.hostname + ':81/?compress=lz');
+    ws.binaryType = 'arraybuffer';
     
     ws.onopen = function() {
         window.terminalState.isConnected = true;
@@ -91,11 +93,11 @@ window.initWebSocket = function initWebSocket() {
         if (window.terminalState.mode === 'xterm' && window.terminalState.currentTerminal) {
             window.terminalState.currentTerminal.writeln('\x1b[32mWebSocket connected!\x1b[0m');
         } else if (window.terminalState.mode === 'basic') {
-            window.terminalState.currentTerminal.textContent += 'WebSocket connected!\n';
-            window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
+            basicAppend('WebSocket connected!\n');
         }
         
-        selectChannel(0);
+        // Restore this page's channel after a reconnect
+        selectChannel(window.terminalState.currentChannel);
     };
     
     ws.onclose = function() {
@@ -110,8 +112,7 @@ window.initWebSocket = function initWebSocket() {
         if (window.terminalState.mode === 'xterm' && window.terminalState.currentTerminal) {
             window.terminalState.currentTerminal.writeln('\x1b[31mWebSocket disconnected!\x1b[0m');
         } else if (window.terminalState.mode === 'basic') {
-            window.terminalState.currentTerminal.textContent += 'WebSocket disconnected!\n';
-            window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
+            basicAppend('WebSocket disconnected!\n');
         }
         
         // Auto-reconnect after 2 seconds
@@ -137,33 +138,23 @@ window.initWebSocket = function initWebSocket() {
         }
     };
     
-    // Simple message handler that handles both text and binary data
+    // Output is rendered on the next animation frame, together with
+    // everything else that arrives before it
     ws.onmessage = function(event) {
-        try {
-            // Handle both text and binary data
-            let data;
-            if (event.data instanceof ArrayBuffer) {
-                // Convert binary data to string
-                data = new TextDecoder('utf-8', { fatal: false }).decode(event.data);
-            } else {
-                // Handle regular text data
-                data = event.data;
-            }
-            
-            // Store message in buffer for terminal switching
-            window.terminalState.messageBuffer.push(data);
-            
-            // Keep only last 1000 messages to prevent memory issues
-            if (window.terminalState.messageBuffer.length > 1000) {
-                window.terminalState.messageBuffer.shift();
+        if (typeof event.data === 'string' && event.data.startsWith(TRIGGER_NOTICE)) {
+            showTriggerAlert(event.data);
+            return;
+        }
+        completeTrace();
+        if (event.data instanceof ArrayBuffer) {
+            const bytes = unpackFrame(new Uint8Array(event.data));
+            if (bytes) {
+                outputState.ring.push(bytes);
             }
-            
-            // Display message in current terminal
-            displayMessage(data);
-            
-        } catch (error) {
-            Logger.error('Failed to process WebSocket message:', error);
+        } else {
+            outputState.ring.pushText(event.data, outputState.encoder);
         }
+        scheduleRender();
     };
     
     window.terminalState.ws = ws;
@@ -208,7 +199,7 @@ window.initXtermTerminal = function initXtermTerminal() {
     // Handle terminal input - xterm.js automatically handles Ctrl+C, Ctrl+D, etc.
     term.onData(data => {
         if (window.terminalState.ws && window.terminalState.ws.readyState === WebSocket.OPEN) {
-            window.terminalState.ws.send(data);
+            sendInput(data);
         }
     });
     
@@ -256,7 +247,8 @@ function initBasicTerminal() {
     document.getElementById('local-echo-container').style.display = 'inline';
     
     // Welcome message
-    terminal.textContent = 'ESP32-C3 Serial Terminal (Basic Mode)\n';
+    resetBasicTerminal(terminal);
+    basicAppend('ESP32-C3 Serial Terminal (Basic Mode)\n');
     
     // Setup keyboard handler for basic terminal
     setupBasicKeyboardHandler();
@@ -313,29 +305,22 @@ function setupBasicKeyboardHandler() {
         let char = event.key;
         let localEcho = document.getElementById('localEcho').checked;
         
+        let sent = '';
         if (char.length === 1) {
-            window.terminalState.ws.send(char);
-            if (localEcho) {
-                window.terminalState.currentTerminal.textContent += char;
-            }
+            sent = char;
         } else if (char === 'Enter') {
-            window.terminalState.ws.send('\n');
-            if (localEcho) {
-                window.terminalState.currentTerminal.textContent += '\n';
-            }
+            sent = '\n';
         } else if (char === 'Backspace') {
-            window.terminalState.ws.send('\b');
-            if (localEcho) {
-                window.terminalState.currentTerminal.textContent = window.terminalState.currentTerminal.textContent.slice(0, -1);
-            }
+            sent = '\b';
         } else if (char === 'Tab') {
-            window.terminalState.ws.send('\t');
+            sent = '\t';
+        }
+        if (sent) {
+            sendInput(sent);
             if (localEcho) {
-                window.terminalState.currentTerminal.textContent += '\t';
+                basicAppend(sent);
             }
         }
-        
-        window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
     };
     
     document.addEventListener('keydown', window.basicKeyHandler);
@@ -351,40 +336,328 @@ window.manualReconnect = function manualReconnect() {
     }, 100);
 }
 
-// Display message in current terminal
-function displayMessage(data) {
-    if (window.terminalState.mode === 'xterm' && window.terminalState.currentTerminal) {
-        window.terminalState.currentTerminal.write(data);
-    } else if (window.terminalState.mode === 'basic' && window.terminalState.currentTerminal) {
-        // Basic terminal with ANSI filtering
-        let filteredData = data.replace(/\x1b\[[0-9;]*m/g, '');
-        filteredData = filteredData.replace(/\x1b\[[0-9;]*[A-Za-z]/g, '');
-        filteredData = filteredData.replace(/\x1b\[!\w*\]/g, '');
-        filteredData = filteredData.replace(/\x1b\[\?\w*[hl]/g, '');
+// Incoming output accumulates in a byte ring and is rendered once per
+// animation frame, so a boot-log flood costs one terminal write per frame
+// instead of one per WebSocket message, and a hidden tab (no frames) only
+// renders the last OUTPUT_RING_BYTES when it comes back. The ring also holds
+// the history replayed when switching terminal implementations.
+const OUTPUT_RING_BYTES = 256 * 1024; // Power of two
+const REPLAY_BYTES = 16 * 1024;
+const BASIC_MAX_LINES = 2000;
+
+class ByteRing {
+    constructor(capacity) {
+        this.bytes = new Uint8Array(capacity);
+        this.mask = capacity - 1;
+        this.total = 0; // Bytes ever pushed; positions count from here
+    }
+    
+    push(data) {
+        const capacity = this.bytes.length;
+        const skip = Math.max(0, data.length - capacity);
+        const start = (this.total + skip) & this.mask;
+        const first = Math.min(data.length - skip, capacity - start);
+        this.bytes.set(data.subarray(skip, skip + first), start);
+        this.bytes.set(data.subarray(skip + first), 0);
+        this.total += data.length;
+    }
+    
+    // Encode straight into the ring when the text fits before its end
+    pushText(text, encoder) {
+        const start = this.total & this.mask;
+        if (text.length * 3 <= this.bytes.length - start) {
+            this.total += encoder.encodeInto(text, this.bytes.subarray(start)).written;
+        } else {
+            this.push(encoder.encode(text));
+        }
+    }
+    
+    // Copy of the bytes between two positions, or of the part still held
+    read(from, to = this.total) {
+        from = Math.max(from, to - this.bytes.length, this.total - this.bytes.length);
+        const length = Math.max(0, to - from);
+        const start = from & this.mask;
+        const first = Math.min(length, this.bytes.length - start);
+        const out = new Uint8Array(length);
+        out.set(this.bytes.subarray(start, start + first));
+        out.set(this.bytes.subarray(0, length - first), first);
+        return out;
+    }
+}
+
+const outputState = {
+    ring: new ByteRing(OUTPUT_RING_BYTES),
+    rendered: 0,            // Ring position written to the terminal
+    frameRequested: false,
+    encoder: new TextEncoder(),
+    decoder: new TextDecoder('utf-8', { fatal: false }), // Streams: keeps a split character for the next frame
+    frames: 0,
+    renderMs: 0,
+    skippedBytes: 0
+};
+
+// Binary frames of a compress=lz connection: a header byte, 0 for raw
+// output, or 1 followed by the output length (16-bit little endian) and an
+// LZ block in the firmware's lz_block.h format
+function unpackFrame(frame) {
+    if (frame[0] === 0) {
+        return frame.subarray(1);
+    }
+    if (frame[0] !== 1 || frame.length < 3) {
+        Logger.warn('Unknown output frame type ' + frame[0]);
+        return null;
+    }
+    const output = new Uint8Array(frame[1] | (frame[2] << 8));
+    const produced = lzDecompress(frame.subarray(3), output);
+    if (produced !== output.length) {
+        Logger.warn('Corrupt compressed output frame');
+        return null;
+    }
+    return output;
+}
+
+// LZ4-style sequences: a token (literal count, match length - 4), the
+// literals, a 16-bit offset; counts of 15 continue in bytes while 255
+function lzDecompress(input, output) {
+    let inPos = 0;
+    let outPos = 0;
+    const readLength = (length) => {
+        let byte;
+        do {
+            byte = inPos < input.length ? input[inPos++] : -1;
+            length += byte;
+        } while (byte === 255);
+        return byte < 0 ? -1 : length;
+    };
+    
+    while (inPos < input.length) {
+        const token = input[inPos++];
+        let literals = token >> 4;
+        if (literals === 15 && (literals = readLength(literals)) < 0) return -1;
+        if (inPos + literals > input.length || outPos + literals > output.length) return -1;
+        output.set(input.subarray(inPos, inPos + literals), outPos);
+        inPos += literals;
+        outPos += literals;
         
-        for (let i = 0; i < filteredData.length; i++) {
-            let char = filteredData[i];
-            if (char === '\n') {
-                window.terminalState.currentTerminal.textContent += '\n';
-            } else if (char === '\r') {
-                window.terminalState.currentTerminal.textContent += '\n';
-            } else if (char === '\t') {
-                window.terminalState.currentTerminal.textContent += '    ';
-            } else if (char === '\b') {
-                window.terminalState.currentTerminal.textContent = window.terminalState.currentTerminal.textContent.slice(0, -1);
-            } else if (char.charCodeAt(0) >= 32) {
-                window.terminalState.currentTerminal.textContent += char;
-            }
+        if (inPos === input.length) break; // Last sequence: literals only
+        if (inPos + 2 > input.length) return -1;
+        const offset = input[inPos] | (input[inPos + 1] << 8);
+        inPos += 2;
+        let matchLength = token & 0x0f;
+        if (matchLength === 15 && (matchLength = readLength(matchLength)) < 0) return -1;
+        matchLength += 4;
+        if (offset === 0 || offset > outPos || outPos + matchLength > output.length) return -1;
+        
+        // Byte by byte: the match may overlap the bytes it produces
+        for (let k = 0; k < matchLength; k++, outPos++) {
+            output[outPos] = output[outPos - offset];
         }
-        window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
+    }
+    return outPos;
+}
+
+function scheduleRender() {
+    if (!outputState.frameRequested) {
+        outputState.frameRequested = true;
+        requestAnimationFrame(renderOutput);
+    }
+}
+
+function renderOutput() {
+    outputState.frameRequested = false;
+    const started = performance.now();
+    const ring = outputState.ring;
+    
+    // More than the ring holds arrived since the last frame
+    const oldest = ring.total - OUTPUT_RING_BYTES;
+    if (outputState.rendered < oldest) {
+        const skipped = oldest - outputState.rendered;
+        outputState.skippedBytes += skipped;
+        outputState.rendered = oldest;
+        outputState.decoder.decode();
+        writeOutput(`\r\n[${skipped} bytes skipped]\r\n`);
+    }
+    const bytes = ring.read(outputState.rendered);
+    outputState.rendered = ring.total;
+    writeOutput(outputState.decoder.decode(bytes, { stream: true }));
+    
+    outputState.frames++;
+    outputState.renderMs += performance.now() - started;
+}
+
+function writeOutput(text) {
+    if (!text || !window.terminalState.currentTerminal) {
+        return;
+    }
+    if (window.terminalState.mode === 'xterm') {
+        window.terminalState.currentTerminal.write(text);
+    } else if (window.terminalState.mode === 'basic') {
+        basicAppend(text);
     }
 }
 
-// Replay buffered messages when switching terminals
+// Basic terminal: one element per line, at most BASIC_MAX_LINES, and only
+// the line being written is touched until it ends
+const basicState = {
+    terminal: null,
+    line: '',
+    lineElement: null,
+    lineCount: 0,
+    carriageReturn: false, // CR seen: LF ends the line, anything else overwrites it
+    escape: ''             // Start of an escape sequence cut by the end of a write
+};
+
+function resetBasicTerminal(terminal) {
+    terminal.textContent = '';
+    basicState.terminal = terminal;
+    basicState.line = '';
+    basicState.lineElement = createBasicLine('');
+    basicState.lineCount = 1;
+    basicState.carriageReturn = false;
+    basicState.escape = '';
+    terminal.appendChild(basicState.lineElement);
+}
+
+function createBasicLine(text) {
+    const element = document.createElement('div');
+    element.className = 'basic-line';
+    element.textContent = text;
+    return element;
+}
+
+// Write text to the basic terminal and scroll to the end
+function basicAppend(text) {
+    const terminal = basicState.terminal;
+    if (!terminal || terminal !== window.terminalState.currentTerminal) {
+        return;
+    }
+    
+    // ANSI sequences are dropped; one cut at the end waits for its rest
+    text = basicState.escape + text;
+    const cut = text.match(/\x1b(\[[0-9;?!]*)?$/);
+    basicState.escape = cut ? cut[0] : '';
+    if (cut) {
+        text = text.slice(0, cut.index);
+    }
+    text = text.replace(/\x1b\[[0-9;?]*[A-Za-z]/g, '').replace(/\x1b\[!\w*\]/g, '');
+    
+    const finished = [];
+    let line = basicState.line;
+    for (let i = 0; i < text.length; i++) {
+        const char = text[i];
+        if (basicState.carriageReturn && char !== '\n') {
+            line = '';
+        }
+        basicState.carriageReturn = false;
+        if (char === '\n') {
+            finished.push(line);
+            line = '';
+        } else if (char === '\r') {
+            basicState.carriageReturn = true;
+        } else if (char === '\t') {
+            line += '    ';
+        } else if (char === '\b') {
+            line = line.slice(0, -1);
+        } else if (char.charCodeAt(0) >= 32) {
+            line += char;
+        }
+    }
+    
+    if (finished.length > 0) {
+        // The current element takes the first finished line, new elements the rest
+        basicState.lineElement.textContent = finished[0];
+        const fragment = document.createDocumentFragment();
+        const from = Math.max(1, finished.length - BASIC_MAX_LINES);
+        for (let i = from; i <= finished.length; i++) {
+            const element = createBasicLine(i < finished.length ? finished[i] : '');
+            fragment.appendChild(element);
+            basicState.lineElement = element;
+        }
+        basicState.lineCount += finished.length + 1 - from;
+        terminal.appendChild(fragment);
+        while (basicState.lineCount > BASIC_MAX_LINES) {
+            terminal.removeChild(terminal.firstChild);
+            basicState.lineCount--;
+        }
+    }
+    basicState.line = line;
+    basicState.lineElement.textContent = line;
+    terminal.scrollTop = terminal.scrollHeight;
+}
+
+// Replay recent output into a terminal that was just created
 function replayBufferedMessages() {
-    // Only replay last 50 messages to avoid overwhelming the terminal
-    const messagesToReplay = window.terminalState.messageBuffer.slice(-50);
-    messagesToReplay.forEach(message => displayMessage(message));
+    const history = outputState.ring.read(outputState.rendered - REPLAY_BYTES, outputState.rendered);
+    writeOutput(new TextDecoder('utf-8', { fatal: false }).decode(history));
+}
+
+// In-page benchmark: replays a captured boot log through the same path as
+// WebSocket output, as fast as it can be delivered, and reports how fast it
+// was rendered. Open the page with ?bench for the recording of SBC1
+// (/record.cast), or ?bench=<url> for another asciicast or plain text file.
+async function runRenderBenchmark(url) {
+    let text;
+    try {
+        const response = await fetch(url, { cache: 'no-store' });
+        text = await response.text();
+    } catch (error) {
+        Logger.error('Benchmark: failed to fetch ' + url, error);
+        return;
+    }
+    
+    // asciicast v2: a header line, then [time, "o", data] per line
+    let chunks = [];
+    const lines = text.split('\n');
+    if (lines[0].startsWith('{') && lines[0].includes('"version"')) {
+        for (let i = 1; i < lines.length; i++) {
+            try {
+                const event = JSON.parse(lines[i]);
+                if (event[1] === 'o') {
+                    chunks.push(outputState.encoder.encode(event[2]));
+                }
+            } catch (error) {
+                // Blank or cut line
+            }
+        }
+    } else {
+        const bytes = outputState.encoder.encode(text);
+        for (let offset = 0; offset < bytes.length; offset += 256) {
+            chunks.push(bytes.subarray(offset, offset + 256));
+        }
+    }
+    const total = chunks.reduce((sum, chunk) => sum + chunk.length, 0);
+    
+    const frames = outputState.frames, renderMs = outputState.renderMs, skipped = outputState.skippedBytes;
+    const started = performance.now();
+    const end = outputState.ring.total + total;
+    for (let i = 0; i < chunks.length; i += 100) {
+        // A flood: 100 messages per task, the frames fit in between
+        chunks.slice(i, i + 100).forEach(chunk => outputState.ring.push(chunk));
+        scheduleRender();
+        await new Promise(resolve => setTimeout(resolve, 0));
+    }
+    while (outputState.rendered < end) {
+        await new Promise(resolve => requestAnimationFrame(resolve));
+    }
+    if (window.terminalState.mode === 'xterm') {
+        await new Promise(resolve => window.terminalState.currentTerminal.write('', resolve));
+    }
+    
+    const seconds = (performance.now() - started) / 1000;
+    const report = `Benchmark: ${total} bytes in ${chunks.length} messages, ` +
+        `${(total / 1024 / seconds).toFixed(0)} KB/s in ${outputState.frames - frames} frames ` +
+        `(${(outputState.renderMs - renderMs).toFixed(0)} ms rendering), ` +
+        `${outputState.skippedBytes - skipped} bytes skipped (${window.terminalState.mode})`;
+    Logger.warn(report);
+    writeOutput('\r\n' + report + '\r\n');
+}
+
+function startBenchmarkFromUrl() {
+    const source = new URLSearchParams(window.location.search).get('bench');
+    if (source !== null && !outputState.benchmarkStarted) {
+        outputState.benchmarkStarted = true;
+        runRenderBenchmark(source || '/record.cast?channel=0');
+    }
 }
 
 // Utility function to focus the terminal
@@ -430,21 +703,182 @@ function selectChannel(channel) {
     document.getElementById('channel').textContent = 'SBC' + (channel + 1);
     
     // Update button states
-    document.querySelectorAll('.channel-buttons button').forEach(b => b.classList.remove('active'));
+    document.querySelectorAll('.channel-buttons button[id^="btn"]').forEach(b => b.classList.remove('active'));
     document.getElementById('btn' + channel).classList.add('active');
     
     // Show channel change in terminal
     if (window.terminalState.mode === 'xterm' && window.terminalState.currentTerminal) {
         window.terminalState.currentTerminal.writeln(`\x1b[33mSwitched to SBC${channel + 1}\x1b[0m`);
     } else if (window.terminalState.mode === 'basic') {
-        window.terminalState.currentTerminal.textContent += `Switched to SBC${channel + 1}\n`;
-        window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
+        basicAppend(`Switched to SBC${channel + 1}\n`);
     }
     
     // Restore focus to terminal after channel change
     setTimeout(() => focusTerminal(), 10);
 }
 
+// Toggle background round-robin capture of all channels
+function toggleScan() {
+    if (!window.terminalState.isConnected || window.terminalState.ws.readyState !== WebSocket.OPEN) {
+        return;
+    }
+    
+    window.terminalState.scanning = !window.terminalState.scanning;
+    window.terminalState.ws.send(window.terminalState.scanning ? 'SCAN:ON' : 'SCAN:OFF');
+    document.getElementById('scan-btn').classList.toggle('active', window.terminalState.scanning);
+    
+    setTimeout(() => focusTerminal(), 10);
+}
+
+// Ask the device for per-channel dwell time and missed byte estimates
+function requestScanStats() {
+    if (!window.terminalState.isConnected || window.terminalState.ws.readyState !== WebSocket.OPEN) {
+        return;
+    }
+    
+    window.terminalState.ws.send('SCAN:STATS');
+    setTimeout(() => focusTerminal(), 10);
+}
+
+// Keystroke latency tracing: one keystroke in flight at a time is announced
+// with TRACE:<id>; the first message back is taken as its echo. The device's
+// share of each round trip comes from /trace.json, matched by id.
+const TRACE_POLL_MS = 1000;
+const TRACE_SEGMENTS = ['queue', 'sbc', 'forward', 'network', 'total'];
+const traceState = {
+    nextId: 1,
+    inFlight: null,     // { id, sentAt } until the echo arrives
+    pending: new Map(), // id -> round trip in ms, until the device reports it
+    traces: [],         // Completed: { id, queue, sbc, forward, network, total } in ms
+    device: null,       // Last /trace.json
+    timer: null
+};
+
+// Send keystrokes, traced when tracing is on and no trace is in flight
+function sendInput(data) {
+    const ws = window.terminalState.ws;
+    if (window.terminalState.tracing && !traceState.inFlight) {
+        const id = traceState.nextId++;
+        ws.send('TRACE:' + id);
+        traceState.inFlight = { id: id, sentAt: performance.now() };
+    }
+    ws.send(data);
+}
+
+function completeTrace() {
+    if (!traceState.inFlight) {
+        return;
+    }
+    traceState.pending.set(traceState.inFlight.id, performance.now() - traceState.inFlight.sentAt);
+    traceState.inFlight = null;
+}
+
+function toggleTrace() {
+    window.terminalState.tracing = !window.terminalState.tracing;
+    document.getElementById('trace-btn').classList.toggle('active', window.terminalState.tracing);
+    document.getElementById('trace-panel').style.display = window.terminalState.tracing ? 'block' : 'none';
+
+    if (window.terminalState.tracing) {
+        traceState.timer = setInterval(pollTraces, TRACE_POLL_MS);
+    } else {
+        clearInterval(traceState.timer);
+        traceState.inFlight = null;
+    }
+    setTimeout(() => focusTerminal(), 10);
+}
+
+// Fetch the device's segments and complete the round trips it reports
+async function pollTraces() {
+    try {
+        const response = await fetch('/trace.json', { cache: 'no-store' });
+        traceState.device = await response.json();
+    } catch (error) {
+        Logger.warn('Failed to fetch trace report:', error);
+        return;
+    }
+
+    for (const trace of traceState.device.recent) {
+        const roundTrip = traceState.pending.get(trace.id);
+        if (roundTrip === undefined) {
+            continue;
+        }
+        traceState.pending.delete(trace.id);
+        const queue = trace.queue_us / 1000, sbc = trace.sbc_us / 1000, forward = trace.forward_us / 1000;
+        traceState.traces.push({
+            id: trace.id, queue: queue, sbc: sbc, forward: forward,
+            network: Math.max(0, roundTrip - queue - sbc - forward), total: roundTrip
+        });
+    }
+    // Traces the device abandoned or that scrolled out of its recent list
+    for (const id of traceState.pending.keys()) {
+        if (id < traceState.nextId - 100) {
+            traceState.pending.delete(id);
+        }
+    }
+    renderTraces();
+}
+
+function renderTraces() {
+    const rows = TRACE_SEGMENTS.map(segment => {
+        const values = traceState.traces.map(trace => trace[segment]);
+        const mean = values.length ? values.reduce((a, b) => a + b, 0) / values.length : 0;
+        const max = values.length ? Math.max(...values) : 0;
+        return `<tr><td>${segment}</td><td>${values.length}</td><td>${mean.toFixed(2)}</td><td>${max.toFixed(2)}</td></tr>`;
+    });
+    const device = traceState.device;
+    document.getElementById('trace-table').innerHTML =
+        '<tr><th>segment</th><th>count</th><th>mean ms</th><th>max ms</th></tr>' + rows.join('');
+    document.getElementById('trace-summary').textContent = device ?
+        `device: ${device.completed} completed, ${device.abandoned} abandoned` : '';
+}
+
+// Save the device's histograms and the browser's round trips
+function exportTraces() {
+    const report = { device: traceState.device, traces: traceState.traces };
+    const link = document.createElement('a');
+    link.href = URL.createObjectURL(new Blob([JSON.stringify(report, null, 2)], { type: 'application/json' }));
+    link.download = 'keystroke-trace.json';
+    link.click();
+    URL.revokeObjectURL(link.href);
+}
+
+// Trigger notices (TRIGGER:<channel>,<pattern>) come as text frames of their
+// own and never belong to the output: each pops up above the terminal for a
+// while, the newest TRIGGER_ALERT_MAX at a time. Clicking one views its channel.
+const TRIGGER_NOTICE = 'TRIGGER:';
+const TRIGGER_ALERT_MS = 10000;
+const TRIGGER_ALERT_MAX = 5;
+
+function showTriggerAlert(notice) {
+    const body = notice.slice(TRIGGER_NOTICE.length);
+    const comma = body.indexOf(',');
+    const channel = parseInt(body.slice(0, comma));
+    const pattern = body.slice(comma + 1);
+    Logger.warn(`SBC${channel + 1}: ${pattern}`);
+
+    let container = document.getElementById('trigger-alerts');
+    if (!container) {
+        container = document.createElement('div');
+        container.id = 'trigger-alerts';
+        document.body.appendChild(container);
+    }
+    const toast = document.createElement('div');
+    toast.className = 'trigger-alert';
+    toast.textContent = `SBC${channel + 1}: ${pattern}`;
+    toast.title = `Click to view SBC${channel + 1}`;
+    toast.onclick = function() {
+        toast.remove();
+        if (document.getElementById('btn' + channel)) {
+            selectChannel(channel);
+        }
+    };
+    container.appendChild(toast);
+    while (container.children.length > TRIGGER_ALERT_MAX) {
+        container.firstChild.remove();
+    }
+    setTimeout(() => toast.remove(), TRIGGER_ALERT_MS);
+}
+
 // Function to send control characters
 function sendControlChar(charCode) {
     if (!window.terminalState.isConnected || window.terminalState.ws.readyState !== WebSocket.OPEN) {
@@ -452,7 +886,7 @@ function sendControlChar(charCode) {
     }
     
     let controlChar = String.fromCharCode(charCode);
-    window.terminalState.ws.send(controlChar);
+    sendInput(controlChar);
     
     // Show control character feedback
     let controlName = '';
@@ -470,8 +904,7 @@ function sendControlChar(charCode) {
     } else if (window.terminalState.mode === 'basic') {
         const localEcho = document.getElementById('localEcho').checked;
         if (localEcho) {
-            window.terminalState.currentTerminal.textContent += controlName;
-            window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
+            basicAppend(controlName);
         }
     }
     
@@ -485,12 +918,7 @@ document.addEventListener('DOMContentLoaded', function() {
     if (localEchoCheckbox) {
         localEchoCheckbox.addEventListener('change', function() {
             if (window.terminalState.mode === 'basic') {
-                if (this.checked) {
-                    window.terminalState.currentTerminal.textContent += 'Local echo enabled\n';
-                } else {
-                    window.terminalState.currentTerminal.textContent += 'Local echo disabled\n';
-                }
-                window.terminalState.currentTerminal.scrollTop = window.terminalState.currentTerminal.scrollHeight;
+                basicAppend(this.checked ? 'Local echo enabled\n' : 'Local echo disabled\n');
             }
         });
     }
@@ -0,0 +1,95 @@
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Fixed-capacity byte FIFO that overwrites its oldest bytes when full.
+ * Storage is inline, so instances never touch the heap.
+ *
+ * Capacity need not be a power of two: indices are kept wrapped below
+ * Capacity with a compare, not a division, and bytes move in at most two
+ * memcpy spans per call.
+ */
+template <size_t Capacity>
+class ByteRing {
+    static_assert(Capacity > 0, "Capacity must not be zero");
+
+public:
+    /**
+     * Append bytes, dropping the oldest data if the ring overflows
+     * @return Number of old bytes that were overwritten
+     */
+    size_t write(const uint8_t* bytes, size_t length) {
+        size_t total = count + length;
+        size_t dropped = total > Capacity ? total - Capacity : 0;
+        if (length > Capacity) {
+            // Only the newest Capacity bytes can stay
+            bytes += length - Capacity;
+            length = Capacity;
+        }
+        if (length == 0) return 0;  // Nothing to copy; bytes may be null
+
+        size_t start = wrap(head + count);
+        size_t first = length < Capacity - start ? length : Capacity - start;
+        memcpy(data + start, bytes, first);
+        memcpy(data, bytes + first, length - first);
+
+        size_t end = wrap(start + length);
+        count = total < Capacity ? total : Capacity;
+        head = end >= count ? end - count : end + Capacity - count;
+        return dropped;
+    }
+
+    /**
+     * Remove up to length of the oldest bytes
+     * @return Number of bytes copied into buffer
+     */
+    size_t read(uint8_t* buffer, size_t length) {
+        size_t copied = copy(0, buffer, length);
+        head = wrap(head + copied);
+        count -= copied;
+        return copied;
+    }
+
+    /**
+     * Copy bytes without consuming them
+     * @param offset Position relative to the oldest byte
+     * @return Number of bytes copied into buffer
+     */
+    size_t copy(size_t offset, uint8_t* buffer, size_t length) const {
+        if (offset >= count) return 0;
+        size_t available = count - offset;
+        size_t copied = length < available ? length : available;
+        if (copied == 0) return 0;  // Nothing to copy; buffer may be null
+
+        size_t start = wrap(head + offset);
+        size_t first = copied < Capacity - start ? copied : Capacity - start;
+        memcpy(buffer, data + start, first);
+        memcpy(buffer + first, data, copied - first);
+        return copied;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    static size_t capacity() { return Capacity; }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+private:
+    uint8_t data[Capacity];
+    size_t head = 0;   // Oldest byte, always below Capacity
+    size_t count = 0;
+
+    /**
+     * Fold an index below 2 * Capacity back below Capacity
+     */
+    static size_t wrap(size_t index) { return index >= Capacity ? index - Capacity : index; }
+};
+
+#endif // BYTE_RING_H
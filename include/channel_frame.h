@@ -0,0 +1,109 @@
+#ifndef CHANNEL_FRAME_H
+#define CHANNEL_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Channel-tagged binary WebSocket framing, version 1
+// (see docs/websocket-protocol.md).
+//
+// A frame is one binary WebSocket message: a version byte followed by one or
+// more records. Each record carries output of (or input for) one channel:
+//
+//   channel  u8
+//   flags    u8   CHANNEL_FLAG_*
+//   sequence u32  little endian: stream position of the first payload byte
+//   length   u16  little endian
+//   payload  length bytes
+
+static const uint8_t CHANNEL_FRAME_VERSION = 1;
+static const size_t CHANNEL_RECORD_HEADER_SIZE = 8;
+
+// Record flags
+static const uint8_t CHANNEL_FLAG_REPLAY = 0x01;       // History sent on connect, not live output
+static const uint8_t CHANNEL_FLAG_INTERACTIVE = 0x02;  // Channel is the one keystrokes go to
+static const uint8_t CHANNEL_FLAG_GAP = 0x04;          // Output before sequence was lost to this client
+
+/**
+ * One decoded record; payload points into the frame
+ */
+struct ChannelRecord {
+    uint8_t channel = 0;
+    uint8_t flags = 0;
+    uint32_t sequence = 0;
+    const uint8_t* payload = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * Builds a frame in a caller-supplied buffer. Payloads are written in place:
+ * beginRecord() returns where the payload goes, endRecord() fixes its length.
+ */
+class ChannelFrameWriter {
+public:
+    /**
+     * Start a frame
+     * @param buffer Frame storage
+     * @param capacity Size of buffer in bytes
+     */
+    void begin(uint8_t* buffer, size_t capacity);
+
+    /**
+     * Reserve a record
+     * @param maxLength Receives the payload space available (0 if the frame is full)
+     * @return Payload destination, or nullptr if no record fits
+     */
+    uint8_t* beginRecord(uint8_t channel, uint8_t flags, uint32_t sequence, size_t& maxLength);
+
+    /**
+     * Complete the record started by beginRecord()
+     * @param length Payload bytes written (at most maxLength)
+     */
+    void endRecord(size_t length);
+
+    /**
+     * @return Frame length so far
+     */
+    size_t size() const;
+
+    /**
+     * @return true if at least one record was added
+     */
+    bool hasRecords() const;
+
+private:
+    uint8_t* buffer = nullptr;
+    size_t capacity = 0;
+    size_t length = 0;
+    size_t recordStart = 0;
+};
+
+/**
+ * Iterates over the records of a received frame
+ */
+class ChannelFrameReader {
+public:
+    /**
+     * @param frame Binary message
+     * @param length Message length
+     */
+    ChannelFrameReader(const uint8_t* frame, size_t length);
+
+    /**
+     * @return false if the message is not a frame of a supported version
+     */
+    bool isValid() const;
+
+    /**
+     * Decode the next record
+     * @return false at the end of the frame or on a truncated record
+     */
+    bool next(ChannelRecord& record);
+
+private:
+    const uint8_t* frame;
+    size_t length;
+    size_t position = 1;
+};
+
+#endif // CHANNEL_FRAME_H
@@ -0,0 +1,334 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Thin hardware abstraction layer for the serial pipeline.
+//
+// The firmware binds these interfaces to the Arduino/ESP-IDF drivers in
+// src/hal_arduino.cpp. The [env:native] build binds them to in-memory fake
+// devices (src/native/hal_native.cpp) so the multiplexer, the WebSocket
+// buffering and the UART forwarding path can run on a Linux host.
+
+namespace hal {
+
+/**
+ * Minimal Arduino-style Print: subclasses provide write(), helpers format
+ */
+class Print {
+public:
+    virtual ~Print() {}
+
+    /**
+     * Write raw bytes
+     * @param data Bytes to write
+     * @param length Number of bytes
+     * @return Number of bytes accepted
+     */
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+    size_t print(const char* text);
+    size_t print(unsigned long value);
+    size_t println(const char* text = "");
+    size_t println(unsigned long value);
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+/**
+ * Monotonic time source and blocking delays
+ */
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual unsigned long millis() = 0;
+    virtual unsigned long micros() = 0;
+    virtual void delay(unsigned long ms) = 0;
+    virtual void delayMicroseconds(unsigned long us) = 0;
+};
+
+/**
+ * Digital output pins (multiplexer select lines, status LED)
+ */
+class Gpio {
+public:
+    virtual ~Gpio() {}
+    virtual void setOutput(uint8_t pin) = 0;
+    virtual void write(uint8_t pin, bool high) = 0;
+
+    /**
+     * Drive several output pins at once: every pin in mask takes the level
+     * of its bit in levels in a single output register write, so no
+     * intermediate combination ever appears on the pins
+     * @param mask Pins to change (bit n = GPIOn)
+     * @param levels New levels (bit n = GPIOn), bits outside mask ignored
+     */
+    virtual void writeMask(uint32_t mask, uint32_t levels) = 0;
+};
+
+/**
+ * UART receive counters
+ */
+struct UartStats {
+    unsigned long rxBytes = 0;          // Bytes taken from the hardware
+    unsigned long ringOverruns = 0;     // Bytes dropped because the receive ring was full
+    unsigned long fifoOverflows = 0;    // Hardware FIFO / driver buffer overflow events
+    unsigned long framingErrors = 0;    // Framing or parity errors reported by the UART
+    unsigned long fencedBytes = 0;      // Bytes dropped by fenceUntil()
+    size_t ringPeak = 0;                // Highest receive ring fill level seen
+    size_t ringCapacity = 0;
+};
+
+enum class Parity : uint8_t {
+    None,
+    Even,
+    Odd
+};
+
+/**
+ * Rate and character format of a UART line
+ */
+struct LineConfig {
+    unsigned long baud = 115200;
+    uint8_t dataBits = 8;           // 5 to 8
+    Parity parity = Parity::None;
+    uint8_t stopBits = 1;           // 1 or 2
+
+    /**
+     * @return Bits on the wire per character, start bit included
+     */
+    unsigned bitsPerChar() const { return 1 + dataBits + (parity != Parity::None ? 1 : 0) + stopBits; }
+
+    /**
+     * @return Time of one character on the wire in microseconds (rounded up)
+     */
+    unsigned long charTimeUs() const { return baud ? (bitsPerChar() * 1000000UL + baud - 1) / baud : 0; }
+
+    bool operator==(const LineConfig& other) const {
+        return baud == other.baud && dataBits == other.dataBits && parity == other.parity &&
+               stopBits == other.stopBits;
+    }
+    bool operator!=(const LineConfig& other) const { return !(*this == other); }
+};
+
+/**
+ * UART connected to the multiplexed SBC consoles
+ */
+class Uart {
+public:
+    virtual ~Uart() {}
+
+    /**
+     * Start the UART at the given baud rate (8N1, pins from pins.h)
+     */
+    virtual void begin(unsigned long baud) = 0;
+
+    /**
+     * Change rate and character format on the fly (e.g. on a mux switch).
+     * The receive ring is kept; a byte on the wire meanwhile is garbled.
+     */
+    virtual void setLineConfig(const LineConfig& config) = 0;
+
+    /**
+     * @return Current rate and character format
+     */
+    virtual LineConfig getLineConfig() = 0;
+
+    /**
+     * Restart the measurement of the shortest pulse on the RX line
+     */
+    virtual void startPulseMeasurement() = 0;
+
+    /**
+     * @return Shortest high or low pulse on RX since startPulseMeasurement()
+     *         in nanoseconds (about one bit time once a few characters went
+     *         by), 0 if too few edges were seen or the UART cannot measure
+     */
+    virtual unsigned long getShortestPulseNs() = 0;
+
+    /**
+     * @return Number of received bytes ready to be read
+     */
+    virtual size_t available() = 0;
+
+    /**
+     * Read up to length received bytes
+     * @return Number of bytes copied into buffer
+     */
+    virtual size_t read(uint8_t* buffer, size_t length) = 0;
+
+    /**
+     * Queue bytes for transmission (blocks while the transmit FIFO is full)
+     * @return Number of bytes accepted
+     */
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+    /**
+     * @return Bytes write() accepts right now without blocking
+     */
+    virtual size_t availableForWrite() = 0;
+
+    /**
+     * @return true once every written byte has left the transmitter
+     */
+    virtual bool txIdle() = 0;
+
+    /**
+     * Hold TX low (a serial BREAK) until called again with false. Wait for
+     * txIdle() first: bytes still on the wire would be cut short.
+     */
+    virtual void setBreak(bool on) = 0;
+
+    /**
+     * Keep TX idle for at least gapUs after every character, so characters
+     * written together still reach the SBC spaced out. The transmitter holds
+     * at most MAX_TX_GAP_BITS bit times; kept across rate changes.
+     * @return Gap in effect in microseconds, less than gapUs if it was capped
+     */
+    virtual unsigned long setTxGap(unsigned long gapUs) = 0;
+
+    static const unsigned long MAX_TX_GAP_BITS = 1023;  // ESP32-C3 UART_TX_IDLE_NUM
+
+    /**
+     * Drop every byte that reaches the receive ring before untilUs, and
+     * whatever the ring holds now (the previous mux channel's tail and the
+     * glitch of the switch itself). Call from the reading task.
+     * @param untilUs End of the fence in micros()
+     */
+    virtual void fenceUntil(unsigned long untilUs) = 0;
+
+    /**
+     * @return Receive counters since begin()
+     */
+    virtual UartStats getStats() = 0;
+};
+
+/**
+ * Debug console (USB CDC on the board, stdout on the host)
+ */
+class Console : public Print {
+};
+
+/**
+ * WebSocket events delivered to the registered handler
+ * (the payload of Connected is the request path, e.g. "/?proto=1")
+ */
+enum class WsEvent : uint8_t {
+    Connected,
+    Disconnected,
+    Text,
+    Binary
+};
+
+typedef void (*WsEventHandler)(uint8_t num, WsEvent type, const uint8_t* payload, size_t length);
+
+/**
+ * WebSocket server transport
+ */
+class WebSocketTransport {
+public:
+    virtual ~WebSocketTransport() {}
+    virtual bool begin() = 0;
+    virtual void loop() = 0;
+    virtual void onEvent(WsEventHandler handler) = 0;
+    virtual bool sendText(uint8_t num, const uint8_t* data, size_t length) = 0;
+    virtual bool sendBinary(uint8_t num, const uint8_t* data, size_t length) = 0;
+    virtual bool broadcastText(const uint8_t* data, size_t length) = 0;
+    virtual bool broadcastBinary(const uint8_t* data, size_t length) = 0;
+    virtual size_t connectedClients() = 0;
+};
+
+/**
+ * Accepted TCP connection, owned by its TcpServer until stop() is called
+ */
+class TcpConnection : public Print {
+public:
+    virtual size_t available() = 0;
+
+    /**
+     * Read the bytes that have already arrived, never waits
+     * @return Number of bytes stored
+     */
+    virtual size_t read(uint8_t* buffer, size_t length) = 0;
+
+    /**
+     * @return true if the send buffer has room, so a write() of one chunk
+     *         does not wait for the peer to acknowledge earlier data
+     */
+    virtual bool writable() = 0;
+
+    virtual bool connected() = 0;
+    virtual void stop() = 0;
+};
+
+/**
+ * Listening TCP socket
+ */
+class TcpServer {
+public:
+    virtual ~TcpServer() {}
+    virtual bool begin() = 0;
+
+    /**
+     * @return Newly accepted connection or nullptr if none is pending
+     */
+    virtual TcpConnection* accept() = 0;
+};
+
+/**
+ * Open file, owned by its FileSystem until close() is called
+ */
+class File {
+public:
+    virtual ~File() {}
+    virtual size_t size() = 0;
+    virtual size_t available() = 0;
+    virtual size_t read(uint8_t* buffer, size_t length) = 0;
+    virtual size_t write(const uint8_t* data, size_t length) = 0;
+
+    /**
+     * Move the read position
+     * @return false if position is past the end
+     */
+    virtual bool seek(size_t position) = 0;
+    virtual void close() = 0;
+};
+
+/**
+ * Flash filesystem holding the web assets and the session recording
+ */
+class FileSystem {
+public:
+    virtual ~FileSystem() {}
+    virtual bool begin() = 0;
+    virtual bool exists(const char* path) = 0;
+
+    /**
+     * @param mode "r", "w" or "a"
+     * @return Open file or nullptr on failure
+     */
+    virtual File* open(const char* path, const char* mode) = 0;
+};
+
+/**
+ * Heap usage, for /metrics
+ */
+struct HeapStats {
+    size_t freeBytes = 0;
+    size_t largestFreeBlock = 0;    // Largest allocation that can still succeed
+    size_t minimumFreeBytes = 0;    // Low-water mark since boot
+};
+
+// Platform bindings (implemented once per build environment)
+Clock& clock();
+Gpio& gpio();
+Uart& sbcUart();
+Console& console();
+FileSystem& fileSystem();
+WebSocketTransport* createWebSocketTransport(uint16_t port);
+TcpServer* createTcpServer(uint16_t port);
+HeapStats heapStats();
+
+} // namespace hal
+
+#endif // HAL_H
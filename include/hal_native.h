@@ -0,0 +1,304 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+#include "pins.h"
+#include "spsc_ring.h"
+
+// Fake devices backing the HAL in the [env:native] build.
+// Only included by sources under src/native/.
+
+namespace hal {
+namespace native {
+
+/**
+ * Simulated clock: time only moves when advanced or delayed, so host runs are
+ * deterministic and never sleep
+ */
+class SimClock : public Clock {
+public:
+    unsigned long millis() override { return (unsigned long)(nowUs / 1000); }
+    unsigned long micros() override { return (unsigned long)nowUs; }
+    void delay(unsigned long ms) override { nowUs += (uint64_t)ms * 1000; }
+    void delayMicroseconds(unsigned long us) override { nowUs += us; }
+
+    void advanceMicros(uint64_t us) { nowUs += us; }
+
+private:
+    uint64_t nowUs = 0;
+};
+
+/**
+ * GPIO that records every level change: each write() or writeMask() call is
+ * one entry in writes, with the pin levels it produced
+ */
+class FakeGpio : public Gpio {
+public:
+    struct PinWrite {
+        uint32_t mask;      // Pins driven by this write
+        uint32_t levels;    // All pin levels after it (bit n = GPIOn)
+    };
+
+    static const size_t PIN_COUNT = 32;
+
+    bool output[PIN_COUNT] = {};
+    bool level[PIN_COUNT] = {};
+    std::vector<PinWrite> writes;
+
+    void setOutput(uint8_t pin) override;
+    void write(uint8_t pin, bool high) override;
+    void writeMask(uint32_t mask, uint32_t levels) override;
+
+    /**
+     * @return Current pin levels (bit n = GPIOn)
+     */
+    uint32_t levels() const;
+};
+
+/**
+ * UART whose receive side is fed by inject() and whose transmit side is captured.
+ * inject() plays the role of the receive interrupt: it pushes into the same
+ * SPSC ring as the firmware, with the same overrun accounting. Transmitted
+ * bytes leave a 128-byte FIFO at the baud rate in simulated time.
+ */
+class FakeUart : public Uart {
+public:
+    static const size_t TX_FIFO_SIZE = 128;
+
+    LineConfig line;
+    bool pulseMeasurement = true;   // false: like a UART without pulse counters
+    std::vector<uint8_t> tx;
+    std::vector<uint64_t> txDoneUs;  // When each byte of tx finished on the wire
+
+    void begin(unsigned long baudRate) override { line = LineConfig(); line.baud = baudRate; }
+    void setLineConfig(const LineConfig& config) override { line = config; lineChanges++; }
+    LineConfig getLineConfig() override { return line; }
+    void startPulseMeasurement() override { shortestPulseNs = 0; }
+    unsigned long getShortestPulseNs() override { return pulseMeasurement ? shortestPulseNs : 0; }
+    size_t available() override { return rx.size(); }
+    size_t read(uint8_t* buffer, size_t length) override { return rx.pop(buffer, length); }
+    size_t write(const uint8_t* data, size_t length) override;
+    size_t availableForWrite() override;
+    bool txIdle() override;
+    void setBreak(bool on) override { if (on && !breakOn) breaks++; breakOn = on; }
+    unsigned long setTxGap(unsigned long gapUs) override;
+    void fenceUntil(unsigned long untilUs) override;
+    UartStats getStats() override;
+
+    /**
+     * Bytes handed over by the driver: dropped while a fence is up
+     */
+    void inject(const uint8_t* data, size_t length);
+
+    /**
+     * Count characters the receiver rejected (bad stop or parity bit)
+     */
+    void injectFramingErrors(unsigned long count);
+
+    /**
+     * Report a pulse seen on the RX line to the pulse measurement
+     */
+    void notePulse(unsigned long ns);
+
+    unsigned long lineChanges = 0;
+    bool breakOn = false;
+    unsigned long breaks = 0;       // Times setBreak() started a break
+
+private:
+    SpscRing<UART_RX_RING_SIZE> rx;
+    UartStats stats;
+    uint64_t wireIdleUs = 0;  // When the transmitter may start the next byte
+    unsigned long txGapUs = 0;
+    unsigned long fenceEndUs = 0;
+    bool fenced = false;
+
+    unsigned long shortestPulseNs = 0;
+
+    uint64_t byteTimeUs() const { return line.baud ? line.bitsPerChar() * 1000000ULL / line.baud : 0; }
+    uint64_t gapUs() const;
+};
+
+/**
+ * Console writing to stdout, can be muted for benchmarks
+ */
+class StdoutConsole : public Console {
+public:
+    bool muted = false;
+
+    size_t write(const uint8_t* data, size_t length) override;
+};
+
+/**
+ * WebSocket transport that records outgoing frames and injects client events
+ */
+class FakeWebSocket : public WebSocketTransport {
+public:
+    struct Frame {
+        uint8_t num;        // Client number, BROADCAST for broadcasts
+        bool text;
+        std::vector<uint8_t> payload;
+    };
+
+    static const uint8_t BROADCAST = 0xFF;
+    static const uint8_t MAX_CLIENTS = 5;
+
+    explicit FakeWebSocket(uint16_t port) : port(port) {}
+
+    uint16_t port;
+    bool started = false;
+    bool connected[MAX_CLIENTS] = {};
+    bool captureFrames = true;
+    std::vector<Frame> frames;
+    size_t textFrames = 0;
+    size_t binaryFrames = 0;
+    size_t payloadBytes = 0;
+
+    bool begin() override { started = true; return true; }
+    void loop() override {}
+    void onEvent(WsEventHandler eventHandler) override { handler = eventHandler; }
+    bool sendText(uint8_t num, const uint8_t* data, size_t length) override;
+    bool sendBinary(uint8_t num, const uint8_t* data, size_t length) override;
+    bool broadcastText(const uint8_t* data, size_t length) override;
+    bool broadcastBinary(const uint8_t* data, size_t length) override;
+    size_t connectedClients() override;
+
+    // Simulated client activity
+    void connect(uint8_t num, const char* path = "/");
+    void disconnect(uint8_t num);
+    void receiveText(uint8_t num, const char* text);
+    void receiveBinary(uint8_t num, const uint8_t* data, size_t length);
+
+    /**
+     * Concatenate the payloads of all captured frames
+     */
+    std::string capturedPayload() const;
+
+private:
+    WsEventHandler handler = nullptr;
+
+    bool record(uint8_t num, bool text, const uint8_t* data, size_t length);
+};
+
+/**
+ * In-memory TCP connection: request bytes are preloaded, response is captured
+ */
+class FakeTcpConnection : public TcpConnection {
+public:
+    std::deque<uint8_t> input;
+    std::string output;
+    bool open = true;
+
+    size_t write(const uint8_t* data, size_t length) override;
+    size_t available() override { return input.size(); }
+    size_t read(uint8_t* buffer, size_t length) override;
+    bool writable() override { return open; }
+    bool connected() override { return open; }
+    void stop() override { open = false; }
+};
+
+/**
+ * TCP server handing out queued in-memory connections
+ */
+class FakeTcpServer : public TcpServer {
+public:
+    explicit FakeTcpServer(uint16_t port) : port(port) {}
+
+    uint16_t port;
+    bool started = false;
+    std::vector<std::unique_ptr<FakeTcpConnection>> connections;
+
+    bool begin() override { started = true; return true; }
+    TcpConnection* accept() override;
+
+    /**
+     * Queue a client connection that will send the given request bytes
+     */
+    FakeTcpConnection* queueConnection(const char* request);
+
+private:
+    size_t nextPending = 0;
+};
+
+class MemoryFileSystem;
+
+class MemoryFile : public File {
+public:
+    MemoryFileSystem* owner = nullptr;
+    std::vector<uint8_t>* data = nullptr;
+    size_t position = 0;
+    bool inUse = false;
+
+    size_t size() override { return data->size(); }
+    size_t available() override { return data->size() - position; }
+    size_t read(uint8_t* buffer, size_t length) override;
+    size_t write(const uint8_t* bytes, size_t length) override;
+    bool seek(size_t offset) override;
+    void close() override { inUse = false; }
+};
+
+/**
+ * Filesystem backed by a path -> contents map.
+ *
+ * Optionally times writes like NOR flash under LittleFS: each write erases
+ * every sector it touches (a partly written last sector is copied to a fresh
+ * one) and programs its bytes page by page. The CPU cannot run code from
+ * flash meanwhile; busyUntilUs tells the simulation how long it is halted.
+ */
+class MemoryFileSystem : public FileSystem {
+public:
+    static const size_t SECTOR_SIZE = 4096;
+    static const size_t PAGE_SIZE = 256;
+
+    std::map<std::string, std::vector<uint8_t>> files;
+    unsigned long sectorEraseUs = 0;
+    unsigned long pageProgramUs = 0;
+    uint64_t busyUntilUs = 0;
+    unsigned long sectorErases = 0;
+    unsigned long bytesWritten = 0;
+
+    bool begin() override { return true; }
+    bool exists(const char* path) override { return files.count(path) != 0; }
+    File* open(const char* path, const char* mode) override;
+
+    void addFile(const char* path, const char* contents);
+
+    /**
+     * Account for appending length bytes to a file of size bytes
+     */
+    void noteWrite(size_t size, size_t length);
+
+private:
+    static const size_t MAX_OPEN_FILES = 4;
+
+    MemoryFile openFiles[MAX_OPEN_FILES];
+};
+
+// Access to the fake instances behind the hal:: bindings
+SimClock& simClock();
+FakeGpio& fakeGpio();
+FakeUart& fakeSbcUart();
+StdoutConsole& stdoutConsole();
+MemoryFileSystem& memoryFileSystem();
+
+/**
+ * @return Transport created for the port, or nullptr if none was created
+ */
+FakeWebSocket* webSocketOnPort(uint16_t port);
+FakeTcpServer* tcpServerOnPort(uint16_t port);
+
+/**
+ * Heap allocations made through operator new since start (see heap_counter.cpp)
+ */
+unsigned long heapAllocations();
+unsigned long heapAllocatedBytes();
+
+} // namespace native
+} // namespace hal
+
+#endif // HAL_NATIVE_H
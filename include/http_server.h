@@ -0,0 +1,262 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "pins.h"
+#include "session_recorder.h"
+#include "web_assets.h"
+
+class KeystrokeTracer;
+class MetricsExport;
+
+/**
+ * Non-blocking HTTP/1.1 server for the web assets.
+ *
+ * Every connection is a small state machine advanced by loop(): the request
+ * is parsed as its bytes arrive, and a file is streamed one HTTP_CHUNK_SIZE
+ * piece per connection per call, so serving a page never holds up the
+ * caller for more than a few chunks. Connections stay open between requests
+ * (keep-alive), and each file carries an ETag computed from its contents so
+ * a reloading browser gets 304 Not Modified instead of the file again.
+ *
+ * Files embedded in the firmware (web_assets.h) are served straight from
+ * flash with their build-time ETag; LittleFS is only consulted for other
+ * paths, or first when built with WEB_ASSETS_LITTLEFS_OVERRIDE.
+ *
+ * /record.cast?channel=<n>&from=<s>&to=<s> streams a channel of the session
+ * recording as an asciicast file, generated chunk by chunk
+ * (Transfer-Encoding: chunked); from and to are seconds of recording and
+ * both optional. One download runs at a time.
+ *
+ * /metrics serves the device's counters in the Prometheus text format
+ * (metrics.h), chunked like the recording; one scrape runs at a time.
+ * /trace.json serves the keystroke latency histograms (keystroke_trace.h).
+ */
+class HttpServer {
+public:
+    /**
+     * Start listening
+     * @param port TCP port
+     * @param files Filesystem holding the assets (plain or .gz)
+     * @return true if the server was started
+     */
+    bool begin(uint16_t port, hal::FileSystem* files);
+
+    /**
+     * Accept new connections and advance every open one by one step
+     */
+    void loop();
+
+    /**
+     * @return Number of open connections
+     */
+    size_t activeConnections() const;
+
+    /**
+     * @return Number of responses sent since start (including 304s)
+     */
+    unsigned long getResponses() const { return responses; }
+
+    /**
+     * @return Number of 304 Not Modified responses since start
+     */
+    unsigned long getNotModified() const { return notModified; }
+
+    /**
+     * Serve /metrics from this exporter (404 until set)
+     */
+    void setMetrics(MetricsExport* metrics) { this->metrics = metrics; }
+
+    /**
+     * Serve /trace.json from this tracer (404 until set)
+     */
+    void setTracer(const KeystrokeTracer* tracer) { this->tracer = tracer; }
+
+private:
+    enum class State : uint8_t {
+        Free,       // Slot unused
+        Reading,    // Waiting for the rest of the request headers
+        Hashing,    // Computing the ETag of the requested file
+        Sending     // Writing the response headers and body
+    };
+
+    // Body generated while it is sent, in chunked encoding
+    enum class Stream : uint8_t {
+        None,
+        Recording,
+        Metrics,
+        Trace
+    };
+
+    static const size_t LINE_SIZE = 256;          // Longer header lines are truncated
+    static const size_t PATH_SIZE = 96;
+    static const size_t QUERY_SIZE = 64;
+    static const size_t ETAG_SIZE = 24;           // "xxxxxxxx-xxxxxxxx" and quotes
+    static const size_t HEADER_SIZE = 320;
+    static const size_t ETAG_CACHE_SIZE = 8;
+    static const unsigned long SEND_TIMEOUT_MS = 10000;
+
+    struct Connection {
+        hal::TcpConnection* client = nullptr;
+        State state = State::Free;
+        unsigned long lastActivity = 0;
+
+        // Request being parsed
+        char line[LINE_SIZE];
+        size_t lineLength = 0;
+        bool requestLineSeen = false;
+        bool head = false;          // HEAD: headers only
+        bool badMethod = false;
+        bool lineTruncated = false; // The current line went past LINE_SIZE
+        bool uriTooLong = false;    // The target did not fit path or query
+        bool keepAlive = true;
+        bool http10 = false;        // HTTP/1.0: no chunked encoding
+        char path[PATH_SIZE];
+        char query[QUERY_SIZE];
+        char ifNoneMatch[ETAG_SIZE];
+
+        // Response being sent: an embedded asset or a file
+        const WebAsset* asset = nullptr;
+        size_t assetSent = 0;
+        hal::File* file = nullptr;
+        char filePath[PATH_SIZE + 4];
+        uint32_t hash = 0;
+        char header[HEADER_SIZE];
+        size_t headerLength = 0;
+        size_t headerSent = 0;
+        bool sendBody = false;
+        Stream stream = Stream::None;
+        bool streamEnded = false;   // Trace: the JSON went out in one chunk
+    };
+
+    struct EtagEntry {
+        char path[PATH_SIZE + 4] = "";
+        size_t size = 0;
+        uint32_t hash = 0;
+    };
+
+    hal::TcpServer* server = nullptr;
+    hal::FileSystem* fileSystem = nullptr;
+    Connection connections[HTTP_MAX_CONNECTIONS];
+    EtagEntry etagCache[ETAG_CACHE_SIZE];
+    size_t nextEtagSlot = 0;
+    uint8_t chunk[HTTP_CHUNK_SIZE];   // Shared: loop() runs on one task
+    RecordingExport recordingExport;
+    Connection* exportConnection = nullptr;
+    MetricsExport* metrics = nullptr;
+    Connection* metricsConnection = nullptr;
+    const KeystrokeTracer* tracer = nullptr;
+    unsigned long responses = 0;
+    unsigned long notModified = 0;
+
+    /**
+     * Read and parse whatever request bytes have arrived
+     */
+    void readRequest(Connection& connection);
+
+    /**
+     * Handle one complete header line (empty line: end of request)
+     */
+    void processLine(Connection& connection);
+
+    /**
+     * Pick the response once the request headers are complete
+     */
+    void startResponse(Connection& connection);
+
+    /**
+     * Hash one chunk of the requested file
+     */
+    void continueHashing(Connection& connection);
+
+    /**
+     * Queue the response headers for a file whose ETag is known
+     */
+    void respondWithFile(Connection& connection);
+
+    /**
+     * Queue the response headers for an embedded asset
+     */
+    void respondWithAsset(Connection& connection);
+
+    /**
+     * Start streaming the recording export requested by the query string
+     */
+    void respondWithRecording(Connection& connection);
+
+    /**
+     * Start streaming the metrics page
+     */
+    void respondWithMetrics(Connection& connection);
+
+    /**
+     * Start sending the keystroke trace report
+     */
+    void respondWithTrace(Connection& connection);
+
+    /**
+     * Queue the headers of a chunked 200 response; HTTP/1.0 clients get the
+     * body unframed and the connection closed after it
+     */
+    void respondWithStream(Connection& connection, const char* headers);
+
+    /**
+     * Write the next chunk of a generated body (unchunked for HTTP/1.0)
+     */
+    void sendStreamChunk(Connection& connection);
+
+    /**
+     * Queue 200 (or 304 when the client's copy matches etag) headers
+     * @return true if the body follows, false for 304
+     */
+    bool respondWithBody(Connection& connection, const char* mimeType, size_t length, bool gzipped,
+                         const char* etag);
+
+    /**
+     * Queue a complete response with a short text body
+     */
+    void respondWithText(Connection& connection, const char* status, const char* body);
+
+    /**
+     * Write the next piece of headers or body
+     */
+    void sendResponse(Connection& connection);
+
+    /**
+     * Response complete: wait for the next request or close
+     */
+    void finishResponse(Connection& connection);
+
+    void closeFile(Connection& connection);
+    void endStream(Connection& connection);
+    void close(Connection& connection);
+    void resetRequest(Connection& connection);
+
+    /**
+     * Look up a file, preferring the exact path over its .gz version
+     * @return true if found, false otherwise
+     */
+    bool findFile(const char* path, char* actualPath, size_t actualPathSize);
+
+    static const char* getMimeType(const char* filename);
+
+    /**
+     * Find name=value in a query string
+     * @return Value (up to the next '&'), nullptr if absent
+     */
+    static const char* findQueryValue(const char* query, const char* name);
+
+    /**
+     * Parse seconds with up to three decimals, e.g. "90" or "12.5"
+     * @return false if malformed
+     */
+    static bool parseSeconds(const char* text, unsigned long& ms);
+
+    bool lookupEtag(const char* path, size_t size, uint32_t& hash) const;
+    void storeEtag(const char* path, size_t size, uint32_t hash);
+    static void formatEtag(char* etag, size_t etagSize, uint32_t hash, size_t size);
+};
+
+#endif // HTTP_SERVER_H
@@ -0,0 +1,123 @@
+#ifndef KEYSTROKE_TRACE_H
+#define KEYSTROKE_TRACE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "latency_stats.h"
+
+/**
+ * Where the time of one traced keystroke went, in microseconds
+ */
+struct KeystrokeTrace {
+    uint32_t id = 0;                // Chosen by the client (TRACE:<id>)
+    unsigned long queueUs = 0;      // WebSocket receive -> written to the UART
+    unsigned long sbcUs = 0;        // Written to the UART -> first byte back (wire and SBC)
+    unsigned long forwardUs = 0;    // First byte back -> sent in a WebSocket frame
+};
+
+/**
+ * Follows one keystroke at a time from the WebSocket to the SBC and its
+ * echo back, so typing latency can be split between the firmware's queues,
+ * the SBC and (by the client, which knows the round trip) the network.
+ *
+ * A client sends TRACE:<id> and then the keystroke. The trace advances one
+ * stage per task: the network task starts it and completes it, the UART
+ * task stamps the UART write and the first byte received afterwards on the
+ * channel, which is taken to be the echo. Only the network task may start
+ * or abandon a trace, with the bridge lock held, so a stage is never
+ * overwritten by two tasks at once. Traces without an echo within
+ * TIMEOUT_MS are abandoned.
+ *
+ * Completed traces feed one LatencyHistogram per segment and a short list
+ * of recent traces, which the client matches by id against its own round
+ * trip times. When nobody traces, each stage costs one atomic load.
+ */
+class KeystrokeTracer {
+public:
+    static const size_t SEGMENTS = 3;
+    static const size_t RECENT_TRACES = 8;
+    static const unsigned long TIMEOUT_MS = 1000;
+
+    /**
+     * Start tracing a keystroke about to be queued (network task, bridge
+     * lock held); an unfinished trace is abandoned
+     * @param channel Channel the keystroke is for
+     * @param txIndex Bytes queued for the channel before the keystroke
+     */
+    void start(uint32_t id, uint8_t channel, unsigned long txIndex, unsigned long nowUs);
+
+    /**
+     * The UART stage wrote input (bridge lock held)
+     * @param txTotal Bytes written to the channel since start
+     */
+    void noteTransmitted(uint8_t channel, unsigned long txTotal, unsigned long nowUs);
+
+    /**
+     * The UART stage queued output of the interactive channel for the
+     * network stage (bridge lock held)
+     * @param liveIndex Live output bytes queued before it since start
+     */
+    void noteReceived(uint8_t channel, unsigned long liveIndex, unsigned long nowUs);
+
+    /**
+     * Live output was sent to the WebSocket clients (network task)
+     * @param liveTotal Live output bytes sent since start
+     */
+    void noteSent(unsigned long liveTotal, unsigned long nowUs);
+
+    /**
+     * @return true if the echo of the traced keystroke is on its way to the clients
+     */
+    bool awaitingFrame() const { return stage.load(std::memory_order_acquire) == Stage::Echoed; }
+
+    /**
+     * @return true if a trace has waited longer than TIMEOUT_MS
+     */
+    bool expired(unsigned long nowUs) const;
+
+    /**
+     * Give up the current trace (network task, bridge lock held)
+     */
+    void abandon();
+
+    /**
+     * Histograms, counters and recent traces as JSON (network task)
+     * @param buffer Output buffer, NUL-terminated
+     * @return Length of the JSON, with fewer recent traces if short of room
+     */
+    size_t formatJson(char* buffer, size_t size) const;
+
+    unsigned long getCompleted() const { return completed.load(std::memory_order_relaxed); }
+    unsigned long getAbandoned() const { return abandoned.load(std::memory_order_relaxed); }
+
+private:
+    enum class Stage : uint8_t {
+        Idle,
+        Queued,         // Waiting for the UART write
+        Transmitted,    // Waiting for the echo
+        Echoed          // Waiting for the WebSocket frame
+    };
+
+    std::atomic<Stage> stage{Stage::Idle};
+
+    // Written by the task that moves the trace into the next stage
+    uint32_t id = 0;
+    uint8_t channel = 0;
+    unsigned long txIndex = 0;
+    unsigned long liveIndex = 0;
+    unsigned long receivedUs = 0;
+    unsigned long transmittedUs = 0;
+    unsigned long echoedUs = 0;
+
+    // Network task
+    LatencyHistogram histograms[SEGMENTS];
+    LatencyStats segments[SEGMENTS];
+    KeystrokeTrace recent[RECENT_TRACES];
+    size_t recentCount = 0;
+    size_t nextRecent = 0;
+    std::atomic<unsigned long> completed{0};
+    std::atomic<unsigned long> abandoned{0};
+};
+
+#endif // KEYSTROKE_TRACE_H
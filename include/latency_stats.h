@@ -0,0 +1,111 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Running count, mean and maximum of a duration in microseconds.
+ * One task records, any task may read: the fields are atomics so a reader
+ * sees a slightly stale but never torn snapshot.
+ */
+class LatencyStats {
+public:
+    /**
+     * Add one sample
+     * @param us Duration in microseconds
+     */
+    void record(unsigned long us);
+
+    /**
+     * Forget all samples (call from the recording task)
+     */
+    void reset();
+
+    unsigned long getCount() const;
+    unsigned long getMeanUs() const;
+    unsigned long getMaxUs() const;
+
+private:
+    std::atomic<unsigned long> count{0};
+    std::atomic<unsigned long> totalUs{0};
+    std::atomic<unsigned long> maxUs{0};
+};
+
+/**
+ * Distribution of a quantity in power-of-two buckets, as a Prometheus
+ * histogram needs it: the counts only grow. One task records, any task may
+ * read.
+ * @tparam Buckets Buckets with an upper bound, followed by one for the rest
+ * @tparam Smallest Upper bound of the first bucket
+ */
+template <size_t Buckets, unsigned long Smallest>
+class Histogram {
+public:
+    static const size_t BUCKETS = Buckets;
+    static const unsigned long SMALLEST = Smallest;
+
+    /**
+     * Add one observation
+     */
+    void record(unsigned long value) {
+        size_t bucket = 0;
+        while (bucket < BUCKETS && value > upperBound(bucket)) {
+            bucket++;
+        }
+        buckets[bucket].store(buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param bucket 0 to BUCKETS (the last one has no upper bound)
+     * @return Observations that fell in the bucket (not cumulative)
+     */
+    unsigned long getBucket(size_t bucket) const {
+        return bucket <= BUCKETS ? buckets[bucket].load(std::memory_order_relaxed) : 0;
+    }
+
+    /**
+     * @return Total of all observations (wraps like a 32-bit counter)
+     */
+    unsigned long getSum() const { return sum.load(std::memory_order_relaxed); }
+
+    static unsigned long upperBound(size_t bucket) { return SMALLEST << bucket; }
+
+private:
+    std::atomic<unsigned long> buckets[BUCKETS + 1] = {};
+    std::atomic<unsigned long> sum{0};
+};
+
+// Bytes per WebSocket frame: at most 16, 32, ... 2048, then the rest
+typedef Histogram<8, 16> SizeHistogram;
+
+// Durations in microseconds: at most 250 us, 500 us, ... 256 ms, then the rest
+typedef Histogram<11, 250> LatencyHistogram;
+
+/**
+ * Measures the period of a loop: tick() once per iteration, and the gaps
+ * between ticks are recorded. The maximum gap is the worst-case time the
+ * loop's work waited, i.e. its jitter on top of the nominal period.
+ */
+class LoopTimer {
+public:
+    /**
+     * Mark the start of an iteration
+     * @param nowUs Current time in microseconds
+     */
+    void tick(unsigned long nowUs);
+
+    /**
+     * @return Distribution of the time between consecutive ticks
+     */
+    const LatencyStats& getPeriods() const;
+
+private:
+    LatencyStats periods;
+    unsigned long lastTickUs = 0;
+    bool started = false;
+};
+
+#endif // LATENCY_STATS_H
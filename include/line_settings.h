@@ -0,0 +1,121 @@
+#ifndef LINE_SETTINGS_H
+#define LINE_SETTINGS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+
+// Rates a channel can be set to
+static const unsigned long LINE_BAUD_MIN = 300;
+static const unsigned long LINE_BAUD_MAX = 5000000;
+
+/**
+ * Line settings of one SBC, applied whenever the mux selects it
+ */
+struct LineSettings {
+    hal::LineConfig config;
+    bool autoBaud = false;  // config.baud is detected (the character format is not)
+};
+
+/**
+ * Parse "<baud|AUTO>[,<data bits><N|E|O><stop bits>]", e.g. "1500000",
+ * "AUTO" or "115200,7E1"; the format defaults to 8N1
+ * @param text Settings, not NUL-terminated
+ * @param length Length of text
+ * @param settings Receives the settings (AUTO keeps settings.config.baud)
+ * @return true if valid, false otherwise (settings unchanged)
+ */
+bool parseLineSettings(const char* text, size_t length, LineSettings& settings);
+
+/**
+ * Format the character format as "8N1"
+ * @param buffer Output buffer of at least 4 bytes
+ */
+void formatLineFormat(char* buffer, const hal::LineConfig& config);
+
+/**
+ * Finds a line's baud rate from what the UART receives while it listens at
+ * candidate rates.
+ *
+ * At the right rate console output is nearly all printable and free of
+ * framing errors; at a wrong one the receiver samples the bits at the wrong
+ * places and sees binary garbage with bad stop bits. Each candidate gets one
+ * window of MIN_SAMPLE_BYTES bytes. When the UART can measure the shortest
+ * pulse on the line (one bit time), the nearest candidate is tried first, so
+ * a talking SBC is usually locked after a single window.
+ *
+ * Plain logic without I/O: the caller feeds the bytes and retunes the UART.
+ */
+class BaudDetector {
+public:
+    enum class Verdict : uint8_t {
+        Listening,  // Keep receiving at getCandidate()
+        Retune,     // Listen at getCandidate() from now on, in a new window
+        Locked      // getCandidate() is the line's rate
+    };
+
+    static const size_t CANDIDATE_COUNT = 12;
+    static const unsigned long CANDIDATES[CANDIDATE_COUNT];
+
+    /**
+     * Start detecting, listening first at the candidate nearest to baud
+     */
+    void start(unsigned long baud);
+
+    /**
+     * Abandon detection
+     */
+    void stop();
+
+    bool isDetecting() const { return detecting; }
+    unsigned long getCandidate() const { return CANDIDATES[index]; }
+
+    /**
+     * @return Windows judged since start()
+     */
+    unsigned long getWindows() const { return windows; }
+
+    /**
+     * Score bytes received at getCandidate() in the current window
+     */
+    void feed(const uint8_t* data, size_t length);
+
+    /**
+     * Judge the current window once it holds enough bytes
+     * @param framingErrors Framing and parity errors since the window started
+     * @param pulseBaud Rate of the shortest pulse on the line, 0 if unknown
+     * @return What the caller must do next
+     */
+    Verdict evaluate(unsigned long framingErrors, unsigned long pulseBaud);
+
+    /**
+     * @return Candidate nearest to baud (by ratio)
+     */
+    static size_t nearestCandidate(unsigned long baud);
+
+private:
+    static const size_t MIN_SAMPLE_BYTES = 32;
+    // Lock: at least 90% printable and at most one framing error per 32
+    // bytes. After a pass without a lock, the best window is taken if it
+    // scored at least FALLBACK_SCORE (per mille).
+    static const unsigned long LOCK_PRINTABLE_PERCENT = 90;
+    static const unsigned long LOCK_BYTES_PER_ERROR = 32;
+    static const long FALLBACK_SCORE = 750;
+
+    bool detecting = false;
+    size_t index = 0;           // Candidate being listened at
+    uint32_t tried = 0;         // Candidates judged in this pass (bit per index)
+    bool pulseUsed = false;     // The pulse hint was followed in this pass
+    size_t windowBytes = 0;
+    size_t windowPrintable = 0;
+    unsigned long windows = 0;
+    long bestScore = -1;
+    size_t bestIndex = 0;
+
+    /**
+     * Listen at candidate from now on
+     */
+    void retune(size_t candidate);
+};
+
+#endif // LINE_SETTINGS_H
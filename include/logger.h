@@ -0,0 +1,128 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+#include "pins.h"
+#include "spsc_ring.h"
+
+// Log levels: a statement above LOG_LEVEL compiles to nothing, so its
+// arguments are never evaluated and it costs no code or cycles.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5   // Adds a hex dump of every interactive SBC byte
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/**
+ * Deferred console output.
+ *
+ * Producers never touch the console: messages are formatted on the caller's
+ * stack and copied into a ring that a low-priority task drains with drain().
+ * A full ring drops the whole message and counts it, it never blocks.
+ *
+ * Messages from any task share one ring whose producers are serialised by a
+ * short critical section (the ESP32-C3 has no compare-and-swap to make a
+ * multi-producer ring lock-free). The per-byte trace of the UART task has a
+ * ring of its own that it alone writes, so the hot path takes no lock.
+ */
+class Logger {
+public:
+    static const size_t LINE_SIZE = 160;
+
+    /**
+     * Queue a formatted message (truncated to LINE_SIZE - 1 bytes)
+     * @param format printf-style format
+     */
+    void printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * Queue text as is
+     * @param text Bytes to log
+     * @param length Number of bytes
+     */
+    void write(const char* text, size_t length);
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+    /**
+     * Queue a trace of received bytes: printable ASCII as is, anything else
+     * as [0xNN]. Only the UART task may call this (single producer).
+     * @param data Bytes to trace
+     * @param length Number of bytes
+     */
+    void traceBytes(const uint8_t* data, size_t length);
+#endif
+
+    /**
+     * Write everything queued so far to output, preceded by a notice when
+     * messages were dropped (call from a single consumer task)
+     * @param output Destination, normally hal::console()
+     * @return Number of bytes written
+     */
+    size_t drain(hal::Print& output);
+
+    /**
+     * @return Number of messages dropped because the ring was full
+     */
+    unsigned long getDropped() const;
+
+private:
+    SpscRing<LOG_RING_SIZE> ring;
+    std::mutex producerMutex;               // Serialises producers of ring
+    std::atomic<unsigned long> dropped{0};  // Written under producerMutex
+    unsigned long reportedDropped = 0;
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+    SpscRing<LOG_TRACE_RING_SIZE> traceRing;
+    std::atomic<unsigned long> droppedTrace{0};  // Bytes, written by the UART task only
+    unsigned long reportedTrace = 0;
+#endif
+};
+
+/**
+ * @return The logger shared by all tasks
+ */
+Logger& logger();
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) logger().printf(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) logger().printf(__VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) logger().printf(__VA_ARGS__)
+#define LOG_INFO_TEXT(text, length) logger().write(text, length)
+#else
+#define LOG_INFO(...) do {} while (0)
+#define LOG_INFO_TEXT(text, length) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) logger().printf(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE_BYTES(data, length) logger().traceBytes(data, length)
+#else
+#define LOG_TRACE_BYTES(data, length) do {} while (0)
+#endif
+
+#endif // LOGGER_H
@@ -0,0 +1,48 @@
+#ifndef LZ_BLOCK_H
+#define LZ_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Small LZ77 block codec for console text.
+ *
+ * A block is compressed on its own (no dictionary carried over), so any
+ * block can be decoded without its predecessors. The format follows LZ4's
+ * sequence layout: a token byte holding the literal count (high nibble) and
+ * the match length minus LZ_MIN_MATCH (low nibble), each extended with 255
+ * bytes when it reaches 15, the literals, then a 16-bit little-endian match
+ * offset. The last sequence holds only literals.
+ *
+ * Matches are found with a single-probe hash table, which is fast and needs
+ * no heap; repetitive console output (timestamps, prompts, escape
+ * sequences) typically shrinks to a half or a third.
+ */
+
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_HASH_BITS = 10;
+static const size_t LZ_HASH_SIZE = (size_t)1 << LZ_HASH_BITS;
+static const size_t LZ_MAX_INPUT = 65535;   // Offsets are 16 bits
+
+/**
+ * Compress a block
+ * @param input Bytes to compress (at most LZ_MAX_INPUT)
+ * @param length Number of bytes
+ * @param output Destination buffer
+ * @param capacity Size of output
+ * @param table Scratch hash table of LZ_HASH_SIZE entries
+ * @return Compressed length, 0 if it would not fit in capacity
+ */
+size_t lzCompress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity, uint16_t* table);
+
+/**
+ * Decompress a block
+ * @param input Compressed bytes
+ * @param length Number of compressed bytes
+ * @param output Destination buffer
+ * @param capacity Size of output
+ * @return Decompressed length, 0 if the block is corrupt or does not fit
+ */
+size_t lzDecompress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity);
+
+#endif // LZ_BLOCK_H
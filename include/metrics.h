@@ -0,0 +1,109 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "pins.h"
+#include "serial_bridge.h"
+#include "session_recorder.h"
+#include "websocket_server.h"
+
+/**
+ * Mean and maximum of a LatencyStats
+ */
+struct TimingSnapshot {
+    unsigned long meanUs = 0;
+    unsigned long maxUs = 0;
+};
+
+/**
+ * Everything /metrics reports, read at the start of a scrape so the page
+ * is consistent however slowly it is sent
+ */
+struct MetricsSnapshot {
+    unsigned long uptimeMs = 0;
+    ChannelCounters channels[MAX_CHANNELS];
+    unsigned long baud[MAX_CHANNELS] = {};
+    int interactiveChannel = 0;
+    hal::UartStats uart;
+    OutputStats output;
+    unsigned long frameBuckets[SizeHistogram::BUCKETS + 1] = {};
+    unsigned long frameBytes = 0;
+    size_t terminalClients = 0;
+    size_t channelClients = 0;
+    unsigned long httpResponses = 0;
+    unsigned long httpNotModified = 0;
+    hal::HeapStats heap;
+    TimingSnapshot uartPeriod;
+    TimingSnapshot networkPeriod;
+    TimingSnapshot forwardLatency;
+    TimingSnapshot switchLatency;
+    bool recording = false;
+    RecorderStats recorder;
+    size_t triggerPatterns = 0;
+    char triggerNames[TriggerMatcher::MAX_PATTERNS][TriggerMatcher::MAX_PATTERN_LENGTH + 1] = {};
+    unsigned long triggerMatches[MAX_CHANNELS][TriggerMatcher::MAX_PATTERNS] = {};
+    unsigned long droppedAlerts = 0;
+};
+
+/**
+ * Streams the device's counters in the Prometheus text format (version
+ * 0.0.4) for GET /metrics: bytes per channel, UART errors, WebSocket frame
+ * counts, sizes and compression, clients, heap, task timing, the session
+ * recorder and trigger matches.
+ *
+ * The counters belong to the components that update them, each written by
+ * one task with relaxed atomic loads and stores (the ESP32-C3 has no atomic
+ * read-modify-write), so they stay on in production. The export copies them
+ * in begin() and formats one line at a time, so it needs no buffer for the
+ * whole page. Timing figures are gauges: LatencyStats halves its history
+ * rather than overflow, so its totals are not counters.
+ */
+class MetricsExport {
+public:
+    /**
+     * @param bridge Serial bridge (per-channel bytes, UART, task timing)
+     * @param server WebSocket server (frames, clients, HTTP)
+     * @param recorder Session recorder, nullptr if recording is off
+     */
+    void setSources(SerialBridge* bridge, WebSocketServer* server, SessionRecorder* recorder);
+
+    /**
+     * Take a snapshot and start the page
+     * @return false if no sources are set
+     */
+    bool begin();
+
+    /**
+     * Produce the next part of the page
+     * @return Bytes written to buffer, 0 once the page is complete
+     */
+    size_t read(uint8_t* buffer, size_t size);
+
+    void end() { open = false; }
+    bool isOpen() const { return open; }
+
+private:
+    static const size_t LINE_SIZE = 160;
+
+    SerialBridge* bridge = nullptr;
+    WebSocketServer* server = nullptr;
+    SessionRecorder* recorder = nullptr;
+
+    MetricsSnapshot snapshot;
+    bool open = false;
+    size_t family = 0;      // Index into the family table
+    size_t step = 0;        // 0: HELP, 1: TYPE, then the samples
+    char line[LINE_SIZE];
+    size_t lineLength = 0;
+    size_t linePosition = 0;
+
+    /**
+     * Format the next line of the page
+     * @return false once there is nothing more
+     */
+    bool stageNext();
+};
+
+#endif // METRICS_H
@@ -1,53 +1,231 @@
 #ifndef MULTIPLEXER_H
 #define MULTIPLEXER_H
 
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
 #include "pins.h"
-#include <Arduino.h>
 
-class MultiplexerController {
+/**
+ * GPIO numbers of a group of mux control lines, least significant first
+ */
+template <uint8_t... Pins>
+struct PinList {
+    static constexpr size_t COUNT = sizeof...(Pins);
+    static constexpr uint8_t PINS[COUNT > 0 ? COUNT : 1] = {Pins...};
+    static constexpr uint32_t MASK = (0u | ... | (1u << Pins));
+};
+
+/**
+ * Wiring of one or more analog multiplexers to the select GPIOs.
+ *
+ * The binary address of a channel drives SelectPins. With EnablePins, chips
+ * sharing the select lines are cascaded: channel / 2^select lines picks the
+ * chip whose active-low enable input is pulled low, all others stay high.
+ * The level of every control line for every channel is computed at compile
+ * time, so a switch is one masked GPIO write and the mux never passes
+ * through another channel's address on the way.
+ */
+template <uint8_t Channels, typename SelectPins, typename EnablePins = PinList<>>
+struct MuxLayout {
+    static constexpr uint8_t CHANNELS = Channels;
+    static constexpr uint8_t CHIP_CHANNELS = 1u << SelectPins::COUNT;
+    static constexpr uint32_t MASK = SelectPins::MASK | EnablePins::MASK;
+    static constexpr uint32_t IDLE_LEVELS = MASK;  // All lines high: no chip enabled / last address
+
+    static_assert((SelectPins::MASK & EnablePins::MASK) == 0, "A pin cannot be both select and enable");
+    static_assert(Channels <= CHIP_CHANNELS * (EnablePins::COUNT > 0 ? EnablePins::COUNT : 1),
+                  "Not enough select/enable lines for the channel count");
+
+    /**
+     * @return Levels of the control lines (bit n = GPIOn) selecting channel
+     */
+    static constexpr uint32_t levelsFor(uint8_t channel) {
+        uint32_t levels = 0;
+        uint8_t address = channel % CHIP_CHANNELS;
+        for (size_t bit = 0; bit < SelectPins::COUNT; bit++) {
+            if (address & (1u << bit)) levels |= 1u << SelectPins::PINS[bit];
+        }
+        for (size_t chip = 0; chip < EnablePins::COUNT; chip++) {
+            if (chip != channel / CHIP_CHANNELS) levels |= 1u << EnablePins::PINS[chip];
+        }
+        return levels;
+    }
+
+    static constexpr std::array<uint32_t, Channels> makeLevels() {
+        std::array<uint32_t, Channels> table{};
+        for (uint8_t channel = 0; channel < Channels; channel++) {
+            table[channel] = levelsFor(channel);
+        }
+        return table;
+    }
+
+    static constexpr std::array<uint32_t, Channels> LEVELS = makeLevels();
+
+    /**
+     * Configure the control lines as outputs, no channel selected
+     */
+    static void configure(hal::Gpio& gpio) {
+        for (size_t i = 0; i < SelectPins::COUNT; i++) gpio.setOutput(SelectPins::PINS[i]);
+        for (size_t i = 0; i < EnablePins::COUNT; i++) gpio.setOutput(EnablePins::PINS[i]);
+        gpio.writeMask(MASK, IDLE_LEVELS);
+    }
+
+    /**
+     * Route channel with a single write of all control lines
+     */
+    static void select(hal::Gpio& gpio, uint8_t channel) {
+        gpio.writeMask(MASK, LEVELS[channel]);
+    }
+
+    /**
+     * @param levels GPIO output levels (bit n = GPIOn)
+     * @return Channel those levels select, or -1 if none
+     */
+    static constexpr int decode(uint32_t levels) {
+        for (uint8_t channel = 0; channel < Channels; channel++) {
+            if ((levels & MASK) == LEVELS[channel]) return channel;
+        }
+        return -1;
+    }
+};
+
+// HP4067 / CD74HC4067: 16 channels, 4 select lines
+template <uint8_t S0, uint8_t S1, uint8_t S2, uint8_t S3>
+using Hp4067Layout = MuxLayout<16, PinList<S0, S1, S2, S3>>;
+
+// 74HC4051: 8 channels, 3 select lines
+template <uint8_t S0, uint8_t S1, uint8_t S2>
+using Hc4051Layout = MuxLayout<8, PinList<S0, S1, S2>>;
+
+// Two 4067s sharing S0-S3, each with its own active-low enable: 32 channels
+template <uint8_t S0, uint8_t S1, uint8_t S2, uint8_t S3, uint8_t Enable0, uint8_t Enable1>
+using Cascaded4067Layout = MuxLayout<32, PinList<S0, S1, S2, S3>, PinList<Enable0, Enable1>>;
+
+// The board's layout, chosen with MUX_TYPE in pins.h
+#if MUX_TYPE == MUX_TYPE_HC4051
+using BoardMuxLayout = Hc4051Layout<MUX_S0_PIN, MUX_S1_PIN, MUX_S2_PIN>;
+#elif MUX_TYPE == MUX_TYPE_CASCADED_4067
+using BoardMuxLayout = Cascaded4067Layout<MUX_S0_PIN, MUX_S1_PIN, MUX_S2_PIN, MUX_S3_PIN, MUX_EN0_PIN, MUX_EN1_PIN>;
+#else
+using BoardMuxLayout = Hp4067Layout<MUX_S0_PIN, MUX_S1_PIN, MUX_S2_PIN, MUX_S3_PIN>;
+#endif
+
+/**
+ * Per-channel receive statistics collected by the scan scheduler
+ */
+struct ChannelStats {
+    unsigned long dwellMs = 0;          // Total time the RX mux spent on the channel
+    unsigned long visits = 0;           // Number of times the channel was selected
+    unsigned long bytesCaptured = 0;    // Bytes received while selected
+    unsigned long bytesMissed = 0;      // Estimated bytes lost while not selected
+    unsigned long bytesPerSecond = 0;   // Smoothed rate observed while selected
+};
+
+/**
+ * Selects the SBC whose console reaches the UART, and time-shares the RX mux
+ * between channels in scan mode.
+ * @tparam Layout Mux wiring (MuxLayout)
+ * @tparam Channels Number of SBCs in use, at most Layout::CHANNELS
+ */
+template <typename Layout, uint8_t Channels>
+class MuxController {
+    static_assert(Channels > 0 && Channels <= Layout::CHANNELS, "The mux layout has too few channels");
+
 public:
+    static constexpr uint8_t CHANNELS = Channels;
+
     /**
      * Initialize the multiplexer control pins
      */
     void init();
 
     /**
-     * Select a specific channel (0-4 for SBC1-SBC5) with proper timing
-     * @param channel The channel number (0-4)
+     * Select a specific channel (0 for SBC1) at once, without waiting for
+     * the mux to settle: the caller discards what the UART receives in the
+     * meantime (see hal::Uart::fenceUntil).
+     * The channel also becomes the interactive channel for scan mode.
+     * @param channel The channel number (0 to Channels - 1)
      * @return true if successful, false if invalid channel
      */
     bool selectChannel(uint8_t channel);
 
-    /**
-     * Force immediate channel switch (bypasses timing restrictions)
-     * @param channel The channel number (0-4)
-     * @return true if successful, false if invalid channel
-     */
-    bool forceSelectChannel(uint8_t channel);
-
     /**
      * Check if a channel is valid
      * @param channel The channel number
-     * @return true if valid (0-4), false otherwise
+     * @return true if valid (0 to Channels - 1), false otherwise
      */
     bool isValidChannel(uint8_t channel) const;
 
     /**
      * Get the currently selected channel
-     * @return Current channel (0-4) or 255 if none
+     * @return Current channel or 255 if none
      */
     uint8_t getCurrentChannel() const;
 
+    /**
+     * Get the channel selected by the user (the one clients are viewing)
+     * @return Interactive channel
+     */
+    uint8_t getInteractiveChannel() const;
+
+    /**
+     * Enable or disable background scanning of all channels.
+     * Disabling returns the RX mux to the interactive channel.
+     * Bytes still pending in the UART must be drained before calling.
+     */
+    void setScanMode(bool enabled);
+
+    /**
+     * @return true if scan mode is enabled
+     */
+    bool isScanning() const;
+
+    /**
+     * Account bytes received on the current channel and advance the scan
+     * schedule. Call after draining the UART so that pending bytes are
+     * attributed to the channel they arrived on.
+     * @param bytesReceived Bytes read from the UART since the previous call
+     * @return true if the RX mux moved to another channel
+     */
+    bool scan(size_t bytesReceived);
+
+    /**
+     * Move the RX mux back to the interactive channel immediately (e.g.
+     * before transmitting). Bytes still pending in the UART must be drained
+     * before calling.
+     * @return true if the mux had to be switched
+     */
+    bool returnToInteractive();
+
+    /**
+     * Get receive statistics for a channel
+     * @param channel The channel number
+     * @return Statistics (dwell time includes the slice in progress)
+     */
+    ChannelStats getChannelStats(uint8_t channel) const;
+
 private:
     uint8_t currentChannel = 255;  // Invalid initial state
-    unsigned long lastSwitchTime = 0;  // Timestamp of last channel switch
+    uint8_t interactiveChannel = 0;  // Channel selected by the user
 
-    // Timing constants (in milliseconds)
-    static const unsigned long MIN_SWITCH_DELAY = 50;  // Minimum delay between switches
-    static const unsigned long SETTLING_DELAY_US = 100;  // Multiplexer settling time
+    // Scan scheduler state
+    bool scanning = false;
+    unsigned long sliceStart = 0;  // When the current channel was entered
+    unsigned long sliceBytes = 0;  // Bytes received during the current slice
+    unsigned long lastByteTime = 0;  // Last time bytes arrived in this slice
+    unsigned long leftAt[Channels] = {};  // When each channel was last deselected
+    ChannelStats stats[Channels];
 
-    // Channel selection bit mapping (S3 S2 S1 S0)
-    static const uint8_t channelBits[MAX_CHANNELS];
+    // Scan timing (in milliseconds)
+    static const unsigned long INTERACTIVE_SLICE_MS = 200;  // Dwell on the viewed channel
+    static const unsigned long BACKGROUND_SLICE_MS = 20;  // Minimum dwell on other channels
+    static const unsigned long BACKGROUND_MAX_SLICE_MS = 100;  // Dwell cap while a channel keeps talking
+    static const unsigned long BACKGROUND_IDLE_MS = 15;  // Silence that ends a background slice early
+    // Activity weighting: +1 scheduling weight per ACTIVITY_WEIGHT_BPS of observed rate
+    static const unsigned long ACTIVITY_WEIGHT_BPS = 500;
+    static const unsigned long MAX_ACTIVITY_WEIGHT = 4;
 
     /**
      * Internal channel selection without timing checks
@@ -55,6 +233,22 @@ private:
      * @return true if successful
      */
     bool setChannelBits(uint8_t channel);
+
+    /**
+     * Switch channels and update dwell/rate/missed-byte statistics
+     * @param channel The channel number
+     * @return true if successful
+     */
+    bool switchChannel(uint8_t channel);
+
+    /**
+     * Pick the background channel that has waited longest, weighted by activity
+     * @param now Current time in milliseconds
+     * @return Channel number, or the interactive channel if there is no other
+     */
+    uint8_t nextBackgroundChannel(unsigned long now) const;
 };
 
+using MultiplexerController = MuxController<BoardMuxLayout, MAX_CHANNELS>;
+
 #endif // MULTIPLEXER_H
\ No newline at end of file
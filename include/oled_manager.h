@@ -3,11 +3,7 @@
 
 #include <U8g2lib.h>
 #include "pins.h"
-
-// u8g2 library natively supports 72×40 SSD1306 displays
-// No offset calculations needed - direct pixel addressing
-#define DISPLAY_WIDTH 72
-#define DISPLAY_HEIGHT 40
+#include "status_screen.h"
 
 class OLEDManager {
 public:
@@ -21,15 +17,18 @@ public:
      * Display IP address last 3 digits on OLED
      * @param ipLast3 Last 3 digits of IP address (e.g., "123")
      */
-    void displayIP(const String& ipLast3);
+    void displayIP(const char* ipLast3);
 
     /**
-     * Display system status with IP, WebSocket connection, and SBC channel
+     * Display system status with IP, WebSocket connection, SBC channel and
+     * each channel's RX activity; only the tiles that changed are sent, and
+     * nothing at all if the screen would look the same
      * @param ipLast3 Last 3 digits of IP address (e.g., "123")
      * @param wsConnected WebSocket connection status
      * @param sbcChannel Current SBC channel (0-4)
+     * @param rxBytes Bytes received so far on each channel (MAX_CHANNELS entries)
      */
-    void displayStatus(const String& ipLast3, bool wsConnected, int sbcChannel);
+    void displayStatus(const char* ipLast3, bool wsConnected, int sbcChannel, const unsigned long* rxBytes);
 
     /**
      * Clear the display
@@ -44,6 +43,17 @@ public:
 private:
     U8G2_SSD1306_72X40_ER_F_HW_I2C* display = nullptr;
     bool initialized = false;
+    StatusScreen screen;
+
+    /**
+     * Draw the IP and channel into the header tile rows of the buffer
+     */
+    void drawHeader();
+
+    /**
+     * Draw every channel's activity bar into the bar tile rows of the buffer
+     */
+    void drawBars();
 };
 
 #endif // OLED_MANAGER_H
\ No newline at end of file
@@ -24,33 +24,187 @@
 #define TX_PIN 1         // GPIO1 - Safe for UART TX
 #define UART_TX_PIN 1    // Alias for compatibility
 #define UART_RX_PIN 0    // Alias for compatibility
-// Common baud rates for SBC communication
-// Try these if you get garbled text:
-#define UART_BAUD_RATE 115200   // Default - most common
-// #define UART_BAUD_RATE 9600     // Alternative 1 - very reliable
-// #define UART_BAUD_RATE 38400    // Alternative 2 - good balance
-// #define UART_BAUD_RATE 57600    // Alternative 3 - faster
-// #define UART_BAUD_RATE 230400   // Alternative 4 - very fast
+// Line rate of each SBC at boot, by channel, e.g. -DCHANNEL_BAUD_RATES="{115200, 1500000}";
+// channels left out use UART_BAUD_RATE, and UART_BAUD_AUTO detects the rate
+// from what the SBC prints. All channels are 8N1 at boot. Change them at run
+// time with the LINE:<channel>,<baud|AUTO>[,8N1] WebSocket command.
+#ifndef UART_BAUD_RATE
+#define UART_BAUD_RATE 115200
+#endif
+#define UART_BAUD_AUTO 1
+#ifndef CHANNEL_BAUD_RATES
+#define CHANNEL_BAUD_RATES {UART_BAUD_RATE}
+#endif
+
+// UART receive path: the UART driver event task moves bytes from the RX FIFO
+// into a lock-free ring that the forwarding path drains in bulk. The ring must
+// absorb the longest stall of loop() (e.g. 16 KB = ~175 ms at 921600 baud).
+#ifndef UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE 16384       // Power of two
+#endif
+#define UART_DRIVER_RX_BUFFER 1024    // ESP-IDF driver buffer in front of the ring
+#define UART_RX_FIFO_SIZE 128         // Hardware RX FIFO
+#define UART_RX_FIFO_THRESHOLD 64     // Bytes in the FIFO before an event fires
+#define UART_RX_TIMEOUT_SYMBOLS 2     // Idle character times before a partial FIFO is flushed
+#define UART_RX_DELIVERY_US 200       // Driver event task wake-up, FIFO to receive ring
+#define UART_RX_RESYNC_CHARS 8        // New line's character times until the receiver finds a start bit
+
+// Task pipeline (see main.cpp): the UART task moves received bytes into the
+// scrollback and the forward queue, the network task serves WebSocket/HTTP
+// and the display task owns the LED and the OLED's slow I2C transfers
+#define UART_TASK_PERIOD_MS 2
+#define NETWORK_TASK_PERIOD_MS 5
+#define DISPLAY_TASK_PERIOD_MS 50
+// OLED refresh (see status_screen.h): the activity bars show each channel's
+// receive rate over this period; an unchanged screen costs no I2C transfer
+#define DISPLAY_REFRESH_MS 250
+
+// WebSocket output coalescing: frames grow with the output rate up to
+// OUTPUT_FRAME_MAX bytes, and no byte is held back longer than
+// OUTPUT_LATENCY_MAX_MS (a keystroke echo or a pause in output is sent at once)
+#ifndef OUTPUT_FRAME_MAX
+#define OUTPUT_FRAME_MAX 1024
+#endif
+#ifndef OUTPUT_LATENCY_MAX_MS
+#define OUTPUT_LATENCY_MAX_MS 50
+#endif
+
+// Terminal clients that connect with "compress=lz" get frames of at least
+// OUTPUT_COMPRESS_MIN bytes LZ-compressed when that makes them smaller;
+// keystroke echoes and other short frames are never delayed by it
+#ifndef OUTPUT_COMPRESS_MIN
+#define OUTPUT_COMPRESS_MIN 256
+#endif
+
+// WebSocket -> UART input: a queue per channel that the UART task writes in
+// bulk while the channel is interactive. Targets with tiny receive buffers
+// (e.g. a U-Boot prompt) can be paced per channel at runtime with
+// PACE:<channel>,<char_us>,<line_ms>,<echo>; these are the defaults.
+#ifndef TX_QUEUE_SIZE
+#define TX_QUEUE_SIZE 4096            // Bytes per channel, power of two
+#endif
+#ifndef TX_CHAR_DELAY_US
+#define TX_CHAR_DELAY_US 0            // Time from one character to the next (UART TX idle gap)
+#endif
+#ifndef TX_LINE_DELAY_MS
+#define TX_LINE_DELAY_MS 0            // Extra gap after each line end
+#endif
+#ifndef TX_ECHO_WAIT
+#define TX_ECHO_WAIT false            // Wait for the echoed line and the next prompt
+#endif
+#define TX_ECHO_TIMEOUT_MS 1000       // Send the next line anyway after this long
+
+// Multiplexer type (see MuxLayout in multiplexer.h)
+#define MUX_TYPE_HP4067 1           // One 4067 per direction: 16 channels
+#define MUX_TYPE_HC4051 2           // One 74HC4051 per direction: 8 channels, S0-S2
+#define MUX_TYPE_CASCADED_4067 3    // Two 4067s per direction on shared S0-S3: 32 channels
+#ifndef MUX_TYPE
+#define MUX_TYPE MUX_TYPE_HP4067
+#endif
 
 // HP4067 Multiplexer control pins - ESP32-C3 GPIO (avoiding GPIO8 status LED)
 #define MUX_S0_PIN 3    // GPIO3 - LSB (A0)
 #define MUX_S1_PIN 4    // GPIO4 - A1
 #define MUX_S2_PIN 9    // GPIO9 - A2
 #define MUX_S3_PIN 10   // GPIO10 - MSB (A3)
+// Active-low enable (EN) of each chip, only for MUX_TYPE_CASCADED_4067
+#define MUX_EN0_PIN 2   // GPIO2 - channels 0-15
+#define MUX_EN1_PIN 7   // GPIO7 - channels 16-31
 
 // WebSocket and HTTP server configuration
 #define WEBSOCKET_PORT 81
 #define HTTP_PORT 80
 
+// HTTP server (see http_server.h): each network-task pass advances every
+// connection by at most one chunk, which bounds how long a page load can
+// delay serial forwarding. Idle keep-alive connections close after
+// HTTP_KEEPALIVE_MS.
+#define HTTP_MAX_CONNECTIONS 4
+#define HTTP_CHUNK_SIZE 1460      // One TCP segment
+#define HTTP_KEEPALIVE_MS 5000
+
+// TCP ports (see port_server.h): channel n is also served on PORT_BASE + n,
+// as raw TCP or RFC 2217 (pyserial "rfc2217://host:port"), one client per
+// channel. With the WebSocket and HTTP servers that makes MAX_CHANNELS + 2
+// listening sockets: raise CONFIG_LWIP_MAX_LISTENING_TCP (16) for 32 channels.
+#ifndef PORT_SERVER_ENABLED
+#define PORT_SERVER_ENABLED 1
+#endif
+#define PORT_BASE 4000
+#define PORT_DETECT_MS 250        // A client silent this long is a raw TCP client
+
+// Web assets are compiled into the firmware from data-src/ (see
+// scripts/embed_assets.py). Set to 1 while working on the web UI to serve
+// files uploaded to LittleFS (pio run -t uploadfs) in preference.
+#ifndef WEB_ASSETS_LITTLEFS_OVERRIDE
+#define WEB_ASSETS_LITTLEFS_OVERRIDE 0
+#endif
+
 // Status LED (ABROBOT ESP32-C3 board)
 #define STATUS_LED_PIN 8  // GPIO8 - ABROBOT board status LED
 
-// Channel configuration
+// Channel configuration: SBCs in use, at most the mux's channel count
+#ifndef MAX_CHANNELS
 #define MAX_CHANNELS 5    // SBC1 through SBC5
+#endif
 #define SBC1_CHANNEL 0
 #define SBC2_CHANNEL 1
 #define SBC3_CHANNEL 2
 #define SBC4_CHANNEL 3
 #define SBC5_CHANNEL 4
 
+// Server-side scrollback: total RAM for per-channel history, split evenly
+// between channels (override with -DSCROLLBACK_BUDGET_BYTES=...)
+#ifndef SCROLLBACK_BUDGET_BYTES
+#define SCROLLBACK_BUDGET_BYTES (32 * 1024)
+#endif
+
+// Output triggers (see trigger_matcher.h): every channel's output is matched
+// against these patterns, separated by '|', and each match is announced to
+// the WebSocket clients and counted in /metrics. Replace them at run time
+// with TRIGGERS:<pattern>|<pattern>...
+#ifndef TRIGGER_PATTERNS
+#define TRIGGER_PATTERNS "Kernel panic|Out of memory|login:"
+#endif
+
+// Session recording (see session_recorder.h): every channel's output is
+// appended to a compressed log on LittleFS, RECORD_SEGMENTS files of
+// RECORD_SEGMENT_BYTES used round-robin, so the oldest output is dropped
+// first. Flash is written in commits of about RECORD_COMMIT_BYTES, at most
+// RECORD_FLUSH_MS after the output arrived, and only once the SBCs have been
+// quiet for RECORD_QUIET_MS or output is slow enough for the RX FIFO to
+// bridge RECORD_COMMIT_STALL_MS: an erase halts the CPU (and the UART
+// interrupt) for tens of milliseconds.
+#ifndef RECORD_ENABLED
+#define RECORD_ENABLED 1
+#endif
+#ifndef RECORD_CHANNEL_MASK
+#define RECORD_CHANNEL_MASK 0xFFFFFFFFUL  // Bit n records channel n
+#endif
+#define RECORD_QUEUE_SIZE 16384       // UART task -> recorder task, power of two
+#define RECORD_BLOCK_SIZE 4096        // Output compressed as one unit
+#define RECORD_COMMIT_BYTES 4096      // One flash sector
+#define RECORD_FLUSH_MS 10000
+#define RECORD_QUIET_MS 100
+#define RECORD_COMMIT_STALL_MS 100    // CPU halt of a commit: two sector erases and page programs
+#define RECORD_MERGE_MS 20            // Output this close together is one record (one asciicast event)
+#ifndef RECORD_SEGMENTS
+#define RECORD_SEGMENTS 4
+#endif
+#ifndef RECORD_SEGMENT_BYTES
+#define RECORD_SEGMENT_BYTES (256 * 1024)
+#endif
+#define RECORD_TASK_PERIOD_MS 50
+
+// Console log (see logger.h): messages wait in a ring for the log task, which
+// writes them to USB serial at the lowest priority. Build with
+// -DLOG_LEVEL=5 for a hex trace of the interactive SBC output.
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 2048            // Power of two
+#endif
+#ifndef LOG_TRACE_RING_SIZE
+#define LOG_TRACE_RING_SIZE 4096      // Power of two, only used at LOG_LEVEL 5
+#endif
+#define LOG_TASK_PERIOD_MS 20
+
 #endif // PINS_H
\ No newline at end of file
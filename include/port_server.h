@@ -0,0 +1,164 @@
+#ifndef PORT_SERVER_H
+#define PORT_SERVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "pins.h"
+#include "telnet.h"
+
+class SerialBridge;
+class WebSocketServer;
+
+/**
+ * One TCP listener per channel on PORT_BASE + channel, for tools that speak
+ * to serial ports rather than browsers (pyserial, conserver, expect).
+ *
+ * A client that starts with a Telnet command (IAC) gets RFC 2217: option
+ * negotiation, then COM-PORT-OPTION subnegotiations to change the channel's
+ * line settings and to send a BREAK. A client that sends anything else, or
+ * nothing for PORT_DETECT_MS, is a raw TCP client: bytes are passed through
+ * unchanged both ways.
+ *
+ * Ports share the WebSocket path's mux scheduling and buffers: output is
+ * read from the channel's scrollback with a cursor, like a terminal client
+ * viewing a channel, and input is queued with SerialBridge::write() after
+ * taking the channel's write lock from the WebSocket server, so a port is
+ * one more writer in its arbitration. A port only gets output captured
+ * after it connected. One client per port; further connections are told
+ * the port is in use and closed.
+ *
+ * Runs on the network task: loop() reads and writes at most
+ * OUTPUT_CHUNKS_PER_CALL chunks per port and never waits for a client.
+ */
+class PortServer {
+public:
+    /**
+     * Start listening on every channel's port
+     * @param bridge Bridge carrying the bytes to and from the SBCs
+     * @param server WebSocket server arbitrating the write locks
+     * @return true if every listener was started
+     */
+    bool begin(SerialBridge* bridge, WebSocketServer* server);
+
+    /**
+     * Accept clients, move their input to the SBCs and send them new output
+     */
+    void loop();
+
+    /**
+     * @return Number of connected port clients
+     */
+    size_t connectedClients() const;
+
+    /**
+     * @return Output bytes sent to port clients since start (before Telnet escaping)
+     */
+    unsigned long getSentBytes() const { return sentBytes; }
+
+    /**
+     * @return Input bytes from port clients queued for the SBCs since start
+     */
+    unsigned long getReceivedBytes() const { return receivedBytes; }
+
+private:
+    enum class Mode : uint8_t {
+        Detecting,  // Connected, not known yet whether it speaks Telnet
+        Raw,
+        Telnet
+    };
+
+    // Options this server accepts in either direction
+    static const uint8_t OPTION_BINARY = 1;
+    static const uint8_t OPTION_SGA = 2;
+    static const uint8_t OPTION_COM_PORT = 4;
+
+    // Bytes read from or sent to a client per step
+    static const size_t CHUNK_SIZE = 512;
+    static const size_t OUTPUT_CHUNKS_PER_CALL = 4;
+    // Modem state reported on NOTIFY-MODEMSTATE: the mux only switches RX
+    // and TX, so CD, DSR and CTS read as asserted, as on a 3-wire cable
+    static const uint8_t MODEM_STATE = 0xB0;
+
+    struct Port {
+        hal::TcpServer* listener = nullptr;
+        hal::TcpConnection* client = nullptr;
+        Mode mode = Mode::Detecting;
+        unsigned long connectedAt = 0;
+        uint32_t sentSequence = 0;      // Next scrollback position to send
+        TelnetParser parser;
+        uint8_t localOptions = 0;       // Enabled on our side (we said WILL)
+        uint8_t remoteOptions = 0;      // Enabled on the client's side (we said DO)
+        bool lastWasCr = false;         // Telnet NVT: CR NUL stands for CR
+        bool suspended = false;         // FLOWCONTROL-SUSPEND received
+        bool dtr = true;                // Control lines the client set; the mux has none
+        bool rts = true;
+        bool readOnlyNotified = false;
+    };
+
+    SerialBridge* bridge = nullptr;
+    WebSocketServer* server = nullptr;
+    Port ports[MAX_CHANNELS];
+    unsigned long sentBytes = 0;
+    unsigned long receivedBytes = 0;
+
+    uint8_t inputChunk[CHUNK_SIZE];
+    uint8_t dataChunk[CHUNK_SIZE];
+    uint8_t outputChunk[CHUNK_SIZE];
+    uint8_t escapedChunk[2 * CHUNK_SIZE];
+
+    /**
+     * Take a new connection for a channel, or turn it away if the port is busy
+     */
+    void accept(uint8_t channel, hal::TcpConnection* connection);
+
+    /**
+     * Close a channel's client and release its write lock
+     */
+    void close(uint8_t channel);
+
+    /**
+     * Read what the client sent, decode Telnet in Telnet mode, and queue
+     * the data for the SBC
+     */
+    void receive(uint8_t channel);
+
+    /**
+     * Queue data from the client for the SBC if the port may write to the
+     * channel; a blocked client is told once that the channel is read-only
+     */
+    void queueInput(uint8_t channel, const uint8_t* data, size_t length);
+
+    /**
+     * Send output captured since the client's cursor
+     */
+    void sendOutput(uint8_t channel);
+
+    /**
+     * Answer WILL/WONT/DO/DONT, accepting BINARY, SGA and COM-PORT-OPTION
+     */
+    void handleOption(uint8_t channel, uint8_t verb, uint8_t option);
+
+    /**
+     * Carry out an RFC 2217 command and answer with the value in effect
+     */
+    void handleComPort(uint8_t channel, const uint8_t* command, size_t length);
+
+    /**
+     * Answer a SET-CONTROL command (flow control, BREAK, DTR and RTS)
+     * @return Value to reply with
+     */
+    uint8_t handleControl(uint8_t channel, uint8_t value);
+
+    /**
+     * Send IAC SB COM-PORT-OPTION <command> <value> IAC SE, escaping the value
+     */
+    void sendSubnegotiation(uint8_t channel, uint8_t command, const uint8_t* value, size_t length);
+
+    /**
+     * Send IAC <verb> <option>
+     */
+    void sendOption(uint8_t channel, uint8_t verb, uint8_t option);
+};
+
+#endif // PORT_SERVER_H
@@ -0,0 +1,55 @@
+#ifndef SCROLLBACK_H
+#define SCROLLBACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "byte_ring.h"
+#include "pins.h"
+
+/**
+ * Per-channel history of SBC output kept on the device, so clients can be
+ * shown recent output when they connect or switch channels. The memory is a
+ * fixed SCROLLBACK_BUDGET_BYTES split evenly between channels; the oldest
+ * output of a channel is overwritten when its share is full.
+ */
+class Scrollback {
+public:
+    static const size_t CHANNEL_SIZE = SCROLLBACK_BUDGET_BYTES / MAX_CHANNELS;
+
+    /**
+     * Append output received from a channel
+     * @param channel Channel number (0-4)
+     * @param data Received bytes
+     * @param length Number of bytes
+     */
+    void append(uint8_t channel, const uint8_t* data, size_t length);
+
+    /**
+     * @param channel Channel number (0-4)
+     * @return Number of history bytes held for the channel
+     */
+    size_t size(uint8_t channel) const;
+
+    /**
+     * Copy history without consuming it
+     * @param channel Channel number (0-4)
+     * @param offset Position relative to the oldest byte held
+     * @param buffer Destination buffer
+     * @param length Maximum number of bytes to copy
+     * @return Number of bytes copied
+     */
+    size_t copy(uint8_t channel, size_t offset, uint8_t* buffer, size_t length) const;
+
+    /**
+     * Stream position of the channel: total bytes ever appended (wraps at
+     * 2^32). The bytes held are those from endSequence() - size() onwards.
+     * @param channel Channel number (0-4)
+     */
+    uint32_t endSequence(uint8_t channel) const;
+
+private:
+    ByteRing<CHANNEL_SIZE> rings[MAX_CHANNELS];
+    uint32_t appended[MAX_CHANNELS] = {};
+};
+
+#endif // SCROLLBACK_H
@@ -0,0 +1,382 @@
+#ifndef SERIAL_BRIDGE_H
+#define SERIAL_BRIDGE_H
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "keystroke_trace.h"
+#include "latency_stats.h"
+#include "line_settings.h"
+#include "multiplexer.h"
+#include "pins.h"
+#include "scrollback.h"
+#include "session_recorder.h"
+#include "spsc_ring.h"
+#include "trigger_matcher.h"
+
+class WebSocketServer;
+
+/**
+ * Input pacing of one channel
+ */
+struct TxPacing {
+    unsigned long charDelayUs = TX_CHAR_DELAY_US;  // Time from one character to the next
+    unsigned long lineDelayMs = TX_LINE_DELAY_MS;  // Extra gap after CR or LF
+    bool echoWait = TX_ECHO_WAIT;                  // Hold the next line until the SBC shows a prompt again
+};
+
+/**
+ * Bytes moved for one channel since start
+ */
+struct ChannelCounters {
+    unsigned long rxBytes = 0;  // Received and recorded in the scrollback
+    unsigned long txBytes = 0;  // Written to the UART
+};
+
+/**
+ * Byte path between the SBC UART and the WebSocket server, split in two
+ * stages so each can run in its own task:
+ * - pump() (UART task): drain the UART receive ring, record every channel in
+ *   the scrollback, queue interactive output and advance the scan schedule
+ * - forward() (network task): move queued output into the WebSocket buffer
+ *
+ * Input travels the other way through a queue per channel: write() (network
+ * task) queues keystrokes and pastes, pump() sends them in bulk while the
+ * channel is interactive, paced per setTxPacing().
+ *
+ * Control calls (selectChannel, write, setScanMode) come from the network
+ * task and take the bridge lock, which pump() also holds while it touches
+ * the UART, the multiplexer and the scrollback.
+ *
+ * A channel switch never waits: the previous channel's pending output goes
+ * to its viewers, the mux moves in one GPIO write and the UART is fenced
+ * until nothing received can belong to the previous channel any more. The
+ * UART stage neither transmits nor moves the mux while the fence is up.
+ *
+ * A BREAK is held on the interactive channel's TX line once its queued
+ * input has left, and keeps the mux there until it is released.
+ *
+ * Each channel has its own line settings, applied with every mux move. A
+ * channel in auto-baud mode has its rate detected while the mux is on it:
+ * what the UART receives is scored by a BaudDetector instead of being
+ * recorded, until the detector locks.
+ *
+ * Everything recorded is also matched against the trigger patterns, and
+ * forward() announces the matches to the WebSocket clients.
+ */
+class SerialBridge {
+public:
+    /**
+     * Attach the bridge to the SBC UART, the multiplexer and the WebSocket server
+     * @param uart UART connected to the multiplexer
+     * @param multiplexer Multiplexer routing the UART to one SBC at a time
+     * @param server WebSocket server receiving the SBC output
+     */
+    void init(hal::Uart* uart, MultiplexerController* multiplexer, WebSocketServer* server);
+
+    /**
+     * Also hand everything recorded in the scrollback to a session recorder
+     * @param recorder Recorder, nullptr to stop
+     */
+    void setRecorder(SessionRecorder* recorder);
+
+    /**
+     * Run both stages back to back (single-loop operation)
+     */
+    void loop();
+
+    /**
+     * UART stage: route received bytes and advance the scan schedule
+     * @return Number of bytes taken from the UART
+     */
+    size_t pump();
+
+    /**
+     * Network stage: hand queued output to the WebSocket server and let it
+     * decide whether to send a frame now
+     */
+    void forward();
+
+    /**
+     * Bridge lock (recursive). Hold it to keep the interactive channel and its
+     * scrollback stable across several calls; usable with std::lock_guard.
+     */
+    void lock();
+    void unlock();
+
+    /**
+     * @param channel Channel number (0-4)
+     * @return Bytes of the channel already in the scrollback but not yet
+     *         handed to the WebSocket server
+     */
+    size_t pendingForward(uint8_t channel) const;
+
+    /**
+     * Switch the interactive channel without blocking. Output captured for
+     * it while it was scanned in the background is in its scrollback.
+     * @param channel Channel number (0-4)
+     * @return true if successful, false if invalid channel
+     */
+    bool selectChannel(uint8_t channel);
+
+    /**
+     * Queue bytes for an SBC. The UART stage sends them while the channel
+     * is interactive (pulling the mux back from a background channel when
+     * scanning).
+     * @param channel Channel number (0-4)
+     * @return Number of bytes queued (less than length if the queue is full)
+     */
+    size_t write(uint8_t channel, const uint8_t* data, size_t length);
+
+    /**
+     * @return Bytes queued for the channel and not yet sent
+     */
+    size_t pendingWrite(uint8_t channel) const;
+
+    /**
+     * Drop the input queued for a channel and not yet sent (network task)
+     * @return Number of bytes dropped
+     */
+    size_t purgeWrite(uint8_t channel);
+
+    /**
+     * Trace the next write() to a channel through the UART, the SBC's echo
+     * and the WebSocket frame carrying it (network task)
+     * @param id Trace id chosen by the client
+     */
+    void traceNextWrite(uint8_t channel, uint32_t id);
+
+    /**
+     * @return Latency of the traced keystrokes
+     */
+    const KeystrokeTracer& getTracer() const;
+
+    /**
+     * Replace the trigger patterns (network task)
+     * @param list Patterns separated by '|', not NUL-terminated
+     * @return false if they do not fit TriggerMatcher's limits (the previous ones stay)
+     */
+    bool setTriggers(const char* list, size_t length);
+
+    /**
+     * @return Trigger patterns and their match counts
+     */
+    const TriggerMatcher& getTriggers() const;
+
+    /**
+     * Set how queued input is paced for a channel. Pacing has the UART
+     * task's period as resolution: characters due within one period are
+     * sent together.
+     */
+    void setTxPacing(uint8_t channel, const TxPacing& pacing);
+    TxPacing getTxPacing(uint8_t channel) const;
+
+    /**
+     * Set a channel's rate and character format, applied whenever the mux
+     * selects the channel. With autoBaud the rate is detected (again) the
+     * next time the channel is selected and prints something.
+     * @param channel Channel number (0-4)
+     */
+    void setLineSettings(uint8_t channel, const LineSettings& settings);
+    LineSettings getLineSettings(uint8_t channel) const;
+
+    /**
+     * Start or end a BREAK on a channel (network task). It is held while the
+     * channel is interactive, after its queued input went out; selecting
+     * another channel ends it.
+     * @param channel Channel number (0-4)
+     */
+    void setBreak(uint8_t channel, bool on);
+
+    /**
+     * @return true while a BREAK is requested for the channel
+     */
+    bool isBreakRequested(uint8_t channel) const;
+
+    /**
+     * @return true while the channel's rate is being detected
+     */
+    bool isDetectingBaud(uint8_t channel) const;
+
+    /**
+     * Enable or disable background round-robin capture of all channels
+     */
+    void setScanMode(bool enabled);
+
+    /**
+     * Format per-channel dwell time, captured and estimated missed bytes
+     * @param buffer Output buffer (always NUL-terminated)
+     * @param size Size of buffer in bytes
+     * @return Length of the report
+     */
+    size_t formatScanReport(char* buffer, size_t size) const;
+
+    /**
+     * @return Per-channel history of everything received from the SBCs
+     */
+    const Scrollback& getScrollback() const;
+
+    /**
+     * Pipeline timing: period of each stage and how long output waited in
+     * the forward queue
+     */
+    const LatencyStats& getPumpPeriods() const;
+    const LatencyStats& getForwardPeriods() const;
+    const LatencyStats& getForwardLatency() const;
+
+    /**
+     * Time from selectChannel() to the first byte of the new channel queued
+     * for the network stage (switches to a channel that stays silent for
+     * SWITCH_FIRST_BYTE_MS are not sampled)
+     */
+    const LatencyStats& getSwitchLatency() const;
+
+    /**
+     * @param channel Channel number (0-4)
+     * @return Bytes received from and sent to the channel (any task)
+     */
+    ChannelCounters getChannelCounters(uint8_t channel) const;
+
+    /**
+     * @return Receive counters of the UART (any task)
+     */
+    hal::UartStats getUartStats() const;
+
+private:
+    hal::Uart* uart = nullptr;
+    MultiplexerController* multiplexer = nullptr;
+    WebSocketServer* server = nullptr;
+    SessionRecorder* recorder = nullptr;
+    unsigned long lastOverrunCheck = 0;
+    unsigned long reportedOverruns = 0;
+
+    // Bytes pulled from the UART receive ring per read() call
+    static const size_t READ_CHUNK_SIZE = 256;
+    // Interval between UART overrun checks
+    static const unsigned long OVERRUN_CHECK_MS = 100;
+    // Interactive output waiting for the network stage (power of two)
+    static const size_t FORWARD_QUEUE_SIZE = 4096;
+    // Largest single write to the UART
+    static const size_t TX_CHUNK_SIZE = 128;
+    // Longest wait for the first byte after a switch that is still sampled
+    static const unsigned long SWITCH_FIRST_BYTE_MS = 1000;
+    // Trigger alerts sent per network pass; the rest wait for the next ones
+    static const size_t ALERTS_PER_FORWARD = 4;
+
+    mutable std::recursive_mutex mutex;
+    Scrollback scrollback;
+
+    // UART stage -> network stage
+    SpscRing<FORWARD_QUEUE_SIZE> forwardQueue;
+    std::atomic<unsigned long> queuedAtUs{0};  // When the queue last became non-empty
+
+    // Network stage -> UART, one queue per channel
+    SpscRing<TX_QUEUE_SIZE> txQueues[MAX_CHANNELS];
+    TxPacing txPacing[MAX_CHANNELS];
+    // Echo wait after a line end: first its echoed LF, then a prompt, i.e.
+    // output that stopped on something other than a line end
+    enum class EchoState : uint8_t {
+        Idle,
+        AwaitLineEnd,
+        AwaitPrompt
+    };
+
+    unsigned long txNextUs = 0;         // When the next paced character is due
+    bool txLineDraining = false;        // Line gap starts once the line end left the wire
+    EchoState echoState = EchoState::Idle;
+    uint8_t lastEchoByte = 0;
+    unsigned long txEchoSince = 0;
+    unsigned long txBytes = 0;
+    unsigned long txEchoTimeouts = 0;
+
+    // Keystroke tracing: bytes ever queued per channel (network stage) and
+    // ever handed to the network stage (UART stage)
+    KeystrokeTracer tracer;
+    unsigned long txQueuedBytes[MAX_CHANNELS] = {};
+    unsigned long liveQueuedBytes = 0;
+
+    TriggerMatcher triggers;
+
+    // Written by the UART stage only, read by /metrics
+    std::atomic<unsigned long> channelRxBytes[MAX_CHANNELS] = {};
+    std::atomic<unsigned long> channelTxBytes[MAX_CHANNELS] = {};
+
+    // Mux switch: the UART drops what it receives until settleUntilUs
+    enum class SwitchState : uint8_t {
+        Live,
+        Settling
+    };
+
+    SwitchState switchState = SwitchState::Live;
+    unsigned long settleUntilUs = 0;
+    unsigned long switchStartUs = 0;    // When selectChannel() was called
+    bool firstByteDue = false;          // No byte of the new channel forwarded yet
+    unsigned long switches = 0;
+    LatencyStats switchLatency;
+
+    LineSettings lineSettings[MAX_CHANNELS];
+    BaudDetector baudDetectors[MAX_CHANNELS];
+    bool detectWindowOpen = false;          // Baseline below taken since the last retune
+    unsigned long detectFramingBase = 0;    // UART framing errors when the window opened
+
+    bool breakRequested[MAX_CHANNELS] = {};
+    unsigned long breakMarks[MAX_CHANNELS] = {};  // txQueuedBytes when the BREAK was requested
+    bool breakActive = false;           // TX of the interactive channel held low
+
+    LoopTimer pumpTimer;
+    LoopTimer forwardTimer;
+    LatencyStats forwardLatency;  // Time output waited in the queue
+
+    /**
+     * Read everything pending in the UART and route it to the channel the
+     * mux currently selects
+     * @return Number of bytes read
+     */
+    size_t drainUart();
+
+    /**
+     * Apply the line settings of the channel the mux now selects and fence
+     * the UART (see hal::Uart::fenceUntil)
+     */
+    void fenceSwitch();
+
+    /**
+     * Score what the UART received at the candidate rate of a channel being
+     * detected, and retune or lock
+     */
+    void detectBaud(uint8_t channel);
+
+    /**
+     * @return true once the fence of the last switch is over
+     */
+    bool settled();
+
+    /**
+     * Send the interactive channel's queued input, as much as the UART
+     * takes without blocking and the channel's pacing allows
+     * @param lineQuiet true if nothing was received since the previous call
+     * @return Number of bytes written
+     */
+    size_t transmit(bool lineQuiet);
+
+    /**
+     * Start or end the interactive channel's BREAK as requested, once its
+     * queued input left the wire (pulling the mux back when scanning)
+     */
+    void applyBreak();
+
+    /**
+     * Move everything in the forward queue into the WebSocket buffer
+     * @return Number of bytes moved
+     */
+    size_t forwardQueued();
+
+    /**
+     * Warn on the console when the UART lost bytes since the last check
+     */
+    void checkOverruns();
+};
+
+#endif // SERIAL_BRIDGE_H
@@ -0,0 +1,339 @@
+#ifndef SESSION_RECORDER_H
+#define SESSION_RECORDER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "hal.h"
+#include "lz_block.h"
+#include "pins.h"
+#include "spsc_ring.h"
+
+/**
+ * Header in front of every block of a segment file (20 bytes, little-endian).
+ * A block holds the output of all channels over a stretch of time as
+ * records: channel byte, varint milliseconds since the previous record (the
+ * first one since firstMs), varint length, bytes. Output of a channel
+ * within RECORD_MERGE_MS of its record's start is part of that record.
+ */
+struct RecordBlockHeader {
+    static const size_t SIZE = 20;
+    static const uint8_t FLAG_COMPRESSED = 0x01;   // Payload is lz_block.h encoded
+    static const uint8_t CHANNEL_GAP = 0x80;       // In a record's channel byte: output was dropped before it
+
+    uint16_t storedLength = 0;  // Payload bytes following the header
+    uint16_t rawLength = 0;     // Payload bytes once decompressed
+    uint16_t boot = 0;          // Device boot the output was recorded in
+    uint8_t flags = 0;
+    uint32_t firstMs = 0;       // Times of the first and last record, ms since boot
+    uint32_t lastMs = 0;
+    uint32_t payloadHash = 0;   // FNV-1a of the stored payload
+
+    void encode(uint8_t* out) const;
+
+    /**
+     * @return false if the bytes are not a valid header (check byte)
+     */
+    bool decode(const uint8_t* in);
+};
+
+/**
+ * Segment files: a 12-byte header ("SREC", version, boot and sequence
+ * number), then blocks. The segment with the highest sequence is the newest.
+ */
+struct RecordSegment {
+    static const size_t HEADER_SIZE = 12;
+    static const uint8_t VERSION = 1;
+
+    /**
+     * @param buffer Receives "/recN.bin" (at least 16 bytes)
+     */
+    static void formatPath(char* buffer, size_t size, size_t slot);
+
+    static void encodeHeader(uint8_t* out, uint16_t boot, uint32_t sequence);
+    static bool decodeHeader(const uint8_t* in, uint16_t& boot, uint32_t& sequence);
+};
+
+/**
+ * Recorder counters
+ */
+struct RecorderStats {
+    unsigned long recordedBytes = 0;    // Output taken from the UART task
+    unsigned long droppedBytes = 0;     // Refused because the queue was full (output without a pause)
+    unsigned long storedBytes = 0;      // Written to flash, headers included
+    unsigned long blocks = 0;
+    unsigned long commits = 0;
+    unsigned long deferredCommits = 0;  // Held back until the SBCs went quiet
+    unsigned long rotations = 0;
+    unsigned long writeErrors = 0;
+    unsigned long segment = 0;          // Sequence number of the segment being written
+    unsigned boot = 0;
+};
+
+/**
+ * Persistent recording of every channel's output, for post-mortems that
+ * reach back further than the RAM scrollback.
+ *
+ * record() runs in the UART task and only copies the bytes, with the time
+ * and channel, into a lock-free queue. loop() runs in a low-priority task:
+ * it packs the queue into RECORD_BLOCK_SIZE blocks, compresses each one on
+ * its own (lz_block.h), and gathers compressed blocks until a commit of
+ * about RECORD_COMMIT_BYTES is due, or RECORD_FLUSH_MS after the oldest
+ * byte arrived. A commit is one append to the current segment file.
+ *
+ * Erasing flash stops the ESP32-C3 from running code out of flash, the UART
+ * interrupt included, long enough for the 128-byte RX FIFO to overflow at
+ * any useful rate. Commits therefore wait until no output has arrived for
+ * RECORD_QUIET_MS, or until output is slow enough for the FIFO to absorb a
+ * RECORD_COMMIT_STALL_MS halt. The live console comes first: fast output
+ * that keeps coming until the queue and the buffers behind it are full
+ * (some 40 KB of text) is dropped from the recording, never from the UART.
+ *
+ * Segments are used round-robin (RECORD_SEGMENTS files of about
+ * RECORD_SEGMENT_BYTES): the recorder moves on to the next one when the
+ * current one is full, overwriting the oldest output. After a reboot it
+ * appends to the newest segment under the next boot number.
+ */
+class SessionRecorder {
+public:
+    /**
+     * Find the newest segment and continue it
+     * @param files Mounted filesystem
+     * @return true if recording can start
+     */
+    bool begin(hal::FileSystem* files);
+
+    /**
+     * Record output received from a channel (UART task, or any caller
+     * holding the bridge lock)
+     */
+    void record(uint8_t channel, const uint8_t* data, size_t length);
+
+    /**
+     * Recorder task: pack queued output and commit it when due
+     */
+    void loop();
+
+    /**
+     * Commit everything received so far, quiet or not
+     */
+    void flush();
+
+    void setChannelMask(uint32_t mask) { channelMask.store(mask, std::memory_order_relaxed); }
+    uint32_t getChannelMask() const { return channelMask.load(std::memory_order_relaxed); }
+
+    RecorderStats getStats() const;
+
+private:
+    // Queue entry: channel, time (ms, 4 bytes), length (2 bytes), then the bytes
+    static const size_t ENTRY_HEADER_SIZE = 7;
+    static const size_t ENTRY_MAX_DATA = 0xFFFF;
+    // Largest record header in a block: channel and two varints
+    static const size_t RECORD_HEADER_MAX = 1 + 5 + 3;
+    static const size_t COMMIT_BUFFER_SIZE = RECORD_COMMIT_BYTES + RecordBlockHeader::SIZE + RECORD_BLOCK_SIZE;
+
+    hal::FileSystem* files = nullptr;
+
+    // UART task -> recorder task
+    SpscRing<RECORD_QUEUE_SIZE> queue;
+    std::atomic<uint32_t> channelMask{RECORD_CHANNEL_MASK};
+    std::atomic<unsigned long> lastOutputMs{0};
+    std::atomic<unsigned long> arrivedBytes{0};    // Recorded or not: the UART's rate
+    std::atomic<unsigned long> recordedBytes{0};   // Written by the producer only
+    std::atomic<unsigned long> droppedBytes{0};
+    uint32_t gapChannels = 0;       // Producer only: channels whose next entry follows dropped output
+
+    // Entry being moved into the block
+    bool entryOpen = false;
+    uint8_t entryChannel = 0;
+    uint32_t entryMs = 0;
+    size_t entryRemaining = 0;
+
+    // Block being filled
+    uint8_t block[RECORD_BLOCK_SIZE];
+    size_t blockLength = 0;
+    uint32_t blockFirstMs = 0;
+    uint32_t blockLastMs = 0;      // Start of the last record
+    bool recordOpen = false;        // The last record may still grow
+    uint8_t recordChannel = 0;
+    size_t recordOffset = 0;        // Position of its length
+    size_t recordLength = 0;
+
+    // Compressed blocks waiting for a commit
+    uint8_t commitBuffer[COMMIT_BUFFER_SIZE];
+    size_t commitLength = 0;
+    unsigned long pendingSinceMs = 0;   // Arrival of the oldest uncommitted output
+    bool pending = false;
+    bool commitDeferred = false;
+    unsigned long rateBytes = 0;    // arrivedBytes at the previous loop()
+    unsigned long rateSinceMs = 0;
+    uint16_t hashTable[LZ_HASH_SIZE];
+
+    // Segment being written
+    uint32_t sequence = 0;
+    size_t segmentSize = 0;     // 0: the segment file does not exist yet
+    uint16_t boot = 0;
+
+    // Written by the recorder task, read anywhere
+    std::atomic<unsigned long> storedBytes{0};
+    std::atomic<unsigned long> blocks{0};
+    std::atomic<unsigned long> commits{0};
+    std::atomic<unsigned long> deferredCommits{0};
+    std::atomic<unsigned long> rotations{0};
+    std::atomic<unsigned long> writeErrors{0};
+
+    /**
+     * Move queued output into blocks, sealing full ones
+     * @param mayCommit A full commit buffer may be written to make room
+     */
+    void drainQueue(bool mayCommit);
+
+    /**
+     * Compress the block into the commit buffer
+     * @return false if the commit buffer has no room for it
+     */
+    bool sealBlock();
+
+    /**
+     * Append the commit buffer to the current segment, moving on to the
+     * next segment first if it would overflow
+     */
+    void commit();
+
+    /**
+     * Walk the blocks of a segment file
+     * @param lastBoot Receives the boot of its last valid block
+     * @return Size up to the end of the last valid block, 0 if unreadable
+     */
+    size_t scanSegment(const char* path, uint16_t& lastBoot);
+
+    static void bump(std::atomic<unsigned long>& counter, unsigned long amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Streams one channel of the recording as an asciicast v2 file (the format
+ * of asciinema and its web player): a JSON header line, then one
+ * [seconds, "o", "text"] line per record.
+ *
+ * Segments are read oldest first, one block at a time, so a download needs
+ * two block buffers whatever its length. Block headers carry their time
+ * range: blocks before the requested start are skipped without being read
+ * or decompressed, and the export stops at the first block past its end.
+ * Time runs on across reboots (each boot continues where the previous one
+ * stopped) and starts at 0 at the requested start.
+ *
+ * Output that is not valid UTF-8 is exported as U+FFFD; a character split
+ * between two records is joined again. Output from the
+ * last RECORD_FLUSH_MS may still be in the recorder's RAM.
+ */
+class RecordingExport {
+public:
+    static const unsigned TERMINAL_COLUMNS = 80;
+    static const unsigned TERMINAL_ROWS = 24;
+    static const unsigned long NO_LIMIT = 0xFFFFFFFFUL;
+
+    ~RecordingExport() { end(); }
+
+    /**
+     * Start an export
+     * @param files Filesystem holding the segments
+     * @param channel Channel to export
+     * @param fromMs Recording time to start at (ms, counted across boots)
+     * @param toMs Recording time to stop at, NO_LIMIT for the end
+     * @return false if there is no recording
+     */
+    bool begin(hal::FileSystem* files, uint8_t channel, unsigned long fromMs, unsigned long toMs);
+
+    /**
+     * Produce the next part of the file
+     * @return Bytes written to buffer, 0 once the export is complete
+     */
+    size_t read(uint8_t* buffer, size_t size);
+
+    /**
+     * Abandon or finish the export, closing its file
+     */
+    void end();
+
+    bool isOpen() const { return open; }
+
+private:
+    static const size_t STAGE_SIZE = 48;
+
+    hal::FileSystem* fileSystem = nullptr;
+    bool open = false;
+    bool finished = false;
+    bool headerSent = false;
+    uint8_t channel = 0;
+    uint64_t fromMs = 0;
+    uint64_t toMs = 0;
+
+    // Segments in age order, with the sequence each had at begin()
+    size_t slots[RECORD_SEGMENTS];
+    uint32_t sequences[RECORD_SEGMENTS];
+    size_t slotCount = 0;
+    size_t nextSlot = 0;
+    hal::File* file = nullptr;
+    size_t filePosition = 0;
+
+    // Recording time: boot-relative ms plus the end of the previous boots
+    bool bootKnown = false;
+    uint16_t boot = 0;
+    uint64_t bootBaseMs = 0;
+    uint64_t lastMs = 0;
+    uint64_t originMs = 0;
+    bool originSet = false;
+
+    // Block being exported
+    uint8_t stored[RECORD_BLOCK_SIZE];
+    uint8_t raw[RECORD_BLOCK_SIZE];
+    size_t rawLength = 0;
+    size_t rawPosition = 0;
+    uint32_t recordMs = 0;
+
+    // Record being exported, and text staged for the caller
+    const uint8_t* data = nullptr;
+    size_t dataLength = 0;
+    size_t dataPosition = 0;
+    uint8_t carry[4];           // Start of a character the record boundary split
+    size_t carryLength = 0;
+    bool gapBefore = false;     // Output was dropped before the current record
+    char staged[STAGE_SIZE];
+    size_t stagedLength = 0;
+    size_t stagedPosition = 0;
+
+    /**
+     * Stage the next piece of output
+     * @return false once there is nothing more
+     */
+    bool stageNext();
+
+    /**
+     * Escape record bytes into the stage, as many as fit
+     */
+    void stageData();
+
+    /**
+     * Find the next record of the channel within the time range
+     * @return false at the end of the export
+     */
+    bool nextRecord();
+
+    /**
+     * Read and unpack the next block in range
+     * @return false when there are no more blocks
+     */
+    bool loadBlock();
+
+    /**
+     * Open the next segment that is still the one seen at begin()
+     * @return false when every segment has been read
+     */
+    bool openNextSegment();
+
+    void closeFile();
+};
+
+#endif // SESSION_RECORDER_H
@@ -0,0 +1,99 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Lock-free single-producer/single-consumer byte FIFO.
+ *
+ * One context (the UART receive interrupt/event task) calls push(), another
+ * (the forwarding path) calls pop(). Indices only ever grow and are published
+ * with release/acquire ordering, so neither side needs a lock or a
+ * read-modify-write atomic. When full, push() refuses the excess bytes and
+ * reports how many it stored so the caller can count the overrun.
+ */
+template <size_t Capacity>
+class SpscRing {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /**
+     * Producer: append bytes
+     * @return Number of bytes stored (less than length if the ring is full)
+     */
+    size_t push(const uint8_t* bytes, size_t length) {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        size_t tail = readIndex.load(std::memory_order_acquire);
+        size_t space = Capacity - (head - tail);
+        size_t count = length < space ? length : space;
+        if (count == 0) return 0;  // Nothing to copy; buffer may be null
+
+        size_t start = head & MASK;
+        size_t first = count < Capacity - start ? count : Capacity - start;
+        memcpy(data + start, bytes, first);
+        memcpy(data, bytes + first, count - first);
+
+        writeIndex.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Consumer: remove up to length of the oldest bytes
+     * @return Number of bytes copied into buffer
+     */
+    size_t pop(uint8_t* buffer, size_t length) {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        size_t head = writeIndex.load(std::memory_order_acquire);
+        size_t used = head - tail;
+        size_t count = length < used ? length : used;
+        if (count == 0) return 0;  // Nothing to copy; buffer may be null
+
+        size_t start = tail & MASK;
+        size_t first = count < Capacity - start ? count : Capacity - start;
+        memcpy(buffer, data + start, first);
+        memcpy(buffer + first, data, count - first);
+
+        readIndex.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Consumer: copy up to length of the oldest bytes without removing them
+     * @return Number of bytes copied into buffer
+     */
+    size_t peek(uint8_t* buffer, size_t length) const {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        size_t head = writeIndex.load(std::memory_order_acquire);
+        size_t used = head - tail;
+        size_t count = length < used ? length : used;
+        if (count == 0) return 0;  // Nothing to copy; buffer may be null
+
+        size_t start = tail & MASK;
+        size_t first = count < Capacity - start ? count : Capacity - start;
+        memcpy(buffer, data + start, first);
+        memcpy(buffer + first, data, count - first);
+        return count;
+    }
+
+    /**
+     * @return Number of bytes waiting (exact for the consumer, a lower bound
+     *         of the free space for the producer)
+     */
+    size_t size() const {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_acquire);
+    }
+
+    static size_t capacity() { return Capacity; }
+
+private:
+    static const size_t MASK = Capacity - 1;
+
+    uint8_t data[Capacity];
+    std::atomic<size_t> writeIndex{0};
+    std::atomic<size_t> readIndex{0};
+};
+
+#endif // SPSC_RING_H
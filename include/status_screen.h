@@ -0,0 +1,113 @@
+#ifndef STATUS_SCREEN_H
+#define STATUS_SCREEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pins.h"
+
+// u8g2 library natively supports 72×40 SSD1306 displays
+// No offset calculations needed - direct pixel addressing
+#define DISPLAY_WIDTH 72
+#define DISPLAY_HEIGHT 40
+
+/**
+ * What the status OLED shows, and which of its 8x8-pixel tiles changed since
+ * they were last sent over I2C.
+ *
+ * The top three tile rows hold the last number of the IP address and the
+ * interactive channel ("X" with no WebSocket client); the bottom two hold an
+ * RX activity bar per channel, with a marker over the interactive one. A
+ * bar's height follows the bit length of the channel's received bytes per
+ * second (one pixel for a prompt, ten for 115200 baud at full speed, the
+ * full height from 1.5 Mbaud), so a chattering SBC stands out while a quiet
+ * box keeps an unchanged screen.
+ *
+ * Only the model lives here; OLEDManager draws it and sends the dirty tiles
+ * with u8g2's updateDisplayArea(). Used by the display task alone.
+ */
+class StatusScreen {
+public:
+    static const uint8_t TILE_COLUMNS = DISPLAY_WIDTH / 8;
+    static const uint8_t TILE_ROWS = DISPLAY_HEIGHT / 8;
+    static const uint8_t HEADER_TILE_ROWS = 3;
+    static const uint8_t BAR_TOP = HEADER_TILE_ROWS * 8;          // Marker row of the interactive channel
+    static const uint8_t BAR_MAX_HEIGHT = DISPLAY_HEIGHT - BAR_TOP - 2;  // Above a 1-pixel floor and the marker row
+    static const uint8_t BAR_RATE_SHIFT = 4;                     // Up to 2^(shift+1)-1 bytes/s is one pixel
+    static const size_t TEXT_SIZE = 4;
+
+    /**
+     * Take the current state and mark the tiles it changes
+     * @param ipLast3 Last number of the IP address, e.g. "123" or "---"
+     * @param wsConnected Whether a WebSocket client is connected
+     * @param channel Interactive channel
+     * @param rxBytes Bytes received so far on each of the MAX_CHANNELS channels
+     * @param nowMs Current time; bars show the rate since the previous update
+     * @return true if any tile has to be sent
+     */
+    bool update(const char* ipLast3, bool wsConnected, int channel, const unsigned long* rxBytes, unsigned long nowMs);
+
+    /**
+     * Mark every tile dirty, e.g. after something else was drawn on the panel
+     */
+    void invalidate();
+
+    /**
+     * Forget the dirty tiles once they were sent
+     */
+    void markSent();
+
+    /**
+     * @return Whether the header tiles (IP and channel) have to be sent
+     */
+    bool isHeaderDirty() const { return headerDirty; }
+
+    /**
+     * @return Bit n set if tile column n of the bar rows has to be sent
+     */
+    uint16_t getDirtyBarColumns() const { return dirtyBarColumns; }
+
+    /**
+     * @return Number of tiles that have to be sent
+     */
+    size_t dirtyTiles() const;
+
+    const char* getIpText() const { return ipText; }
+    const char* getChannelText() const { return channelText; }
+    int getInteractiveChannel() const { return interactive; }
+    uint8_t getBarHeight(uint8_t channel) const { return channel < MAX_CHANNELS ? barHeights[channel] : 0; }
+
+    /**
+     * @return Left pixel column of a channel's bar
+     */
+    static uint8_t barX(uint8_t channel);
+
+    /**
+     * @return Width of every bar in pixels
+     */
+    static uint8_t barWidth();
+
+    /**
+     * Bar height for a receive rate: its bit length less BAR_RATE_SHIFT,
+     * at least one pixel for any activity and at most BAR_MAX_HEIGHT
+     */
+    static uint8_t barHeight(unsigned long bytesPerSecond);
+
+private:
+    char ipText[TEXT_SIZE] = "";
+    char channelText[TEXT_SIZE] = "";
+    int interactive = -1;
+    uint8_t barHeights[MAX_CHANNELS] = {};
+    unsigned long lastRxBytes[MAX_CHANNELS] = {};
+    unsigned long lastUpdateMs = 0;
+    bool sampled = false;
+
+    bool headerDirty = true;
+    uint16_t dirtyBarColumns = (1u << TILE_COLUMNS) - 1;
+
+    /**
+     * Mark the tile columns a channel's bar and marker cover
+     */
+    void markBar(uint8_t channel);
+};
+
+#endif // STATUS_SCREEN_H
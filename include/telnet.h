@@ -0,0 +1,133 @@
+#ifndef TELNET_H
+#define TELNET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Telnet (RFC 854) as far as RFC 2217 serial port control needs it.
+//
+// Commands start with IAC; an IAC data byte is sent twice. Options are
+// negotiated with WILL/WONT/DO/DONT <option>, and RFC 2217 carries its port
+// settings in subnegotiations: IAC SB COM-PORT-OPTION <command> <value...>
+// IAC SE. The access server answers each command with the same command code
+// plus SERVER_OFFSET and the value now in effect.
+
+static const uint8_t TELNET_IAC = 255;
+static const uint8_t TELNET_DONT = 254;
+static const uint8_t TELNET_DO = 253;
+static const uint8_t TELNET_WONT = 252;
+static const uint8_t TELNET_WILL = 251;
+static const uint8_t TELNET_SB = 250;
+static const uint8_t TELNET_BREAK = 243;
+static const uint8_t TELNET_SE = 240;
+
+// Options
+static const uint8_t TELNET_OPTION_BINARY = 0;
+static const uint8_t TELNET_OPTION_ECHO = 1;
+static const uint8_t TELNET_OPTION_SGA = 3;         // Suppress go-ahead
+static const uint8_t TELNET_OPTION_COM_PORT = 44;   // RFC 2217
+
+// RFC 2217 commands (client to access server)
+namespace rfc2217 {
+static const uint8_t SIGNATURE = 0;
+static const uint8_t SET_BAUDRATE = 1;          // u32 big endian, 0 asks
+static const uint8_t SET_DATASIZE = 2;          // 5 to 8, 0 asks
+static const uint8_t SET_PARITY = 3;            // PARITY_*, 0 asks
+static const uint8_t SET_STOPSIZE = 4;          // STOPSIZE_*, 0 asks
+static const uint8_t SET_CONTROL = 5;           // CONTROL_*
+static const uint8_t NOTIFY_LINESTATE = 6;
+static const uint8_t NOTIFY_MODEMSTATE = 7;
+static const uint8_t FLOWCONTROL_SUSPEND = 8;   // Stop sending output to the client
+static const uint8_t FLOWCONTROL_RESUME = 9;
+static const uint8_t SET_LINESTATE_MASK = 10;
+static const uint8_t SET_MODEMSTATE_MASK = 11;
+static const uint8_t PURGE_DATA = 12;           // PURGE_*
+static const uint8_t SERVER_OFFSET = 100;
+
+static const uint8_t PARITY_NONE = 1;
+static const uint8_t PARITY_ODD = 2;
+static const uint8_t PARITY_EVEN = 3;
+
+static const uint8_t STOPSIZE_1 = 1;
+static const uint8_t STOPSIZE_2 = 2;
+
+static const uint8_t CONTROL_FLOW_REQUEST = 0;          // Outbound flow control, 1 to 3 set it
+static const uint8_t CONTROL_FLOW_NONE = 1;
+static const uint8_t CONTROL_BREAK_REQUEST = 4;
+static const uint8_t CONTROL_BREAK_ON = 5;
+static const uint8_t CONTROL_BREAK_OFF = 6;
+static const uint8_t CONTROL_DTR_REQUEST = 7;
+static const uint8_t CONTROL_DTR_ON = 8;
+static const uint8_t CONTROL_DTR_OFF = 9;
+static const uint8_t CONTROL_RTS_REQUEST = 10;
+static const uint8_t CONTROL_RTS_ON = 11;
+static const uint8_t CONTROL_RTS_OFF = 12;
+static const uint8_t CONTROL_INBOUND_REQUEST = 13;      // Inbound flow control, 14 to 19 set it
+static const uint8_t CONTROL_INBOUND_NONE = 14;
+static const uint8_t CONTROL_INBOUND_LAST = 19;
+
+static const uint8_t PURGE_RECEIVE = 1;         // The access server's output to the client
+static const uint8_t PURGE_TRANSMIT = 2;        // Input not yet written to the line
+static const uint8_t PURGE_BOTH = 3;
+} // namespace rfc2217
+
+/**
+ * Splits a Telnet byte stream from a client into data and commands.
+ * Plain logic without I/O: the caller feeds what it reads and acts on each
+ * event. Subnegotiations longer than MAX_SUBNEGOTIATION are cut short.
+ */
+class TelnetParser {
+public:
+    static const size_t MAX_SUBNEGOTIATION = 16;
+
+    enum class Event : uint8_t {
+        None,               // Byte consumed, nothing complete yet
+        Data,               // getData() is a data byte
+        Option,             // getVerb() (WILL/WONT/DO/DONT) and getOption()
+        Subnegotiation,     // getOption() and getSubnegotiation()
+        Command             // Any other command, e.g. BREAK, in getVerb()
+    };
+
+    /**
+     * Feed one received byte
+     * @return What the byte completed
+     */
+    Event feed(uint8_t byte);
+
+    /**
+     * Forget a partly received command (new connection)
+     */
+    void reset();
+
+    uint8_t getData() const { return data; }
+    uint8_t getVerb() const { return verb; }
+    uint8_t getOption() const { return option; }
+    const uint8_t* getSubnegotiation() const { return subnegotiation; }
+    size_t getSubnegotiationLength() const { return subnegotiationLength; }
+
+private:
+    enum class State : uint8_t {
+        Data,
+        Command,            // After IAC
+        OptionCode,         // After IAC WILL/WONT/DO/DONT
+        SubOption,          // After IAC SB
+        SubData,
+        SubCommand          // IAC inside a subnegotiation
+    };
+
+    State state = State::Data;
+    uint8_t data = 0;
+    uint8_t verb = 0;
+    uint8_t option = 0;
+    uint8_t subnegotiation[MAX_SUBNEGOTIATION];
+    size_t subnegotiationLength = 0;
+};
+
+/**
+ * Copy data to a Telnet stream, doubling each IAC byte
+ * @param output Destination of at least 2 * length bytes
+ * @return Bytes written to output
+ */
+size_t telnetEscape(const uint8_t* data, size_t length, uint8_t* output);
+
+#endif // TELNET_H
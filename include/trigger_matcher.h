@@ -0,0 +1,103 @@
+#ifndef TRIGGER_MATCHER_H
+#define TRIGGER_MATCHER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "pins.h"
+#include "spsc_ring.h"
+
+/**
+ * One match of a trigger pattern
+ */
+struct TriggerAlert {
+    uint8_t channel = 0;
+    uint8_t pattern = 0;    // Index into the pattern list
+};
+
+/**
+ * Spots patterns such as "Kernel panic" in the output of every channel as
+ * it streams through the bridge, whichever channel the clients look at.
+ *
+ * The patterns are compiled into an Aho-Corasick automaton laid out as a
+ * full transition table, so each byte costs one table lookup whatever the
+ * number of patterns, and a match costs nothing more until it is reported.
+ * Bytes that occur in no pattern share one column of the table, which keeps
+ * it small. Each channel keeps its own state, so a pattern split across UART
+ * reads or scan slices still matches.
+ *
+ * feed() runs on the UART stage, the rest on the network stage; compile()
+ * must hold the bridge lock so feed() never sees a half-built table. Matches
+ * are counted per channel and pattern and queued as alerts for the network
+ * stage; alerts that do not fit are counted as dropped.
+ */
+class TriggerMatcher {
+public:
+    static const size_t MAX_PATTERNS = 16;
+    static const size_t MAX_PATTERN_LENGTH = 32;
+    static const size_t MAX_STATES = 128;     // Total pattern length below this
+    static const size_t MAX_CLASSES = 48;     // Distinct pattern bytes below this
+
+    /**
+     * Replace the patterns; every channel starts over and the counts are reset
+     * @param list Patterns separated by '|', not NUL-terminated; empty ones are skipped
+     * @param length Length of list
+     * @return false if they do not fit the limits above (the previous ones stay)
+     */
+    bool compile(const char* list, size_t length);
+
+    /**
+     * Match a channel's output, continuing from where its previous output ended
+     */
+    void feed(uint8_t channel, const uint8_t* data, size_t length);
+
+    /**
+     * Take the oldest alert (network stage)
+     * @return false if there is none
+     */
+    bool popAlert(TriggerAlert& alert);
+
+    size_t getPatternCount() const { return patternCount; }
+
+    /**
+     * @return Pattern text, NUL-terminated ("" if index is out of range)
+     */
+    const char* getPattern(size_t index) const { return index < patternCount ? patterns[index] : ""; }
+
+    /**
+     * Format the pattern list as compile() takes it
+     * @param buffer Output buffer (always NUL-terminated)
+     * @return Length of the list
+     */
+    size_t formatList(char* buffer, size_t size) const;
+
+    /**
+     * @return Matches of a pattern on a channel since compile() (any task)
+     */
+    unsigned long getMatches(uint8_t channel, size_t pattern) const;
+
+    unsigned long getDroppedAlerts() const { return droppedAlerts.load(std::memory_order_relaxed); }
+
+private:
+    // Two bytes per alert (channel, pattern), pushed and popped together
+    static const size_t ALERT_QUEUE_SIZE = 64;
+
+    uint8_t byteClasses[256] = {};                  // 0: in no pattern
+    uint8_t transitions[MAX_STATES][MAX_CLASSES] = {};
+    uint16_t outputs[MAX_STATES] = {};              // Bit n: pattern n ends here
+    uint8_t states[MAX_CHANNELS] = {};
+
+    char patterns[MAX_PATTERNS][MAX_PATTERN_LENGTH + 1] = {};
+    size_t patternCount = 0;
+
+    SpscRing<ALERT_QUEUE_SIZE> alerts;
+    std::atomic<unsigned long> matches[MAX_CHANNELS][MAX_PATTERNS] = {};
+    std::atomic<unsigned long> droppedAlerts{0};
+
+    /**
+     * Count and queue the patterns that end in a state (UART stage)
+     */
+    void report(uint8_t channel, uint16_t ended);
+};
+
+#endif // TRIGGER_MATCHER_H
@@ -0,0 +1,54 @@
+#ifndef UTF8_VALIDATOR_H
+#define UTF8_VALIDATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Streaming UTF-8 validator. Bytes are fed as they are produced and each
+ * byte is examined once; a character split across two feed() calls is
+ * carried over in the state. Runs of ASCII are skipped a machine word at a
+ * time.
+ *
+ * Validation is strict (no overlong forms, surrogates or code points above
+ * U+10FFFF), matching what browsers accept in a WebSocket text frame.
+ */
+class Utf8Validator {
+public:
+    /**
+     * Validate the next bytes of the stream
+     * @param data Bytes following those of the previous call
+     * @param length Number of bytes
+     */
+    void feed(const uint8_t* data, size_t length);
+
+    /**
+     * @return false once an invalid sequence has been fed (until reset())
+     */
+    bool isValid() const;
+
+    /**
+     * @return Number of trailing bytes that start a character not yet complete
+     */
+    size_t pending() const;
+
+    /**
+     * Start a new stream
+     */
+    void reset();
+
+private:
+    uint8_t needed = 0;       // Continuation bytes still expected
+    uint8_t partial = 0;      // Bytes of the incomplete character seen so far
+    uint8_t lower = 0x80;     // Allowed range of the next continuation byte
+    uint8_t upper = 0xBF;
+    bool valid = true;
+
+    /**
+     * Start a multi-byte character
+     * @return false if lead is not a valid lead byte
+     */
+    bool startSequence(uint8_t lead);
+};
+
+#endif // UTF8_VALIDATOR_H
@@ -0,0 +1,34 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Web asset compiled into the firmware by scripts/embed_assets.py
+ * (minified, gzipped when that is smaller, hashed at build time)
+ */
+struct WebAsset {
+    const char* path;       // Request path, e.g. "/index.html"
+    const char* mimeType;
+    const char* etag;       // Quoted, same format as HttpServer's file ETags
+    const uint8_t* data;    // Response body, in flash
+    size_t length;
+    bool gzipped;           // Body needs Content-Encoding: gzip
+};
+
+/**
+ * Look up an embedded asset: one hash and one string compare, no filesystem
+ * access and no allocation
+ * @param path Request path without query string
+ * @return Asset, or nullptr if the path is not embedded
+ */
+const WebAsset* findWebAsset(const char* path);
+
+/**
+ * @return Number of embedded assets (0 when the firmware was built without
+ *         the generated web_assets_data.h)
+ */
+size_t webAssetCount();
+
+#endif // WEB_ASSETS_H
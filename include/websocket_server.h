@@ -1,14 +1,37 @@
 #ifndef WEBSOCKET_SERVER_H
 #define WEBSOCKET_SERVER_H
 
-#include <WebSocketsServer.h>
-#include <WiFi.h>
-#include <HardwareSerial.h>
-#include <LittleFS.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "channel_frame.h"
+#include "hal.h"
+#include "http_server.h"
+#include "latency_stats.h"
+#include "lz_block.h"
+#include "multiplexer.h"
 #include "pins.h"
+#include "utf8_validator.h"
 
-// Forward declaration
-class MultiplexerController;
+// Forward declarations
+class SerialBridge;
+
+/**
+ * Live output counters
+ */
+struct OutputStats {
+    unsigned long frames = 0;           // Frames sent since start
+    unsigned long textFrames = 0;       // Of which complete UTF-8, sent as text frames
+    unsigned long binaryFrames = 0;     // Of which invalid UTF-8, sent as binary frames
+    unsigned long bytes = 0;            // Payload bytes sent since start
+    unsigned long liveBytes = 0;        // Of which interactive output sent as it arrived
+    unsigned long framesPerSecond = 0;  // Over the last rate window
+    unsigned long bytesPerSecond = 0;   // Smoothed output rate
+    size_t frameTarget = 0;             // Current coalescing frame size
+    unsigned long compressedFrames = 0;     // Frames sent LZ-compressed to compressing clients
+    unsigned long compressInputBytes = 0;   // Payload of the frames offered to the compressor
+    unsigned long compressOutputBytes = 0;  // What those frames took on the wire, compressed or not
+    unsigned long compressUs = 0;           // Time spent compressing
+};
 
 class WebSocketServer {
 public:
@@ -24,23 +47,26 @@ public:
     void loop();
 
     /**
-     * Set references to multiplexer and serial for channel switching
+     * Set references to multiplexer and serial bridge for channel switching
      * @param multiplexer Pointer to multiplexer controller
-     * @param serial Pointer to hardware serial for SBC communication
+     * @param bridge Pointer to the bridge carrying bytes to and from the SBCs
      */
-    void setReferences(MultiplexerController* multiplexer, HardwareSerial* serial);
+    void setReferences(MultiplexerController* multiplexer, SerialBridge* bridge);
 
     /**
-     * Set the current serial channel (0-4 for SBC1-SBC5)
+     * Make a channel interactive (move the mux). Clients keep the channel
+     * they view: viewers of the previous channel continue from the
+     * scrollback, viewers of the new one catch up and then get live output.
      * @param channel Channel number (0-4)
      */
     void setChannel(int channel);
 
     /**
-     * Send data to all connected WebSocket clients
+     * Send data to the terminal clients viewing the interactive channel
      * @param data Data to send
+     * @param length Length of data in bytes
      */
-    void broadcast(const String& data);
+    void broadcast(const uint8_t* data, size_t length);
 
     /**
      * Add character to buffer for UTF-8 processing
@@ -49,9 +75,59 @@ public:
     void addToBuffer(char c);
 
     /**
-     * Force flush the character buffer
+     * Send the character buffer
+     * @param holdPartial Keep a trailing incomplete UTF-8 character for the
+     *        next frame (it is still sent once older than OUTPUT_LATENCY_MAX_MS);
+     *        false sends everything, e.g. before a channel switch
+     */
+    void flushBuffer(bool holdPartial = false);
+
+    /**
+     * Coalescing policy, called after each batch of addToBuffer() calls.
+     * Also sends pending output of all channels to channel-protocol clients.
+     * The buffer is sent when a keystroke echo is expected, when the line
+     * went idle, or when its oldest byte reaches OUTPUT_LATENCY_MAX_MS;
+     * otherwise it keeps growing towards the current frame target.
+     * @param lineIdle true if no output arrived since the previous call
+     */
+    void flushIfDue(bool lineIdle);
+
+    /**
+     * @return Frame rate and size of the live output
+     */
+    OutputStats getOutputStats() const;
+
+    /**
+     * @return Sizes of the live output frames sent by sendBufferedData()
+     */
+    const SizeHistogram& getFrameSizes() const { return frameSizes; }
+
+    /**
+     * @return Connected clients using the terminal protocol
+     */
+    size_t getTerminalClients() const;
+
+    /**
+     * @return Connected clients using the channel protocol
      */
-    void flushBuffer();
+    size_t getChannelClients() const { return channelClients; }
+
+    /**
+     * @return The HTTP server sharing the network task
+     */
+    const HttpServer& getHttpServer() const { return httpServer; }
+
+    /**
+     * Serve /metrics from an exporter
+     */
+    void setMetrics(MetricsExport* metrics) { httpServer.setMetrics(metrics); }
+
+    /**
+     * Tell every client that a channel's output matched a trigger pattern
+     * with a TRIGGER:<channel>,<pattern> text frame, on either protocol and
+     * never inside the channel's output
+     */
+    void notifyTrigger(uint8_t channel, const char* pattern);
 
     /**
      * Send binary data to all connected WebSocket clients
@@ -60,6 +136,28 @@ public:
      */
     void broadcastBinary(const uint8_t* data, size_t length);
 
+    /**
+     * A TCP port client (port_server.h) connected to a channel: the mux
+     * follows unless another writer holds the interactive channel, as when
+     * a terminal client selects a channel to view
+     * @param channel Channel number (0-4)
+     */
+    void attachPort(uint8_t channel);
+
+    /**
+     * Take the write lock of a channel for its TCP port, sharing the
+     * arbitration of the WebSocket clients, and move the mux to it
+     * @param channel Channel number (0-4)
+     * @return true if the port may write to the channel now
+     */
+    bool claimForPort(uint8_t channel);
+
+    /**
+     * The TCP port client of a channel left: release its write lock
+     * @param channel Channel number (0-4)
+     */
+    void detachPort(uint8_t channel);
+
     /**
      * Get current WebSocket connection status
      * @return true if at least one client is connected
@@ -68,72 +166,346 @@ public:
 
     /**
      * Get current SBC channel
-     * @return Current channel number (0-4)
+     * @return Interactive channel number (0-4)
      */
     int getCurrentChannel();
 
 private:
-    WebSocketsServer* webSocket = nullptr;
-    WiFiServer* httpServer = nullptr;
+    /**
+     * Wire protocol chosen by a client when it connects
+     */
+    enum class ClientProtocol : uint8_t {
+        None,       // Not connected
+        Terminal,   // Legacy: raw bytes of the viewed channel
+        Channel     // Channel-tagged binary frames for all channels (channel_frame.h)
+    };
+
+    hal::WebSocketTransport* webSocket = nullptr;
+    HttpServer httpServer;
+    hal::FileSystem* fileSystem = nullptr;
     int currentChannel = 0;
     bool initialized = false;
 
-    // Character buffering for UTF-8 handling
-    static const size_t BUFFER_SIZE = 256;
-    static const unsigned long BUFFER_TIMEOUT_MS = 50;
+    // Character buffering for UTF-8 handling, sized for the largest frame
+    static const size_t BUFFER_SIZE = OUTPUT_FRAME_MAX;
+    static const size_t MIN_FRAME_TARGET = 64;
+    // Output after a keystroke is treated as its echo for this long
+    static const unsigned long ECHO_WINDOW_MS = 200;
+    // Period over which the output rate and frames/s are measured
+    static const unsigned long RATE_WINDOW_MS = 250;
+
+    // Reply buffer for SCAN:STATS
+    static const size_t SCAN_REPORT_SIZE = 768 + MAX_CHANNELS * 128;
+
+    // Scrollback replay on connect/channel switch
+    static const size_t REPLAY_TAIL_BYTES = 4096;  // History sent per replay
+    static const size_t REPLAY_FRAME_SIZE = 1024;  // Bytes per WebSocket frame
+    static const int ALL_CLIENTS = -1;  // Every terminal client viewing the interactive channel
+
+    uint8_t replayFrame[REPLAY_FRAME_SIZE];
+
+    // Terminal clients that asked for "compress=lz" get binary frames with a
+    // PACKED_HEADER: 0 then raw bytes, or 1, the length (16-bit little
+    // endian) and an lz_block.h block. Text frames are sent as they are.
+    static const size_t PACKED_HEADER = 3;
+    static const uint8_t PACKED_RAW = 0;
+    static const uint8_t PACKED_LZ = 1;
+    static const size_t PACKED_FRAME_SIZE =
+        PACKED_HEADER + (BUFFER_SIZE > REPLAY_FRAME_SIZE ? BUFFER_SIZE : REPLAY_FRAME_SIZE);
+
+    uint8_t packedFrame[PACKED_FRAME_SIZE];
+    uint16_t lzTable[LZ_HASH_SIZE];
+
+    // Connected clients (WEBSOCKETS_SERVER_CLIENT_MAX of the WebSockets library)
+    static const uint8_t MAX_CLIENTS = 5;
+    // Channel protocol: frame size and frames sent per client per call
+    static const size_t CHANNEL_FRAME_SIZE = 2048;
+    static const int MAX_CHANNEL_FRAMES_PER_CALL = 4;
+
+    ClientProtocol clientProtocols[MAX_CLIENTS] = {};
+    size_t channelClients = 0;
+    bool compressOutput[MAX_CLIENTS] = {};
+    size_t compressClients = 0;
+
+    // Per-client subscriptions: the channel a terminal client views, the
+    // channels a channel-protocol client streams (bit n = channel n)
+    typedef uint32_t ChannelMask;
+    static_assert(MAX_CHANNELS <= 32, "ChannelMask holds one bit per channel");
+    static const ChannelMask ALL_CHANNELS = (ChannelMask)((1ULL << MAX_CHANNELS) - 1);
+
+    uint8_t viewChannels[MAX_CLIENTS] = {};
+    ChannelMask subscriptions[MAX_CLIENTS] = {};
+    bool broadcastLive = true;  // Every client is a terminal viewing the interactive channel
+
+    // Write arbitration: one client at a time may type on a channel, the
+    // others are read-only observers. The lock is released when its owner
+    // disconnects, views another channel or stays silent for
+    // WRITE_LOCK_IDLE_MS. Keystrokes for another channel only move the mux
+    // away from a locked channel after MUX_HOLD_MS of silence; selecting a
+    // channel to view never does. The TCP port of channel n writes as owner
+    // MAX_CLIENTS + n.
+    static const int8_t NO_WRITER = -1;
+    static const unsigned long WRITE_LOCK_IDLE_MS = 60000;
+    static const unsigned long MUX_HOLD_MS = 5000;
+
+    int8_t writeOwners[MAX_CHANNELS];
+    unsigned long lastWriteTime[MAX_CHANNELS] = {};
+    bool readOnlyNotified[MAX_CLIENTS] = {};
+
+    // Keystroke tracing: id announced by TRACE:<id> for a client's next input
+    uint32_t traceIds[MAX_CLIENTS] = {};
+    bool tracePending[MAX_CLIENTS] = {};
+
+    // Per channel-protocol client: next stream position to send per channel,
+    // end of the history replayed on connect, and age of unsent output.
+    // Terminal clients viewing a channel other than the interactive one are
+    // fed from the scrollback with the same cursor.
+    uint32_t sentSequence[MAX_CLIENTS][MAX_CHANNELS] = {};
+    uint32_t replayEnd[MAX_CLIENTS][MAX_CHANNELS] = {};
+    unsigned long pendingSince[MAX_CLIENTS] = {};
+    bool pendingOutput[MAX_CLIENTS] = {};
+    uint8_t firstChannel[MAX_CLIENTS] = {};  // Round-robin start of the next frame
+
+    uint8_t channelFrame[CHANNEL_FRAME_SIZE];
 
     uint8_t charBuffer[BUFFER_SIZE];
     size_t bufferPos = 0;
+    size_t validatedPos = 0;  // Bytes of charBuffer already fed to utf8
     unsigned long lastBufferTime = 0;
+    Utf8Validator utf8;
+
+    // Coalescing state
+    size_t frameTarget = MIN_FRAME_TARGET;
+    unsigned long lastKeystrokeTime = 0;
+    bool keystrokeSeen = false;
+    unsigned long rateWindowStart = 0;
+    unsigned long rateWindowBytes = 0;
+    unsigned long rateWindowFrames = 0;
+    OutputStats outputStats;
+    SizeHistogram frameSizes;
 
     /**
      * WebSocket event handler
      */
-    static void webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length);
+    static void webSocketEvent(uint8_t num, hal::WsEvent type, const uint8_t* payload, size_t length);
     
     /**
-     * Handle HTTP requests
+     * Handle channel selection command
+     * @param num Client that sent the command
+     * @param command Command text ("CHANNEL:n"), not NUL-terminated
+     * @param length Command length in bytes
      */
-    void handleHTTPClient();
-    
+    void handleChannelCommand(uint8_t num, const uint8_t* command, size_t length);
+
     /**
-     * Serve file from LittleFS with proper MIME type and gzip handling
-     * @param client WiFi client to serve to
-     * @param path File path to serve
+     * Handle channel subscription command of a channel-protocol client
+     * ("SUBSCRIBE:0,2,4", "SUBSCRIBE:*" for all channels)
+     * @param num Client that sent the command
+     * @param command Command text, not NUL-terminated
+     * @param length Command length in bytes
      */
-    void serveFile(WiFiClient& client, const String& path);
-    
+    void handleSubscribeCommand(uint8_t num, const uint8_t* command, size_t length);
+
     /**
-     * Get MIME type for file extension
-     * @param filename File name or path
-     * @return MIME type string
+     * Handle input pacing command ("PACE:<channel>,<char_us>,<line_ms>,<echo>",
+     * "PACE:<channel>" to query); replies with the channel's pacing
+     * @param num Client that sent the command
+     * @param command Command text, not NUL-terminated
+     * @param length Command length in bytes
      */
-    String getMimeType(const String& filename);
-    
+    void handlePaceCommand(uint8_t num, const uint8_t* command, size_t length);
+
     /**
-     * Check if file exists in LittleFS (with or without .gz extension)
-     * @param path File path to check
-     * @return actual file path if found, empty string if not found
+     * Handle line settings command ("LINE:<channel>,<baud|AUTO>[,8N1]",
+     * "LINE:<channel>" to query); replies with the channel's settings
+     * @param num Client that sent the command
+     * @param command Command text, not NUL-terminated
+     * @param length Command length in bytes
      */
-    String findFile(const String& path);
-    
+    void handleLineCommand(uint8_t num, const uint8_t* command, size_t length);
+
     /**
-     * Handle channel selection command
+     * Handle trigger command: "TRIGGERS" reports the patterns,
+     * "TRIGGERS:<pattern>|<pattern>..." replaces them
+     * @param num Client that sent the command
+     * @param command Command text, not NUL-terminated
+     * @param length Command length in bytes
+     */
+    void handleTriggersCommand(uint8_t num, const uint8_t* command, size_t length);
+
+    /**
+     * Handle keystroke trace command ("TRACE:<id>"): the client's next
+     * input is traced (see keystroke_trace.h) and reported in /trace.json
+     * @param num Client that sent the command
+     * @param command Command text, not NUL-terminated
+     * @param length Command length in bytes
      */
-    void handleChannelCommand(const String& command);
+    void handleTraceCommand(uint8_t num, const uint8_t* command, size_t length);
 
     /**
-     * Check if buffer contains valid UTF-8 sequence
-     * @param data Buffer data to check
-     * @param length Buffer length
+     * Trace the input about to be queued if the client announced a trace
+     */
+    void startTrace(uint8_t num, uint8_t channel);
+
+    /**
+     * Queue input for an SBC; a client whose paste does not fit is told how
+     * many bytes were dropped
+     */
+    void queueInput(uint8_t num, uint8_t channel, const uint8_t* data, size_t length);
+
+    /**
+     * Show a channel to a terminal client (replaying its history), or ask
+     * for it to become interactive for a channel-protocol client. The mux
+     * follows unless another client holds the interactive channel's write lock.
+     */
+    void selectView(uint8_t num, uint8_t channel);
+
+    /**
+     * Take the write lock of a channel for a client and move the mux to it
+     * @return true if the client may write to the channel now; false if the
+     *         client is a read-only observer (it is told so once)
+     */
+    bool claimChannel(uint8_t num, uint8_t channel);
+
+    /**
+     * Take the write lock of a channel for a client or TCP port and move
+     * the mux to it (bridge lock held)
+     * @param owner Client number, or portOwner() of the channel
+     * @param blocking Set to the channel whose lock is in the way, if any
+     * @return false if another writer blocks the channel
+     */
+    bool acquireConsole(int8_t owner, uint8_t channel, int& blocking);
+
+    /**
+     * @return Write lock owner id of a channel's TCP port
+     */
+    static int8_t portOwner(uint8_t channel) { return (int8_t)(MAX_CLIENTS + channel); }
+
+    /**
+     * @return true if a writer other than owner holds the write lock of the
+     *         channel and used it within the given time
+     */
+    bool lockedByOther(int8_t owner, uint8_t channel, unsigned long heldMs, unsigned long now) const;
+
+    /**
+     * Drop every write lock and subscription of a client
+     */
+    void releaseClient(uint8_t num);
+
+    /**
+     * Recompute whether live output can be broadcast to every client
+     */
+    void updateRouting();
+
+    /**
+     * Send a terminal client viewing a non-interactive channel the output
+     * captured since its cursor
+     * @param all Send everything now (before the channel goes live) instead
+     *        of following the coalescing policy
+     */
+    void sendTerminalBacklog(uint8_t num, bool lineIdle, bool all);
+
+    /**
+     * Position a channel-protocol client's cursor at the tail of a channel's
+     * history, which is then sent as REPLAY records
+     */
+    void startChannelStream(uint8_t num, uint8_t channel);
+
+    /**
+     * Handle background scan command (SCAN:ON, SCAN:OFF, SCAN:STATS)
+     * @param num Client that sent the command (receives the STATS report)
+     * @param command Command text, not NUL-terminated
+     * @param length Command length in bytes
+     */
+    void handleScanCommand(uint8_t num, const uint8_t* command, size_t length);
+
+    /**
+     * Check if data is complete, valid UTF-8
+     * @param data Bytes to check
+     * @param length Number of bytes
      * @return true if valid UTF-8, false otherwise
      */
     bool isValidUTF8Sequence(const uint8_t* data, size_t length);
 
     /**
-     * Send buffered data using appropriate frame type
+     * Send buffered data using appropriate frame type: complete characters
+     * go out as a text frame, invalid data as a binary frame
+     * @param holdPartial Keep a trailing incomplete character in the buffer
+     */
+    void sendBufferedData(bool holdPartial);
+
+    /**
+     * Close the rate window if it has elapsed and derive the frame target:
+     * the bytes arriving in OUTPUT_LATENCY_MAX_MS at the smoothed rate
+     */
+    void updateFrameTarget(unsigned long now);
+
+    /**
+     * @return true while output is likely the echo of a recent keystroke
+     */
+    bool echoExpected(unsigned long now) const;
+
+    /**
+     * Send the tail of a channel's scrollback in a few large frames
+     * @param channel Channel whose history is replayed
+     * @param num Client to send to, or ALL_CLIENTS for every terminal client
+     */
+    void replayScrollback(uint8_t channel, int num);
+
+    /**
+     * Send raw terminal output to one or all clients using the legacy protocol
+     * @param num Client number, or ALL_CLIENTS
+     * @param text Send as a text frame (data is complete UTF-8) or binary;
+     *             output that looks like a trigger notice is sent binary
+     * @param length At most PACKED_FRAME_SIZE - PACKED_HEADER bytes
+     */
+    void sendTerminalData(int num, bool text, const uint8_t* data, size_t length);
+
+    /**
+     * Build the frame compressing clients get for some terminal output in
+     * packedFrame: compressed if it is long enough and shrinks, else the raw
+     * bytes behind a header if they go in a binary frame
+     * @return Length of the frame, 0 if they get the output as a text frame
+     */
+    size_t packTerminalData(bool text, const uint8_t* data, size_t length);
+
+    /**
+     * Send terminal output to one client: the packed frame if it compresses
+     * and there is one, the raw output otherwise
+     */
+    void sendTerminalFrame(uint8_t num, bool text, const uint8_t* data, size_t length, size_t packedLength);
+
+    /**
+     * Register a new client; "proto=1" in the request path selects the
+     * channel protocol, anything else the terminal protocol, which
+     * "compress=lz" asks to be compressed
+     * @param path Request path sent by the client, not NUL-terminated
+     */
+    void connectClient(uint8_t num, const uint8_t* path, size_t length);
+
+    /**
+     * Send control text (e.g. ACTIVE:n) to every channel-protocol client
+     */
+    void notifyChannelClients(const char* text);
+
+    /**
+     * Send pending output of subscribed channels to channel-protocol
+     * clients, and scrollback output to terminal clients viewing a channel
+     * other than the interactive one
+     * @param lineIdle true if no output arrived since the previous call
+     */
+    void serviceChannelClients(bool lineIdle);
+
+    /**
+     * Fill channelFrame with the next unsent output for a client
+     * @return Frame length, 0 if nothing is pending
+     */
+    size_t buildChannelFrame(uint8_t num);
+
+    /**
+     * Write the payload of each record of a client frame to its channel
      */
-    void sendBufferedData();
+    void handleChannelInput(uint8_t num, const uint8_t* frame, size_t length);
 };
 
 #endif // WEBSOCKET_SERVER_H
\ No newline at end of file
@@ -18,16 +18,21 @@ public:
     bool isConnected() const;
 
     /**
-     * Get IP address as string
-     * @return IP address string
+     * Format the IP address, e.g. "192.168.1.123"
+     * @param buffer Destination, at least IP_ADDRESS_SIZE bytes
+     * @param size Size of buffer
      */
-    String getIPAddress() const;
+    void getIPAddress(char* buffer, size_t size) const;
 
     /**
-     * Get last 3 digits of IP address for OLED display
-     * @return last 3 digits as string (e.g., "123" from "192.168.1.123")
+     * Format the last number of the IP address for the OLED display
+     * @param buffer Destination, at least IP_LAST3_SIZE bytes; "---" if not connected
+     * @param size Size of buffer
      */
-    String getIPLast3Digits() const;
+    void getIPLast3Digits(char* buffer, size_t size) const;
+
+    static const size_t IP_ADDRESS_SIZE = 16;  // "255.255.255.255"
+    static const size_t IP_LAST3_SIZE = 4;
 
 private:
     bool connected = false;
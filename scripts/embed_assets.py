@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+PlatformIO pre-build script to embed the web assets in the firmware
+This script minifies and compresses the files in data-src/ and writes
+include/web_assets_data.h: one flash array per file plus a perfect-hashed
+lookup table, so the HTTP server serves them without touching LittleFS.
+Also runs standalone: python3 scripts/embed_assets.py
+"""
+
+import gzip
+import re
+from pathlib import Path
+
+try:
+    import zopfli.gzip as zopfli_gzip  # pip install zopfli: ~5% smaller
+except ImportError:
+    zopfli_gzip = None
+
+MIME_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.svg': 'image/svg+xml',
+    '.json': 'application/json',
+    '.txt': 'text/plain',
+    '.ico': 'image/x-icon',
+    '.png': 'image/png',
+}
+
+# Same constants as the FNV-1a ETags computed by src/http_server.cpp
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+
+def fnv1a(data, seed=FNV_OFFSET):
+    value = seed
+    for byte in data:
+        value = ((value ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def minify(text, suffix):
+    """Conservative minification: indentation, blank lines and comment lines
+
+    Only whitespace at line boundaries is removed and line breaks are kept,
+    so automatic semicolon insertion and string contents are unaffected.
+    Files with a template literal spanning lines are left alone.
+    """
+    if any(line.count('`') % 2 for line in text.splitlines()):
+        return text
+    if suffix == '.css':
+        text = re.sub(r'/\*.*?\*/', '', text, flags=re.S)
+    lines = []
+    for line in text.splitlines():
+        line = line.strip()
+        if not line:
+            continue
+        if suffix == '.js' and line.startswith('//'):
+            continue
+        lines.append(line)
+    return '\n'.join(lines) + '\n'
+
+
+def compress(data):
+    if zopfli_gzip:
+        return zopfli_gzip.compress(data)
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def perfect_hash(paths):
+    """Find a seed for which FNV-1a of every path lands in its own slot"""
+    table_size = 1
+    while table_size < len(paths):
+        table_size *= 2
+    while True:
+        for seed in range(1, 1 << 16):
+            slots = {fnv1a(path.encode(), seed) & (table_size - 1) for path in paths}
+            if len(slots) == len(paths):
+                return seed, table_size
+        table_size *= 2
+
+
+def c_bytes(data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    return '\n'.join(rows)
+
+
+def embed_assets(project_dir):
+    data_src_dir = project_dir / "data-src"
+    header_path = project_dir / "include" / "web_assets_data.h"
+
+    if not data_src_dir.exists():
+        print("No data-src directory found, skipping asset embedding")
+        return
+
+    assets = []
+    for file_path in sorted(data_src_dir.rglob('*')):
+        suffix = file_path.suffix.lower()
+        if not file_path.is_file() or suffix not in MIME_TYPES:
+            continue
+        raw = file_path.read_bytes()
+        if suffix in ('.html', '.css', '.js', '.svg', '.json'):
+            raw = minify(raw.decode('utf-8'), suffix).encode('utf-8')
+        body = compress(raw)
+        gzipped = len(body) < len(raw)
+        if not gzipped:
+            body = raw
+        path = '/' + file_path.relative_to(data_src_dir).as_posix()
+        etag = '"%08x-%x"' % (fnv1a(body), len(body))
+        assets.append((path, MIME_TYPES[suffix], etag, body, gzipped, file_path.stat().st_size))
+
+    if not assets:
+        print("No web assets to embed")
+        return
+
+    seed, table_size = perfect_hash([asset[0] for asset in assets])
+    slots = [-1] * table_size
+    for index, asset in enumerate(assets):
+        slots[fnv1a(asset[0].encode(), seed) & (table_size - 1)] = index
+
+    out = ['// Generated by scripts/embed_assets.py from data-src/ - do not edit',
+           '#ifndef WEB_ASSETS_DATA_H',
+           '#define WEB_ASSETS_DATA_H',
+           '',
+           '#include "web_assets.h"',
+           '',
+           'namespace web_assets_data {',
+           '']
+    for index, (path, _, _, body, _, _) in enumerate(assets):
+        out.append('// %s' % path)
+        out.append('static const uint8_t ASSET_%d[%d] = {' % (index, len(body)))
+        out.append(c_bytes(body))
+        out.append('};')
+        out.append('')
+    out.append('static constexpr WebAsset ASSETS[] = {')
+    for index, (path, mime, etag, body, gzipped, _) in enumerate(assets):
+        out.append('    {"%s", "%s", "%s", ASSET_%d, %d, %s},' %
+                   (path, mime, etag.replace('"', '\\"'), index, len(body), 'true' if gzipped else 'false'))
+    out.append('};')
+    out.append('')
+    out.append('static constexpr uint32_t HASH_SEED = %du;' % seed)
+    out.append('static constexpr size_t TABLE_SIZE = %d;' % table_size)
+    out.append('static constexpr int8_t SLOTS[TABLE_SIZE] = {%s};' % ', '.join(str(s) for s in slots))
+    out.append('')
+    out.append('} // namespace web_assets_data')
+    out.append('')
+    out.append('#endif // WEB_ASSETS_DATA_H')
+    content = '\n'.join(out) + '\n'
+
+    # Leave the header untouched when nothing changed, so it does not
+    # trigger a rebuild
+    if header_path.exists() and header_path.read_text() == content:
+        return
+    header_path.write_text(content)
+
+    original = sum(asset[5] for asset in assets)
+    embedded = sum(len(asset[3]) for asset in assets)
+    print(f"Embedded {len(assets)} web assets: {original} -> {embedded} bytes "
+          f"({'zopfli' if zopfli_gzip else 'gzip -9'}, {table_size}-slot table)")
+
+
+try:
+    Import("env")
+    embed_assets(Path(env.subst("$PROJECT_DIR")))
+except NameError:
+    embed_assets(Path(__file__).resolve().parent.parent)
@@ -0,0 +1,73 @@
+#include "channel_frame.h"
+
+void ChannelFrameWriter::begin(uint8_t* buffer, size_t capacity) {
+    this->buffer = buffer;
+    this->capacity = capacity;
+    length = 0;
+    if (capacity > 0) {
+        buffer[length++] = CHANNEL_FRAME_VERSION;
+    }
+}
+
+uint8_t* ChannelFrameWriter::beginRecord(uint8_t channel, uint8_t flags, uint32_t sequence, size_t& maxLength) {
+    maxLength = 0;
+    if (length + CHANNEL_RECORD_HEADER_SIZE >= capacity) {
+        return nullptr;
+    }
+
+    recordStart = length;
+    uint8_t* header = buffer + length;
+    header[0] = channel;
+    header[1] = flags;
+    header[2] = (uint8_t)sequence;
+    header[3] = (uint8_t)(sequence >> 8);
+    header[4] = (uint8_t)(sequence >> 16);
+    header[5] = (uint8_t)(sequence >> 24);
+
+    size_t space = capacity - length - CHANNEL_RECORD_HEADER_SIZE;
+    maxLength = space < 0xFFFF ? space : 0xFFFF;
+    return header + CHANNEL_RECORD_HEADER_SIZE;
+}
+
+void ChannelFrameWriter::endRecord(size_t payloadLength) {
+    uint8_t* header = buffer + recordStart;
+    header[6] = (uint8_t)payloadLength;
+    header[7] = (uint8_t)(payloadLength >> 8);
+    length = recordStart + CHANNEL_RECORD_HEADER_SIZE + payloadLength;
+}
+
+size_t ChannelFrameWriter::size() const {
+    return length;
+}
+
+bool ChannelFrameWriter::hasRecords() const {
+    return length > 1;
+}
+
+ChannelFrameReader::ChannelFrameReader(const uint8_t* frame, size_t length)
+    : frame(frame), length(length) {}
+
+bool ChannelFrameReader::isValid() const {
+    return length > 0 && frame[0] == CHANNEL_FRAME_VERSION;
+}
+
+bool ChannelFrameReader::next(ChannelRecord& record) {
+    if (!isValid() || position + CHANNEL_RECORD_HEADER_SIZE > length) {
+        return false;
+    }
+
+    const uint8_t* header = frame + position;
+    size_t payloadLength = header[6] | (size_t)header[7] << 8;
+    if (position + CHANNEL_RECORD_HEADER_SIZE + payloadLength > length) {
+        return false;
+    }
+
+    record.channel = header[0];
+    record.flags = header[1];
+    record.sequence = (uint32_t)header[2] | (uint32_t)header[3] << 8 |
+                      (uint32_t)header[4] << 16 | (uint32_t)header[5] << 24;
+    record.payload = header + CHANNEL_RECORD_HEADER_SIZE;
+    record.length = payloadLength;
+    position += CHANNEL_RECORD_HEADER_SIZE + payloadLength;
+    return true;
+}
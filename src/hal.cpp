@@ -0,0 +1,43 @@
+#include "hal.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace hal {
+
+size_t Print::print(const char* text) {
+    return write((const uint8_t*)text, strlen(text));
+}
+
+size_t Print::print(unsigned long value) {
+    char digits[24];
+    int length = snprintf(digits, sizeof(digits), "%lu", value);
+    return write((const uint8_t*)digits, (size_t)length);
+}
+
+size_t Print::println(const char* text) {
+    return print(text) + write((const uint8_t*)"\r\n", 2);
+}
+
+size_t Print::println(unsigned long value) {
+    return print(value) + write((const uint8_t*)"\r\n", 2);
+}
+
+size_t Print::printf(const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return 0;
+    }
+    if ((size_t)length >= sizeof(line)) {
+        length = sizeof(line) - 1;  // Truncated
+    }
+    return write((const uint8_t*)line, (size_t)length);
+}
+
+} // namespace hal
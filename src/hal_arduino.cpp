@@ -0,0 +1,508 @@
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <WebSocketsServer.h>
+#include <WiFi.h>
+#include <LittleFS.h>
+#include <lwip/sockets.h>
+
+#include <atomic>
+#include <mutex>
+#include <driver/uart.h>
+#include <esp_heap_caps.h>
+#include <hal/uart_ll.h>
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+
+#include "hal.h"
+#include "pins.h"
+#include "spsc_ring.h"
+
+// Arduino/ESP-IDF bindings for the HAL interfaces declared in hal.h
+
+namespace {
+
+class ArduinoClock : public hal::Clock {
+public:
+    unsigned long millis() override { return ::millis(); }
+    unsigned long micros() override { return ::micros(); }
+    void delay(unsigned long ms) override { ::delay(ms); }
+    void delayMicroseconds(unsigned long us) override { ::delayMicroseconds(us); }
+};
+
+class ArduinoGpio : public hal::Gpio {
+public:
+    void setOutput(uint8_t pin) override {
+        pinMode(pin, OUTPUT);
+    }
+
+    void write(uint8_t pin, bool high) override {
+        digitalWrite(pin, high ? HIGH : LOW);
+    }
+
+    void writeMask(uint32_t mask, uint32_t levels) override {
+        // Read-modify-write of the whole output register: interrupts are off
+        // so a digitalWrite() of another pin (W1TS/W1TC) cannot slip in
+        // between and be lost
+        portENTER_CRITICAL(&lock);
+        uint32_t out = REG_READ(GPIO_OUT_REG);
+        REG_WRITE(GPIO_OUT_REG, (out & ~mask) | (levels & mask));
+        portEXIT_CRITICAL(&lock);
+    }
+
+private:
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+/**
+ * UART whose receive side is pumped by the ESP-IDF UART driver event task
+ * (RX FIFO-full and RX timeout events) into a lock-free SPSC ring, so bytes
+ * keep flowing while loop() is busy serving HTTP or sending frames.
+ */
+class ArduinoUart : public hal::Uart {
+public:
+    ArduinoUart(HardwareSerial& serial, uart_port_t port) : serial(serial), port(port) {}
+
+    void begin(unsigned long baud) override {
+        line = hal::LineConfig();
+        line.baud = baud;
+        serial.setRxBufferSize(UART_DRIVER_RX_BUFFER);  // Must precede begin()
+        serial.begin(baud, SERIAL_8N1, RX_PIN, TX_PIN);
+        serial.setRxFIFOFull(UART_RX_FIFO_THRESHOLD);
+        serial.setRxTimeout(UART_RX_TIMEOUT_SYMBOLS);
+        serial.onReceiveError([this](hardwareSerial_error_t error) { countError(error); });
+        serial.onReceive([this]() { pump(); }, false);
+    }
+
+    void setLineConfig(const hal::LineConfig& config) override {
+        // Register writes only: the driver, its buffer and rxRing stay as they are
+        if (config.baud != line.baud) {
+            serial.updateBaudRate(config.baud);
+        }
+        bool regap = config.baud != line.baud;
+        if (config.dataBits != line.dataBits) {
+            uart_set_word_length(port, (uart_word_length_t)(UART_DATA_5_BITS + (config.dataBits - 5)));
+        }
+        if (config.parity != line.parity) {
+            uart_set_parity(port, config.parity == hal::Parity::Even ? UART_PARITY_EVEN :
+                                  config.parity == hal::Parity::Odd ? UART_PARITY_ODD : UART_PARITY_DISABLE);
+        }
+        if (config.stopBits != line.stopBits) {
+            uart_set_stop_bits(port, config.stopBits == 2 ? UART_STOP_BITS_2 : UART_STOP_BITS_1);
+        }
+        line = config;
+        if (regap && txGapUs > 0) {
+            applyTxGap();   // Same time, different number of bit times
+        }
+    }
+
+    hal::LineConfig getLineConfig() override {
+        return line;
+    }
+
+    void startPulseMeasurement() override {
+        // The autobaud counters restart when re-enabled
+        uart_dev_t* hw = UART_LL_GET_HW(port);
+        uart_ll_set_autobaud_en(hw, false);
+        uart_ll_set_autobaud_en(hw, true);
+    }
+
+    unsigned long getShortestPulseNs() override {
+        uart_dev_t* hw = UART_LL_GET_HW(port);
+        if (uart_ll_get_rxd_edge_cnt(hw) < PULSE_MIN_EDGES) {
+            return 0;
+        }
+        uint32_t low = uart_ll_get_low_pulse_cnt(hw);
+        uint32_t high = uart_ll_get_high_pulse_cnt(hw);
+        uint32_t cycles = low < high ? low : high;
+        // Counted in UART source clock cycles (APB, the Arduino default)
+        return (unsigned long)((uint64_t)cycles * 1000000000ULL / APB_CLK_FREQ);
+    }
+
+    size_t available() override {
+        // Lift an expired fence here, on the reading task, so the flag has a
+        // single writer and a stale end time can never wrap around
+        if (fenced.load(std::memory_order_relaxed) &&
+            (long)(micros() - fenceEnd.load(std::memory_order_relaxed)) >= 0) {
+            fenced.store(false, std::memory_order_relaxed);
+        }
+        return rxRing.size();
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        return rxRing.pop(buffer, length);
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        return serial.write(data, length);
+    }
+
+    size_t availableForWrite() override {
+        int space = serial.availableForWrite();
+        return space > 0 ? (size_t)space : 0;
+    }
+
+    bool txIdle() override {
+        return uart_wait_tx_done(port, 0) == ESP_OK;  // Zero timeout: just poll
+    }
+
+    void setBreak(bool on) override {
+        // Inverting the idle-high TX line holds it low for as long as needed
+        uart_set_line_inverse(port, on ? UART_SIGNAL_TXD_INV : UART_SIGNAL_INV_DISABLE);
+    }
+
+    unsigned long setTxGap(unsigned long gapUs) override {
+        if (gapUs != txGapUs) {
+            txGapUs = gapUs;
+            applyTxGap();
+        }
+        unsigned long maxUs = line.baud ? (unsigned long)(MAX_TX_GAP_BITS * 1000000ULL / line.baud) : 0;
+        return gapUs < maxUs ? gapUs : maxUs;
+    }
+
+    void fenceUntil(unsigned long untilUs) override {
+        fenceEnd.store(untilUs, std::memory_order_relaxed);
+        fenced.store(true, std::memory_order_release);
+
+        // The reading task is the consumer of rxRing: it may empty it
+        uint8_t chunk[128];
+        size_t count;
+        while ((count = rxRing.pop(chunk, sizeof(chunk))) > 0) {
+            fencedByReader.store(fencedByReader.load(std::memory_order_relaxed) + count,
+                                 std::memory_order_relaxed);
+        }
+    }
+
+    hal::UartStats getStats() override {
+        hal::UartStats stats;
+        stats.rxBytes = rxBytes.load(std::memory_order_relaxed);
+        stats.ringOverruns = ringOverruns.load(std::memory_order_relaxed);
+        stats.fifoOverflows = fifoOverflows.load(std::memory_order_relaxed);
+        stats.framingErrors = framingErrors.load(std::memory_order_relaxed);
+        stats.fencedBytes = fencedByDriver.load(std::memory_order_relaxed) +
+                            fencedByReader.load(std::memory_order_relaxed);
+        stats.ringPeak = ringPeak.load(std::memory_order_relaxed);
+        stats.ringCapacity = rxRing.capacity();
+        return stats;
+    }
+
+private:
+    HardwareSerial& serial;
+    uart_port_t port;
+    SpscRing<UART_RX_RING_SIZE> rxRing;
+    hal::LineConfig line;
+    unsigned long txGapUs = 0;
+
+    // Edges before the shortest pulse is likely a single bit
+    static const uint32_t PULSE_MIN_EDGES = 40;
+
+    // Written only by the reading task (fenceUntil, available)
+    std::atomic<unsigned long> fenceEnd{0};
+    std::atomic<bool> fenced{false};
+    std::atomic<unsigned long> fencedByReader{0};
+    // Written only by the driver event task
+    std::atomic<unsigned long> fencedByDriver{0};
+
+    // Written only by the driver event task, read anywhere
+    std::atomic<unsigned long> rxBytes{0};
+    std::atomic<unsigned long> ringOverruns{0};
+    std::atomic<unsigned long> fifoOverflows{0};
+    std::atomic<unsigned long> framingErrors{0};
+    std::atomic<size_t> ringPeak{0};
+
+    // Idle bit times after each character for txGapUs at the current rate
+    void applyTxGap() {
+        uint64_t bits = line.baud ? ((uint64_t)txGapUs * line.baud + 999999) / 1000000 : 0;
+        uart_set_tx_idle_num(port, (uint16_t)(bits < MAX_TX_GAP_BITS ? bits : MAX_TX_GAP_BITS));
+    }
+
+    // Runs in the UART driver event task: the single producer of rxRing
+    void pump() {
+        uint8_t chunk[128];
+        int pending;
+        while ((pending = serial.available()) > 0) {
+            size_t count = serial.read(chunk, (size_t)pending < sizeof(chunk) ? (size_t)pending : sizeof(chunk));
+            if (count == 0) break;
+
+            if (fenced.load(std::memory_order_acquire) &&
+                (long)(micros() - fenceEnd.load(std::memory_order_relaxed)) < 0) {
+                fencedByDriver.store(fencedByDriver.load(std::memory_order_relaxed) + count,
+                                     std::memory_order_relaxed);
+                continue;
+            }
+
+            size_t stored = rxRing.push(chunk, count);
+            rxBytes.store(rxBytes.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+            if (stored < count) {
+                ringOverruns.store(ringOverruns.load(std::memory_order_relaxed) + (count - stored),
+                                   std::memory_order_relaxed);
+            }
+
+            size_t fill = rxRing.size();
+            if (fill > ringPeak.load(std::memory_order_relaxed)) {
+                ringPeak.store(fill, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void countError(hardwareSerial_error_t error) {
+        switch (error) {
+            case UART_FIFO_OVF_ERROR:
+            case UART_BUFFER_FULL_ERROR:
+                fifoOverflows.store(fifoOverflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                break;
+            case UART_FRAME_ERROR:
+            case UART_PARITY_ERROR:
+                framingErrors.store(framingErrors.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+class ArduinoConsole : public hal::Console {
+public:
+    size_t write(const uint8_t* data, size_t length) override {
+        return Serial.write(data, length);
+    }
+};
+
+class ArduinoWebSocket : public hal::WebSocketTransport {
+public:
+    explicit ArduinoWebSocket(uint16_t port) : server(port) {}
+
+    bool begin() override {
+        server.begin();
+        server.onEvent([this](uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+            dispatch(num, type, payload, length);
+        });
+        return true;
+    }
+
+    void loop() override {
+        server.loop();
+    }
+
+    void onEvent(hal::WsEventHandler eventHandler) override {
+        handler = eventHandler;
+    }
+
+    bool sendText(uint8_t num, const uint8_t* data, size_t length) override {
+        return server.sendTXT(num, const_cast<uint8_t*>(data), length);
+    }
+
+    bool sendBinary(uint8_t num, const uint8_t* data, size_t length) override {
+        return server.sendBIN(num, data, length);
+    }
+
+    bool broadcastText(const uint8_t* data, size_t length) override {
+        return server.broadcastTXT(const_cast<uint8_t*>(data), length);
+    }
+
+    bool broadcastBinary(const uint8_t* data, size_t length) override {
+        return server.broadcastBIN(data, length);
+    }
+
+    size_t connectedClients() override {
+        return server.connectedClients();
+    }
+
+private:
+    WebSocketsServer server;
+    hal::WsEventHandler handler = nullptr;
+
+    void dispatch(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+        if (!handler) return;
+
+        switch (type) {
+            case WStype_CONNECTED:
+                handler(num, hal::WsEvent::Connected, payload, length);
+                break;
+            case WStype_DISCONNECTED:
+                handler(num, hal::WsEvent::Disconnected, payload, length);
+                break;
+            case WStype_TEXT:
+                handler(num, hal::WsEvent::Text, payload, length);
+                break;
+            case WStype_BIN:
+                handler(num, hal::WsEvent::Binary, payload, length);
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+class ArduinoTcpConnection : public hal::TcpConnection {
+public:
+    WiFiClient client;
+    bool inUse = false;
+
+    size_t write(const uint8_t* data, size_t length) override {
+        return client.write(data, length);
+    }
+
+    size_t available() override {
+        int count = client.available();
+        return count > 0 ? (size_t)count : 0;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        int count = client.read(buffer, length);
+        return count > 0 ? (size_t)count : 0;
+    }
+
+    bool writable() override {
+        // lwIP reports a socket writable while its send buffer has room
+        int fd = client.fd();
+        if (fd < 0) return false;
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(fd, &set);
+        struct timeval timeout = {0, 0};
+        return select(fd + 1, nullptr, &set, nullptr, &timeout) > 0;
+    }
+
+    bool connected() override {
+        return client.connected();
+    }
+
+    void stop() override {
+        client.stop();
+        inUse = false;
+    }
+};
+
+class ArduinoTcpServer : public hal::TcpServer {
+public:
+    explicit ArduinoTcpServer(uint16_t port) : server(port) {}
+
+    bool begin() override {
+        server.begin();
+        return true;
+    }
+
+    hal::TcpConnection* accept() override {
+        WiFiClient client = server.available();
+        if (!client) {
+            return nullptr;
+        }
+
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++) {
+            if (!connections[i].inUse) {
+                connections[i].client = client;
+                connections[i].inUse = true;
+                return &connections[i];
+            }
+        }
+
+        // No free slot - refuse the connection
+        client.stop();
+        return nullptr;
+    }
+
+private:
+    static const size_t MAX_CONNECTIONS = HTTP_MAX_CONNECTIONS;
+
+    WiFiServer server;
+    ArduinoTcpConnection connections[MAX_CONNECTIONS];
+};
+
+class LittleFsFile : public hal::File {
+public:
+    fs::File file;
+    bool inUse = false;
+
+    size_t size() override { return file.size(); }
+
+    size_t available() override {
+        int count = file.available();
+        return count > 0 ? (size_t)count : 0;
+    }
+
+    size_t read(uint8_t* buffer, size_t length) override {
+        return file.read(buffer, length);
+    }
+
+    size_t write(const uint8_t* data, size_t length) override {
+        return file.write(data, length);
+    }
+
+    bool seek(size_t position) override {
+        return position <= file.size() && file.seek(position, fs::SeekSet);
+    }
+
+    void close() override {
+        file.close();
+        inUse = false;
+    }
+};
+
+class LittleFsFileSystem : public hal::FileSystem {
+public:
+    bool begin() override {
+        return LittleFS.begin();
+    }
+
+    bool exists(const char* path) override {
+        return LittleFS.exists(path);
+    }
+
+    hal::File* open(const char* path, const char* mode) override {
+        // The network task serves files while the recorder task writes
+        std::lock_guard<std::mutex> guard(slotMutex);
+        for (size_t i = 0; i < MAX_OPEN_FILES; i++) {
+            if (!files[i].inUse) {
+                files[i].file = LittleFS.open(path, mode);
+                if (!files[i].file) {
+                    return nullptr;
+                }
+                files[i].inUse = true;
+                return &files[i];
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    static const size_t MAX_OPEN_FILES = 4;
+
+    LittleFsFile files[MAX_OPEN_FILES];
+    std::mutex slotMutex;
+};
+
+HardwareSerial SerialSBC(1); // Use UART1 for SBC communication
+
+ArduinoClock clockInstance;
+ArduinoGpio gpioInstance;
+ArduinoUart sbcUartInstance(SerialSBC, UART_NUM_1);
+ArduinoConsole consoleInstance;
+LittleFsFileSystem fileSystemInstance;
+
+} // namespace
+
+namespace hal {
+
+Clock& clock() { return clockInstance; }
+Gpio& gpio() { return gpioInstance; }
+Uart& sbcUart() { return sbcUartInstance; }
+Console& console() { return consoleInstance; }
+FileSystem& fileSystem() { return fileSystemInstance; }
+
+WebSocketTransport* createWebSocketTransport(uint16_t port) {
+    return new ArduinoWebSocket(port);
+}
+
+TcpServer* createTcpServer(uint16_t port) {
+    return new ArduinoTcpServer(port);
+}
+
+HeapStats heapStats() {
+    HeapStats stats;
+    stats.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    stats.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    stats.minimumFreeBytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    return stats;
+}
+
+} // namespace hal
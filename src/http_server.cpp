@@ -0,0 +1,658 @@
+#include "http_server.h"
+#include "keystroke_trace.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char RECORDING_PATH[] = "/record.cast";
+static const char METRICS_PATH[] = "/metrics";
+static const char TRACE_PATH[] = "/trace.json";
+// Chunk framing: "xxxx\r\n" before the data, "\r\n" after it
+static const size_t CHUNK_PREFIX_SIZE = 6;
+static const size_t CHUNK_SUFFIX_SIZE = 2;
+
+static bool endsWith(const char* text, const char* suffix) {
+    size_t textLength = strlen(text);
+    size_t suffixLength = strlen(suffix);
+    return textLength >= suffixLength && strcmp(text + textLength - suffixLength, suffix) == 0;
+}
+
+// FNV-1a, 32 bits: cheap, and plenty to tell two builds of an asset apart
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+bool HttpServer::begin(uint16_t port, hal::FileSystem* files) {
+    fileSystem = files;
+    server = hal::createTcpServer(port);
+    return server->begin();
+}
+
+void HttpServer::loop() {
+    if (!server) return;
+
+    // Accept while a slot is free; the TCP backlog holds the rest
+    for (Connection& connection : connections) {
+        if (connection.state != State::Free) continue;
+        hal::TcpConnection* client = server->accept();
+        if (!client) break;
+        connection.client = client;
+        connection.state = State::Reading;
+        connection.keepAlive = true;
+        connection.lastActivity = hal::clock().millis();
+        resetRequest(connection);
+    }
+
+    unsigned long now = hal::clock().millis();
+    for (Connection& connection : connections) {
+        if (connection.state == State::Free) continue;
+
+        if (!connection.client->connected()) {
+            close(connection);
+            continue;
+        }
+
+        switch (connection.state) {
+            case State::Reading:
+                readRequest(connection);
+                if (connection.state == State::Reading && now - connection.lastActivity > HTTP_KEEPALIVE_MS) {
+                    close(connection);
+                }
+                break;
+            case State::Hashing:
+                continueHashing(connection);
+                break;
+            case State::Sending:
+                sendResponse(connection);
+                if (connection.state == State::Sending && now - connection.lastActivity > SEND_TIMEOUT_MS) {
+                    LOG_WARN("HTTP send timeout: %s\r\n", connection.path);
+                    close(connection);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+size_t HttpServer::activeConnections() const {
+    size_t count = 0;
+    for (const Connection& connection : connections) {
+        if (connection.state != State::Free) count++;
+    }
+    return count;
+}
+
+void HttpServer::readRequest(Connection& connection) {
+    // Byte by byte: bytes past the end of this request belong to the next
+    // (pipelined) one and must stay in the socket
+    uint8_t byte;
+    while (connection.state == State::Reading && connection.client->read(&byte, 1) == 1) {
+        connection.lastActivity = hal::clock().millis();
+        if (byte == '\n') {
+            processLine(connection);
+            connection.lineLength = 0;
+            connection.lineTruncated = false;
+        } else if (byte != '\r' && connection.lineLength < LINE_SIZE - 1) {
+            connection.line[connection.lineLength++] = (char)byte;
+        } else if (byte != '\r') {
+            connection.lineTruncated = true;
+        }
+    }
+}
+
+void HttpServer::processLine(Connection& connection) {
+    char* line = connection.line;
+    line[connection.lineLength] = '\0';
+
+    if (!connection.requestLineSeen) {
+        // Tolerate blank lines before the request line (RFC 9112 2.2)
+        if (connection.lineLength == 0) return;
+        connection.requestLineSeen = true;
+
+        // METHOD SP target SP HTTP/x.y
+        char* target = strchr(line, ' ');
+        if (!target) {
+            connection.badMethod = true;
+            return;
+        }
+        *target++ = '\0';
+        char* version = strchr(target, ' ');
+        if (version) {
+            *version++ = '\0';
+            connection.http10 = strcmp(version, "HTTP/1.0") == 0;
+            connection.keepAlive = !connection.http10;
+        }
+        connection.head = strcmp(line, "HEAD") == 0;
+        connection.badMethod = !connection.head && strcmp(line, "GET") != 0;
+
+        // The query string does not select a different file; a target cut
+        // anywhere would name the wrong resource, so it is refused
+        char* query = strchr(target, '?');
+        if (query) {
+            *query++ = '\0';
+            connection.uriTooLong = strlen(query) >= sizeof(connection.query);
+            snprintf(connection.query, sizeof(connection.query), "%s", query);
+        }
+        if (connection.lineTruncated || strlen(target) >= sizeof(connection.path)) {
+            connection.uriTooLong = true;
+        } else {
+            strcpy(connection.path, target);
+        }
+        return;
+    }
+
+    if (connection.lineLength == 0) {
+        startResponse(connection);
+        return;
+    }
+
+    char* value = strchr(line, ':');
+    if (!value) return;
+    *value++ = '\0';
+    while (*value == ' ' || *value == '\t') value++;
+
+    if (strcasecmp(line, "Connection") == 0) {
+        if (strcasecmp(value, "close") == 0) {
+            connection.keepAlive = false;
+        } else if (strcasecmp(value, "keep-alive") == 0) {
+            connection.keepAlive = true;
+        }
+    } else if (strcasecmp(line, "If-None-Match") == 0 && strlen(value) < sizeof(connection.ifNoneMatch)) {
+        strcpy(connection.ifNoneMatch, value);
+    }
+}
+
+void HttpServer::startResponse(Connection& connection) {
+    if (connection.badMethod) {
+        connection.keepAlive = false;
+        respondWithText(connection, "405 Method Not Allowed", "Method not allowed");
+        return;
+    }
+    if (connection.uriTooLong) {
+        connection.keepAlive = false;
+        respondWithText(connection, "414 URI Too Long", "URI too long");
+        return;
+    }
+
+    if (strcmp(connection.path, RECORDING_PATH) == 0) {
+        respondWithRecording(connection);
+        return;
+    }
+    if (strcmp(connection.path, METRICS_PATH) == 0) {
+        respondWithMetrics(connection);
+        return;
+    }
+    if (strcmp(connection.path, TRACE_PATH) == 0) {
+        respondWithTrace(connection);
+        return;
+    }
+
+    // Default to index.html for root path
+    if (strcmp(connection.path, "/") == 0) {
+        strcpy(connection.path, "/index.html");
+    }
+
+#if !WEB_ASSETS_LITTLEFS_OVERRIDE
+    connection.asset = findWebAsset(connection.path);
+    if (connection.asset) {
+        respondWithAsset(connection);
+        return;
+    }
+#endif
+
+    if (!findFile(connection.path, connection.filePath, sizeof(connection.filePath))) {
+#if WEB_ASSETS_LITTLEFS_OVERRIDE
+        connection.asset = findWebAsset(connection.path);
+        if (connection.asset) {
+            respondWithAsset(connection);
+            return;
+        }
+#endif
+        respondWithText(connection, "404 Not Found", "File not found");
+        return;
+    }
+
+    connection.file = fileSystem->open(connection.filePath, "r");
+    if (!connection.file) {
+        respondWithText(connection, "500 Internal Server Error", "Failed to open file");
+        return;
+    }
+
+    if (lookupEtag(connection.filePath, connection.file->size(), connection.hash)) {
+        respondWithFile(connection);
+    } else {
+        connection.hash = FNV_OFFSET;
+        connection.state = State::Hashing;
+    }
+}
+
+void HttpServer::continueHashing(Connection& connection) {
+    size_t count = connection.file->read(chunk, sizeof(chunk));
+    connection.hash = fnv1a(connection.hash, chunk, count);
+    if (connection.file->available() > 0) {
+        return;
+    }
+
+    // Hashed to the end: start over for the body
+    storeEtag(connection.filePath, connection.file->size(), connection.hash);
+    closeFile(connection);
+    connection.file = fileSystem->open(connection.filePath, "r");
+    if (!connection.file) {
+        respondWithText(connection, "500 Internal Server Error", "Failed to open file");
+        return;
+    }
+    respondWithFile(connection);
+}
+
+void HttpServer::respondWithFile(Connection& connection) {
+    size_t size = connection.file->size();
+    char etag[ETAG_SIZE];
+    formatEtag(etag, sizeof(etag), connection.hash, size);
+    if (!respondWithBody(connection, getMimeType(connection.path), size, endsWith(connection.filePath, ".gz"),
+                         etag)) {
+        closeFile(connection);
+    }
+}
+
+void HttpServer::respondWithAsset(Connection& connection) {
+    const WebAsset& asset = *connection.asset;
+    connection.assetSent = 0;
+    if (!respondWithBody(connection, asset.mimeType, asset.length, asset.gzipped, asset.etag)) {
+        connection.asset = nullptr;
+    }
+}
+
+void HttpServer::respondWithRecording(Connection& connection) {
+    if (exportConnection) {
+        respondWithText(connection, "503 Service Unavailable", "Another recording download is running");
+        return;
+    }
+
+    unsigned long channel = 0;
+    unsigned long fromMs = 0;
+    unsigned long toMs = RecordingExport::NO_LIMIT;
+    const char* value;
+    char* end;
+    bool valid = true;
+    if ((value = findQueryValue(connection.query, "channel"))) {
+        channel = strtoul(value, &end, 10);
+        valid = end != value && (*end == '\0' || *end == '&') && channel < MAX_CHANNELS;
+    }
+    if (valid && (value = findQueryValue(connection.query, "from"))) {
+        valid = parseSeconds(value, fromMs);
+    }
+    if (valid && (value = findQueryValue(connection.query, "to"))) {
+        valid = parseSeconds(value, toMs) && toMs >= fromMs;
+    }
+    if (!valid) {
+        respondWithText(connection, "400 Bad Request", "Expected channel=<n>&from=<s>&to=<s>");
+        return;
+    }
+    if (!recordingExport.begin(fileSystem, (uint8_t)channel, fromMs, toMs)) {
+        respondWithText(connection, "404 Not Found", "No recording");
+        return;
+    }
+
+    char headers[96];
+    snprintf(headers, sizeof(headers),
+             "Content-Type: application/x-asciicast\r\n"
+             "Content-Disposition: attachment; filename=\"sbc%lu.cast\"\r\n",
+             channel + 1);
+    respondWithStream(connection, headers);
+    if (connection.head) {
+        recordingExport.end();
+        return;
+    }
+    connection.stream = Stream::Recording;
+    exportConnection = &connection;
+}
+
+void HttpServer::respondWithMetrics(Connection& connection) {
+    if (!metrics) {
+        respondWithText(connection, "404 Not Found", "File not found");
+        return;
+    }
+    if (metricsConnection) {
+        respondWithText(connection, "503 Service Unavailable", "Another scrape is running");
+        return;
+    }
+    if (!metrics->begin()) {
+        respondWithText(connection, "500 Internal Server Error", "Metrics unavailable");
+        return;
+    }
+
+    respondWithStream(connection, "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n");
+    if (connection.head) {
+        metrics->end();
+        return;
+    }
+    connection.stream = Stream::Metrics;
+    metricsConnection = &connection;
+}
+
+void HttpServer::respondWithTrace(Connection& connection) {
+    if (!tracer) {
+        respondWithText(connection, "404 Not Found", "File not found");
+        return;
+    }
+
+    respondWithStream(connection, "Content-Type: application/json\r\n");
+    if (!connection.head) {
+        connection.stream = Stream::Trace;
+        connection.streamEnded = false;
+    }
+}
+
+void HttpServer::respondWithStream(Connection& connection, const char* headers) {
+    // HTTP/1.0 has no chunked encoding: closing the connection ends the body
+    if (connection.http10) {
+        connection.keepAlive = false;
+    }
+    connection.headerLength = snprintf(connection.header, sizeof(connection.header),
+                                       "HTTP/1.1 200 OK\r\n"
+                                       "%s"
+                                       "%s"
+                                       "Cache-Control: no-store\r\n"
+                                       "Connection: %s\r\n"
+                                       "\r\n",
+                                       headers, connection.http10 ? "" : "Transfer-Encoding: chunked\r\n",
+                                       connection.keepAlive ? "keep-alive" : "close");
+    connection.headerSent = 0;
+    connection.state = State::Sending;
+    connection.sendBody = !connection.head;
+}
+
+void HttpServer::sendStreamChunk(Connection& connection) {
+    uint8_t* body = chunk + CHUNK_PREFIX_SIZE;
+    size_t room = sizeof(chunk) - CHUNK_PREFIX_SIZE - CHUNK_SUFFIX_SIZE;
+    size_t count = 0;
+    if (connection.stream == Stream::Recording) {
+        count = recordingExport.read(body, room);
+    } else if (connection.stream == Stream::Metrics) {
+        count = metrics->read(body, room);
+    } else if (!connection.streamEnded) {
+        // One chunk; the tracer is only updated by this (the network) task
+        count = tracer->formatJson((char*)body, room);
+        connection.streamEnded = true;
+    }
+    if (count == 0 && connection.http10) {
+        finishResponse(connection);
+        return;
+    }
+    if (count == 0) {
+        static const char LAST_CHUNK[] = "0\r\n\r\n";
+        if (connection.client->write((const uint8_t*)LAST_CHUNK, sizeof(LAST_CHUNK) - 1) < sizeof(LAST_CHUNK) - 1) {
+            close(connection);
+            return;
+        }
+        finishResponse(connection);
+        return;
+    }
+
+    if (connection.http10) {
+        if (connection.client->write(body, count) < count) {
+            close(connection);
+            return;
+        }
+        connection.lastActivity = hal::clock().millis();
+        return;
+    }
+
+    char prefix[CHUNK_PREFIX_SIZE + 1];
+    snprintf(prefix, sizeof(prefix), "%04x\r\n", (unsigned)count);
+    memcpy(chunk, prefix, CHUNK_PREFIX_SIZE);
+    memcpy(chunk + CHUNK_PREFIX_SIZE + count, "\r\n", CHUNK_SUFFIX_SIZE);
+    size_t length = CHUNK_PREFIX_SIZE + count + CHUNK_SUFFIX_SIZE;
+    if (connection.client->write(chunk, length) < length) {
+        close(connection);
+        return;
+    }
+    connection.lastActivity = hal::clock().millis();
+}
+
+bool HttpServer::respondWithBody(Connection& connection, const char* mimeType, size_t length, bool gzipped,
+                                 const char* etag) {
+    const char* connectionHeader = connection.keepAlive ? "keep-alive" : "close";
+    connection.headerSent = 0;
+    connection.state = State::Sending;
+
+    if (strcmp(connection.ifNoneMatch, etag) == 0) {
+        connection.headerLength = snprintf(connection.header, sizeof(connection.header),
+                                           "HTTP/1.1 304 Not Modified\r\n"
+                                           "ETag: %s\r\n"
+                                           "Cache-Control: no-cache\r\n"
+                                           "Connection: %s\r\n"
+                                           "\r\n",
+                                           etag, connectionHeader);
+        notModified++;
+        return false;
+    }
+
+    // no-cache: the browser keeps the file but revalidates it, so a
+    // firmware or asset update is picked up on the next load
+    connection.headerLength = snprintf(connection.header, sizeof(connection.header),
+                                       "HTTP/1.1 200 OK\r\n"
+                                       "Content-Type: %s\r\n"
+                                       "Content-Length: %lu\r\n"
+                                       "%s"
+                                       "ETag: %s\r\n"
+                                       "Cache-Control: no-cache\r\n"
+                                       "Connection: %s\r\n"
+                                       "\r\n",
+                                       mimeType, (unsigned long)length,
+                                       gzipped ? "Content-Encoding: gzip\r\n" : "", etag, connectionHeader);
+    connection.sendBody = !connection.head;
+    return true;
+}
+
+void HttpServer::respondWithText(Connection& connection, const char* status, const char* body) {
+    int length = snprintf(connection.header, sizeof(connection.header),
+                          "HTTP/1.1 %s\r\n"
+                          "Content-Type: text/plain\r\n"
+                          "Content-Length: %u\r\n"
+                          "Connection: %s\r\n"
+                          "\r\n"
+                          "%s",
+                          status, (unsigned)strlen(body), connection.keepAlive ? "keep-alive" : "close",
+                          connection.head ? "" : body);
+    connection.headerLength = (size_t)length < sizeof(connection.header) ? (size_t)length : sizeof(connection.header) - 1;
+    connection.headerSent = 0;
+    connection.sendBody = false;
+    connection.state = State::Sending;
+}
+
+void HttpServer::sendResponse(Connection& connection) {
+    if (!connection.client->writable()) {
+        return;
+    }
+
+    if (connection.headerSent < connection.headerLength) {
+        size_t sent = connection.client->write((const uint8_t*)connection.header + connection.headerSent,
+                                               connection.headerLength - connection.headerSent);
+        connection.headerSent += sent;
+        if (sent > 0) {
+            connection.lastActivity = hal::clock().millis();
+        }
+        // Small files go out in the same step as their headers
+        if (connection.headerSent < connection.headerLength || !connection.client->writable()) {
+            return;
+        }
+    }
+
+    if (connection.sendBody && connection.stream != Stream::None) {
+        sendStreamChunk(connection);
+        return;
+    } else if (connection.sendBody && connection.asset) {
+        // Straight from flash, no copy
+        const WebAsset& asset = *connection.asset;
+        size_t count = asset.length - connection.assetSent;
+        count = count < HTTP_CHUNK_SIZE ? count : HTTP_CHUNK_SIZE;
+        size_t sent = connection.client->write(asset.data + connection.assetSent, count);
+        if (sent < count) {
+            close(connection);
+            return;
+        }
+        connection.assetSent += sent;
+        connection.lastActivity = hal::clock().millis();
+        if (connection.assetSent < asset.length) {
+            return;
+        }
+    } else if (connection.sendBody && connection.file->available() > 0) {
+        size_t count = connection.file->read(chunk, sizeof(chunk));
+        size_t sent = connection.client->write(chunk, count);
+        if (sent < count) {
+            // The connection failed mid-transfer
+            close(connection);
+            return;
+        }
+        connection.lastActivity = hal::clock().millis();
+        if (connection.file->available() > 0) {
+            return;
+        }
+    }
+
+    finishResponse(connection);
+}
+
+void HttpServer::finishResponse(Connection& connection) {
+    LOG_DEBUG("HTTP client served: %s\r\n", connection.path);
+    responses++;
+    closeFile(connection);
+    endStream(connection);
+    connection.asset = nullptr;
+    if (!connection.keepAlive) {
+        close(connection);
+        return;
+    }
+    connection.state = State::Reading;
+    resetRequest(connection);
+}
+
+void HttpServer::closeFile(Connection& connection) {
+    if (connection.file) {
+        connection.file->close();
+        connection.file = nullptr;
+    }
+}
+
+void HttpServer::endStream(Connection& connection) {
+    if (connection.stream == Stream::Recording) {
+        recordingExport.end();
+        exportConnection = nullptr;
+    } else if (connection.stream == Stream::Metrics) {
+        metrics->end();
+        metricsConnection = nullptr;
+    }
+    connection.stream = Stream::None;
+}
+
+void HttpServer::close(Connection& connection) {
+    closeFile(connection);
+    endStream(connection);
+    connection.asset = nullptr;
+    connection.client->stop();
+    connection.client = nullptr;
+    connection.state = State::Free;
+}
+
+void HttpServer::resetRequest(Connection& connection) {
+    connection.lineLength = 0;
+    connection.requestLineSeen = false;
+    connection.head = false;
+    connection.badMethod = false;
+    connection.lineTruncated = false;
+    connection.uriTooLong = false;
+    connection.http10 = false;
+    strcpy(connection.path, "/");
+    connection.query[0] = '\0';
+    connection.ifNoneMatch[0] = '\0';
+    connection.headerLength = 0;
+    connection.headerSent = 0;
+    connection.sendBody = false;
+}
+
+bool HttpServer::findFile(const char* path, char* actualPath, size_t actualPathSize) {
+    // First try the exact path
+    if (fileSystem->exists(path)) {
+        snprintf(actualPath, actualPathSize, "%s", path);
+        return true;
+    }
+
+    // Then try with .gz extension
+    snprintf(actualPath, actualPathSize, "%s.gz", path);
+    return fileSystem->exists(actualPath);
+}
+
+const char* HttpServer::getMimeType(const char* filename) {
+    if (endsWith(filename, ".html")) return "text/html";
+    if (endsWith(filename, ".css")) return "text/css";
+    if (endsWith(filename, ".js")) return "application/javascript";
+    if (endsWith(filename, ".svg")) return "image/svg+xml";
+    if (endsWith(filename, ".json")) return "application/json";
+    if (endsWith(filename, ".txt")) return "text/plain";
+    if (endsWith(filename, ".ico")) return "image/x-icon";
+    return "text/plain";
+}
+
+const char* HttpServer::findQueryValue(const char* query, const char* name) {
+    size_t nameLength = strlen(name);
+    for (const char* p = query; *p; ) {
+        if (strncmp(p, name, nameLength) == 0 && p[nameLength] == '=') {
+            return p + nameLength + 1;
+        }
+        p = strchr(p, '&');
+        if (!p) break;
+        p++;
+    }
+    return nullptr;
+}
+
+bool HttpServer::parseSeconds(const char* text, unsigned long& ms) {
+    char* end;
+    unsigned long seconds = strtoul(text, &end, 10);
+    if (end == text || seconds > RecordingExport::NO_LIMIT / 1000) return false;
+    unsigned long fraction = 0;
+    unsigned long scale = 100;
+    if (*end == '.') {
+        for (end++; *end >= '0' && *end <= '9'; end++) {
+            fraction += (unsigned long)(*end - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if (*end != '\0' && *end != '&') return false;
+    ms = seconds * 1000 + fraction;
+    return true;
+}
+
+bool HttpServer::lookupEtag(const char* path, size_t size, uint32_t& hash) const {
+    for (const EtagEntry& entry : etagCache) {
+        if (entry.size == size && strcmp(entry.path, path) == 0) {
+            hash = entry.hash;
+            return true;
+        }
+    }
+    return false;
+}
+
+void HttpServer::storeEtag(const char* path, size_t size, uint32_t hash) {
+    EtagEntry& entry = etagCache[nextEtagSlot];
+    nextEtagSlot = (nextEtagSlot + 1) % ETAG_CACHE_SIZE;
+    snprintf(entry.path, sizeof(entry.path), "%s", path);
+    entry.size = size;
+    entry.hash = hash;
+}
+
+void HttpServer::formatEtag(char* etag, size_t etagSize, uint32_t hash, size_t size) {
+    snprintf(etag, etagSize, "\"%08lx-%lx\"", (unsigned long)hash, (unsigned long)size);
+}
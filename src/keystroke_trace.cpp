@@ -0,0 +1,116 @@
+#include "keystroke_trace.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static const char* const SEGMENT_NAMES[KeystrokeTracer::SEGMENTS] = {"queue", "sbc", "forward"};
+
+/**
+ * Append formatted text to buffer, up to its size
+ */
+static void append(char* buffer, size_t size, size_t& length, const char* format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void append(char* buffer, size_t size, size_t& length, const char* format, ...) {
+    if (length >= size) return;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buffer + length, size - length, format, args);
+    va_end(args);
+    if (written > 0) length += written;
+}
+
+void KeystrokeTracer::start(uint32_t id, uint8_t channel, unsigned long txIndex, unsigned long nowUs) {
+    if (stage.load(std::memory_order_relaxed) != Stage::Idle) {
+        abandon();
+    }
+    this->id = id;
+    this->channel = channel;
+    this->txIndex = txIndex;
+    receivedUs = nowUs;
+    stage.store(Stage::Queued, std::memory_order_release);
+}
+
+void KeystrokeTracer::noteTransmitted(uint8_t channel, unsigned long txTotal, unsigned long nowUs) {
+    if (stage.load(std::memory_order_acquire) != Stage::Queued || channel != this->channel) return;
+
+    // Written once the first byte of the keystroke went out
+    if ((long)(txTotal - txIndex) > 0) {
+        transmittedUs = nowUs;
+        stage.store(Stage::Transmitted, std::memory_order_release);
+    }
+}
+
+void KeystrokeTracer::noteReceived(uint8_t channel, unsigned long liveIndex, unsigned long nowUs) {
+    if (stage.load(std::memory_order_acquire) != Stage::Transmitted || channel != this->channel) return;
+
+    this->liveIndex = liveIndex;
+    echoedUs = nowUs;
+    stage.store(Stage::Echoed, std::memory_order_release);
+}
+
+void KeystrokeTracer::noteSent(unsigned long liveTotal, unsigned long nowUs) {
+    if (!awaitingFrame() || (long)(liveTotal - liveIndex) <= 0) return;
+
+    KeystrokeTrace trace;
+    trace.id = id;
+    trace.queueUs = transmittedUs - receivedUs;
+    trace.sbcUs = echoedUs - transmittedUs;
+    trace.forwardUs = nowUs - echoedUs;
+    stage.store(Stage::Idle, std::memory_order_relaxed);
+
+    const unsigned long durations[SEGMENTS] = {trace.queueUs, trace.sbcUs, trace.forwardUs};
+    for (size_t segment = 0; segment < SEGMENTS; segment++) {
+        histograms[segment].record(durations[segment]);
+        segments[segment].record(durations[segment]);
+    }
+    recent[nextRecent] = trace;
+    nextRecent = (nextRecent + 1) % RECENT_TRACES;
+    if (recentCount < RECENT_TRACES) recentCount++;
+    completed.store(completed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+bool KeystrokeTracer::expired(unsigned long nowUs) const {
+    return stage.load(std::memory_order_relaxed) != Stage::Idle && nowUs - receivedUs > TIMEOUT_MS * 1000UL;
+}
+
+void KeystrokeTracer::abandon() {
+    if (stage.load(std::memory_order_relaxed) == Stage::Idle) return;
+    stage.store(Stage::Idle, std::memory_order_relaxed);
+    abandoned.store(abandoned.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+size_t KeystrokeTracer::formatJson(char* buffer, size_t size) const {
+    if (size == 0) return 0;
+    size_t length = 0;
+
+    append(buffer, size, length, "{\"completed\":%lu,\"abandoned\":%lu,\"bounds_us\":[", getCompleted(),
+           getAbandoned());
+    for (size_t bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++) {
+        append(buffer, size, length, bucket ? ",%lu" : "%lu", LatencyHistogram::upperBound(bucket));
+    }
+    append(buffer, size, length, "],\"segments\":{");
+    for (size_t segment = 0; segment < SEGMENTS; segment++) {
+        append(buffer, size, length, "%s\"%s\":{\"counts\":[", segment ? "," : "", SEGMENT_NAMES[segment]);
+        for (size_t bucket = 0; bucket <= LatencyHistogram::BUCKETS; bucket++) {
+            append(buffer, size, length, bucket ? ",%lu" : "%lu", histograms[segment].getBucket(bucket));
+        }
+        append(buffer, size, length, "],\"mean_us\":%lu,\"max_us\":%lu}", segments[segment].getMeanUs(),
+               segments[segment].getMaxUs());
+    }
+    append(buffer, size, length, "},\"recent\":[");
+
+    // Newest first, as many as fit with the closing brackets
+    static const size_t CLOSING = 3;
+    for (size_t i = 0; i < recentCount; i++) {
+        const KeystrokeTrace& trace = recent[(nextRecent + RECENT_TRACES - 1 - i) % RECENT_TRACES];
+        char entry[96];
+        int entryLength = snprintf(entry, sizeof(entry),
+                                   "%s{\"id\":%lu,\"queue_us\":%lu,\"sbc_us\":%lu,\"forward_us\":%lu}",
+                                   i ? "," : "", (unsigned long)trace.id, trace.queueUs, trace.sbcUs, trace.forwardUs);
+        if (entryLength <= 0 || length + entryLength + CLOSING >= size) break;
+        append(buffer, size, length, "%s", entry);
+    }
+    append(buffer, size, length, "]}\n");
+    return length < size ? length : size - 1;
+}
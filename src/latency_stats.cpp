@@ -0,0 +1,51 @@
+#include "latency_stats.h"
+
+#include <limits.h>
+
+void LatencyStats::record(unsigned long us) {
+    unsigned long samples = count.load(std::memory_order_relaxed);
+    unsigned long total = totalUs.load(std::memory_order_relaxed);
+
+    // Halve the history instead of overflowing the 32-bit total
+    if (total > ULONG_MAX - us) {
+        total /= 2;
+        samples /= 2;
+    }
+
+    totalUs.store(total + us, std::memory_order_relaxed);
+    count.store(samples + 1, std::memory_order_relaxed);
+    if (us > maxUs.load(std::memory_order_relaxed)) {
+        maxUs.store(us, std::memory_order_relaxed);
+    }
+}
+
+void LatencyStats::reset() {
+    count.store(0, std::memory_order_relaxed);
+    totalUs.store(0, std::memory_order_relaxed);
+    maxUs.store(0, std::memory_order_relaxed);
+}
+
+unsigned long LatencyStats::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+unsigned long LatencyStats::getMeanUs() const {
+    unsigned long samples = count.load(std::memory_order_relaxed);
+    return samples ? totalUs.load(std::memory_order_relaxed) / samples : 0;
+}
+
+unsigned long LatencyStats::getMaxUs() const {
+    return maxUs.load(std::memory_order_relaxed);
+}
+
+void LoopTimer::tick(unsigned long nowUs) {
+    if (started) {
+        periods.record(nowUs - lastTickUs);
+    }
+    lastTickUs = nowUs;
+    started = true;
+}
+
+const LatencyStats& LoopTimer::getPeriods() const {
+    return periods;
+}
@@ -0,0 +1,160 @@
+#include "line_settings.h"
+
+// Common console rates, plus the ESP8266/ESP32 boot ROM's 74880
+const unsigned long BaudDetector::CANDIDATES[CANDIDATE_COUNT] = {
+    9600, 19200, 38400, 57600, 74880, 115200, 230400, 460800, 921600, 1000000, 1500000, 2000000
+};
+
+bool parseLineSettings(const char* text, size_t length, LineSettings& settings) {
+    LineSettings parsed = settings;
+    size_t i = 0;
+
+    if (length >= 4 && text[0] == 'A' && text[1] == 'U' && text[2] == 'T' && text[3] == 'O') {
+        parsed.autoBaud = true;
+        i = 4;
+    } else {
+        unsigned long baud = 0;
+        for (; i < length && text[i] >= '0' && text[i] <= '9'; i++) {
+            baud = baud * 10 + (unsigned long)(text[i] - '0');
+            if (baud > LINE_BAUD_MAX) return false;
+        }
+        if (baud < LINE_BAUD_MIN) return false;
+        parsed.config.baud = baud;
+        parsed.autoBaud = false;
+    }
+
+    parsed.config.dataBits = 8;
+    parsed.config.parity = hal::Parity::None;
+    parsed.config.stopBits = 1;
+    if (i < length) {
+        // ",<data bits><parity><stop bits>"
+        if (length - i != 4 || text[i] != ',') return false;
+        char data = text[i + 1], parity = text[i + 2], stop = text[i + 3];
+        if (data < '5' || data > '8' || (stop != '1' && stop != '2')) return false;
+        parsed.config.dataBits = (uint8_t)(data - '0');
+        parsed.config.stopBits = (uint8_t)(stop - '0');
+        if (parity == 'E') {
+            parsed.config.parity = hal::Parity::Even;
+        } else if (parity == 'O') {
+            parsed.config.parity = hal::Parity::Odd;
+        } else if (parity != 'N') {
+            return false;
+        }
+    }
+
+    settings = parsed;
+    return true;
+}
+
+void formatLineFormat(char* buffer, const hal::LineConfig& config) {
+    buffer[0] = (char)('0' + config.dataBits);
+    buffer[1] = config.parity == hal::Parity::Even ? 'E' : config.parity == hal::Parity::Odd ? 'O' : 'N';
+    buffer[2] = (char)('0' + config.stopBits);
+    buffer[3] = '\0';
+}
+
+void BaudDetector::start(unsigned long baud) {
+    detecting = true;
+    tried = 0;
+    pulseUsed = false;
+    windows = 0;
+    bestScore = -1;
+    retune(nearestCandidate(baud));
+}
+
+void BaudDetector::stop() {
+    detecting = false;
+}
+
+void BaudDetector::feed(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = data[i];
+        // Text and the control characters a console uses (BEL, BS, TAB, LF,
+        // CR, ESC); anything above 0x7F is rare enough to count against
+        if ((c >= 0x20 && c < 0x7F) || (c >= 0x07 && c <= 0x0A) || c == 0x0D || c == 0x1B) {
+            windowPrintable++;
+        }
+    }
+    windowBytes += length;
+}
+
+BaudDetector::Verdict BaudDetector::evaluate(unsigned long framingErrors, unsigned long pulseBaud) {
+    if (!detecting) {
+        return Verdict::Locked;
+    }
+
+    // Once per pass, jump to the rate the pulse measurement points at
+    if (pulseBaud > 0 && !pulseUsed) {
+        pulseUsed = true;
+        size_t hinted = nearestCandidate(pulseBaud);
+        if (hinted != index && !(tried & (1u << hinted))) {
+            retune(hinted);
+            return Verdict::Retune;
+        }
+    }
+
+    // A silent line tells nothing: keep listening
+    if (windowBytes < MIN_SAMPLE_BYTES) {
+        return Verdict::Listening;
+    }
+
+    windows++;
+    bool locked = windowPrintable * 100 >= windowBytes * LOCK_PRINTABLE_PERCENT &&
+                  framingErrors * LOCK_BYTES_PER_ERROR <= windowBytes;
+    if (locked) {
+        detecting = false;
+        return Verdict::Locked;
+    }
+
+    long score = ((long)windowPrintable - 4 * (long)framingErrors) * 1000 / (long)windowBytes;
+    if (score > bestScore) {
+        bestScore = score;
+        bestIndex = index;
+    }
+    tried |= 1u << index;
+
+    // Next untried candidate, in order
+    for (size_t step = 1; step < CANDIDATE_COUNT; step++) {
+        size_t next = (index + step) % CANDIDATE_COUNT;
+        if (!(tried & (1u << next))) {
+            retune(next);
+            return Verdict::Retune;
+        }
+    }
+
+    // Every candidate judged: settle for the best one if it was close,
+    // otherwise start another pass (the SBC may have printed binary data)
+    if (bestScore >= FALLBACK_SCORE) {
+        detecting = false;
+        retune(bestIndex);
+        return Verdict::Locked;
+    }
+    tried = 0;
+    pulseUsed = false;
+    bestScore = -1;
+    retune((index + 1) % CANDIDATE_COUNT);
+    return Verdict::Retune;
+}
+
+size_t BaudDetector::nearestCandidate(unsigned long baud) {
+    if (baud == 0) baud = 1;
+    size_t best = 0;
+    uint64_t bestRatio = UINT64_MAX;
+    for (size_t i = 0; i < CANDIDATE_COUNT; i++) {
+        // Larger over smaller rate, in thousandths
+        uint64_t high = baud > CANDIDATES[i] ? baud : CANDIDATES[i];
+        uint64_t low = baud > CANDIDATES[i] ? CANDIDATES[i] : baud;
+        uint64_t ratio = high * 1000 / low;
+        if (ratio < bestRatio) {
+            bestRatio = ratio;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void BaudDetector::retune(size_t candidate) {
+    index = candidate;
+    windowBytes = 0;
+    windowPrintable = 0;
+}
@@ -0,0 +1,94 @@
+#include "logger.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+void Logger::printf(const char* format, ...) {
+    char line[LINE_SIZE];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if (length < 0) return;
+    write(line, (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1);
+}
+
+void Logger::write(const char* text, size_t length) {
+    std::lock_guard<std::mutex> guard(producerMutex);
+    // All or nothing: a half message would garble the next one
+    if (ring.capacity() - ring.size() < length) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    ring.push((const uint8_t*)text, length);
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+void Logger::traceBytes(const uint8_t* data, size_t length) {
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+    char text[64];
+    size_t used = 0;
+    size_t lost = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = data[i];
+        if (c >= 32 && c <= 126) {
+            text[used++] = (char)c;
+        } else {
+            const char escaped[6] = {'[', '0', 'x', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F], ']'};
+            for (char e : escaped) text[used++] = e;
+        }
+
+        if (used > sizeof(text) - 6 || i + 1 == length) {
+            lost += used - traceRing.push((const uint8_t*)text, used);
+            used = 0;
+        }
+    }
+
+    if (lost) {
+        droppedTrace.store(droppedTrace.load(std::memory_order_relaxed) + lost, std::memory_order_relaxed);
+    }
+}
+#endif
+
+size_t Logger::drain(hal::Print& output) {
+    size_t total = 0;
+    uint8_t chunk[128];
+
+    unsigned long droppedNow = dropped.load(std::memory_order_relaxed);
+    if (droppedNow != reportedDropped) {
+        total += output.printf("\r\n[log] %lu messages dropped\r\n", droppedNow - reportedDropped);
+        reportedDropped = droppedNow;
+    }
+
+    size_t count;
+    while ((count = ring.pop(chunk, sizeof(chunk))) > 0) {
+        total += output.write(chunk, count);
+    }
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+    while ((count = traceRing.pop(chunk, sizeof(chunk))) > 0) {
+        total += output.write(chunk, count);
+    }
+    unsigned long traceNow = droppedTrace.load(std::memory_order_relaxed);
+    if (traceNow != reportedTrace) {
+        total += output.printf("\r\n[log] %lu trace bytes dropped\r\n", traceNow - reportedTrace);
+        reportedTrace = traceNow;
+    }
+#endif
+
+    return total;
+}
+
+unsigned long Logger::getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+namespace {
+
+Logger loggerInstance;
+
+} // namespace
+
+Logger& logger() { return loggerInstance; }
@@ -0,0 +1,128 @@
+#include "lz_block.h"
+
+#include <string.h>
+
+static inline uint32_t read32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline size_t hash4(const uint8_t* p) {
+    return (read32(p) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/**
+ * Append a length extension (the part above 15) as 255 bytes plus remainder
+ * @return Position after it, nullptr if it does not fit
+ */
+static uint8_t* writeLength(uint8_t* out, const uint8_t* end, size_t length) {
+    while (length >= 255) {
+        if (out >= end) return nullptr;
+        *out++ = 255;
+        length -= 255;
+    }
+    if (out >= end) return nullptr;
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+/**
+ * Append one sequence: literals, then a match unless matchLength is 0
+ * @return Position after it, nullptr if it does not fit
+ */
+static uint8_t* writeSequence(uint8_t* out, const uint8_t* end, const uint8_t* literals, size_t literalCount,
+                              size_t offset, size_t matchLength) {
+    if (out >= end) return nullptr;
+    uint8_t* token = out++;
+    size_t matchCode = matchLength ? matchLength - LZ_MIN_MATCH : 0;
+    *token = (uint8_t)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+    if (literalCount >= 15 && !(out = writeLength(out, end, literalCount - 15))) return nullptr;
+    if ((size_t)(end - out) < literalCount) return nullptr;
+    memcpy(out, literals, literalCount);
+    out += literalCount;
+
+    if (matchLength == 0) return out;
+    if (end - out < 2) return nullptr;
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+    if (matchCode >= 15 && !(out = writeLength(out, end, matchCode - 15))) return nullptr;
+    return out;
+}
+
+size_t lzCompress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity, uint16_t* table) {
+    if (length > LZ_MAX_INPUT) return 0;
+    uint8_t* out = output;
+    const uint8_t* end = output + capacity;
+
+    // Positions are stored plus one, so 0 means empty
+    memset(table, 0, LZ_HASH_SIZE * sizeof(uint16_t));
+    size_t anchor = 0;
+    size_t i = 0;
+    while (length >= LZ_MIN_MATCH && i <= length - LZ_MIN_MATCH) {
+        size_t slot = hash4(input + i);
+        size_t candidate = table[slot];
+        table[slot] = (uint16_t)(i + 1);
+        if (candidate == 0 || read32(input + candidate - 1) != read32(input + i)) {
+            i++;
+            continue;
+        }
+
+        size_t from = candidate - 1;
+        size_t matchLength = LZ_MIN_MATCH;
+        while (i + matchLength < length && input[from + matchLength] == input[i + matchLength]) {
+            matchLength++;
+        }
+        out = writeSequence(out, end, input + anchor, i - anchor, i - from, matchLength);
+        if (!out) return 0;
+        i += matchLength;
+        anchor = i;
+    }
+
+    out = writeSequence(out, end, input + anchor, length - anchor, 0, 0);
+    return out ? (size_t)(out - output) : 0;
+}
+
+/**
+ * Read a length extension
+ * @return false if the input ends inside it
+ */
+static bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+    uint8_t byte;
+    do {
+        if (in >= end) return false;
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+size_t lzDecompress(const uint8_t* input, size_t length, uint8_t* output, size_t capacity) {
+    const uint8_t* in = input;
+    const uint8_t* inEnd = input + length;
+    size_t produced = 0;
+
+    while (in < inEnd) {
+        uint8_t token = *in++;
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !readLength(in, inEnd, literalCount)) return 0;
+        if ((size_t)(inEnd - in) < literalCount || capacity - produced < literalCount) return 0;
+        memcpy(output + produced, in, literalCount);
+        in += literalCount;
+        produced += literalCount;
+
+        if (in == inEnd) break;     // Last sequence: literals only
+        if (inEnd - in < 2) return 0;
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !readLength(in, inEnd, matchLength)) return 0;
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > produced || capacity - produced < matchLength) return 0;
+
+        // Byte by byte: the match may overlap the bytes it produces
+        for (size_t k = 0; k < matchLength; k++, produced++) {
+            output[produced] = output[produced - offset];
+        }
+    }
+    return produced;
+}
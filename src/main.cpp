@@ -1,137 +1,236 @@
 #include <Arduino.h>
-#include <HardwareSerial.h>
 
 // Project includes
 #include "pins.h"
+#include "hal.h"
+#include "logger.h"
 #include "wifi_manager.h"
 #include "oled_manager.h"
 #include "websocket_server.h"
 #include "multiplexer.h"
+#include "serial_bridge.h"
+#include "session_recorder.h"
+#include "metrics.h"
+#include "port_server.h"
 
 // Global instances
 WiFiManager wifiManager;
 OLEDManager oledManager;
 WebSocketServer webSocketServer;
 MultiplexerController multiplexer;
+SerialBridge serialBridge;
+SessionRecorder sessionRecorder;
+MetricsExport metricsExport;
+PortServer portServer;
 
-// Serial communication
-HardwareSerial SerialSBC(1); // Use UART1 for SBC communication
+// Serial communication (UART1, see hal_arduino.cpp)
+hal::Uart& SerialSBC = hal::sbcUart();
+
+// Task pipeline: the byte path never waits for WiFi or the OLED.
+// UART task > network task > display task > log and recorder tasks
+// (Arduino loop() runs at priority 1 and deletes itself)
+static const UBaseType_t UART_TASK_PRIORITY = 5;
+static const UBaseType_t NETWORK_TASK_PRIORITY = 3;
+static const UBaseType_t DISPLAY_TASK_PRIORITY = 2;
+static const UBaseType_t LOG_TASK_PRIORITY = 1;
+static const UBaseType_t RECORD_TASK_PRIORITY = 1;
+static const uint32_t UART_TASK_STACK = 4096;
+static const uint32_t NETWORK_TASK_STACK = 8192;
+static const uint32_t DISPLAY_TASK_STACK = 4096;
+static const uint32_t LOG_TASK_STACK = 3072;
+static const uint32_t RECORD_TASK_STACK = 3072;
+
+// Latest connection state for the display task (single-slot queue)
+struct DisplayStatus {
+    bool wsConnected;
+    int channel;
+};
+
+TaskHandle_t networkTaskHandle = nullptr;
+QueueHandle_t displayStatusQueue = nullptr;
+
+/**
+ * Move SBC output from the UART receive ring into the scrollback and the
+ * forward queue, and run the background scan schedule
+ */
+void uartTask(void*) {
+    for (;;) {
+        if (serialBridge.pump() > 0) {
+            xTaskNotifyGive(networkTaskHandle);
+        }
+        vTaskDelay(pdMS_TO_TICKS(UART_TASK_PERIOD_MS));
+    }
+}
+
+/**
+ * Serve WebSocket, HTTP and TCP port clients and send queued SBC output; wakes early
+ * when the UART task has queued output
+ */
+void networkTask(void*) {
+    DisplayStatus lastStatus = {false, -1};
+    for (;;) {
+        webSocketServer.loop();
+#if PORT_SERVER_ENABLED
+        portServer.loop();
+#endif
+        serialBridge.forward();
+
+        DisplayStatus status = {webSocketServer.hasConnectedClients(), webSocketServer.getCurrentChannel()};
+        if (status.wsConnected != lastStatus.wsConnected || status.channel != lastStatus.channel) {
+            xQueueOverwrite(displayStatusQueue, &status);
+            lastStatus = status;
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_TASK_PERIOD_MS));
+    }
+}
+
+/**
+ * Status LED and OLED; the slow I2C transfers only ever delay this task
+ */
+void displayTask(void*) {
+    unsigned long lastDisplayUpdate = 0;
+    unsigned long lastLedBlink = 0;
+    bool ledState = false;
+    DisplayStatus status = {false, 0};
+
+    for (;;) {
+        xQueuePeek(displayStatusQueue, &status, 0);
+
+        // Handle status LED blinking when WebSocket connected (inverted logic)
+        if (status.wsConnected) {
+            // Blink LED every 500ms when connected
+            if (millis() - lastLedBlink > 500) {
+                ledState = !ledState;
+                digitalWrite(STATUS_LED_PIN, ledState ? LOW : HIGH);  // LOW = ON, HIGH = OFF
+                lastLedBlink = millis();
+            }
+        } else {
+            // Turn off LED when disconnected
+            digitalWrite(STATUS_LED_PIN, HIGH);  // HIGH = OFF
+            ledState = false;
+        }
+
+        // Update the OLED; it only sends the tiles that changed
+        if (millis() - lastDisplayUpdate >= DISPLAY_REFRESH_MS) {
+            unsigned long rxBytes[MAX_CHANNELS];
+            for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+                rxBytes[channel] = serialBridge.getChannelCounters(channel).rxBytes;
+            }
+            if (wifiManager.isConnected()) {
+                char ipLast3[WiFiManager::IP_LAST3_SIZE];
+                wifiManager.getIPLast3Digits(ipLast3, sizeof(ipLast3));
+                oledManager.displayStatus(ipLast3, status.wsConnected, status.channel, rxBytes);
+            } else {
+                oledManager.displayStatus("---", false, 0, rxBytes);
+            }
+            lastDisplayUpdate = millis();
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(DISPLAY_TASK_PERIOD_MS));
+    }
+}
+
+/**
+ * Write queued log messages to USB serial; only runs when every other task
+ * is idle, so a slow or absent USB host never delays the byte path
+ */
+void logTask(void*) {
+    for (;;) {
+        logger().drain(hal::console());
+        vTaskDelay(pdMS_TO_TICKS(LOG_TASK_PERIOD_MS));
+    }
+}
+
+/**
+ * Compress recorded SBC output and append it to flash while the SBCs are
+ * quiet; the UART task only ever copies into the recorder's queue
+ */
+void recorderTask(void*) {
+    for (;;) {
+        sessionRecorder.loop();
+        vTaskDelay(pdMS_TO_TICKS(RECORD_TASK_PERIOD_MS));
+    }
+}
 
 void setup() {
     // Initialize serial for debugging
     Serial.begin(115200);
     delay(1000);
-    Serial.println("ESP32-C3 Serial Multiplexer starting...");
+    xTaskCreate(logTask, "log", LOG_TASK_STACK, nullptr, LOG_TASK_PRIORITY, nullptr);
+    LOG_INFO("ESP32-C3 Serial Multiplexer starting...\r\n");
     
     // Initialize status LED (inverted logic - HIGH = OFF, LOW = ON)
     pinMode(STATUS_LED_PIN, OUTPUT);
     digitalWrite(STATUS_LED_PIN, HIGH);  // Turn OFF initially
-    Serial.println("Status LED initialized");
+    LOG_INFO("Status LED initialized\r\n");
     
     // Initialize OLED display first
     if (!oledManager.init()) {
-        Serial.println("OLED initialization failed");
+        LOG_ERROR("OLED initialization failed\r\n");
         return;
     }
     
     // Initialize multiplexer
     multiplexer.init();
     multiplexer.selectChannel(0); // Start with SBC1
-    Serial.println("Multiplexer initialized - Channel 0 selected");
+    LOG_INFO("Multiplexer initialized - Channel 0 selected\r\n");
     
     // Initialize SBC serial communication
-    SerialSBC.begin(UART_BAUD_RATE, SERIAL_8N1, RX_PIN, TX_PIN);
-    Serial.println("SBC Serial initialized");
+    SerialSBC.begin(UART_BAUD_RATE);
+    LOG_INFO("SBC Serial initialized\r\n");
     
     // Initialize WiFi
     if (!wifiManager.init()) {
-        Serial.println("WiFi connection failed");
+        LOG_ERROR("WiFi connection failed\r\n");
         oledManager.displayIP("ERR");
         return;
     }
     
     // Display initial status on OLED
-    String ipLast3 = wifiManager.getIPLast3Digits();
-    oledManager.displayStatus(ipLast3, false, 0); // WebSocket not connected yet, SBC1 selected
-    Serial.print("WiFi connected - IP last 3 digits: ");
-    Serial.println(ipLast3);
+    char ipLast3[WiFiManager::IP_LAST3_SIZE];
+    wifiManager.getIPLast3Digits(ipLast3, sizeof(ipLast3));
+    unsigned long rxBytes[MAX_CHANNELS] = {};
+    oledManager.displayStatus(ipLast3, false, 0, rxBytes); // WebSocket not connected yet, SBC1 selected
+    LOG_INFO("WiFi connected - IP last 3 digits: %s\r\n", ipLast3);
     
     // Initialize WebSocket server
     if (!webSocketServer.init()) {
-        Serial.println("WebSocket server initialization failed");
+        LOG_ERROR("WebSocket server initialization failed\r\n");
         return;
     }
     
     // Set references for WebSocket server
-    webSocketServer.setReferences(&multiplexer, &SerialSBC);
+    webSocketServer.setReferences(&multiplexer, &serialBridge);
+    serialBridge.init(&SerialSBC, &multiplexer, &webSocketServer);
+    metricsExport.setSources(&serialBridge, &webSocketServer, nullptr);
+
+#if RECORD_ENABLED
+    // LittleFS was mounted by the WebSocket server
+    if (sessionRecorder.begin(&hal::fileSystem())) {
+        serialBridge.setRecorder(&sessionRecorder);
+        metricsExport.setSources(&serialBridge, &webSocketServer, &sessionRecorder);
+        xTaskCreate(recorderTask, "recorder", RECORD_TASK_STACK, nullptr, RECORD_TASK_PRIORITY, nullptr);
+    }
+#endif
+    webSocketServer.setMetrics(&metricsExport);
+#if PORT_SERVER_ENABLED
+    portServer.begin(&serialBridge, &webSocketServer);
+#endif
+
+    // Start the task pipeline
+    displayStatusQueue = xQueueCreate(1, sizeof(DisplayStatus));
+    xTaskCreate(networkTask, "network", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY, &networkTaskHandle);
+    xTaskCreate(uartTask, "uart", UART_TASK_STACK, nullptr, UART_TASK_PRIORITY, nullptr);
+    xTaskCreate(displayTask, "display", DISPLAY_TASK_STACK, nullptr, DISPLAY_TASK_PRIORITY, nullptr);
     
-    Serial.println("ESP32-C3 Serial Multiplexer ready!");
-    Serial.print("Access web interface at: http://");
-    Serial.println(wifiManager.getIPAddress());
+    LOG_INFO("ESP32-C3 Serial Multiplexer ready!\r\n");
+    char ipAddress[WiFiManager::IP_ADDRESS_SIZE];
+    wifiManager.getIPAddress(ipAddress, sizeof(ipAddress));
+    LOG_INFO("Access web interface at: http://%s\r\n", ipAddress);
 }
 
 void loop() {
-    static unsigned long lastDisplayUpdate = 0;
-    static unsigned long lastLedBlink = 0;
-    static bool ledState = false;
-    
-    // Handle WebSocket server
-    webSocketServer.loop();
-    
-    // Forward data from SBC to WebSocket clients using buffering
-    if (SerialSBC.available()) {
-        while (SerialSBC.available()) {
-            char c = SerialSBC.read();
-            
-            // Debug: Print character code to help diagnose communication issues
-            if (c < 32 || c > 126) {
-                Serial.printf("[0x%02X]", (unsigned char)c);
-            } else {
-                Serial.print(c);
-            }
-            
-            // Use buffering system for proper UTF-8 handling
-            // Only exclude NULL (0) which can cause string termination issues
-            if (c != 0) {
-                webSocketServer.addToBuffer(c);
-            }
-        }
-    }
-    
-    // Check if buffer needs to be flushed periodically
-    static unsigned long lastFlushCheck = 0;
-    if (millis() - lastFlushCheck > 100) { // Check every 100ms
-        webSocketServer.flushBuffer();
-        lastFlushCheck = millis();
-    }
-    
-    // Handle status LED blinking when WebSocket connected (inverted logic)
-    bool wsConnected = webSocketServer.hasConnectedClients();
-    if (wsConnected) {
-        // Blink LED every 500ms when connected
-        if (millis() - lastLedBlink > 500) {
-            ledState = !ledState;
-            digitalWrite(STATUS_LED_PIN, ledState ? LOW : HIGH);  // LOW = ON, HIGH = OFF
-            lastLedBlink = millis();
-        }
-    } else {
-        // Turn off LED when disconnected
-        digitalWrite(STATUS_LED_PIN, HIGH);  // HIGH = OFF
-        ledState = false;
-    }
-    
-    // Update OLED display periodically (every 0.8 seconds)
-    if (millis() - lastDisplayUpdate > 800) {
-        if (wifiManager.isConnected()) {
-            String ipLast3 = wifiManager.getIPLast3Digits();
-            int currentChannel = webSocketServer.getCurrentChannel();
-            oledManager.displayStatus(ipLast3, wsConnected, currentChannel);
-        } else {
-            oledManager.displayStatus("---", false, 0);
-        }
-        lastDisplayUpdate = millis();
-    }
-    
-    // Small delay to prevent overwhelming the system
-    delay(10);
-}
\ No newline at end of file
+    // All work runs in the tasks started by setup()
+    vTaskDelete(nullptr);
+}
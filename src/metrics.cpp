@@ -0,0 +1,304 @@
+#include "metrics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+typedef size_t (*SampleCount)(const MetricsSnapshot& s);
+// Writes what follows the family name: suffix, labels and value
+typedef int (*SampleFormat)(const MetricsSnapshot& s, size_t i, char* out, size_t size);
+
+/**
+ * One metric family of the page
+ */
+struct MetricFamily {
+    const char* name;
+    const char* type;
+    const char* help;
+    SampleCount samples;    // 0 leaves the family out
+    SampleFormat format;
+};
+
+size_t one(const MetricsSnapshot&) { return 1; }
+size_t perChannel(const MetricsSnapshot&) { return MAX_CHANNELS; }
+size_t two(const MetricsSnapshot&) { return 2; }
+size_t ifRecording(const MetricsSnapshot& s) { return s.recording ? 1 : 0; }
+
+int value(char* out, size_t size, unsigned long v) {
+    return snprintf(out, size, " %lu", v);
+}
+
+int seconds(char* out, size_t size, const char* labels, unsigned long us) {
+    return snprintf(out, size, "%s %lu.%06lu", labels, us / 1000000, us % 1000000);
+}
+
+/**
+ * Copy text into a label value, escaped as the text format requires
+ */
+void escapeLabel(char* out, size_t size, const char* text) {
+    size_t length = 0;
+    for (; *text && length + 2 < size; text++) {
+        if (*text == '\\' || *text == '"' || *text == '\n') {
+            out[length++] = '\\';
+        }
+        out[length++] = *text == '\n' ? 'n' : *text;
+    }
+    out[length] = '\0';
+}
+
+const char* taskLabel(size_t i) {
+    return i == 0 ? "{task=\"uart\"}" : "{task=\"network\"}";
+}
+
+const MetricFamily FAMILIES[] = {
+    {"sbcmux_uptime_seconds", "gauge", "Time since boot", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return snprintf(out, size, " %lu.%03lu", s.uptimeMs / 1000, s.uptimeMs % 1000);
+     }},
+    {"sbcmux_channel_rx_bytes_total", "counter", "Bytes received from the SBC and kept in the scrollback", perChannel,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return snprintf(out, size, "{channel=\"%u\"} %lu", (unsigned)i, s.channels[i].rxBytes);
+     }},
+    {"sbcmux_channel_tx_bytes_total", "counter", "Bytes written to the SBC", perChannel,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return snprintf(out, size, "{channel=\"%u\"} %lu", (unsigned)i, s.channels[i].txBytes);
+     }},
+    {"sbcmux_channel_baud", "gauge", "Line rate of the channel", perChannel,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return snprintf(out, size, "{channel=\"%u\"} %lu", (unsigned)i, s.baud[i]);
+     }},
+    {"sbcmux_interactive_channel", "gauge", "Channel the clients type on", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return snprintf(out, size, " %d", s.interactiveChannel);
+     }},
+    {"sbcmux_uart_rx_bytes_total", "counter", "Bytes taken from the UART", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.uart.rxBytes); }},
+    {"sbcmux_uart_ring_overrun_bytes_total", "counter", "Bytes dropped because the UART receive ring was full", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.uart.ringOverruns); }},
+    {"sbcmux_uart_fifo_overflows_total", "counter", "UART FIFO or driver buffer overflows", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.uart.fifoOverflows); }},
+    {"sbcmux_uart_framing_errors_total", "counter", "UART framing and parity errors", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.uart.framingErrors); }},
+    {"sbcmux_uart_fenced_bytes_total", "counter", "Bytes dropped while the UART settled after a channel switch", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.uart.fencedBytes); }},
+    {"sbcmux_uart_ring_peak_bytes", "gauge", "Highest fill level of the UART receive ring", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.uart.ringPeak); }},
+    {"sbcmux_ws_frames_total", "counter", "Live output frames sent to terminal clients", two,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return i == 0 ? snprintf(out, size, "{type=\"text\"} %lu", s.output.textFrames)
+                       : snprintf(out, size, "{type=\"binary\"} %lu", s.output.binaryFrames);
+     }},
+    {"sbcmux_ws_frame_bytes", "histogram", "Size of the live output frames",
+     [](const MetricsSnapshot&) { return SizeHistogram::BUCKETS + 3; },
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         unsigned long cumulative = 0;
+         for (size_t b = 0; b <= i && b <= SizeHistogram::BUCKETS; b++) {
+             cumulative += s.frameBuckets[b];
+         }
+         if (i < SizeHistogram::BUCKETS) {
+             return snprintf(out, size, "_bucket{le=\"%lu\"} %lu", SizeHistogram::upperBound(i), cumulative);
+         }
+         if (i == SizeHistogram::BUCKETS) return snprintf(out, size, "_bucket{le=\"+Inf\"} %lu", cumulative);
+         if (i == SizeHistogram::BUCKETS + 1) return snprintf(out, size, "_sum %lu", s.frameBytes);
+         return snprintf(out, size, "_count %lu", cumulative);
+     }},
+    {"sbcmux_ws_output_bytes_total", "counter", "Live output bytes sent to terminal clients", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.output.bytes); }},
+    {"sbcmux_ws_compressed_frames_total", "counter", "Frames sent LZ-compressed to compressing clients", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return value(out, size, s.output.compressedFrames);
+     }},
+    {"sbcmux_ws_compress_bytes_total", "counter", "Frames offered to the compressor, before and on the wire", two,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return i == 0 ? snprintf(out, size, "{stage=\"in\"} %lu", s.output.compressInputBytes)
+                       : snprintf(out, size, "{stage=\"out\"} %lu", s.output.compressOutputBytes);
+     }},
+    {"sbcmux_ws_compress_seconds_total", "counter", "Time spent compressing frames", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return seconds(out, size, "", s.output.compressUs);
+     }},
+    {"sbcmux_ws_compress_ratio", "gauge", "Bytes on the wire per byte offered to the compressor", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         unsigned long in = s.output.compressInputBytes;
+         unsigned long long scaled = (unsigned long long)s.output.compressOutputBytes * 1000;
+         unsigned long permille = in ? (unsigned long)(scaled / in) : 1000;
+         return snprintf(out, size, " %lu.%03lu", permille / 1000, permille % 1000);
+     }},
+    {"sbcmux_ws_compress_seconds_per_kibibyte", "gauge", "Compression time per KiB offered", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         unsigned long in = s.output.compressInputBytes;
+         return seconds(out, size, "", in ? (unsigned long)((unsigned long long)s.output.compressUs * 1024 / in) : 0);
+     }},
+    {"sbcmux_ws_clients", "gauge", "Connected WebSocket clients", two,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return i == 0 ? snprintf(out, size, "{protocol=\"terminal\"} %u", (unsigned)s.terminalClients)
+                       : snprintf(out, size, "{protocol=\"channel\"} %u", (unsigned)s.channelClients);
+     }},
+    {"sbcmux_http_responses_total", "counter", "HTTP responses sent, 304s included", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.httpResponses); }},
+    {"sbcmux_http_not_modified_total", "counter", "HTTP 304 Not Modified responses", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.httpNotModified); }},
+    {"sbcmux_heap_free_bytes", "gauge", "Free heap", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.heap.freeBytes); }},
+    {"sbcmux_heap_largest_free_block_bytes", "gauge", "Largest allocation that can succeed", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return value(out, size, s.heap.largestFreeBlock);
+     }},
+    {"sbcmux_heap_minimum_free_bytes", "gauge", "Lowest free heap since boot", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return value(out, size, s.heap.minimumFreeBytes);
+     }},
+    {"sbcmux_task_period_mean_seconds", "gauge", "Mean time between iterations of a task loop", two,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return seconds(out, size, taskLabel(i), (i == 0 ? s.uartPeriod : s.networkPeriod).meanUs);
+     }},
+    {"sbcmux_task_period_max_seconds", "gauge", "Longest time between iterations of a task loop", two,
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         return seconds(out, size, taskLabel(i), (i == 0 ? s.uartPeriod : s.networkPeriod).maxUs);
+     }},
+    {"sbcmux_forward_latency_mean_seconds", "gauge", "Mean time output waited for the network task", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return seconds(out, size, "", s.forwardLatency.meanUs);
+     }},
+    {"sbcmux_forward_latency_max_seconds", "gauge", "Longest time output waited for the network task", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return seconds(out, size, "", s.forwardLatency.maxUs);
+     }},
+    {"sbcmux_switch_latency_mean_seconds", "gauge", "Mean time from a channel switch to its first byte", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) {
+         return seconds(out, size, "", s.switchLatency.meanUs);
+     }},
+    {"sbcmux_record_bytes_total", "counter", "Output handed to the session recorder", ifRecording,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.recorder.recordedBytes); }},
+    {"sbcmux_record_dropped_bytes_total", "counter", "Output left out of the recording", ifRecording,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.recorder.droppedBytes); }},
+    {"sbcmux_record_flash_bytes_total", "counter", "Bytes the recorder wrote to flash", ifRecording,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.recorder.storedBytes); }},
+    {"sbcmux_record_commits_total", "counter", "Flash writes of the recorder", ifRecording,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.recorder.commits); }},
+    {"sbcmux_record_write_errors_total", "counter", "Failed flash writes of the recorder", ifRecording,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.recorder.writeErrors); }},
+    {"sbcmux_trigger_matches_total", "counter", "Matches of a trigger pattern in a channel's output",
+     [](const MetricsSnapshot& s) { return MAX_CHANNELS * s.triggerPatterns; },
+     [](const MetricsSnapshot& s, size_t i, char* out, size_t size) {
+         size_t channel = i / s.triggerPatterns, pattern = i % s.triggerPatterns;
+         char label[2 * TriggerMatcher::MAX_PATTERN_LENGTH + 1];
+         escapeLabel(label, sizeof(label), s.triggerNames[pattern]);
+         return snprintf(out, size, "{channel=\"%u\",pattern=\"%s\"} %lu", (unsigned)channel, label,
+                         s.triggerMatches[channel][pattern]);
+     }},
+    {"sbcmux_trigger_alerts_dropped_total", "counter", "Trigger alerts lost because too many matched at once", one,
+     [](const MetricsSnapshot& s, size_t, char* out, size_t size) { return value(out, size, s.droppedAlerts); }},
+};
+
+const size_t FAMILY_COUNT = sizeof(FAMILIES) / sizeof(FAMILIES[0]);
+
+TimingSnapshot timing(const LatencyStats& stats) {
+    TimingSnapshot snapshot;
+    snapshot.meanUs = stats.getMeanUs();
+    snapshot.maxUs = stats.getMaxUs();
+    return snapshot;
+}
+
+} // namespace
+
+void MetricsExport::setSources(SerialBridge* bridge, WebSocketServer* server, SessionRecorder* recorder) {
+    this->bridge = bridge;
+    this->server = server;
+    this->recorder = recorder;
+}
+
+bool MetricsExport::begin() {
+    if (!bridge || !server) return false;
+
+    snapshot = MetricsSnapshot();
+    snapshot.uptimeMs = hal::clock().millis();
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        snapshot.channels[channel] = bridge->getChannelCounters(channel);
+        snapshot.baud[channel] = bridge->getLineSettings(channel).config.baud;
+    }
+    snapshot.interactiveChannel = server->getCurrentChannel();
+    snapshot.uart = bridge->getUartStats();
+    snapshot.output = server->getOutputStats();
+    const SizeHistogram& frameSizes = server->getFrameSizes();
+    for (size_t bucket = 0; bucket <= SizeHistogram::BUCKETS; bucket++) {
+        snapshot.frameBuckets[bucket] = frameSizes.getBucket(bucket);
+    }
+    snapshot.frameBytes = frameSizes.getSum();
+    snapshot.terminalClients = server->getTerminalClients();
+    snapshot.channelClients = server->getChannelClients();
+    snapshot.httpResponses = server->getHttpServer().getResponses();
+    snapshot.httpNotModified = server->getHttpServer().getNotModified();
+    snapshot.heap = hal::heapStats();
+    snapshot.uartPeriod = timing(bridge->getPumpPeriods());
+    snapshot.networkPeriod = timing(bridge->getForwardPeriods());
+    snapshot.forwardLatency = timing(bridge->getForwardLatency());
+    snapshot.switchLatency = timing(bridge->getSwitchLatency());
+    if (recorder) {
+        snapshot.recording = true;
+        snapshot.recorder = recorder->getStats();
+    }
+    const TriggerMatcher& triggers = bridge->getTriggers();
+    snapshot.triggerPatterns = triggers.getPatternCount();
+    for (size_t pattern = 0; pattern < snapshot.triggerPatterns; pattern++) {
+        strncpy(snapshot.triggerNames[pattern], triggers.getPattern(pattern), TriggerMatcher::MAX_PATTERN_LENGTH);
+        for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+            snapshot.triggerMatches[channel][pattern] = triggers.getMatches(channel, pattern);
+        }
+    }
+    snapshot.droppedAlerts = triggers.getDroppedAlerts();
+
+    open = true;
+    family = 0;
+    step = 0;
+    lineLength = 0;
+    linePosition = 0;
+    return true;
+}
+
+size_t MetricsExport::read(uint8_t* buffer, size_t size) {
+    size_t produced = 0;
+    while (open && produced < size) {
+        if (linePosition == lineLength) {
+            lineLength = 0;
+            linePosition = 0;
+            if (!stageNext()) break;
+        }
+        size_t count = lineLength - linePosition;
+        if (count > size - produced) count = size - produced;
+        memcpy(buffer + produced, line + linePosition, count);
+        linePosition += count;
+        produced += count;
+    }
+    return produced;
+}
+
+bool MetricsExport::stageNext() {
+    while (family < FAMILY_COUNT) {
+        const MetricFamily& metric = FAMILIES[family];
+        size_t samples = metric.samples(snapshot);
+        if (samples == 0 || step >= samples + 2) {
+            family++;
+            step = 0;
+            continue;
+        }
+
+        int length;
+        if (step == 0) {
+            length = snprintf(line, sizeof(line), "# HELP %s %s\n", metric.name, metric.help);
+        } else if (step == 1) {
+            length = snprintf(line, sizeof(line), "# TYPE %s %s\n", metric.name, metric.type);
+        } else {
+            length = snprintf(line, sizeof(line), "%s", metric.name);
+            size_t room = sizeof(line) - length - 1;    // Keep space for the line end
+            int more = metric.format(snapshot, step - 2, line + length, room);
+            if (more > 0) length += (size_t)more < room ? more : (int)room - 1;
+            line[length++] = '\n';
+        }
+        step++;
+        lineLength = (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1;
+        return true;
+    }
+    return false;
+}
@@ -1,83 +1,190 @@
 #include "multiplexer.h"
+#include "hal.h"
 
-const uint8_t MultiplexerController::channelBits[MAX_CHANNELS] = {
-    0b0000,  // Channel 0: S3=0, S2=0, S1=0, S0=0
-    0b0001,  // Channel 1: S3=0, S2=0, S1=0, S0=1
-    0b0010,  // Channel 2: S3=0, S2=0, S1=1, S0=0
-    0b0011,  // Channel 3: S3=0, S2=0, S1=1, S0=1
-    0b0100   // Channel 4: S3=0, S2=1, S1=0, S0=0
-};
-
-void MultiplexerController::init() {
-    // Configure control pins as outputs
-    pinMode(MUX_S0_PIN, OUTPUT);
-    pinMode(MUX_S1_PIN, OUTPUT);
-    pinMode(MUX_S2_PIN, OUTPUT);
-    pinMode(MUX_S3_PIN, OUTPUT);
-    
-    // Set initial state to all high (no channel selected)
-    digitalWrite(MUX_S0_PIN, HIGH);
-    digitalWrite(MUX_S1_PIN, HIGH);
-    digitalWrite(MUX_S2_PIN, HIGH);
-    digitalWrite(MUX_S3_PIN, HIGH);
-    
+template <typename Layout, uint8_t Channels>
+void MuxController<Layout, Channels>::init() {
+    // Control pins as outputs, all high (no channel selected)
+    Layout::configure(hal::gpio());
     currentChannel = 255;  // Invalid state
 }
 
-bool MultiplexerController::selectChannel(uint8_t channel) {
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::selectChannel(uint8_t channel) {
     if (!isValidChannel(channel)) {
         return false;
     }
 
-    // Check minimum delay between switches to prevent data corruption
-    unsigned long currentTime = millis();
-    if (currentTime - lastSwitchTime < MIN_SWITCH_DELAY) {
-        // Wait for minimum delay
-        delay(MIN_SWITCH_DELAY - (currentTime - lastSwitchTime));
+    interactiveChannel = channel;
+    return switchChannel(channel);
+}
+
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::setChannelBits(uint8_t channel) {
+    // All select/enable lines change in the same register write
+    Layout::select(hal::gpio(), channel);
+    currentChannel = channel;
+    return true;
+}
+
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::isValidChannel(uint8_t channel) const {
+    return channel < Channels;
+}
+
+template <typename Layout, uint8_t Channels>
+uint8_t MuxController<Layout, Channels>::getCurrentChannel() const {
+    return currentChannel;
+}
+
+template <typename Layout, uint8_t Channels>
+uint8_t MuxController<Layout, Channels>::getInteractiveChannel() const {
+    return interactiveChannel;
+}
+
+template <typename Layout, uint8_t Channels>
+void MuxController<Layout, Channels>::setScanMode(bool enabled) {
+    if (enabled == scanning) {
+        return;
     }
 
-    // Perform the actual channel switch
-    if (setChannelBits(channel)) {
-        lastSwitchTime = millis();
-        return true;
+    scanning = enabled;
+    unsigned long now = hal::clock().millis();
+    for (uint8_t channel = 0; channel < Channels; channel++) {
+        leftAt[channel] = now;
     }
 
-    return false;
+    if (!enabled) {
+        returnToInteractive();
+    }
 }
 
-bool MultiplexerController::forceSelectChannel(uint8_t channel) {
-    if (!isValidChannel(channel)) {
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::isScanning() const {
+    return scanning;
+}
+
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::scan(size_t bytesReceived) {
+    if (!isValidChannel(currentChannel)) {
+        return false;
+    }
+
+    unsigned long now = hal::clock().millis();
+    stats[currentChannel].bytesCaptured += bytesReceived;
+    sliceBytes += bytesReceived;
+    if (bytesReceived > 0) {
+        lastByteTime = now;
+    }
+
+    if (!scanning) {
         return false;
     }
 
-    // Force immediate switch without timing checks
-    return setChannelBits(channel);
+    unsigned long dwell = now - sliceStart;
+    if (currentChannel == interactiveChannel) {
+        if (dwell < INTERACTIVE_SLICE_MS) {
+            return false;
+        }
+
+        uint8_t next = nextBackgroundChannel(now);
+        if (next == currentChannel) {
+            return false;  // Nothing else to visit
+        }
+        return switchChannel(next);
+    }
+
+    // Stay on a background channel for the minimum slice, and longer while
+    // it keeps producing output
+    bool talking = sliceBytes > 0 && now - lastByteTime < BACKGROUND_IDLE_MS;
+    if (dwell < BACKGROUND_SLICE_MS || (talking && dwell < BACKGROUND_MAX_SLICE_MS)) {
+        return false;
+    }
+    return switchChannel(interactiveChannel);
 }
 
-bool MultiplexerController::setChannelBits(uint8_t channel) {
-    uint8_t bits = channelBits[channel];
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::returnToInteractive() {
+    if (currentChannel == interactiveChannel) {
+        return false;
+    }
+    return switchChannel(interactiveChannel);
+}
 
-    // Set S0 (LSB)
-    digitalWrite(MUX_S0_PIN, (bits & 0b0001) ? HIGH : LOW);
-    // Set S1
-    digitalWrite(MUX_S1_PIN, (bits & 0b0010) ? HIGH : LOW);
-    // Set S2
-    digitalWrite(MUX_S2_PIN, (bits & 0b0100) ? HIGH : LOW);
-    // Set S3 (MSB)
-    digitalWrite(MUX_S3_PIN, (bits & 0b1000) ? HIGH : LOW);
+template <typename Layout, uint8_t Channels>
+ChannelStats MuxController<Layout, Channels>::getChannelStats(uint8_t channel) const {
+    ChannelStats result;
+    if (!isValidChannel(channel)) {
+        return result;
+    }
 
-    currentChannel = channel;
+    result = stats[channel];
+    unsigned long now = hal::clock().millis();
+    if (channel == currentChannel) {
+        result.dwellMs += now - sliceStart;
+    } else if (scanning) {
+        // Include the loss estimate for the absence in progress
+        result.bytesMissed += result.bytesPerSecond * (now - leftAt[channel]) / 1000;
+    }
+    return result;
+}
 
-    // Delay for multiplexer settling time
-    delayMicroseconds(SETTLING_DELAY_US);
+template <typename Layout, uint8_t Channels>
+bool MuxController<Layout, Channels>::switchChannel(uint8_t channel) {
+    unsigned long now = hal::clock().millis();
 
+    // Close the slice of the channel we are leaving
+    if (isValidChannel(currentChannel)) {
+        ChannelStats& leaving = stats[currentChannel];
+        unsigned long dwell = now - sliceStart;
+        leaving.dwellMs += dwell;
+        if (dwell > 0) {
+            unsigned long sample = sliceBytes * 1000 / dwell;
+            leaving.bytesPerSecond = (leaving.bytesPerSecond * 3 + sample) / 4;
+        }
+        leftAt[currentChannel] = now;
+    }
+
+    // Whatever the channel printed while deselected is gone; estimate it from
+    // the rate observed on previous visits
+    if (scanning && channel != currentChannel) {
+        stats[channel].bytesMissed += stats[channel].bytesPerSecond * (now - leftAt[channel]) / 1000;
+    }
+
+    if (!setChannelBits(channel)) {
+        return false;
+    }
+
+    stats[channel].visits++;
+    sliceStart = hal::clock().millis();
+    sliceBytes = 0;
+    lastByteTime = sliceStart;
     return true;
 }
 
-bool MultiplexerController::isValidChannel(uint8_t channel) const {
-    return channel < MAX_CHANNELS;
+template <typename Layout, uint8_t Channels>
+uint8_t MuxController<Layout, Channels>::nextBackgroundChannel(unsigned long now) const {
+    uint8_t best = interactiveChannel;
+    unsigned long bestPriority = 0;
+
+    for (uint8_t channel = 0; channel < Channels; channel++) {
+        if (channel == interactiveChannel) {
+            continue;
+        }
+
+        unsigned long weight = 1 + stats[channel].bytesPerSecond / ACTIVITY_WEIGHT_BPS;
+        if (weight > MAX_ACTIVITY_WEIGHT) {
+            weight = MAX_ACTIVITY_WEIGHT;
+        }
+
+        // +1 so that channels left at this very millisecond still rank
+        unsigned long priority = (now - leftAt[channel] + 1) * weight;
+        if (priority > bestPriority) {
+            bestPriority = priority;
+            best = channel;
+        }
+    }
+    return best;
 }
 
-uint8_t MultiplexerController::getCurrentChannel() const {
-    return currentChannel;
-}
\ No newline at end of file
+// The board's controller; other layouts only need their own instantiation
+template class MuxController<BoardMuxLayout, MAX_CHANNELS>;
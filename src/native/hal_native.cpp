@@ -0,0 +1,343 @@
+#include "hal_native.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace hal {
+namespace native {
+
+void FakeGpio::setOutput(uint8_t pin) {
+    if (pin < PIN_COUNT) {
+        output[pin] = true;
+    }
+}
+
+void FakeGpio::write(uint8_t pin, bool high) {
+    if (pin >= PIN_COUNT) return;
+    writeMask(1u << pin, high ? 1u << pin : 0);
+}
+
+void FakeGpio::writeMask(uint32_t mask, uint32_t newLevels) {
+    for (size_t pin = 0; pin < PIN_COUNT; pin++) {
+        if (mask & (1u << pin)) {
+            level[pin] = (newLevels >> pin) & 1;
+        }
+    }
+    writes.push_back({mask, levels()});
+}
+
+uint32_t FakeGpio::levels() const {
+    uint32_t result = 0;
+    for (size_t pin = 0; pin < PIN_COUNT; pin++) {
+        if (level[pin]) result |= 1u << pin;
+    }
+    return result;
+}
+
+size_t FakeUart::write(const uint8_t* data, size_t length) {
+    uint64_t now = simClock().micros();
+    uint64_t start = wireIdleUs > now ? wireIdleUs : now;
+    for (size_t i = 0; i < length; i++) {
+        uint64_t done = start + byteTimeUs();
+        txDoneUs.push_back(done);
+        start = done + gapUs();
+    }
+    wireIdleUs = start;
+    tx.insert(tx.end(), data, data + length);
+    return length;
+}
+
+size_t FakeUart::availableForWrite() {
+    uint64_t now = simClock().micros();
+    uint64_t slotUs = byteTimeUs() + gapUs();
+    if (wireIdleUs <= now || slotUs == 0) {
+        return TX_FIFO_SIZE;
+    }
+    uint64_t queued = (wireIdleUs - now + slotUs - 1) / slotUs;
+    return queued < TX_FIFO_SIZE ? TX_FIFO_SIZE - (size_t)queued : 0;
+}
+
+bool FakeUart::txIdle() {
+    return wireIdleUs <= simClock().micros();
+}
+
+unsigned long FakeUart::setTxGap(unsigned long gapUs) {
+    txGapUs = gapUs;
+    unsigned long maxUs = line.baud ? (unsigned long)(MAX_TX_GAP_BITS * 1000000ULL / line.baud) : 0;
+    return gapUs < maxUs ? gapUs : maxUs;
+}
+
+uint64_t FakeUart::gapUs() const {
+    // Whole bit times, at most MAX_TX_GAP_BITS of them, like the hardware
+    if (line.baud == 0) return 0;
+    uint64_t bits = ((uint64_t)txGapUs * line.baud + 999999) / 1000000;
+    if (bits > MAX_TX_GAP_BITS) bits = MAX_TX_GAP_BITS;
+    return (bits * 1000000 + line.baud - 1) / line.baud;
+}
+
+void FakeUart::fenceUntil(unsigned long untilUs) {
+    fenceEndUs = untilUs;
+    fenced = true;
+    uint8_t chunk[256];
+    size_t count;
+    while ((count = rx.pop(chunk, sizeof(chunk))) > 0) {
+        stats.fencedBytes += count;
+    }
+}
+
+void FakeUart::injectFramingErrors(unsigned long count) {
+    if (fenced && (long)(simClock().micros() - fenceEndUs) < 0) {
+        return;
+    }
+    stats.framingErrors += count;
+}
+
+void FakeUart::notePulse(unsigned long ns) {
+    if (shortestPulseNs == 0 || ns < shortestPulseNs) {
+        shortestPulseNs = ns;
+    }
+}
+
+UartStats FakeUart::getStats() {
+    UartStats result = stats;
+    result.ringCapacity = rx.capacity();
+    return result;
+}
+
+void FakeUart::inject(const uint8_t* data, size_t length) {
+    if (fenced && (long)(simClock().micros() - fenceEndUs) < 0) {
+        stats.fencedBytes += length;
+        return;
+    }
+    fenced = false;
+
+    size_t stored = rx.push(data, length);
+    stats.rxBytes += length;
+    stats.ringOverruns += length - stored;
+    if (rx.size() > stats.ringPeak) {
+        stats.ringPeak = rx.size();
+    }
+}
+
+size_t StdoutConsole::write(const uint8_t* data, size_t length) {
+    if (muted) {
+        return length;
+    }
+    return fwrite(data, 1, length, stdout);
+}
+
+bool FakeWebSocket::record(uint8_t num, bool text, const uint8_t* data, size_t length) {
+    if (text) {
+        textFrames++;
+    } else {
+        binaryFrames++;
+    }
+    payloadBytes += length;
+
+    if (captureFrames) {
+        frames.push_back({num, text, std::vector<uint8_t>(data, data + length)});
+    }
+    return true;
+}
+
+bool FakeWebSocket::sendText(uint8_t num, const uint8_t* data, size_t length) {
+    if (num >= MAX_CLIENTS || !connected[num]) return false;
+    return record(num, true, data, length);
+}
+
+bool FakeWebSocket::sendBinary(uint8_t num, const uint8_t* data, size_t length) {
+    if (num >= MAX_CLIENTS || !connected[num]) return false;
+    return record(num, false, data, length);
+}
+
+bool FakeWebSocket::broadcastText(const uint8_t* data, size_t length) {
+    return record(BROADCAST, true, data, length);
+}
+
+bool FakeWebSocket::broadcastBinary(const uint8_t* data, size_t length) {
+    return record(BROADCAST, false, data, length);
+}
+
+size_t FakeWebSocket::connectedClients() {
+    size_t count = 0;
+    for (uint8_t i = 0; i < MAX_CLIENTS; i++) {
+        if (connected[i]) count++;
+    }
+    return count;
+}
+
+void FakeWebSocket::connect(uint8_t num, const char* path) {
+    if (num >= MAX_CLIENTS) return;
+    connected[num] = true;
+    if (handler) {
+        handler(num, WsEvent::Connected, (const uint8_t*)path, strlen(path));
+    }
+}
+
+void FakeWebSocket::disconnect(uint8_t num) {
+    if (num >= MAX_CLIENTS) return;
+    connected[num] = false;
+    if (handler) {
+        handler(num, WsEvent::Disconnected, nullptr, 0);
+    }
+}
+
+void FakeWebSocket::receiveText(uint8_t num, const char* text) {
+    if (num >= MAX_CLIENTS || !connected[num] || !handler) return;
+    handler(num, WsEvent::Text, (const uint8_t*)text, strlen(text));
+}
+
+void FakeWebSocket::receiveBinary(uint8_t num, const uint8_t* data, size_t length) {
+    if (num >= MAX_CLIENTS || !connected[num] || !handler) return;
+    handler(num, WsEvent::Binary, data, length);
+}
+
+std::string FakeWebSocket::capturedPayload() const {
+    std::string payload;
+    for (const Frame& frame : frames) {
+        payload.append(frame.payload.begin(), frame.payload.end());
+    }
+    return payload;
+}
+
+size_t FakeTcpConnection::write(const uint8_t* data, size_t length) {
+    if (!open) return 0;
+    output.append((const char*)data, length);
+    return length;
+}
+
+size_t FakeTcpConnection::read(uint8_t* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length && !input.empty()) {
+        buffer[count++] = input.front();
+        input.pop_front();
+    }
+    return count;
+}
+
+TcpConnection* FakeTcpServer::accept() {
+    if (!started || nextPending >= connections.size()) {
+        return nullptr;
+    }
+    return connections[nextPending++].get();
+}
+
+FakeTcpConnection* FakeTcpServer::queueConnection(const char* request) {
+    connections.emplace_back(new FakeTcpConnection());
+    FakeTcpConnection* connection = connections.back().get();
+    connection->input.assign(request, request + strlen(request));
+    return connection;
+}
+
+size_t MemoryFile::read(uint8_t* buffer, size_t length) {
+    size_t count = available() < length ? available() : length;
+    memcpy(buffer, data->data() + position, count);
+    position += count;
+    return count;
+}
+
+size_t MemoryFile::write(const uint8_t* bytes, size_t length) {
+    owner->noteWrite(data->size(), length);
+    data->insert(data->end(), bytes, bytes + length);
+    position = data->size();
+    return length;
+}
+
+bool MemoryFile::seek(size_t offset) {
+    if (offset > data->size()) return false;
+    position = offset;
+    return true;
+}
+
+File* MemoryFileSystem::open(const char* path, const char* mode) {
+    bool reading = mode[0] == 'r';
+    if (reading && !exists(path)) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < MAX_OPEN_FILES; i++) {
+        MemoryFile& file = openFiles[i];
+        if (!file.inUse) {
+            file.owner = this;
+            file.data = &files[path];
+            if (mode[0] == 'w') {
+                file.data->clear();
+            }
+            file.position = mode[0] == 'a' ? file.data->size() : 0;
+            file.inUse = true;
+            return &file;
+        }
+    }
+    return nullptr;
+}
+
+void MemoryFileSystem::noteWrite(size_t size, size_t length) {
+    if (length == 0) return;
+    size_t sectors = (size + length - 1) / SECTOR_SIZE - size / SECTOR_SIZE + 1;
+    size_t pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t now = simClock().micros();
+    uint64_t start = busyUntilUs > now ? busyUntilUs : now;
+    busyUntilUs = start + sectors * sectorEraseUs + pages * pageProgramUs;
+    sectorErases += sectors;
+    bytesWritten += length;
+}
+
+void MemoryFileSystem::addFile(const char* path, const char* contents) {
+    files[path].assign(contents, contents + strlen(contents));
+}
+
+namespace {
+
+SimClock clockInstance;
+FakeGpio gpioInstance;
+FakeUart sbcUartInstance;
+StdoutConsole consoleInstance;
+MemoryFileSystem fileSystemInstance;
+std::vector<std::unique_ptr<FakeWebSocket>> webSockets;
+std::vector<std::unique_ptr<FakeTcpServer>> tcpServers;
+
+} // namespace
+
+SimClock& simClock() { return clockInstance; }
+FakeGpio& fakeGpio() { return gpioInstance; }
+FakeUart& fakeSbcUart() { return sbcUartInstance; }
+StdoutConsole& stdoutConsole() { return consoleInstance; }
+MemoryFileSystem& memoryFileSystem() { return fileSystemInstance; }
+
+FakeWebSocket* webSocketOnPort(uint16_t port) {
+    for (auto& webSocket : webSockets) {
+        if (webSocket->port == port) return webSocket.get();
+    }
+    return nullptr;
+}
+
+FakeTcpServer* tcpServerOnPort(uint16_t port) {
+    for (auto& server : tcpServers) {
+        if (server->port == port) return server.get();
+    }
+    return nullptr;
+}
+
+} // namespace native
+
+Clock& clock() { return native::clockInstance; }
+Gpio& gpio() { return native::gpioInstance; }
+Uart& sbcUart() { return native::sbcUartInstance; }
+Console& console() { return native::consoleInstance; }
+FileSystem& fileSystem() { return native::fileSystemInstance; }
+
+WebSocketTransport* createWebSocketTransport(uint16_t port) {
+    native::webSockets.emplace_back(new native::FakeWebSocket(port));
+    return native::webSockets.back().get();
+}
+
+TcpServer* createTcpServer(uint16_t port) {
+    native::tcpServers.emplace_back(new native::FakeTcpServer(port));
+    return native::tcpServers.back().get();
+}
+
+HeapStats heapStats() {
+    return HeapStats();     // The host heap says nothing about the device's
+}
+
+} // namespace hal
@@ -0,0 +1,44 @@
+// Replaces the global operator new/delete of the native build so the harness
+// can count heap allocations (see heapAllocations() in hal_native.h). Every
+// std container, std::string and `new` in the firmware goes through these.
+
+#include <new>
+#include <stdlib.h>
+
+#include "hal_native.h"
+
+namespace {
+
+unsigned long allocations = 0;
+unsigned long allocatedBytes = 0;
+
+void* allocate(size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    void* block = malloc(size ? size : 1);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+} // namespace
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* block) noexcept { free(block); }
+void operator delete[](void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+void operator delete[](void* block, size_t) noexcept { free(block); }
+
+namespace hal {
+namespace native {
+
+unsigned long heapAllocations() {
+    return allocations;
+}
+
+unsigned long heapAllocatedBytes() {
+    return allocatedBytes;
+}
+
+} // namespace native
+} // namespace hal
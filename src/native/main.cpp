@@ -0,0 +1,3040 @@
+// Host harness for the [env:native] build.
+//
+// Runs the same MultiplexerController / WebSocketServer / SerialBridge objects
+// as the firmware against the fake devices in hal_native.cpp, feeding SBC
+// output into the fake UART at the configured baud rate (simulated time) and
+// reporting host CPU throughput plus the WebSocket frames that came out.
+//
+// Usage: program [replay <file>] [--baud N] [--bytes N] [--stall-ms N] [--tasks] [--verbose]
+//        program scan [--baud N] [--seconds N] [--verbose]
+//        program utf8bench [--bytes N]
+//        program paste [--baud N] [--bytes N] [--char-us N] [--line-ms N] [--echo]
+//        program http [--baud N] [--bytes N]
+//        program muxpins
+//        program switch [--baud N] [--seconds N] [--hop-ms N]
+//        program autobaud [replay <file>] [--no-pulse]
+//        program record [--baud N] [--seconds N]
+//        program metrics [--baud N] [--bytes N]
+//        program trace [--baud N] [--seconds N]
+//        program triggers [--baud N] [--seconds N] [--bytes N]
+//        program compress [replay <file>] [--baud N] [--bytes N]
+//        program ports
+//        program alloc [--baud N] [--seconds N]
+//        program display [--baud N]
+//
+// The scan mode simulates every SBC talking at its own rate, only the one the
+// mux selects reaching the UART, and compares the scheduler's missed-byte
+// estimate with what was actually lost. Several clients are connected: a
+// channel-protocol client, a writer, a viewer of another channel and a
+// read-only observer, and each must receive exactly its own channels.
+//
+// The paste mode types a configuration script into a simulated U-Boot prompt
+// (16-byte receive FIFO, deaf while it runs a command) through the input
+// queue, and reports what the target lost and the closest two characters
+// came on the wire. Without pacing options it pastes unpaced, with several
+// char_us values at two baud rates, with line_ms and with echo; characters
+// must never come closer than char_us, and every pacing the target can keep
+// up with must deliver the script intact. With pacing options it runs only
+// that pacing, which must deliver it intact. --bytes is capped at
+// TX_QUEUE_SIZE, the largest paste accepted at once.
+//
+// The http mode loads the web UI over one keep-alive connection while the
+// SBC talks at line rate, reloads it with If-None-Match (expecting 304s),
+// and reports the most HTTP bytes written in one network-task pass and the
+// forwarding latency meanwhile. Request targets too long to keep must get
+// 414. --bytes sizes the script (at most 64 KB).
+//
+// The muxpins mode checks the compile-time pin tables of every supported
+// mux layout (HP4067, 74HC4051, two cascaded 4067s): each channel switch
+// must be a single GPIO write that lands on the right address.
+//
+// The switch mode hops the interactive channel every --hop-ms while the SBCs
+// print, behind a model of the UART's receive FIFO (handed over at its
+// threshold or after the idle timeout). Every SBC prints its own letter, so
+// any byte filed under the wrong channel shows; the switch must not advance
+// the clock (no delay), and the switch-to-first-byte latency is reported.
+//
+// The autobaud mode connects SBCs at different rates and formats (9600 to
+// 1.5 Mbaud, one of them 8E1) through a bit-level model of their TX lines
+// and of the UART receiver, so a wrong rate yields the garbage and framing
+// errors a real UART sees. It first gives every channel its settings with
+// LINE: and hops between them, then lets auto-baud detect each rate from
+// 115200, and reports the time to lock. Every channel's scrollback must hold
+// only characters of the text the SBC printed. --no-pulse detects without
+// the pulse measurement; replay prints a recorded console log instead of
+// the synthetic one.
+//
+// The record mode lets two SBCs talk in bursts, one after the other, with
+// the session recorder attached and flash writes timed like the C3's SPI
+// flash (the CPU halts during an erase while the 128-byte RX FIFO fills).
+// The device is then rebooted into a second recording session. It checks
+// that no byte was lost to a flash write, and that /record.cast exports
+// each channel's output intact, in time order and within a seek range.
+//
+// The metrics mode scrapes /metrics twice at once while the SBC prints and
+// types into it, and checks the page's format (HELP and TYPE ahead of each
+// family's samples, a cumulative histogram) and that its counters agree with
+// what the harness fed in and what the WebSocket client received. A third,
+// HTTP/1.0 scrape must get the page unchunked, ended by closing.
+//
+// The trace mode types one traced keystroke at a time into an SBC that
+// echoes each byte a while after it came off the wire, as a shell does, and
+// times each round trip as the browser would. Every trace must complete,
+// the device's segments must fit in the round trip, and /trace.json must
+// report them; a keystroke the SBC never echoes must be abandoned.
+//
+// The triggers mode scans every channel while each SBC prints and now and
+// then panics, runs out of memory or prompts for a login, with overlapping
+// and quoted patterns set by TRIGGERS:. Only the bytes the mux let through
+// can match; every match must be counted once per channel and pattern, and
+// announced to both a terminal and a channel-protocol client with a
+// TRIGGER: notice and on /metrics. Output that itself reads "TRIGGER:..."
+// must reach the terminal client as output, not as a notice. It then times the matcher alone on --bytes of boot log with 3
+// and with 16 patterns, whose cost per byte must not depend on the count.
+//
+// The compress mode connects a plain and a compress=lz terminal client while
+// the SBC prints, then drops the plain one halfway so the rest is broadcast
+// compressed. Each client's frames, unpacked as the web client does, must
+// give back the output; it reports the bytes each one cost on the wire, the
+// /metrics ratio, and the compressor's host CPU time per KB of frames.
+//
+// The ports mode connects tools to the per-channel TCP ports the way
+// pyserial and a raw TCP client do, over in-memory connections: the raw
+// client must get its SBC's output and reach its UART unchanged, the
+// RFC 2217 client must negotiate, change its channel's rate and format, hold
+// a BREAK on the right channel and see 0xFF escaped both ways, and ports
+// must share the write lock with the WebSocket clients. A second client of
+// a busy port is turned away.
+//
+// The alloc mode serves every kind of client at once while the SBC prints
+// and types into it: terminal, channel-protocol and compressed WebSocket
+// clients, a raw TCP port and a keep-alive HTTP connection fetching the page
+// and /metrics. After a warm-up it counts the heap allocations made inside
+// the firmware's calls, which must stay at zero.
+//
+// The display mode refreshes the OLED's screen model on the display task's
+// schedule from the bridge's counters while SBC1 boots, falls quiet, the
+// client switches to SBC3 and it prints a prompt. An idle screen must send
+// no tiles, and activity only the tiles of the channel's bar; it reports
+// the tiles sent against a full redraw every 800 ms.
+//
+// The utf8bench mode times the streaming validator used for WebSocket frames
+// against the previous whole-buffer check, on 256-byte flushes.
+//
+// --stall-ms blocks the loop for N ms once per simulated second (a slow HTTP
+// transfer or WiFi hiccup) while bytes keep arriving at line rate, to check
+// that the UART receive ring absorbs the stall without overruns.
+//
+// By default the stages run back to back like the original single loop();
+// --tasks schedules them like the firmware's task pipeline instead, where a
+// stall only delays the network task and the UART task keeps its period.
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "channel_frame.h"
+#include "hal_native.h"
+#include "logger.h"
+#include "lz_block.h"
+#include "metrics.h"
+#include "multiplexer.h"
+#include "pins.h"
+#include "port_server.h"
+#include "serial_bridge.h"
+#include "session_recorder.h"
+#include "status_screen.h"
+#include "telnet.h"
+#include "trigger_matcher.h"
+#include "utf8_validator.h"
+#include "web_assets.h"
+#include "websocket_server.h"
+
+namespace {
+
+struct Options {
+    bool scan = false;
+    bool utf8Bench = false;
+    bool paste = false;
+    bool http = false;
+    bool muxPins = false;
+    bool switching = false;
+    bool autoBaud = false;
+    bool pulses = true;
+    bool record = false;
+    bool metrics = false;
+    bool trace = false;
+    bool triggers = false;
+    bool compress = false;
+    bool ports = false;
+    bool alloc = false;
+    bool display = false;
+    unsigned long hopMs = 25;
+    unsigned long charDelayUs = TX_CHAR_DELAY_US;
+    unsigned long lineDelayMs = TX_LINE_DELAY_MS;
+    bool echoWait = TX_ECHO_WAIT;
+    bool pacingGiven = false;
+    unsigned long seconds = 30;
+    const char* replayPath = nullptr;
+    unsigned long baud = UART_BAUD_RATE;
+    size_t bytes = 1 << 20;
+    unsigned long stallMs = 0;
+    bool tasks = false;
+    bool verbose = false;
+};
+
+// Period of the single cooperative loop() the firmware used before the task
+// pipeline (stages run back to back, then delay)
+const unsigned long LOOP_PERIOD_MS = 10;
+
+/**
+ * Build a synthetic boot log: kernel-style lines, ANSI colour, UTF-8 glyphs
+ */
+std::string syntheticBootLog(size_t bytes) {
+    static const char* const lines[] = {
+        "[    0.000000] Booting Linux on physical CPU 0x0000000000 [0x410fd034]\r\n",
+        "[    0.412345] usb 1-1: new high-speed USB device number 2 using xhci_hcd\r\n",
+        "[  \x1b[32mOK\x1b[0m  ] Started \x1b[0;1;39mNetwork Time Synchronization\x1b[0m.\r\n",
+        "Temp: 42\xC2\xB0" "C \xE2\x9C\x93 fan \xE2\x86\x92 auto\r\n",
+        "U-Boot SPL 2021.07 (Oct 01 2026 - 12:00:00 +0000)\r\n",
+        "root@sbc:~# ",
+    };
+    const size_t lineCount = sizeof(lines) / sizeof(lines[0]);
+
+    std::string log;
+    log.reserve(bytes);
+    for (size_t i = 0; log.size() < bytes; i++) {
+        log += lines[i % lineCount];
+    }
+    log.resize(bytes);
+    return log;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "replay") == 0 && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        } else if (strcmp(argv[i], "scan") == 0) {
+            options.scan = true;
+        } else if (strcmp(argv[i], "utf8bench") == 0) {
+            options.utf8Bench = true;
+        } else if (strcmp(argv[i], "muxpins") == 0) {
+            options.muxPins = true;
+        } else if (strcmp(argv[i], "autobaud") == 0) {
+            options.autoBaud = true;
+        } else if (strcmp(argv[i], "record") == 0) {
+            options.record = true;
+        } else if (strcmp(argv[i], "metrics") == 0) {
+            options.metrics = true;
+        } else if (strcmp(argv[i], "trace") == 0) {
+            options.trace = true;
+        } else if (strcmp(argv[i], "triggers") == 0) {
+            options.triggers = true;
+        } else if (strcmp(argv[i], "compress") == 0) {
+            options.compress = true;
+        } else if (strcmp(argv[i], "ports") == 0) {
+            options.ports = true;
+        } else if (strcmp(argv[i], "alloc") == 0) {
+            options.alloc = true;
+        } else if (strcmp(argv[i], "display") == 0) {
+            options.display = true;
+        } else if (strcmp(argv[i], "--no-pulse") == 0) {
+            options.pulses = false;
+        } else if (strcmp(argv[i], "switch") == 0) {
+            options.switching = true;
+        } else if (strcmp(argv[i], "--hop-ms") == 0 && i + 1 < argc) {
+            options.hopMs = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "http") == 0) {
+            options.http = true;
+        } else if (strcmp(argv[i], "paste") == 0) {
+            options.paste = true;
+        } else if (strcmp(argv[i], "--char-us") == 0 && i + 1 < argc) {
+            options.charDelayUs = strtoul(argv[++i], nullptr, 10);
+            options.pacingGiven = true;
+        } else if (strcmp(argv[i], "--line-ms") == 0 && i + 1 < argc) {
+            options.lineDelayMs = strtoul(argv[++i], nullptr, 10);
+            options.pacingGiven = true;
+        } else if (strcmp(argv[i], "--echo") == 0) {
+            options.echoWait = true;
+            options.pacingGiven = true;
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            options.baud = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) {
+            options.bytes = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--stall-ms") == 0 && i + 1 < argc) {
+            options.stallMs = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--tasks") == 0) {
+            options.tasks = true;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            options.verbose = true;
+        } else {
+            fprintf(stderr, "usage: %s [replay <file>] [--baud N] [--bytes N] [--stall-ms N] [--tasks] [--verbose]\n", argv[0]);
+            fprintf(stderr, "       %s scan [--baud N] [--seconds N] [--verbose]\n", argv[0]);
+            fprintf(stderr, "       %s utf8bench [--bytes N]\n", argv[0]);
+            fprintf(stderr, "       %s paste [--baud N] [--bytes N] [--char-us N] [--line-ms N] [--echo]\n", argv[0]);
+            fprintf(stderr, "       %s http [--baud N] [--bytes N]\n", argv[0]);
+            fprintf(stderr, "       %s muxpins\n", argv[0]);
+            fprintf(stderr, "       %s switch [--baud N] [--seconds N] [--hop-ms N]\n", argv[0]);
+            fprintf(stderr, "       %s autobaud [replay <file>] [--no-pulse]\n", argv[0]);
+            fprintf(stderr, "       %s record [--baud N] [--seconds N]\n", argv[0]);
+            fprintf(stderr, "       %s metrics [--baud N] [--bytes N]\n", argv[0]);
+            fprintf(stderr, "       %s trace [--baud N] [--seconds N]\n", argv[0]);
+            fprintf(stderr, "       %s triggers [--baud N] [--seconds N] [--bytes N]\n", argv[0]);
+            fprintf(stderr, "       %s compress [replay <file>] [--baud N] [--bytes N]\n", argv[0]);
+            fprintf(stderr, "       %s ports\n", argv[0]);
+            fprintf(stderr, "       %s alloc [--baud N] [--seconds N]\n", argv[0]);
+            fprintf(stderr, "       %s display [--baud N]\n", argv[0]);
+            return false;
+        }
+    }
+    return options.baud > 0 && options.hopMs > 0;
+}
+
+/**
+ * Firmware objects wired together the same way setup() does it
+ */
+struct Pipeline {
+    MultiplexerController multiplexer;
+    WebSocketServer webSocketServer;
+    SerialBridge serialBridge;
+    MetricsExport metrics;
+    hal::native::FakeWebSocket* webSocket = nullptr;
+
+    bool init(unsigned long baud) {
+        multiplexer.init();
+        multiplexer.selectChannel(0);
+        hal::sbcUart().begin(baud);
+        if (!webSocketServer.init()) {
+            fprintf(stderr, "WebSocket server initialization failed\n");
+            return false;
+        }
+        webSocketServer.setReferences(&multiplexer, &serialBridge);
+        serialBridge.init(&hal::sbcUart(), &multiplexer, &webSocketServer);
+        metrics.setSources(&serialBridge, &webSocketServer, nullptr);
+        webSocketServer.setMetrics(&metrics);
+
+        webSocket = hal::native::webSocketOnPort(WEBSOCKET_PORT);
+        webSocket->connect(0);
+        return true;
+    }
+
+    void loop() {
+        webSocketServer.loop();
+        serialBridge.loop();
+        logger().drain(hal::console());
+        hal::clock().delay(LOOP_PERIOD_MS);
+    }
+};
+
+/**
+ * Channel the RX mux currently routes to the UART, decoded from the fake GPIO
+ */
+int selectedChannel() {
+    int channel = BoardMuxLayout::decode(hal::native::fakeGpio().levels());
+    return channel < MAX_CHANNELS ? channel : -1;
+}
+
+int runForward(const Options& options) {
+    std::string input;
+    if (options.replayPath) {
+        std::ifstream file(options.replayPath, std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", options.replayPath);
+            return 2;
+        }
+        input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        input = syntheticBootLog(options.bytes);
+    }
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+
+    hal::native::FakeWebSocket* webSocket = pipeline.webSocket;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+
+    // 10 bits per byte on the wire (8N1)
+    const unsigned long bytesPerSecond = options.baud / 10;
+    size_t fed = 0;
+    size_t iterations = 0;
+    unsigned long long credit = 0;  // bytes * 1000000 not yet delivered
+    unsigned long lastFeedUs = clock.micros();
+    unsigned long lastStallMs = clock.millis();
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    unsigned long networkBusyUntilMs = 0;
+    SerialBridge& bridge = pipeline.serialBridge;
+
+    auto start = std::chrono::steady_clock::now();
+    while (fed < input.size() || uart.available() ||
+           bridge.pendingForward(pipeline.multiplexer.getInteractiveChannel())) {
+        bool stall = options.stallMs && clock.millis() - lastStallMs >= 1000;
+        if (stall) {
+            lastStallMs = clock.millis();
+        }
+        if (stall && !options.tasks) {
+            // A slow HTTP transfer blocks the whole loop
+            clock.delay(options.stallMs);
+        }
+
+        // The wire delivers bytes for however long the last iteration took
+        unsigned long nowUs = clock.micros();
+        credit += (unsigned long long)(nowUs - lastFeedUs) * bytesPerSecond;
+        lastFeedUs = nowUs;
+        size_t count = (size_t)(credit / 1000000);
+        credit -= credit / 1000000 * 1000000;
+        if (count > input.size() - fed) count = input.size() - fed;
+        uart.inject((const uint8_t*)input.data() + fed, count);
+        fed += count;
+
+        if (!options.tasks) {
+            pipeline.loop();
+        } else {
+            // 1 ms scheduler tick; a slow HTTP transfer only blocks the network task
+            unsigned long now = clock.millis();
+            if (now >= nextPumpMs) {
+                // Queued output notifies the network task, unless it is busy
+                if (bridge.pump() > 0 && now >= networkBusyUntilMs) {
+                    nextNetworkMs = now;
+                }
+                nextPumpMs = now + UART_TASK_PERIOD_MS;
+            }
+            if (now >= nextNetworkMs) {
+                pipeline.webSocketServer.loop();
+                bridge.forward();
+                networkBusyUntilMs = now + (stall ? options.stallMs : 0);
+                nextNetworkMs = networkBusyUntilMs + NETWORK_TASK_PERIOD_MS;
+            }
+            logger().drain(hal::console());
+            clock.delay(1);
+        }
+        iterations++;
+    }
+    pipeline.webSocketServer.flushBuffer();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    // Everything except NUL bytes must come out, in order
+    std::string expected;
+    expected.reserve(input.size());
+    for (char c : input) {
+        if (c != 0) expected += c;
+    }
+    bool intact = webSocket->capturedPayload() == expected;
+    hal::UartStats uartStats = uart.getStats();
+
+    size_t frames = webSocket->textFrames + webSocket->binaryFrames;
+    printf("input bytes      : %zu (%s)\n", input.size(), options.replayPath ? options.replayPath : "synthetic");
+    printf("baud             : %lu (%lu bytes/s, %lu ms stall per second)\n", options.baud, bytesPerSecond,
+           options.stallMs);
+    printf("loop iterations  : %zu (%.1f s simulated)\n", iterations, clock.millis() / 1000.0);
+    printf("frames           : %zu text, %zu binary, %.1f bytes avg, %.1f frames/s\n", webSocket->textFrames,
+           webSocket->binaryFrames, frames ? (double)webSocket->payloadBytes / frames : 0.0,
+           frames / (clock.millis() / 1000.0));
+    printf("host throughput  : %.2f MB/s (%.1f ns/byte)\n", input.size() / seconds / 1e6,
+           seconds * 1e9 / (input.size() ? input.size() : 1));
+    printf("uart rx ring     : peak %zu/%zu bytes, %lu bytes overrun\n", uartStats.ringPeak,
+           uartStats.ringCapacity, uartStats.ringOverruns);
+    printf("uart stage period: avg %lu us, max %lu us\n", bridge.getPumpPeriods().getMeanUs(),
+           bridge.getPumpPeriods().getMaxUs());
+    printf("net stage period : avg %lu us, max %lu us\n", bridge.getForwardPeriods().getMeanUs(),
+           bridge.getForwardPeriods().getMaxUs());
+    printf("forward latency  : avg %lu us, max %lu us (%s)\n", bridge.getForwardLatency().getMeanUs(),
+           bridge.getForwardLatency().getMaxUs(), options.tasks ? "task pipeline" : "single loop");
+    printf("payload integrity: %s\n", intact ? "OK" : "MISMATCH");
+
+    return intact ? 0 : 1;
+}
+
+/**
+ * Decode the channel-protocol frames sent to a client and check that each
+ * channel's records are contiguous and end with the same bytes as the
+ * device's scrollback
+ */
+bool checkChannelStreams(const hal::native::FakeWebSocket& webSocket, uint8_t client, const Scrollback& history) {
+    std::string streams[MAX_CHANNELS];
+    uint32_t nextSequence[MAX_CHANNELS] = {};
+    bool started[MAX_CHANNELS] = {};
+    size_t frames = 0, records = 0, replayRecords = 0, gaps = 0;
+    bool ok = true;
+
+    for (const hal::native::FakeWebSocket::Frame& frame : webSocket.frames) {
+        if (frame.num != client || frame.text) continue;
+        frames++;
+
+        ChannelFrameReader reader(frame.payload.data(), frame.payload.size());
+        ChannelRecord record;
+        while (reader.next(record)) {
+            records++;
+            if (record.channel >= MAX_CHANNELS) {
+                ok = false;
+                continue;
+            }
+            if (record.flags & CHANNEL_FLAG_REPLAY) replayRecords++;
+            if (record.flags & CHANNEL_FLAG_GAP) {
+                gaps++;
+                streams[record.channel].clear();
+            } else if (started[record.channel] && record.sequence != nextSequence[record.channel]) {
+                ok = false;
+            }
+            streams[record.channel].append((const char*)record.payload, record.length);
+            nextSequence[record.channel] = record.sequence + (uint32_t)record.length;
+            started[record.channel] = true;
+        }
+    }
+
+    // The received stream must match the history up to the last byte sent
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        if (!started[channel]) continue;
+        uint32_t end = history.endSequence(channel);
+        uint32_t start = end - (uint32_t)history.size(channel);
+        size_t held = nextSequence[channel] - start;
+        size_t compared = held < streams[channel].size() ? held : streams[channel].size();
+
+        std::string expected(compared, '\0');
+        history.copy(channel, held - compared, (uint8_t*)&expected[0], compared);
+        if (streams[channel].compare(streams[channel].size() - compared, compared, expected) != 0) {
+            ok = false;
+        }
+    }
+
+    printf("\nchannel protocol : %zu frames, %zu records (%zu replay, %zu gaps), streams %s\n",
+           frames, records, replayRecords, gaps, ok ? "OK" : "MISMATCH");
+    return ok;
+}
+
+/**
+ * Check per-client routing: the background viewer received exactly the tail
+ * of its channel's history, the observer was refused, and only the writer's
+ * keystrokes reached the UART
+ */
+bool checkClientRouting(const hal::native::FakeWebSocket& webSocket, uint8_t viewer, uint8_t viewedChannel,
+                        uint8_t observer, const Scrollback& history, const std::vector<uint8_t>& tx,
+                        const char* written, int interactive) {
+    std::string viewed;
+    size_t observerNotices = 0;
+    for (const hal::native::FakeWebSocket::Frame& frame : webSocket.frames) {
+        if (frame.num == viewer) {
+            viewed.append(frame.payload.begin(), frame.payload.end());
+        } else if (frame.num == observer && frame.text &&
+                   std::string(frame.payload.begin(), frame.payload.end()).find("read-only") != std::string::npos) {
+            observerNotices++;
+        }
+    }
+
+    size_t compared = viewed.size() < history.size(viewedChannel) ? viewed.size() : history.size(viewedChannel);
+    std::string expected(compared, '\0');
+    history.copy(viewedChannel, history.size(viewedChannel) - compared, (uint8_t*)&expected[0], compared);
+    bool viewerOk = compared > 0 && viewed.compare(viewed.size() - compared, compared, expected) == 0;
+    bool txOk = std::string(tx.begin(), tx.end()) == written;
+
+    bool ok = viewerOk && observerNotices == 1 && txOk && interactive == 0;
+    printf("client routing   : viewer %zu bytes of SBC%u %s, observer %s, uart tx %s, mux on SBC%d: %s\n",
+           viewed.size(), viewedChannel + 1, viewerOk ? "match" : "MISMATCH",
+           observerNotices == 1 ? "read-only" : "NOT REFUSED", txOk ? "writer only" : "MIXED", interactive + 1,
+           ok ? "OK" : "FAIL");
+    return ok;
+}
+
+int runScan(const Options& options) {
+    // Output rate of each simulated SBC in bytes/s (capped by the baud rate):
+    // a chatty interactive shell, a boot-log flood, a heartbeat, a silent board
+    // and a moderately busy one; any further channels print occasionally
+    const unsigned long lineRate = options.baud / 10;
+    unsigned long rates[MAX_CHANNELS];
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        static const unsigned long profile[] = {200, 1000000, 60, 0, 2000};
+        unsigned long rate = channel < 5 ? profile[channel] : 30;
+        rates[channel] = rate < lineRate ? rate : lineRate;
+    }
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    pipeline.serialBridge.setScanMode(true);
+
+    // A second client watches every channel over the channel protocol
+    const uint8_t CHANNEL_CLIENT = 1;
+    pipeline.webSocket->connect(CHANNEL_CLIENT, "/?proto=1");
+
+    // Client 0 types on SBC1 and holds its write lock; a third client watches
+    // the boot flood of SBC2 without moving the mux, a fourth one is a
+    // read-only observer of SBC1
+    const uint8_t VIEWER_CLIENT = 2;
+    const uint8_t OBSERVER_CLIENT = 3;
+    const uint8_t VIEWED_CHANNEL = 1;
+    const char WRITTEN[] = "\r";
+    pipeline.webSocket->receiveText(0, WRITTEN);
+    pipeline.webSocket->connect(VIEWER_CLIENT);
+    pipeline.webSocket->receiveText(VIEWER_CLIENT, "CHANNEL:1");
+    pipeline.webSocket->connect(OBSERVER_CLIENT);
+    pipeline.webSocket->receiveText(OBSERVER_CLIENT, "x");
+
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    unsigned long produced[MAX_CHANNELS] = {};
+    unsigned long lost[MAX_CHANNELS] = {};
+    unsigned long long credit[MAX_CHANNELS] = {};  // bytes * 1000 not yet emitted
+    unsigned long lineNumber[MAX_CHANNELS] = {};
+    std::string pending[MAX_CHANNELS];
+
+    unsigned long iterations = options.seconds * 1000 / LOOP_PERIOD_MS;
+    for (unsigned long i = 0; i < iterations; i++) {
+        int selected = selectedChannel();
+
+        for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+            credit[channel] += (unsigned long long)rates[channel] * LOOP_PERIOD_MS;
+            size_t count = credit[channel] / 1000;
+            credit[channel] -= count * 1000ULL;
+
+            for (size_t n = 0; n < count; n++) {
+                if (pending[channel].empty()) {
+                    char line[48];
+                    snprintf(line, sizeof(line), "SBC%d line %lu\r\n", channel + 1, lineNumber[channel]++);
+                    pending[channel] = line;
+                }
+                uint8_t byte = (uint8_t)pending[channel][0];
+                pending[channel].erase(0, 1);
+
+                produced[channel]++;
+                if (channel == selected) {
+                    uart.inject(&byte, 1);
+                } else {
+                    lost[channel]++;
+                }
+            }
+        }
+
+        pipeline.loop();
+    }
+
+    char report[768 + MAX_CHANNELS * 128];
+    pipeline.serialBridge.formatScanReport(report, sizeof(report));
+    printf("%s\n", report);
+    printf("channel  produced      lost  estimated\n");
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        ChannelStats stats = pipeline.multiplexer.getChannelStats(channel);
+        printf("SBC%-4d %9lu %9lu  %9lu\n", channel + 1, produced[channel], lost[channel], stats.bytesMissed);
+    }
+
+    // Let the viewer catch up with the end of the history
+    for (int i = 0; i < 16; i++) {
+        pipeline.webSocketServer.flushIfDue(true);
+    }
+
+    bool streamsOk = checkChannelStreams(*pipeline.webSocket, CHANNEL_CLIENT, pipeline.serialBridge.getScrollback());
+    bool routingOk = checkClientRouting(*pipeline.webSocket, VIEWER_CLIENT, VIEWED_CHANNEL, OBSERVER_CLIENT,
+                                        pipeline.serialBridge.getScrollback(), uart.tx, WRITTEN,
+                                        pipeline.multiplexer.getInteractiveChannel());
+    return streamsOk && routingOk ? 0 : 1;
+}
+
+/**
+ * U-Boot style prompt on the far end of the UART: a polled 16-byte receive
+ * FIFO, every character echoed, and no polling while a command runs after CR
+ */
+struct BootloaderTarget {
+    static const size_t FIFO_SIZE = 16;
+    static const uint64_t COMMAND_US = 3000;
+
+    std::deque<uint8_t> fifo;
+    uint64_t busyUntilUs = 0;
+    bool commandRunning = false;
+    size_t delivered = 0;  // Bytes of the bridge's tx stream that reached the target
+    std::string received;  // Characters the target read
+    size_t overflows = 0;
+
+    /**
+     * Deliver every byte that finished on the wire by nowUs
+     */
+    void advance(hal::native::FakeUart& uart, uint64_t nowUs) {
+        while (delivered < uart.tx.size() && uart.txDoneUs[delivered] <= nowUs) {
+            uint64_t arrivalUs = uart.txDoneUs[delivered];
+            poll(uart, arrivalUs);
+            uint8_t c = uart.tx[delivered++];
+            if (fifo.size() < FIFO_SIZE) {
+                fifo.push_back(c);
+            } else {
+                overflows++;
+            }
+            poll(uart, arrivalUs);
+        }
+        poll(uart, nowUs);
+    }
+
+    bool idle() const { return fifo.empty() && !commandRunning; }
+
+private:
+    void poll(hal::native::FakeUart& uart, uint64_t nowUs) {
+        if (commandRunning && nowUs >= busyUntilUs) {
+            commandRunning = false;
+            echo(uart, "ok\r\n=> ");
+        }
+        while (!commandRunning && !fifo.empty()) {
+            uint8_t c = fifo.front();
+            fifo.pop_front();
+            received += (char)c;
+            if (c == '\r') {
+                echo(uart, "\r\n");
+                commandRunning = true;
+                busyUntilUs = nowUs + COMMAND_US;
+            } else {
+                uart.inject(&c, 1);
+            }
+        }
+    }
+
+    void echo(hal::native::FakeUart& uart, const char* text) {
+        uart.inject((const uint8_t*)text, strlen(text));
+    }
+};
+
+/**
+ * One paste into the bootloader prompt at a given line rate and pacing
+ */
+struct PasteRound {
+    unsigned long baud;
+    unsigned long charDelayUs;
+    unsigned long lineDelayMs;
+    bool echoWait;
+    bool mustArrive;  // The pacing is enough for the target to read every character
+};
+
+/**
+ * Send the paste with the round's settings and run the task schedule until
+ * the target read everything the UART sent
+ * @return true if the round passed: sent in order, characters at least
+ *         char_us apart, and intact where the round requires it
+ */
+bool runPasteRound(Pipeline& pipeline, const std::string& paste, const PasteRound& round) {
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    SerialBridge& bridge = pipeline.serialBridge;
+
+    char command[64];
+    if (uart.getLineConfig().baud != round.baud) {
+        snprintf(command, sizeof(command), "LINE:0,%lu", round.baud);
+        pipeline.webSocket->receiveText(0, command);
+    }
+    snprintf(command, sizeof(command), "PACE:0,%lu,%lu,%u", round.charDelayUs, round.lineDelayMs,
+             round.echoWait ? 1u : 0u);
+    pipeline.webSocket->receiveText(0, command);
+    pipeline.webSocket->receiveText(0, paste.c_str());
+
+    BootloaderTarget target;
+    size_t first = uart.tx.size();
+    target.delivered = first;
+    unsigned long startMs = clock.millis();
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    const unsigned long TIMEOUT_MS = 120000;
+
+    // Task pipeline schedule on a 1 ms tick, the target polled in between
+    while ((bridge.pendingWrite(0) || target.delivered < uart.tx.size() || !target.idle()) &&
+           clock.millis() - startMs < TIMEOUT_MS) {
+        unsigned long now = clock.millis();
+        if (now >= nextPumpMs) {
+            bridge.pump();
+            nextPumpMs = now + UART_TASK_PERIOD_MS;
+        }
+        if (now >= nextNetworkMs) {
+            pipeline.webSocketServer.loop();
+            bridge.forward();
+            nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+        }
+        logger().drain(hal::console());
+        clock.delay(1);
+        target.advance(uart, clock.micros());
+    }
+
+    double seconds = (clock.millis() - startMs) / 1000.0;
+    bool sent = std::string(uart.tx.begin() + first, uart.tx.end()) == paste;
+    uint64_t spacingUs = UINT64_MAX;  // Closest two characters came, end to end
+    for (size_t i = first + 1; i < uart.tx.size(); i++) {
+        uint64_t gapUs = uart.txDoneUs[i] - uart.txDoneUs[i - 1];
+        if (gapUs < spacingUs) spacingUs = gapUs;
+    }
+    bool spaced = spacingUs >= round.charDelayUs;
+    bool intact = target.received == paste;
+
+    printf("%7lu %7lu %7lu  %-4s %7.2f %7.0f %8llu %6zu  %s%s%s\n", round.baud, round.charDelayUs,
+           round.lineDelayMs, round.echoWait ? "on" : "off", seconds, seconds > 0 ? paste.size() / seconds : 0.0,
+           (unsigned long long)spacingUs, target.overflows, intact ? "intact" : "CORRUPTED",
+           sent ? "" : ", UART TX INCOMPLETE", spaced ? "" : ", CHARACTERS TOO CLOSE");
+    return sent && spaced && (intact || !round.mustArrive);
+}
+
+int runPaste(const Options& options) {
+    // A U-Boot environment script, one command per CR as a browser paste sends it
+    size_t bytes = options.bytes < TX_QUEUE_SIZE ? options.bytes : TX_QUEUE_SIZE;
+    std::string paste;
+    for (unsigned line = 0; paste.size() < bytes; line++) {
+        char command[96];
+        snprintf(command, sizeof(command), "setenv bootargs_%u console=ttyS0,115200 root=/dev/mmcblk0p%u rw\r",
+                 line, line % 4 + 1);
+        paste += command;
+    }
+    paste.resize(bytes);
+
+    // The target reads FIFO_SIZE characters per command it runs, so char_us
+    // has to cover COMMAND_US / FIFO_SIZE (188 us) on its own; below that it
+    // loses characters however they are spaced, and those rounds only check
+    // the spacing. Unpaced is the baseline that shows what pacing is for.
+    const unsigned long FAST_BAUD = 921600;
+    const unsigned long NEEDED_US = (BootloaderTarget::COMMAND_US + BootloaderTarget::FIFO_SIZE - 1) /
+                                    BootloaderTarget::FIFO_SIZE;
+    std::vector<PasteRound> rounds;
+    if (options.pacingGiven) {
+        bool paced = options.charDelayUs > 0 || options.lineDelayMs > 0 || options.echoWait;
+        rounds.push_back({options.baud, options.charDelayUs, options.lineDelayMs, options.echoWait, paced});
+    } else {
+        rounds.push_back({options.baud, 0, 0, false, false});
+        rounds.push_back({options.baud, 200, 0, false, true});
+        rounds.push_back({options.baud, 100, 0, false, false});
+        rounds.push_back({options.baud, 10000, 0, false, true});  // Longer than the UART's idle gap holds
+        rounds.push_back({options.baud, 0, 20, false, true});
+        rounds.push_back({options.baud, 0, 0, true, true});
+        rounds.push_back({FAST_BAUD, 200, 0, false, true});
+        rounds.push_back({FAST_BAUD, 20, 0, false, false});
+    }
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+
+    size_t lines = 0;
+    for (char c : paste) {
+        if (c == '\r') lines++;
+    }
+    printf("paste            : %zu bytes, %zu lines\n", paste.size(), lines);
+    printf("target           : %zu-byte FIFO, deaf %llu us per command (char_us from %lu us)\n",
+           BootloaderTarget::FIFO_SIZE, (unsigned long long)BootloaderTarget::COMMAND_US, NEEDED_US);
+    printf("   baud char_us line_ms  echo       s chars/s  spacing   lost  script\n");
+    bool ok = true;
+    for (const PasteRound& round : rounds) {
+        ok = runPasteRound(pipeline, paste, round) && ok;
+    }
+    return ok ? 0 : 1;
+}
+
+/**
+ * One HTTP response parsed back out of a connection's output
+ */
+struct HttpResponse {
+    int status = 0;
+    std::string etag;
+    std::string body;
+};
+
+/**
+ * Split everything written to a connection into responses (Content-Length
+ * framing, as a keep-alive client reads them)
+ */
+std::vector<HttpResponse> parseResponses(const std::string& output) {
+    std::vector<HttpResponse> responses;
+    size_t position = 0;
+    while (position < output.size()) {
+        size_t headerEnd = output.find("\r\n\r\n", position);
+        if (headerEnd == std::string::npos) break;
+        std::string header = output.substr(position, headerEnd - position);
+
+        HttpResponse response;
+        response.status = atoi(header.c_str() + strlen("HTTP/1.1 "));
+        if (header.find("Transfer-Encoding: chunked") != std::string::npos) {
+            // Chunks up to the empty last one
+            size_t chunk = headerEnd + 4;
+            bool complete = false;
+            while (!complete) {
+                size_t lineEnd = output.find("\r\n", chunk);
+                if (lineEnd == std::string::npos) break;
+                size_t length = strtoul(output.c_str() + chunk, nullptr, 16);
+                if (lineEnd + 2 + length + 2 > output.size()) break;
+                response.body.append(output, lineEnd + 2, length);
+                chunk = lineEnd + 2 + length + 2;
+                complete = length == 0;
+            }
+            if (!complete) break;   // Still arriving
+            position = chunk;
+            responses.push_back(response);
+            continue;
+        }
+        size_t length = 0;
+        size_t field = header.find("Content-Length: ");
+        if (field != std::string::npos) {
+            length = strtoul(header.c_str() + field + strlen("Content-Length: "), nullptr, 10);
+        }
+        field = header.find("ETag: ");
+        if (field != std::string::npos) {
+            size_t start = field + strlen("ETag: ");
+            response.etag = header.substr(start, header.find("\r\n", start) - start);
+        }
+        position = headerEnd + 4;
+        if (response.status == 304) {
+            length = 0;
+        }
+        if (position + length > output.size()) break;  // Still arriving
+        response.body = output.substr(position, length);
+        position += length;
+        responses.push_back(response);
+    }
+    return responses;
+}
+
+int runHttp(const Options& options) {
+    // The web UI: an HTML page, a large gzipped script and a stylesheet
+    hal::native::MemoryFileSystem& files = hal::native::memoryFileSystem();
+    std::string page = "<html>" + std::string(6000, 'p') + "</html>";
+    std::string script(options.bytes < 65536 ? options.bytes : 65536, '\0');
+    for (size_t i = 0; i < script.size(); i++) {
+        script[i] = (char)(i * 131 + (i >> 7));
+    }
+    std::string style(3000, 's');
+    files.addFile("/index.html", page.c_str());
+    files.files["/script.js.gz"].assign(script.begin(), script.end());
+    files.addFile("/style.css", style.c_str());
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    hal::native::FakeTcpServer* server = hal::native::tcpServerOnPort(HTTP_PORT);
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    SerialBridge& bridge = pipeline.serialBridge;
+    std::string boot = syntheticBootLog(options.baud / 10 * 2);
+
+    // A first visit pipelines the three assets on one connection; the reload
+    // revalidates them with their ETags and then asks for a missing file
+    hal::native::FakeTcpConnection* first = server->queueConnection(
+        "GET / HTTP/1.1\r\nHost: esp32\r\n\r\n"
+        "GET /script.js HTTP/1.1\r\nHost: esp32\r\nAccept-Encoding: gzip\r\n\r\n"
+        "GET /style.css?v=2 HTTP/1.1\r\nHost: esp32\r\n\r\n");
+    hal::native::FakeTcpConnection* reload = nullptr;
+    std::vector<HttpResponse> loaded;
+    std::vector<HttpResponse> revalidated;
+
+    size_t fed = 0;
+    size_t passes = 0;
+    size_t maxPassBytes = 0;
+    unsigned long loadMs = 0;
+    unsigned long reloadMs = 0;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    const unsigned long TIMEOUT_MS = 10000;
+
+    // Task pipeline schedule on a 1 ms tick, the SBC talking at line rate
+    while (clock.millis() < TIMEOUT_MS) {
+        unsigned long now = clock.millis();
+        size_t count = options.baud / 10 / 1000;
+        if (count > boot.size() - fed) count = boot.size() - fed;
+        uart.inject((const uint8_t*)boot.data() + fed, count);
+        fed += count;
+
+        if (now >= nextPumpMs) {
+            bridge.pump();
+            nextPumpMs = now + UART_TASK_PERIOD_MS;
+        }
+        if (now >= nextNetworkMs) {
+            size_t before = first->output.size() + (reload ? reload->output.size() : 0);
+            pipeline.webSocketServer.loop();
+            bridge.forward();
+            size_t written = first->output.size() + (reload ? reload->output.size() : 0) - before;
+            if (written > maxPassBytes) maxPassBytes = written;
+            passes++;
+            nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+        }
+        logger().drain(hal::console());
+        clock.delay(1);
+
+        if (!reload && parseResponses(first->output).size() == 3) {
+            loaded = parseResponses(first->output);
+            loadMs = clock.millis();
+            std::string request;
+            const char* paths[] = {"/", "/script.js", "/style.css"};
+            for (size_t i = 0; i < loaded.size(); i++) {
+                request += std::string("GET ") + paths[i] + " HTTP/1.1\r\nIf-None-Match: " + loaded[i].etag + "\r\n\r\n";
+            }
+            request += "GET /missing.js HTTP/1.1\r\nConnection: close\r\n\r\n";
+            reload = server->queueConnection(request.c_str());
+        }
+        if (reload && !reload->open && revalidated.empty()) {
+            revalidated = parseResponses(reload->output);
+            reloadMs = clock.millis() - loadMs;
+        }
+        if (!revalidated.empty() && fed == boot.size() && !bridge.pendingForward(0)) {
+            break;
+        }
+    }
+    pipeline.webSocketServer.flushBuffer();
+
+    // Targets too long for the path buffer or for a request line are refused,
+    // not served as the page the truncated path would name
+    std::string longPath = "GET /" + std::string(200, 'a') + " HTTP/1.1\r\n\r\n";
+    std::string longLine = "GET /" + std::string(400, 'a') + " HTTP/1.1\r\n\r\n";
+    hal::native::FakeTcpConnection* tooLong[] = {server->queueConnection(longPath.c_str()),
+                                                  server->queueConnection(longLine.c_str())};
+    for (int pass = 0; pass < 20 && (tooLong[0]->open || tooLong[1]->open); pass++) {
+        pipeline.webSocketServer.loop();
+        clock.delay(NETWORK_TASK_PERIOD_MS);
+    }
+    bool refused = true;
+    for (hal::native::FakeTcpConnection* connection : tooLong) {
+        std::vector<HttpResponse> responses = parseResponses(connection->output);
+        refused = refused && !connection->open && responses.size() == 1 && responses[0].status == 414;
+    }
+
+    // Embedded assets (web_assets_data.h) take precedence over LittleFS
+    const char* assetPaths[] = {"/index.html", "/script.js", "/style.css"};
+    const std::string* fileBodies[] = {&page, &script, &style};
+    size_t embedded = 0;
+    bool bodies = loaded.size() == 3;
+    for (size_t i = 0; bodies && i < 3; i++) {
+        const WebAsset* asset = WEB_ASSETS_LITTLEFS_OVERRIDE ? nullptr : findWebAsset(assetPaths[i]);
+        std::string expectedBody = asset ? std::string((const char*)asset->data, asset->length) : *fileBodies[i];
+        bodies = loaded[i].status == 200 && loaded[i].body == expectedBody;
+        if (asset) embedded++;
+    }
+    bool etags = bodies && !loaded[0].etag.empty() && loaded[0].etag != loaded[1].etag;
+    bool notModified = revalidated.size() == 4 && revalidated[0].status == 304 && revalidated[1].status == 304 &&
+                       revalidated[2].status == 304 && revalidated[3].status == 404;
+    bool keepAlive = first->open && !reload->open;
+    std::string expected;
+    for (char c : boot) {
+        if (c != 0) expected += c;
+    }
+    bool intact = pipeline.webSocket->capturedPayload() == expected;
+
+    size_t bodyBytes = 0;
+    for (const HttpResponse& response : loaded) {
+        bodyBytes += response.body.size();
+    }
+    printf("first visit      : %zu responses on one connection, %zu body bytes in %lu ms, %s\n", loaded.size(),
+           bodyBytes, loadMs, bodies ? "bodies OK" : "BODIES WRONG");
+    printf("sources          : %zu embedded (%zu in firmware), %zu from LittleFS\n", embedded, webAssetCount(),
+           loaded.size() - embedded);
+    printf("etags            : %s / %s / %s\n", bodies ? loaded[0].etag.c_str() : "-",
+           bodies ? loaded[1].etag.c_str() : "-", bodies ? loaded[2].etag.c_str() : "-");
+    printf("reload           : %zu responses in %lu ms, %s\n", revalidated.size(), reloadMs,
+           notModified ? "304 x3 then 404: OK" : "UNEXPECTED STATUS");
+    printf("connections      : keep-alive %s, close on request %s\n", first->open ? "kept" : "CLOSED",
+           reload && !reload->open ? "closed" : "OPEN");
+    printf("network passes   : %zu, max %zu HTTP bytes per pass (chunk %u + headers)\n", passes, maxPassBytes,
+           (unsigned)HTTP_CHUNK_SIZE);
+    printf("forward latency  : avg %lu us, max %lu us during the page load\n",
+           bridge.getForwardLatency().getMeanUs(), bridge.getForwardLatency().getMaxUs());
+    printf("long targets     : %s\n", refused ? "414 and closed: OK" : "NOT REFUSED");
+    printf("payload integrity: %s\n", intact ? "OK" : "MISMATCH");
+    return bodies && etags && notModified && keepAlive && refused && intact ? 0 : 1;
+}
+
+/**
+ * The per-flush check WebSocketServer used before the streaming validator:
+ * rescans the whole buffer and rejects a character cut by the buffer end
+ */
+bool legacyIsValidUtf8(const uint8_t* data, size_t length) {
+    for (size_t i = 0; i < length; ) {
+        uint8_t byte = data[i];
+
+        if (byte <= 0x7F) {
+            i++;
+        } else if ((byte & 0xE0) == 0xC0) {
+            if (i + 1 >= length || (data[i + 1] & 0xC0) != 0x80) return false;
+            i += 2;
+        } else if ((byte & 0xF0) == 0xE0) {
+            if (i + 2 >= length || (data[i + 1] & 0xC0) != 0x80 || (data[i + 2] & 0xC0) != 0x80) return false;
+            i += 3;
+        } else if ((byte & 0xF8) == 0xF0) {
+            if (i + 3 >= length || (data[i + 1] & 0xC0) != 0x80 || (data[i + 2] & 0xC0) != 0x80 || (data[i + 3] & 0xC0) != 0x80) return false;
+            i += 4;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Validate input in flush-sized pieces with both validators
+ */
+void benchUtf8(const char* label, const std::string& input) {
+    const size_t FLUSH_SIZE = 256;
+    const int PASSES = 20;
+    const uint8_t* data = (const uint8_t*)input.data();
+
+    size_t legacyBinary = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < PASSES; pass++) {
+        legacyBinary = 0;
+        for (size_t offset = 0; offset < input.size(); offset += FLUSH_SIZE) {
+            size_t length = input.size() - offset < FLUSH_SIZE ? input.size() - offset : FLUSH_SIZE;
+            legacyBinary += legacyIsValidUtf8(data + offset, length) ? 0 : 1;
+        }
+    }
+    double legacySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t heldBack = 0;
+    bool valid = true;
+    start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < PASSES; pass++) {
+        Utf8Validator validator;
+        heldBack = 0;
+        for (size_t offset = 0; offset < input.size(); offset += FLUSH_SIZE) {
+            size_t length = input.size() - offset < FLUSH_SIZE ? input.size() - offset : FLUSH_SIZE;
+            validator.feed(data + offset, length);
+            heldBack += validator.pending() ? 1 : 0;
+        }
+        valid = validator.isValid();
+    }
+    double streamSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double megabytes = (double)input.size() * PASSES / 1e6;
+    size_t flushes = (input.size() + FLUSH_SIZE - 1) / FLUSH_SIZE;
+    printf("%s (%zu bytes, %zu flushes of %zu)\n", label, input.size(), flushes, FLUSH_SIZE);
+    printf("  whole-buffer check : %8.1f MB/s, %zu frames sent as binary\n", megabytes / legacySeconds, legacyBinary);
+    printf("  streaming validator: %8.1f MB/s, %zu frames held back a partial character, stream %s\n",
+           megabytes / streamSeconds, heldBack, valid ? "valid" : "INVALID");
+}
+
+/**
+ * Switch between every ordered pair of a layout's channels and check that
+ * each switch is one GPIO write landing on the right address. Also count
+ * the transitions that would pass through a third channel if the control
+ * lines were written one at a time, as the controller used to.
+ * @param expectChannel, expectLevels One channel and the pin levels it must produce
+ */
+template <typename Layout>
+bool checkMuxLayout(const char* name, uint8_t expectChannel, uint32_t expectLevels) {
+    hal::native::FakeGpio& gpio = hal::native::fakeGpio();
+    gpio.writes.clear();
+    Layout::configure(gpio);
+    // All lines high: the last address, or no chip enabled when cascaded
+    bool ok = Layout::decode(gpio.levels()) == (Layout::MASK == Layout::LEVELS[Layout::CHANNELS - 1] ?
+                                                Layout::CHANNELS - 1 : -1);
+
+    size_t transitions = 0, singleWrites = 0, glitches = 0;
+    for (uint8_t from = 0; from < Layout::CHANNELS; from++) {
+        for (uint8_t to = 0; to < Layout::CHANNELS; to++) {
+            if (from == to) continue;
+            Layout::select(gpio, from);
+            gpio.writes.clear();
+            Layout::select(gpio, to);
+            transitions++;
+            if (gpio.writes.size() == 1 && Layout::decode(gpio.levels()) == to) singleWrites++;
+
+            // Pin by pin, lowest GPIO first
+            uint32_t levels = Layout::LEVELS[from];
+            bool glitch = false;
+            for (uint8_t pin = 0; pin < 32; pin++) {
+                uint32_t bit = 1u << pin;
+                if (!(Layout::MASK & bit) || (levels & bit) == (Layout::LEVELS[to] & bit)) continue;
+                levels ^= bit;
+                int seen = Layout::decode(levels);
+                if (levels != Layout::LEVELS[to] && seen >= 0) glitch = true;
+            }
+            if (glitch) glitches++;
+        }
+    }
+    ok = ok && singleWrites == transitions && Layout::LEVELS[expectChannel] == expectLevels;
+
+    printf("%-20s %8u %8zu %14zu %18zu   %s\n", name, (unsigned)Layout::CHANNELS, transitions, singleWrites,
+           glitches, ok ? "OK" : "FAIL");
+    return ok;
+}
+
+int runMuxPins() {
+    printf("layout               channels switches  single writes  pin-by-pin glitches\n");
+    bool ok = true;
+    ok &= checkMuxLayout<BoardMuxLayout>("board (pins.h)", 0, BoardMuxLayout::levelsFor(0));
+    ok &= checkMuxLayout<Hp4067Layout<3, 4, 9, 10>>("HP4067", 11, (1u << 3) | (1u << 4) | (1u << 10));
+    ok &= checkMuxLayout<Hc4051Layout<3, 4, 9>>("74HC4051", 5, (1u << 3) | (1u << 9));
+    // Channel 17: address 1 on the second chip, whose enable (GPIO7) is low
+    ok &= checkMuxLayout<Cascaded4067Layout<3, 4, 9, 10, 2, 7>>("2x 4067 cascaded", 17, (1u << 3) | (1u << 2));
+
+    // The controller drives the board layout the same way
+    hal::native::FakeGpio& gpio = hal::native::fakeGpio();
+    MultiplexerController multiplexer;
+    multiplexer.init();
+    size_t switches = 0, writes = 0;
+    bool routed = true;
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        gpio.writes.clear();
+        multiplexer.selectChannel(channel);
+        switches++;
+        writes += gpio.writes.size();
+        routed = routed && BoardMuxLayout::decode(gpio.levels()) == channel;
+    }
+    bool controllerOk = routed && writes == switches;
+    printf("controller           : %zu switches, %zu GPIO writes, %s\n", switches, writes,
+           controllerOk ? "routed OK" : "WRONG");
+    return ok && controllerOk ? 0 : 1;
+}
+
+int runSwitch(const Options& options) {
+    // Output rate of each SBC in bytes/s: floods at line rate, steady talkers
+    // and a quiet one; each prints lines of its own letter
+    const unsigned long lineRate = options.baud / 10;
+    unsigned long rates[MAX_CHANNELS];
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        static const unsigned long profile[] = {1000000, 3000, 500, 1000000, 100};
+        unsigned long rate = channel < 5 ? profile[channel] : 200;
+        rates[channel] = rate < lineRate ? rate : lineRate;
+    }
+    auto letter = [](int channel) { return (uint8_t)('a' + channel % 26); };
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    SerialBridge& bridge = pipeline.serialBridge;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+
+    // One step per character time on the wire
+    const unsigned long charUs = 10000000UL / options.baud;
+    unsigned long long credit[MAX_CHANNELS] = {};  // bytes * 1000000 not yet emitted
+    unsigned long column[MAX_CHANNELS] = {};
+    std::vector<uint8_t> fifo;
+    unsigned long idleChars = 0;
+    unsigned long nextPumpUs = 0, nextNetworkUs = 0, nextHopUs = options.hopMs * 1000UL;
+    unsigned long hops = 0, blockedUs = 0;
+    uint8_t target = 0;
+
+    const unsigned long endUs = options.seconds * 1000000UL;
+    while (clock.micros() < endUs) {
+        int selected = selectedChannel();
+        bool sent = false;
+        for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+            credit[channel] += (unsigned long long)rates[channel] * charUs;
+            if (credit[channel] < 1000000) continue;
+            credit[channel] -= 1000000;
+
+            uint8_t byte = column[channel] == 40 ? '\r' : column[channel] == 41 ? '\n' : letter(channel);
+            column[channel] = (column[channel] + 1) % 42;
+            if (channel == selected) {
+                fifo.push_back(byte);
+                sent = true;
+            }
+        }
+
+        // The FIFO is handed over at its threshold, or once the line idles
+        idleChars = sent ? 0 : idleChars + 1;
+        if (fifo.size() >= UART_RX_FIFO_THRESHOLD || (!fifo.empty() && idleChars >= UART_RX_TIMEOUT_SYMBOLS)) {
+            uart.inject(fifo.data(), fifo.size());
+            fifo.clear();
+        }
+
+        unsigned long now = clock.micros();
+        if (now >= nextHopUs) {
+            target = (uint8_t)((target + 3) % MAX_CHANNELS);
+            char command[16];
+            snprintf(command, sizeof(command), "CHANNEL:%u", target);
+            pipeline.webSocket->receiveText(0, command);
+            blockedUs += clock.micros() - now;
+            hops++;
+            nextHopUs = now + options.hopMs * 1000UL;
+        }
+        if (now >= nextPumpUs) {
+            bridge.pump();
+            nextPumpUs = now + UART_TASK_PERIOD_MS * 1000UL;
+        }
+        if (now >= nextNetworkUs) {
+            pipeline.webSocketServer.loop();
+            bridge.forward();
+            nextNetworkUs = now + NETWORK_TASK_PERIOD_MS * 1000UL;
+        }
+        logger().drain(hal::console());
+        clock.advanceMicros(charUs);
+    }
+
+    // Every byte in a channel's history must be its own letter or a line end
+    const Scrollback& history = bridge.getScrollback();
+    unsigned long misattributed = 0, captured = 0;
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        uint8_t chunk[256];
+        size_t offset = 0, count;
+        while ((count = history.copy(channel, offset, chunk, sizeof(chunk))) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                if (chunk[i] != letter(channel) && chunk[i] != '\r' && chunk[i] != '\n') misattributed++;
+            }
+            offset += count;
+            captured += count;
+        }
+    }
+
+    const LatencyStats& latency = bridge.getSwitchLatency();
+    bool ok = misattributed == 0 && blockedUs == 0 && latency.getCount() > 0;
+    printf("baud             : %lu, hop every %lu ms, %.1f s simulated\n", options.baud, options.hopMs,
+           clock.millis() / 1000.0);
+    printf("switches         : %lu, %lu us spent inside the switch calls\n", hops, blockedUs);
+    printf("first byte       : avg %lu us, max %lu us (%lu switches sampled)\n", latency.getMeanUs(),
+           latency.getMaxUs(), latency.getCount());
+    printf("fenced           : %lu bytes dropped while the mux settled\n", uart.getStats().fencedBytes);
+    printf("attribution      : %lu bytes in the scrollback, %lu from another channel, %s\n", captured,
+           misattributed, ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * TX line of an SBC: characters back to back at its rate and format, with a
+ * pause after each line end, kept as level changes in time
+ */
+struct SbcLine {
+    struct Edge {
+        uint64_t ns;
+        bool level;     // Level from ns on
+    };
+
+    std::string text;
+    size_t position = 0;
+    hal::LineConfig config;
+    uint64_t nextCharNs = 0;
+    bool level = true;          // Idle high
+    std::deque<Edge> edges;
+
+    /**
+     * Print every character that starts before untilNs
+     */
+    void extend(uint64_t untilNs) {
+        const uint64_t bitNs = 1000000000ULL / config.baud;
+        while (nextCharNs < untilNs) {
+            uint8_t c = (uint8_t)text[position++ % text.size()];
+            bool bits[12];
+            size_t count = 0;
+            bits[count++] = false;
+            bool parity = config.parity == hal::Parity::Odd;
+            for (uint8_t i = 0; i < config.dataBits; i++) {
+                bits[count++] = (c >> i) & 1;
+                parity ^= (c >> i) & 1;
+            }
+            if (config.parity != hal::Parity::None) bits[count++] = parity;
+            for (uint8_t i = 0; i < config.stopBits; i++) bits[count++] = true;
+
+            uint64_t t = nextCharNs;
+            for (size_t i = 0; i < count; i++, t += bitNs) {
+                if (bits[i] != level) {
+                    level = bits[i];
+                    edges.push_back({t, level});
+                }
+            }
+            nextCharNs = t + (c == '\n' ? 200 * bitNs : 0);
+        }
+    }
+
+    bool levelAt(uint64_t ns) const {
+        auto it = std::upper_bound(edges.begin(), edges.end(), ns,
+                                   [](uint64_t value, const Edge& edge) { return value < edge.ns; });
+        return it == edges.begin() ? true : (it - 1)->level;
+    }
+
+    /**
+     * Forget edges before ns, keeping the one that sets the level at ns
+     */
+    void trim(uint64_t ns) {
+        while (edges.size() > 1 && edges[1].ns <= ns) edges.pop_front();
+    }
+};
+
+/**
+ * UART receiver sampling an SbcLine at its own settings: a falling edge
+ * starts a character, every bit is sampled in its middle, and a low stop bit
+ * or a wrong parity bit is a framing error (the byte is still delivered)
+ */
+struct LineReceiver {
+    uint64_t cursorNs = 0;      // Idle, waiting for a start bit, from here
+
+    /**
+     * Receive every character that ends before untilNs
+     */
+    void run(const SbcLine& line, const hal::LineConfig& config, uint64_t untilNs, std::vector<uint8_t>& bytes,
+             unsigned long& errors) {
+        const uint64_t bitNs = 1000000000ULL / config.baud;
+        const unsigned frameBits = 1 + config.dataBits + (config.parity != hal::Parity::None ? 1 : 0);
+        while (true) {
+            auto it = std::lower_bound(line.edges.begin(), line.edges.end(), cursorNs,
+                                       [](const SbcLine::Edge& edge, uint64_t value) { return edge.ns < value; });
+            while (it != line.edges.end() && it->level) ++it;
+            if (it == line.edges.end()) {
+                cursorNs = untilNs > cursorNs ? untilNs : cursorNs;
+                return;
+            }
+            uint64_t start = it->ns;
+            uint64_t stopNs = start + frameBits * bitNs + bitNs / 2;
+            if (stopNs > untilNs) {
+                cursorNs = start;
+                return;
+            }
+            if (line.levelAt(start + bitNs / 2)) {
+                cursorNs = start + bitNs / 2;  // Glitch, not a start bit
+                continue;
+            }
+
+            uint8_t c = 0;
+            bool parity = config.parity == hal::Parity::Odd;
+            for (uint8_t i = 0; i < config.dataBits; i++) {
+                bool bit = line.levelAt(start + (1 + i) * bitNs + bitNs / 2);
+                c |= (uint8_t)(bit << i);
+                parity ^= bit;
+            }
+            bool bad = !line.levelAt(stopNs);
+            if (config.parity != hal::Parity::None) {
+                bad = bad || line.levelAt(start + (1 + config.dataBits) * bitNs + bitNs / 2) != parity;
+            }
+            bytes.push_back(c);
+            if (bad) errors++;
+            cursorNs = stopNs;
+        }
+    }
+};
+
+int runAutoBaud(const Options& options) {
+    std::string text;
+    if (options.replayPath) {
+        std::ifstream file(options.replayPath, std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", options.replayPath);
+            return 2;
+        }
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        text = syntheticBootLog(64 * 1024);
+    }
+    if (text.empty()) {
+        fprintf(stderr, "nothing to replay\n");
+        return 2;
+    }
+    bool alphabet[256] = {};
+    for (char c : text) {
+        alphabet[(uint8_t)c] = true;
+    }
+
+    Pipeline pipeline;
+    if (!pipeline.init(UART_BAUD_RATE)) {
+        return 1;
+    }
+    SerialBridge& bridge = pipeline.serialBridge;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    uart.pulseMeasurement = options.pulses;
+
+    // Each SBC prints the text from its own offset
+    static const unsigned long profile[] = {115200, 1500000, 9600, 921600, 74880};
+    SbcLine lines[MAX_CHANNELS];
+    LineReceiver receivers[MAX_CHANNELS];
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        lines[channel].text = text;
+        lines[channel].position = channel * 997 % text.size();
+        lines[channel].config.baud = channel < 5 ? profile[channel] : 230400;
+        if (channel == 1) lines[channel].config.parity = hal::Parity::Even;
+    }
+
+    int lastSelected = -1;
+    uint64_t lastNs = 0;
+    unsigned long nextPumpUs = 0, nextNetworkUs = 0;
+    auto run = [&](unsigned long ms, int until) {
+        // Advance in 100 us steps; until >= 0 stops once that channel is locked
+        const unsigned long endUs = clock.micros() + ms * 1000UL;
+        while (clock.micros() < endUs) {
+            if (until >= 0 && !bridge.isDetectingBaud((uint8_t)until)) return true;
+            uint64_t nowNs = (uint64_t)clock.micros() * 1000;
+            int selected = selectedChannel();
+            for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+                lines[channel].extend(nowNs);
+            }
+            if (selected >= 0) {
+                SbcLine& line = lines[selected];
+                LineReceiver& receiver = receivers[selected];
+                if (selected != lastSelected) {
+                    receiver.cursorNs = nowNs;  // The mux just connected this line
+                }
+                std::vector<uint8_t> bytes;
+                unsigned long errors = 0;
+                receiver.run(line, uart.getLineConfig(), nowNs, bytes, errors);
+                if (!bytes.empty()) {
+                    uart.inject(bytes.data(), bytes.size());
+                }
+                uart.injectFramingErrors(errors);
+
+                // The pulse counters see every edge on the connected line
+                for (size_t i = 1; i < line.edges.size(); i++) {
+                    if (line.edges[i].ns > lastNs && line.edges[i].ns <= nowNs) {
+                        uart.notePulse((unsigned long)(line.edges[i].ns - line.edges[i - 1].ns));
+                    }
+                }
+            }
+            for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+                uint64_t keep = channel == selected ? receivers[channel].cursorNs : nowNs;
+                lines[channel].trim(keep < lastNs ? keep : lastNs);
+            }
+            lastSelected = selected;
+            lastNs = nowNs;
+
+            unsigned long now = clock.micros();
+            if (now >= nextPumpUs) {
+                bridge.pump();
+                nextPumpUs = now + UART_TASK_PERIOD_MS * 1000UL;
+            }
+            if (now >= nextNetworkUs) {
+                pipeline.webSocketServer.loop();
+                bridge.forward();
+                nextNetworkUs = now + NETWORK_TASK_PERIOD_MS * 1000UL;
+            }
+            logger().drain(hal::console());
+            clock.advanceMicros(100);
+        }
+        return until < 0;
+    };
+    auto send = [&](const char* format, int channel, const char* settings) {
+        char command[48];
+        snprintf(command, sizeof(command), format, channel, settings);
+        pipeline.webSocket->receiveText(0, command);
+    };
+    auto formatOf = [](const hal::LineConfig& config) {
+        char format[4];
+        formatLineFormat(format, config);
+        return std::string(format);
+    };
+
+    // Fixed settings, applied on every switch
+    bool ok = true;
+    printf("fixed settings   :");
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        char settings[24];
+        snprintf(settings, sizeof(settings), "%lu,%s", lines[channel].config.baud,
+                 formatOf(lines[channel].config).c_str());
+        send("LINE:%d,%s", channel, settings);
+    }
+    size_t hops = 0, applied = 0;
+    for (int round = 0; round < 2; round++) {
+        for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+            send("CHANNEL:%d%s", channel, "");
+            run(300, -1);
+            hops++;
+            if (uart.getLineConfig() == lines[channel].config) applied++;
+        }
+    }
+    printf(" %zu switches, settings applied on %zu\n", hops, applied);
+    ok = ok && applied == hops;
+
+    // Auto-baud from a wrong rate
+    printf("channel  line             detected       lock\n");
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        std::string format = formatOf(lines[channel].config);
+        send("LINE:%d,%s", channel, ("115200," + format).c_str());
+        send("LINE:%d,%s", channel, ("AUTO," + format).c_str());
+        unsigned long startMs = clock.millis();
+        send("CHANNEL:%d%s", channel, "");
+        bool locked = run(3000, channel);
+        unsigned long lockMs = clock.millis() - startMs;
+        run(300, -1);
+
+        LineSettings settings = bridge.getLineSettings((uint8_t)channel);
+        bool right = locked && settings.config.baud == lines[channel].config.baud;
+        ok = ok && right;
+        printf("SBC%-4d %8lu %s  %8lu %s  %5lu ms  %s\n", channel + 1, lines[channel].config.baud, format.c_str(),
+               settings.config.baud, formatOf(settings.config).c_str(), lockMs, right ? "OK" : "WRONG");
+    }
+
+    // Garbage from a wrong rate must never reach the scrollback
+    const Scrollback& history = bridge.getScrollback();
+    unsigned long captured = 0, foreign = 0;
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        uint8_t chunk[256];
+        size_t offset = 0, count;
+        while ((count = history.copy(channel, offset, chunk, sizeof(chunk))) > 0) {
+            for (size_t i = 0; i < count; i++) {
+                if (!alphabet[chunk[i]]) foreign++;
+            }
+            offset += count;
+            captured += count;
+        }
+    }
+    ok = ok && foreign == 0 && captured > 0;
+    printf("scrollback       : %lu bytes, %lu not in the printed text (framing errors %lu, fenced %lu)\n",
+           captured, foreign, uart.getStats().framingErrors, uart.getStats().fencedBytes);
+    printf("auto-baud        : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Shell session output: command lines and counters that change from line to
+ * line, so it compresses less well than a boot log
+ */
+std::string shellSession(size_t bytes) {
+    std::string text;
+    char line[96];
+    for (unsigned long i = 0; text.size() < bytes; i++) {
+        snprintf(line, sizeof(line), i % 8 == 0 ? "root@sbc2:~# ip -s link show eth0\r\n"
+                                                : "    RX: %lu bytes %lu packets  TX: %lu bytes\r\n",
+                 i * 1517 + 40960, i * 3 + 7, i * 911);
+        text += line;
+    }
+    text.resize(bytes);
+    return text;
+}
+
+/**
+ * One asciicast v2 event line, decoded
+ */
+struct CastEvent {
+    double time = 0;
+    std::string text;
+};
+
+/**
+ * Parse an asciicast v2 file: the header line, then [time, "o", "text"]
+ * events (only the escapes RecordingExport produces are decoded)
+ * @return false if a line is malformed
+ */
+bool parseCast(const std::string& cast, std::vector<CastEvent>& events) {
+    size_t position = cast.find('\n');
+    if (cast.compare(0, 13, "{\"version\": 2") != 0 || position == std::string::npos) return false;
+    for (position++; position < cast.size(); ) {
+        size_t end = cast.find('\n', position);
+        if (end == std::string::npos || cast[position] != '[') return false;
+        CastEvent event;
+        event.time = strtod(cast.c_str() + position + 1, nullptr);
+        size_t text = cast.find(", \"o\", \"", position);
+        if (text == std::string::npos || text > end) return false;
+        for (size_t i = text + 8; i < end - 2; i++) {
+            char c = cast[i];
+            if (c != '\\') {
+                event.text += c;
+                continue;
+            }
+            c = cast[++i];
+            if (c == 'n') {
+                event.text += '\n';
+            } else if (c == 'r') {
+                event.text += '\r';
+            } else if (c == 'u') {
+                event.text += (char)strtoul(cast.substr(i + 1, 4).c_str(), nullptr, 16);
+                i += 4;
+            } else {
+                event.text += c;
+            }
+        }
+        events.push_back(event);
+        position = end + 1;
+    }
+    return true;
+}
+
+int runRecord(const Options& options) {
+    // Typical 4 KB sector erase and 256-byte page program of the C3's flash
+    hal::native::MemoryFileSystem& files = hal::native::memoryFileSystem();
+    files.sectorEraseUs = 45000;
+    files.pageProgramUs = 700;
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    SerialBridge& bridge = pipeline.serialBridge;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    static SessionRecorder recorders[2];   // Before and after the reboot
+
+    // SBC1 talks for the first half of the run, SBC2 for the second; each
+    // burst is followed by a pause, as a console does between commands
+    const std::string texts[2] = {syntheticBootLog(4 << 20), shellSession(4 << 20)};
+    size_t fed[2] = {};
+    std::string expected[2];
+    std::string fifo;                   // Waiting in the RX FIFO while the CPU is halted
+    size_t lost = 0;
+    size_t lostInOutput = 0;            // In a commit begun while fast output was flowing
+    bool commitInOutput = false;
+    std::vector<std::pair<unsigned long, size_t>> pumped;   // Output as the recorder saw it: time, bytes
+    size_t unpumped = 0;
+    unsigned long haltedMs = 0;
+    uint32_t seed = 12345;
+    auto random = [&](uint32_t low, uint32_t high) {
+        seed = seed * 1103515245u + 12345u;
+        return low + (seed >> 8) % (high - low + 1);
+    };
+
+    int talker = 0;
+    size_t burstLeft = 0;
+    unsigned long quietUntilMs = 0;
+    unsigned long long credit = 0;
+    unsigned long nextPumpMs = 0, nextNetworkMs = 0, nextRecordMs = 0;
+    SessionRecorder* recorder = nullptr;
+    auto run = [&](unsigned long ms, int channel) {
+        const unsigned long endMs = clock.millis() + ms;
+        while (clock.millis() < endMs) {
+            unsigned long now = clock.millis();
+            bool halted = files.busyUntilUs > clock.micros();
+            if (halted) haltedMs++;
+
+            // The mux is moved between bursts
+            if (channel != talker && burstLeft == 0 && fifo.empty() && !halted) {
+                char command[16];
+                snprintf(command, sizeof(command), "CHANNEL:%d", channel);
+                pipeline.webSocket->receiveText(0, command);
+                talker = channel;
+                quietUntilMs = now + 50;    // The fence may still drop the first bytes
+            }
+
+            std::string arriving;
+            if (burstLeft == 0 && now >= quietUntilMs && talker == channel) {
+                burstLeft = random(512, 24 * 1024);
+            }
+            if (burstLeft > 0) {
+                credit += options.baud / 10;
+                size_t count = (size_t)(credit / 1000);
+                credit %= 1000;
+                if (count > burstLeft) count = burstLeft;
+                arriving = texts[talker].substr(fed[talker], count);
+                fed[talker] += count;
+                burstLeft -= count;
+                if (burstLeft == 0) quietUntilMs = now + random(100, 2000);
+            }
+
+            if (halted) {
+                // Nothing runs from flash, the interrupt included
+                fifo += arriving;
+                if (fifo.size() > UART_RX_FIFO_SIZE) {
+                    lost += fifo.size() - UART_RX_FIFO_SIZE;
+                    if (commitInOutput) lostInOutput += fifo.size() - UART_RX_FIFO_SIZE;
+                    fifo.resize(UART_RX_FIFO_SIZE);
+                }
+            } else {
+                fifo += arriving;
+                uart.inject((const uint8_t*)fifo.data(), fifo.size());
+                expected[talker] += fifo;
+                unpumped += fifo.size();
+                fifo.clear();
+
+                if (now >= nextPumpMs) {
+                    bridge.pump();
+                    if (unpumped > 0) pumped.push_back({now, unpumped});
+                    unpumped = 0;
+                    nextPumpMs = now + UART_TASK_PERIOD_MS;
+                }
+                if (now >= nextNetworkMs) {
+                    pipeline.webSocketServer.loop();
+                    bridge.forward();
+                    nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+                }
+                if (recorder && now >= nextRecordMs) {
+                    recorder->loop();
+                    nextRecordMs = now + RECORD_TASK_PERIOD_MS;
+                    if (files.busyUntilUs > clock.micros()) {
+                        // A commit began: was output flowing faster than the FIFO can bridge?
+                        size_t recent = 0;
+                        for (size_t i = pumped.size(); i > 0 && now - pumped[i - 1].first < RECORD_TASK_PERIOD_MS; i--) {
+                            recent += pumped[i - 1].second;
+                        }
+                        bool quiet = pumped.empty() || now - pumped.back().first >= RECORD_QUIET_MS;
+                        commitInOutput = !quiet && recent * RECORD_COMMIT_STALL_MS >
+                                                       (UART_RX_FIFO_SIZE - UART_RX_FIFO_THRESHOLD) * RECORD_TASK_PERIOD_MS;
+                    }
+                }
+            }
+            logger().drain(hal::console());
+            clock.delay(1);
+        }
+    };
+    auto finish = [&]() {
+        // Let the last burst end, then power off cleanly
+        while (burstLeft > 0) run(1, talker);
+        run(200, talker);
+        recorder->flush();
+    };
+
+    // First session
+    recorder = &recorders[0];
+    recorder->begin(&files);
+    bridge.setRecorder(recorder);
+    unsigned long half = options.seconds * 1000 / 2;
+    run(half, 0);
+    run(options.seconds * 1000 - half, 1);
+    finish();
+    RecorderStats first = recorder->getStats();
+
+    // Reboot: a new recorder finds the log and carries on under the next boot
+    recorder = &recorders[1];
+    recorder->begin(&files);
+    bridge.setRecorder(recorder);
+    run(5000, 0);
+    finish();
+    RecorderStats second = recorder->getStats();
+
+    // Download both channels and a seek range on one keep-alive connection
+    const unsigned long FROM_S = 5, TO_S = 10;
+    bool reused = first.rotations + second.rotations >= RECORD_SEGMENTS;
+    char seek[96];
+    snprintf(seek, sizeof(seek), "GET /record.cast?channel=0&from=%lu&to=%lu HTTP/1.1\r\n\r\n", FROM_S, TO_S);
+    std::string requests = std::string("GET /record.cast?channel=0 HTTP/1.1\r\n\r\n") +
+                           "GET /record.cast?channel=1 HTTP/1.1\r\n\r\n" + seek +
+                           "GET /record.cast?channel=99 HTTP/1.1\r\n\r\n";
+    hal::native::FakeTcpConnection* client =
+        hal::native::tcpServerOnPort(HTTP_PORT)->queueConnection(requests.c_str());
+    std::vector<HttpResponse> responses;
+    unsigned long downloadStartMs = clock.millis();
+    while (responses.size() < 4 && clock.millis() - downloadStartMs < 60000) {
+        pipeline.webSocketServer.loop();
+        clock.delay(NETWORK_TASK_PERIOD_MS);
+        responses = parseResponses(client->output);
+    }
+
+    // A burst that starts while a commit is under way still loses what the
+    // FIFO cannot hold, but a commit must not begin while fast output flows
+    size_t received = expected[0].size() + expected[1].size();
+    bool ok = responses.size() == 4 && lostInOutput == 0 && first.writeErrors == 0 && second.writeErrors == 0 &&
+              second.boot == first.boot + 1;
+    printf("recorded         : %lu + %lu bytes in two boots, %lu dropped\n", first.recordedBytes,
+           second.recordedBytes, first.droppedBytes + second.droppedBytes);
+    unsigned long recordedBytes = first.recordedBytes + second.recordedBytes;
+    unsigned long storedBytes = first.storedBytes + second.storedBytes;
+    printf("flash            : %lu bytes (%.1f%% of the output), %lu commits, %lu segment rotations\n",
+           storedBytes, recordedBytes ? 100.0 * storedBytes / recordedBytes : 0.0,
+           first.commits + second.commits, first.rotations + second.rotations);
+    printf("flash wear       : %lu sector erases, %.1f per MB recorded\n", files.sectorErases,
+           recordedBytes ? files.sectorErases * 1048576.0 / recordedBytes : 0.0);
+    printf("commit timing    : %lu deferred until quiet; CPU halted %lu ms\n",
+           first.deferredCommits + second.deferredCommits, haltedMs);
+    printf("rx lost to flash : %zu of %zu bytes in bursts that began during a commit, %zu in commits begun "
+           "during fast output\n", lost - lostInOutput, received + lost, lostInOutput);
+
+    size_t exportedBytes = 0;
+    for (size_t i = 0; i < responses.size() && i < 3; i++) {
+        std::vector<CastEvent> events;
+        bool parsed = responses[i].status == 200 && parseCast(responses[i].body, events);
+        // Records are whole UART reads: each one follows the previous in
+        // what the SBC sent, with gaps where the recording dropped output
+        const std::string& all = expected[i < 2 ? i : 0];
+        size_t exported = 0, cursor = 0;
+        bool ordered = true, intact = !events.empty();
+        for (size_t e = 0; e < events.size(); e++) {
+            ordered = ordered && (e == 0 || events[e].time >= events[e - 1].time);
+            size_t at = all.find(events[e].text, cursor);
+            intact = intact && at != std::string::npos;
+            if (at != std::string::npos) cursor = at + events[e].text.size();
+            exported += events[e].text.size();
+        }
+        double span = events.empty() ? 0 : events.back().time - events.front().time;
+        if (i < 2) {
+            exportedBytes += exported;
+            printf("SBC%zu export      : %zu events, %zu of %zu bytes, %.1f s, %s\n", i + 1, events.size(),
+                   exported, all.size(), span, parsed && ordered && intact ? "OK" : "MISMATCH");
+        } else {
+            // Unless the start of the recording has been overwritten
+            intact = reused || (intact && events.back().time <= TO_S - FROM_S);
+            printf("seek %lu-%lu s     : %zu events, %zu bytes, %.1f-%.1f s, %s\n", FROM_S, TO_S, events.size(),
+                   exported, events.empty() ? 0 : events.front().time, events.empty() ? 0 : events.back().time,
+                   parsed && ordered && intact ? "OK" : "MISMATCH");
+        }
+        ok = ok && parsed && ordered && intact;
+    }
+    // Every byte received (but for those fenced off after the switch) is
+    // recorded or counted as dropped, and every recorded byte is exported
+    // unless its segment has been reused since (or it starts a character that
+    // the end of a burst cut off)
+    unsigned long droppedBytes = first.droppedBytes + second.droppedBytes;
+    ok = ok && recordedBytes + droppedBytes + uart.getStats().fencedBytes == received &&
+         (reused || (exportedBytes <= recordedBytes && exportedBytes + 2 * 3 >= recordedBytes));
+    if (responses.size() == 4) {
+        printf("bad channel      : %d\n", responses[3].status);
+        ok = ok && responses[3].status == 400;
+    }
+    printf("recording        : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Samples of a metrics page by name with labels, e.g.
+ * "sbcmux_ws_frames_total{type=\"text\"}"; false if the format is broken
+ */
+bool parseMetrics(const std::string& page, std::map<std::string, double>& samples) {
+    std::string family;
+    bool typed = false;
+    size_t position = 0;
+    while (position < page.size()) {
+        size_t end = page.find('\n', position);
+        if (end == std::string::npos) return false;
+        std::string line = page.substr(position, end - position);
+        position = end + 1;
+
+        if (line.compare(0, 7, "# HELP ") == 0) {
+            family = line.substr(7, line.find(' ', 7) - 7);
+            typed = false;
+        } else if (line.compare(0, 7, "# TYPE ") == 0) {
+            typed = line.compare(7, family.size() + 1, family + " ") == 0;
+            if (!typed) return false;
+        } else {
+            size_t space = line.rfind(' ');
+            if (!typed || space == std::string::npos || line.compare(0, family.size(), family) != 0) return false;
+            char* valueEnd;
+            double value = strtod(line.c_str() + space + 1, &valueEnd);
+            if (*valueEnd != '\0') return false;
+            samples[line.substr(0, space)] = value;
+        }
+    }
+    return !samples.empty();
+}
+
+int runMetrics(const Options& options) {
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    hal::native::FakeTcpServer* server = hal::native::tcpServerOnPort(HTTP_PORT);
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    SerialBridge& bridge = pipeline.serialBridge;
+    std::string boot = syntheticBootLog(options.bytes < 262144 ? options.bytes : 262144);
+    static const char TYPED[] = "uname -a\r";
+
+    // The SBC prints at line rate and the client types a command
+    pipeline.webSocket->receiveText(0, TYPED);
+    size_t fed = 0;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    for (unsigned long now = 0; (fed < boot.size() || uart.available() || bridge.pendingForward(0)) && now < 60000;
+         now = clock.millis()) {
+        size_t count = options.baud / 10 / 1000;
+        if (count > boot.size() - fed) count = boot.size() - fed;
+        uart.inject((const uint8_t*)boot.data() + fed, count);
+        fed += count;
+        if (now >= nextPumpMs) {
+            bridge.pump();
+            nextPumpMs = now + UART_TASK_PERIOD_MS;
+        }
+        if (now >= nextNetworkMs) {
+            pipeline.webSocketServer.loop();
+            bridge.forward();
+            nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+        }
+        clock.delay(1);
+    }
+    pipeline.webSocketServer.flushBuffer();
+
+    // Two scrapes at once: the second must wait its turn
+    hal::native::FakeTcpConnection* scrape = server->queueConnection("GET /metrics HTTP/1.1\r\n\r\n");
+    hal::native::FakeTcpConnection* busy =
+        server->queueConnection("GET /metrics HTTP/1.1\r\nConnection: close\r\n\r\n");
+    std::vector<HttpResponse> responses;
+    for (int pass = 0; pass < 100 && responses.empty(); pass++) {
+        pipeline.webSocketServer.loop();
+        clock.delay(NETWORK_TASK_PERIOD_MS);
+        responses = parseResponses(scrape->output);
+    }
+    std::vector<HttpResponse> refused = parseResponses(busy->output);
+
+    logger().drain(hal::console());
+
+    std::map<std::string, double> samples;
+    bool formatted = responses.size() == 1 && responses[0].status == 200 && parseMetrics(responses[0].body, samples);
+
+    // HTTP/1.0 has no chunked encoding: the body ends when the device closes,
+    // even if the client asked to keep the connection
+    hal::native::FakeTcpConnection* legacy =
+        server->queueConnection("GET /metrics HTTP/1.0\r\nConnection: keep-alive\r\n\r\n");
+    for (int pass = 0; pass < 100 && legacy->open; pass++) {
+        pipeline.webSocketServer.loop();
+        clock.delay(NETWORK_TASK_PERIOD_MS);
+    }
+    size_t legacyHeaderEnd = legacy->output.find("\r\n\r\n");
+    std::string legacyHeader = legacy->output.substr(0, legacyHeaderEnd);
+    std::map<std::string, double> legacySamples;
+    bool unchunked = !legacy->open && legacyHeaderEnd != std::string::npos &&
+                     legacyHeader.find("Transfer-Encoding") == std::string::npos &&
+                     legacyHeader.find("Connection: close") != std::string::npos &&
+                     parseMetrics(legacy->output.substr(legacyHeaderEnd + 4), legacySamples) &&
+                     legacySamples.size() == samples.size();
+    OutputStats output = pipeline.webSocketServer.getOutputStats();
+    const hal::native::FakeWebSocket& webSocket = *pipeline.webSocket;
+
+    // Bytes that arrived while the mux settled at start are fenced off
+    double received = fed - samples["sbcmux_uart_fenced_bytes_total"];
+    bool bytes = samples["sbcmux_channel_rx_bytes_total{channel=\"0\"}"] == received &&
+                 samples["sbcmux_uart_rx_bytes_total"] == received &&
+                 samples["sbcmux_uart_fenced_bytes_total"] == uart.getStats().fencedBytes &&
+                 samples["sbcmux_channel_tx_bytes_total{channel=\"0\"}"] == strlen(TYPED) &&
+                 samples["sbcmux_channel_rx_bytes_total{channel=\"1\"}"] == 0 &&
+                 samples["sbcmux_ws_output_bytes_total"] == webSocket.payloadBytes;
+    double text = samples["sbcmux_ws_frames_total{type=\"text\"}"];
+    double binary = samples["sbcmux_ws_frames_total{type=\"binary\"}"];
+    bool frames = text == webSocket.textFrames && binary == webSocket.binaryFrames && text + binary == output.frames;
+
+    // Buckets count every frame at or below their bound
+    bool cumulative = true;
+    double previous = 0;
+    for (size_t i = 0; i < SizeHistogram::BUCKETS; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "sbcmux_ws_frame_bytes_bucket{le=\"%lu\"}", SizeHistogram::upperBound(i));
+        cumulative = cumulative && samples.count(name) && samples[name] >= previous;
+        previous = samples[name];
+    }
+    double all = samples["sbcmux_ws_frame_bytes_bucket{le=\"+Inf\"}"];
+    bool histogram = cumulative && all >= previous && all == samples["sbcmux_ws_frame_bytes_count"] &&
+                     all == text + binary && samples["sbcmux_ws_frame_bytes_sum"] == output.bytes;
+    bool clients = samples["sbcmux_ws_clients{protocol=\"terminal\"}"] == 1 &&
+                   samples["sbcmux_channel_baud{channel=\"0\"}"] == bridge.getLineSettings(0).config.baud &&
+                   samples["sbcmux_task_period_max_seconds{task=\"uart\"}"] > 0;
+    bool serialized = refused.size() == 1 && refused[0].status == 503;
+
+    printf("page             : %zu bytes, %zu samples, %s\n", responses.empty() ? 0 : responses[0].body.size(),
+           samples.size(), formatted ? "format OK" : "FORMAT BROKEN");
+    printf("bytes            : %zu fed, %.0f fenced, %.0f received, %.0f typed, %.0f sent to clients, %s\n", fed,
+           samples["sbcmux_uart_fenced_bytes_total"], samples["sbcmux_channel_rx_bytes_total{channel=\"0\"}"],
+           samples["sbcmux_channel_tx_bytes_total{channel=\"0\"}"], samples["sbcmux_ws_output_bytes_total"],
+           bytes ? "OK" : "MISMATCH");
+    printf("frames           : %.0f text, %.0f binary, %s\n", text, binary, frames ? "OK" : "MISMATCH");
+    printf("frame sizes      : %.0f frames, %.0f bytes, %s\n", all, samples["sbcmux_ws_frame_bytes_sum"],
+           histogram ? "histogram OK" : "HISTOGRAM WRONG");
+    printf("gauges           : %.0f terminal client, %.0f baud, uart period max %.3f ms, %s\n",
+           samples["sbcmux_ws_clients{protocol=\"terminal\"}"], samples["sbcmux_channel_baud{channel=\"0\"}"],
+           samples["sbcmux_task_period_max_seconds{task=\"uart\"}"] * 1000, clients ? "OK" : "WRONG");
+    printf("second scrape    : %d, %s\n", refused.empty() ? 0 : refused[0].status,
+           serialized ? "OK" : "NOT REFUSED");
+    printf("HTTP/1.0 scrape  : %zu samples, %s\n", legacySamples.size(),
+           unchunked ? "unchunked, closed OK" : "FRAMING WRONG");
+    bool ok = formatted && bytes && frames && histogram && clients && serialized && unchunked;
+    printf("metrics          : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * A shell that echoes every byte it reads, ECHO_US after it left the wire
+ */
+struct EchoingSbc {
+    static const unsigned long ECHO_US = 400;
+
+    size_t echoed = 0;
+    bool muted = false;   // Reads without echoing, like a hung SBC
+
+    void advance(hal::native::FakeUart& uart, uint64_t nowUs) {
+        while (echoed < uart.tx.size() && uart.txDoneUs[echoed] + ECHO_US <= nowUs) {
+            if (!muted) uart.inject(&uart.tx[echoed], 1);
+            echoed++;
+        }
+    }
+};
+
+/**
+ * Value of a JSON number field after the given position, -1 if missing
+ */
+long jsonNumber(const std::string& json, const char* field, size_t from = 0) {
+    size_t at = json.find(std::string("\"") + field + "\":", from);
+    return at == std::string::npos ? -1 : strtol(json.c_str() + at + strlen(field) + 3, nullptr, 10);
+}
+
+int runTrace(const Options& options) {
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    hal::native::FakeWebSocket& webSocket = *pipeline.webSocket;
+    SerialBridge& bridge = pipeline.serialBridge;
+    EchoingSbc sbc;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+
+    // Task pipeline schedule on a 1 ms tick, the SBC polled in between
+    auto tick = [&]() {
+        unsigned long now = clock.millis();
+        if (now >= nextPumpMs) {
+            bridge.pump();
+            nextPumpMs = now + UART_TASK_PERIOD_MS;
+        }
+        if (now >= nextNetworkMs) {
+            pipeline.webSocketServer.loop();
+            bridge.forward();
+            nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+        }
+        logger().drain(hal::console());
+        clock.delay(1);
+        sbc.advance(uart, clock.micros());
+    };
+    for (int i = 0; i < 100; i++) tick();   // Past the fence of the first switch
+
+    // One keystroke at a time, at varying phases of the task periods
+    std::map<unsigned long, unsigned long> roundTrips;
+    unsigned long keys = options.seconds * 10;
+    unsigned long lostEchoes = 0;
+    for (unsigned long id = 1; id <= keys; id++) {
+        char command[32];
+        snprintf(command, sizeof(command), "TRACE:%lu", id);
+        char key[2] = {(char)('a' + id % 26), '\0'};
+        size_t framesBefore = webSocket.frames.size();
+        unsigned long sentUs = clock.micros();
+        webSocket.receiveText(0, command);
+        webSocket.receiveText(0, key);
+
+        bool echoed = false;
+        for (int wait = 0; wait < 500 && !echoed; wait++) {
+            tick();
+            for (size_t f = framesBefore; f < webSocket.frames.size() && !echoed; f++) {
+                const std::vector<uint8_t>& payload = webSocket.frames[f].payload;
+                echoed = std::find(payload.begin(), payload.end(), (uint8_t)key[0]) != payload.end();
+            }
+        }
+        if (echoed) {
+            roundTrips[id] = clock.micros() - sentUs;
+        } else {
+            lostEchoes++;
+        }
+        for (unsigned long idle = id % 7 + 20; idle > 0; idle--) tick();
+    }
+
+    // A keystroke that never comes back is given up
+    sbc.muted = true;
+    webSocket.receiveText(0, "TRACE:999999");
+    webSocket.receiveText(0, "x");
+    for (unsigned long waited = 0; waited < KeystrokeTracer::TIMEOUT_MS + 100; waited++) tick();
+
+    hal::native::FakeTcpConnection* client =
+        hal::native::tcpServerOnPort(HTTP_PORT)->queueConnection("GET /trace.json HTTP/1.1\r\n\r\n");
+    std::vector<HttpResponse> responses;
+    for (int pass = 0; pass < 100 && responses.empty(); pass++) {
+        tick();
+        responses = parseResponses(client->output);
+    }
+    std::string json = responses.size() == 1 && responses[0].status == 200 ? responses[0].body : "";
+
+    // Every segment's histogram counts every completed trace
+    long completed = jsonNumber(json, "completed");
+    bool counted = completed == (long)keys && jsonNumber(json, "abandoned") == 1 && lostEchoes == 0;
+    static const char* const SEGMENTS[KeystrokeTracer::SEGMENTS] = {"queue", "sbc", "forward"};
+    for (const char* segment : SEGMENTS) {
+        size_t at = json.find(std::string("\"") + segment + "\":{\"counts\":[");
+        long sum = 0;
+        for (const char* c = at == std::string::npos ? "" : json.c_str() + at; *c && *c != ']'; c++) {
+            if (*c == '[' || *c == ',') sum += strtol(c + 1, nullptr, 10);
+        }
+        unsigned long mean = jsonNumber(json, "mean_us", at);
+        unsigned long max = jsonNumber(json, "max_us", at);
+        printf("%-17s: mean %.2f ms, max %.2f ms\n", segment, mean / 1000.0, max / 1000.0);
+        counted = counted && at != std::string::npos && sum == completed;
+    }
+
+    // The recent traces fit in the round trips the client measured
+    size_t matched = 0;
+    bool fits = true;
+    unsigned long networkMaxUs = 0;
+    for (size_t at = json.find("{\"id\":"); at != std::string::npos; at = json.find("{\"id\":", at + 1)) {
+        unsigned long id = jsonNumber(json, "id", at);
+        unsigned long device = jsonNumber(json, "queue_us", at) + jsonNumber(json, "sbc_us", at) +
+                               jsonNumber(json, "forward_us", at);
+        fits = fits && roundTrips.count(id) && device <= roundTrips[id] &&
+               (unsigned long)jsonNumber(json, "sbc_us", at) >= EchoingSbc::ECHO_US;
+        if (roundTrips.count(id) && device <= roundTrips[id]) {
+            networkMaxUs = std::max(networkMaxUs, roundTrips[id] - device);
+        }
+        matched++;
+    }
+    fits = fits && matched == KeystrokeTracer::RECENT_TRACES;
+
+    unsigned long roundTripMaxUs = 0;
+    double roundTripTotalUs = 0;
+    for (const auto& trip : roundTrips) {
+        roundTripMaxUs = std::max(roundTripMaxUs, trip.second);
+        roundTripTotalUs += trip.second;
+    }
+    printf("round trip       : %zu keystrokes at %lu baud, mean %.2f ms, max %.2f ms\n", roundTrips.size(),
+           bridge.getLineSettings(0).config.baud, roundTrips.empty() ? 0 : roundTripTotalUs / roundTrips.size() / 1000,
+           roundTripMaxUs / 1000.0);
+    printf("traces           : %ld completed, %ld abandoned, %s\n", completed, jsonNumber(json, "abandoned"),
+           counted ? "OK" : "MISMATCH");
+    printf("recent           : %zu matched by id, outside the device at most %.2f ms, %s\n", matched,
+           networkMaxUs / 1000.0, fits ? "OK" : "DO NOT FIT");
+    bool ok = counted && fits;
+    printf("trace            : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Occurrences of a pattern in text, overlapping ones included
+ */
+size_t countOccurrences(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Time TriggerMatcher::feed() over text in UART-read-sized pieces
+ * @return Nanoseconds per byte
+ */
+double benchTriggers(TriggerMatcher& matcher, const char* patterns, const std::string& text) {
+    const size_t READ_SIZE = 256;
+    matcher.compile(patterns, strlen(patterns));
+    auto start = std::chrono::steady_clock::now();
+    for (size_t offset = 0; offset < text.size(); offset += READ_SIZE) {
+        size_t length = text.size() - offset < READ_SIZE ? text.size() - offset : READ_SIZE;
+        matcher.feed(0, (const uint8_t*)text.data() + offset, length);
+        TriggerAlert alert;
+        while (matcher.popAlert(alert)) {
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / text.size();
+}
+
+int runTriggers(const Options& options) {
+    // Bytes/s of each SBC, and every how many lines it prints an event
+    static const unsigned long RATES[] = {3000, 20000, 500, 100, 8000};
+    static const char* const EVENTS[] = {
+        "[  %lu.123456] Kernel panic - not syncing: VFS: Unable to mount root fs\r\n",
+        "Out of memory: Killed process %lu (stress)\r\n",
+        "\r\nsbc login: ",
+        "echo \"quoted\" %lu\r\n",
+    };
+    static const char PATTERNS[] = "Kernel panic|Out of memory|login:|panic|\"quoted\"";
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    hal::native::FakeWebSocket& webSocket = *pipeline.webSocket;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    SerialBridge& bridge = pipeline.serialBridge;
+    const uint8_t CHANNEL_CLIENT = 1;
+    webSocket.connect(CHANNEL_CLIENT, "/?proto=1");
+    std::string setCommand = std::string("TRIGGERS:") + PATTERNS;
+    webSocket.receiveText(0, setCommand.c_str());
+    std::string tooMany = "TRIGGERS:";
+    for (size_t i = 0; i <= TriggerMatcher::MAX_PATTERNS; i++) tooMany += "p" + std::to_string(i) + "|";
+    webSocket.receiveText(CHANNEL_CLIENT, tooMany.c_str());
+    bridge.setScanMode(true);
+
+    // Every byte the mux lets through, per channel, is what the matcher sees
+    std::string delivered[MAX_CHANNELS];
+    std::string pending[MAX_CHANNELS];
+    unsigned long long credit[MAX_CHANNELS] = {};
+    unsigned long lines[MAX_CHANNELS] = {};
+    unsigned long iterations = options.seconds * 1000 / LOOP_PERIOD_MS;
+    for (unsigned long i = 0; i < iterations + 100; i++) {
+        int selected = selectedChannel();
+        for (int channel = 0; channel < MAX_CHANNELS && i < iterations; channel++) {
+            unsigned long lineRate = options.baud / 10;
+            unsigned long rate = RATES[channel % 5] < lineRate ? RATES[channel % 5] : lineRate;
+            credit[channel] += (unsigned long long)rate * LOOP_PERIOD_MS;
+            size_t count = credit[channel] / 1000;
+            credit[channel] -= count * 1000ULL;
+
+            for (size_t n = 0; n < count; n++) {
+                if (pending[channel].empty()) {
+                    char line[96];
+                    unsigned long number = lines[channel]++;
+                    if (number % (7 + channel) == 3) {
+                        snprintf(line, sizeof(line), EVENTS[(number / (7 + channel) + channel) % 4], number);
+                    } else {
+                        snprintf(line, sizeof(line), "SBC%d line %lu\r\n", channel + 1, number);
+                    }
+                    pending[channel] = line;
+                }
+                uint8_t byte = (uint8_t)pending[channel][0];
+                pending[channel].erase(0, 1);
+                if (channel != selected) continue;
+
+                unsigned long fenced = uart.getStats().fencedBytes;
+                uart.inject(&byte, 1);
+                if (uart.getStats().fencedBytes == fenced) {
+                    delivered[channel] += (char)byte;
+                }
+            }
+        }
+        pipeline.loop();
+    }
+
+    // Matches counted per channel and pattern, against what got through
+    const TriggerMatcher& triggers = bridge.getTriggers();
+    bool counted = triggers.getPatternCount() == 5 && triggers.getDroppedAlerts() == 0;
+    unsigned long expectedTotal = 0;
+    printf("channel  matched/expected per pattern\n        ");
+    for (size_t pattern = 0; pattern < triggers.getPatternCount(); pattern++) {
+        printf(" %-14s", triggers.getPattern(pattern));
+    }
+    printf("\n");
+    for (int channel = 0; channel < MAX_CHANNELS; channel++) {
+        printf("SBC%-5d", channel + 1);
+        for (size_t pattern = 0; pattern < triggers.getPatternCount(); pattern++) {
+            size_t expected = countOccurrences(delivered[channel], triggers.getPattern(pattern));
+            unsigned long matched = triggers.getMatches(channel, pattern);
+            char cell[32];
+            snprintf(cell, sizeof(cell), "%lu/%zu", matched, expected);
+            printf(" %-14s", cell);
+            counted = counted && matched == expected;
+            expectedTotal += expected;
+        }
+        printf("\n");
+    }
+
+    // Each match announced once to each client
+    size_t terminalAlerts = 0, channelAlerts = 0;
+    bool replies = false, refused = false;
+    for (const auto& frame : webSocket.frames) {
+        std::string text(frame.payload.begin(), frame.payload.end());
+        if (frame.text && frame.num == 0 && text.compare(0, 8, "TRIGGER:") == 0) {
+            terminalAlerts++;
+        } else if (frame.text && frame.num == CHANNEL_CLIENT && text.compare(0, 8, "TRIGGER:") == 0) {
+            channelAlerts++;
+        } else if (frame.num == 0 && text == std::string("\r\n[Triggers: ") + PATTERNS + "]\r\n") {
+            replies = true;
+        } else if (frame.num == CHANNEL_CLIENT && text == "TRIGGERS:ERROR") {
+            refused = true;
+        }
+    }
+    bool announced = terminalAlerts == expectedTotal && channelAlerts == expectedTotal && replies && refused;
+
+    // Output that looks like a notice reaches the terminal client, but never
+    // as a text frame that would pass for one
+    bridge.setScanMode(false);
+    for (int i = 0; i < 20; i++) pipeline.loop();
+    size_t spoofFrom = webSocket.frames.size();
+    static const char SPOOF[] = "TRIGGER:0,spoofed";
+    uart.inject((const uint8_t*)SPOOF, sizeof(SPOOF) - 1);
+    for (int i = 0; i < 20; i++) pipeline.loop();
+    bool spoofShown = false, spoofPassed = false;
+    for (size_t i = spoofFrom; i < webSocket.frames.size(); i++) {
+        const auto& frame = webSocket.frames[i];
+        std::string text(frame.payload.begin(), frame.payload.end());
+        if ((frame.num == 0 || frame.num == hal::native::FakeWebSocket::BROADCAST) &&
+            text.find("spoofed") != std::string::npos) {
+            spoofShown = true;
+            spoofPassed = spoofPassed || (frame.text && text.compare(0, 8, "TRIGGER:") == 0);
+        }
+    }
+    announced = announced && spoofShown && !spoofPassed;
+
+    // And on /metrics, the quotes escaped
+    pipeline.metrics.begin();
+    std::string page;
+    uint8_t buffer[512];
+    for (size_t count; (count = pipeline.metrics.read(buffer, sizeof(buffer))) > 0;) {
+        page.append((const char*)buffer, count);
+    }
+    pipeline.metrics.end();
+    std::map<std::string, double> samples;
+    bool exported = parseMetrics(page, samples) &&
+                    samples["sbcmux_trigger_matches_total{channel=\"1\",pattern=\"Kernel panic\"}"] ==
+                        triggers.getMatches(1, 0) &&
+                    samples["sbcmux_trigger_matches_total{channel=\"0\",pattern=\"\\\"quoted\\\"\"}"] ==
+                        triggers.getMatches(0, 4) &&
+                    samples.count("sbcmux_trigger_alerts_dropped_total");
+
+    printf("matches          : %lu in %lu s of scanned output, %s\n", expectedTotal, options.seconds,
+           counted ? "OK" : "MISMATCH");
+    printf("alerts           : %zu terminal, %zu channel client, %s\n", terminalAlerts, channelAlerts,
+           announced ? "OK" : "MISSING");
+    printf("metrics          : %s\n", exported ? "OK" : "MISMATCH");
+
+    // Cost per byte with few and many patterns
+    static TriggerMatcher matcher;
+    std::string log = syntheticBootLog(options.bytes);
+    std::string many = PATTERNS;
+    for (size_t i = 5; i < TriggerMatcher::MAX_PATTERNS; i++) many += "|sig" + std::to_string(i);
+    double few = benchTriggers(matcher, "Kernel panic|Out of memory|login:", log);
+    double all = benchTriggers(matcher, many.c_str(), log);
+    printf("matcher          : %.2f ns/byte with 3 patterns, %.2f ns/byte with %zu\n", few, all,
+           TriggerMatcher::MAX_PATTERNS);
+
+    bool ok = counted && announced && exported && expectedTotal > 0;
+    printf("triggers         : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Output a terminal client received, with frames of a compress=lz client
+ * unpacked as the web client does
+ * @param until Frames sent before the client disconnected
+ * @param wireBytes Payload bytes the client received
+ * @return false if a frame does not unpack
+ */
+bool terminalOutput(const hal::native::FakeWebSocket& webSocket, uint8_t client, bool packed, size_t until,
+                    std::string& output, size_t& wireBytes) {
+    for (size_t i = 0; i < until && i < webSocket.frames.size(); i++) {
+        const hal::native::FakeWebSocket::Frame& frame = webSocket.frames[i];
+        if (frame.num != client && frame.num != hal::native::FakeWebSocket::BROADCAST) continue;
+        wireBytes += frame.payload.size();
+        const uint8_t* data = frame.payload.data();
+        size_t length = frame.payload.size();
+
+        if (frame.text || !packed) {
+            output.append((const char*)data, length);
+        } else if (length >= 1 && data[0] == 0) {
+            output.append((const char*)data + 1, length - 1);
+        } else if (length >= 3 && data[0] == 1) {
+            size_t expected = data[1] | (data[2] << 8);
+            std::vector<uint8_t> block(expected);
+            if (lzDecompress(data + 3, length - 3, block.data(), block.size()) != expected) return false;
+            output.append(block.begin(), block.end());
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int runCompress(const Options& options) {
+    std::string input;
+    if (options.replayPath) {
+        std::ifstream file(options.replayPath, std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "cannot open %s\n", options.replayPath);
+            return 2;
+        }
+        input.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    } else {
+        input = syntheticBootLog(options.bytes < 262144 ? options.bytes : 262144);
+    }
+    input.erase(std::remove(input.begin(), input.end(), '\0'), input.end());
+
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    hal::native::FakeWebSocket* webSocket = pipeline.webSocket;
+    hal::native::FakeTcpServer* server = hal::native::tcpServerOnPort(HTTP_PORT);
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    SerialBridge& bridge = pipeline.serialBridge;
+    webSocket->connect(1, "/?compress=lz");
+    bridge.setTriggers("", 0);  // A replayed log could match one, and the alert joins the output
+
+    // Client 0 takes plain frames for the first half, then leaves
+    size_t fed = 0;
+    size_t plainUntil = 0;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    for (unsigned long now = 0; (fed < input.size() || uart.available() || bridge.pendingForward(0)) && now < 600000;
+         now = clock.millis()) {
+        // 10 bits per byte on the wire (8N1)
+        size_t due = (size_t)((unsigned long long)(now + 1) * options.baud / 10000);
+        size_t count = (due < input.size() ? due : input.size()) - fed;
+        uart.inject((const uint8_t*)input.data() + fed, count);
+        fed += count;
+        if (now >= nextPumpMs) {
+            bridge.pump();
+            nextPumpMs = now + UART_TASK_PERIOD_MS;
+        }
+        if (now >= nextNetworkMs) {
+            pipeline.webSocketServer.loop();
+            bridge.forward();
+            nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+        }
+        if (plainUntil == 0 && fed >= input.size() / 2) {
+            pipeline.webSocketServer.flushBuffer();
+            plainUntil = webSocket->frames.size();
+            webSocket->disconnect(0);
+        }
+        clock.delay(1);
+    }
+    pipeline.webSocketServer.flushBuffer();
+
+    std::string plain, unpacked;
+    size_t plainWire = 0, packedWire = 0;
+    bool decoded = terminalOutput(*webSocket, 0, false, plainUntil, plain, plainWire) &&
+                   terminalOutput(*webSocket, 1, true, webSocket->frames.size(), unpacked, packedWire);
+    // Bytes arriving while the UART settled after the mux switch never reach a client
+    std::string expected = input.substr(uart.getStats().fencedBytes);
+    bool intact = decoded && unpacked == expected && !plain.empty() && expected.compare(0, plain.size(), plain) == 0;
+
+    // The /metrics figures cover the frames offered to the compressor
+    hal::native::FakeTcpConnection* scrape = server->queueConnection("GET /metrics HTTP/1.1\r\n\r\n");
+    std::vector<HttpResponse> responses;
+    for (int pass = 0; pass < 100 && responses.empty(); pass++) {
+        pipeline.webSocketServer.loop();
+        clock.delay(NETWORK_TASK_PERIOD_MS);
+        responses = parseResponses(scrape->output);
+    }
+    std::map<std::string, double> samples;
+    OutputStats stats = pipeline.webSocketServer.getOutputStats();
+    bool exported = responses.size() == 1 && parseMetrics(responses[0].body, samples) &&
+                    samples["sbcmux_ws_compressed_frames_total"] == stats.compressedFrames &&
+                    samples["sbcmux_ws_compress_bytes_total{stage=\"in\"}"] == stats.compressInputBytes &&
+                    samples["sbcmux_ws_compress_bytes_total{stage=\"out\"}"] == stats.compressOutputBytes &&
+                    samples.count("sbcmux_ws_compress_ratio") &&
+                    samples.count("sbcmux_ws_compress_seconds_per_kibibyte");
+    // Slow output never fills a frame worth compressing
+    bool shrunk = stats.compressInputBytes == 0 || stats.compressOutputBytes < stats.compressInputBytes;
+
+    // Host CPU time of the compressor alone on full frames (the simulated clock stands still)
+    uint16_t table[LZ_HASH_SIZE];
+    std::vector<uint8_t> scratch(OUTPUT_FRAME_MAX);
+    size_t benchBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 20; round++) {
+        for (size_t offset = 0; offset + OUTPUT_FRAME_MAX <= input.size(); offset += OUTPUT_FRAME_MAX) {
+            lzCompress((const uint8_t*)input.data() + offset, OUTPUT_FRAME_MAX, scratch.data(), scratch.size(), table);
+            benchBytes += OUTPUT_FRAME_MAX;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("input bytes      : %zu (%s) at %lu baud\n", input.size(),
+           options.replayPath ? options.replayPath : "synthetic", options.baud);
+    printf("plain client     : %zu bytes of output, %zu bytes on the wire (left halfway)\n", plain.size(),
+           plainWire);
+    printf("compress client  : %zu bytes of output, %zu bytes on the wire (%.0f%%)\n", unpacked.size(),
+           packedWire, unpacked.empty() ? 0.0 : 100.0 * packedWire / unpacked.size());
+    printf("compressor       : %lu frames compressed, %lu -> %lu bytes offered (ratio %.3f in /metrics)\n",
+           stats.compressedFrames, stats.compressInputBytes, stats.compressOutputBytes,
+           samples["sbcmux_ws_compress_ratio"]);
+    printf("compressor cpu   : %.1f us/KB on this host (%zu-byte frames)\n",
+           benchBytes ? seconds * 1e6 * 1024 / benchBytes : 0.0, (size_t)OUTPUT_FRAME_MAX);
+    printf("streams intact   : %s\n", intact ? "OK" : "MISMATCH");
+    printf("metrics          : %s\n", exported ? "OK" : "MISMATCH");
+    return intact && exported && shrunk ? 0 : 1;
+}
+
+/**
+ * Bytes from a list of values (Telnet sequences are awkward as literals)
+ */
+std::string byteString(std::initializer_list<int> values) {
+    std::string bytes;
+    for (int value : values) {
+        bytes += (char)value;
+    }
+    return bytes;
+}
+
+/**
+ * IAC SB COM-PORT-OPTION <command> <value> IAC SE
+ */
+std::string comPortCommand(uint8_t command, const std::string& value) {
+    return byteString({TELNET_IAC, TELNET_SB, TELNET_OPTION_COM_PORT, command}) + value +
+           byteString({TELNET_IAC, TELNET_SE});
+}
+
+/**
+ * Firmware pipeline plus the TCP ports, run like the network and UART tasks
+ */
+struct PortRig {
+    Pipeline pipeline;
+    PortServer ports;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+
+    void run(unsigned long ms) {
+        hal::native::SimClock& clock = hal::native::simClock();
+        for (unsigned long end = clock.millis() + ms; clock.millis() < end; clock.delay(1)) {
+            unsigned long now = clock.millis();
+            if (now >= nextPumpMs) {
+                pipeline.serialBridge.pump();
+                nextPumpMs = now + UART_TASK_PERIOD_MS;
+            }
+            if (now >= nextNetworkMs) {
+                pipeline.webSocketServer.loop();
+                ports.loop();
+                pipeline.serialBridge.forward();
+                nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+            }
+        }
+        logger().drain(hal::console());
+    }
+
+    /**
+     * SBC output, which only reaches the UART while the mux selects the channel
+     */
+    bool print(int channel, const std::string& text) {
+        if (selectedChannel() != channel) return false;
+        hal::native::fakeSbcUart().inject((const uint8_t*)text.data(), text.size());
+        run(20);
+        return true;
+    }
+
+    /**
+     * Send bytes from a client and run until they were handled
+     * @return What the UART transmitted meanwhile
+     */
+    std::string send(hal::native::FakeTcpConnection* client, const std::string& bytes) {
+        std::vector<uint8_t>& tx = hal::native::fakeSbcUart().tx;
+        size_t sent = tx.size();
+        client->input.insert(client->input.end(), bytes.begin(), bytes.end());
+        run(30);
+        return std::string(tx.begin() + sent, tx.end());
+    }
+};
+
+int runPorts() {
+    if (MAX_CHANNELS < 3) {
+        fprintf(stderr, "the ports mode needs 3 channels\n");
+        return 2;
+    }
+    PortRig rig;
+    if (!rig.pipeline.init(UART_BAUD_RATE)) {
+        return 1;
+    }
+    SerialBridge& bridge = rig.pipeline.serialBridge;
+    hal::native::FakeWebSocket* webSocket = rig.pipeline.webSocket;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    bool started = rig.ports.begin(&bridge, &rig.pipeline.webSocketServer);
+    hal::native::FakeTcpServer* rawPort = hal::native::tcpServerOnPort(PORT_BASE + 1);
+    hal::native::FakeTcpServer* rfcPort = hal::native::tcpServerOnPort(PORT_BASE + 2);
+    rig.run(50);
+
+    // Raw client: sends nothing at first, the mux follows it to SBC2
+    hal::native::FakeTcpConnection* raw = rawPort->queueConnection("");
+    rig.run(PORT_DETECT_MS + 50);
+    const std::string rawText = "\r\nsbc2 login: " + byteString({0xFF, 0xFE}) + "\r\n";
+    const std::string rawTyped = "root\r" + byteString({0xFF});
+    bool rawOk = rig.print(1, rawText) && raw->output == rawText && rig.send(raw, rawTyped) == rawTyped;
+
+    // A browser viewing SBC2 is read-only while the port types on it
+    webSocket->receiveText(0, "CHANNEL:1");
+    rig.run(20);
+    size_t framesBefore = webSocket->frames.size();
+    size_t txBefore = uart.tx.size();
+    webSocket->receiveText(0, "ls\r");
+    rig.run(20);
+    char portNotice[64];
+    snprintf(portNotice, sizeof(portNotice), "TCP port %u is typing on SBC2", (unsigned)(PORT_BASE + 1));
+    const std::vector<uint8_t>& notice = webSocket->frames.back().payload;
+    bool browserReadOnly = uart.tx.size() == txBefore && webSocket->frames.size() > framesBefore &&
+                           std::string(notice.begin(), notice.end()).find(portNotice) != std::string::npos;
+
+    // RFC 2217 client, negotiating as pyserial does; the mux stays with the raw port's console
+    hal::native::FakeTcpConnection* rfc = rfcPort->queueConnection("");
+    rig.run(20);
+    rig.send(rfc, byteString({TELNET_IAC, TELNET_WILL, TELNET_OPTION_COM_PORT, TELNET_IAC, TELNET_WILL,
+                              TELNET_OPTION_BINARY, TELNET_IAC, TELNET_DO, TELNET_OPTION_BINARY, TELNET_IAC,
+                              TELNET_WILL, TELNET_OPTION_SGA, TELNET_IAC, TELNET_DO, TELNET_OPTION_SGA, TELNET_IAC,
+                              TELNET_DO, TELNET_OPTION_ECHO}));
+    bool negotiated = rfc->output == byteString({TELNET_IAC, TELNET_DO, TELNET_OPTION_COM_PORT, TELNET_IAC,
+                                                 TELNET_DO, TELNET_OPTION_BINARY, TELNET_IAC, TELNET_WILL,
+                                                 TELNET_OPTION_BINARY, TELNET_IAC, TELNET_DO, TELNET_OPTION_SGA,
+                                                 TELNET_IAC, TELNET_WILL, TELNET_OPTION_SGA, TELNET_IAC, TELNET_WONT,
+                                                 TELNET_OPTION_ECHO}) &&
+                      selectedChannel() == 1;
+
+    // 9600 7E1; mark parity is refused with the parity in effect
+    rfc->output.clear();
+    rig.send(rfc, comPortCommand(rfc2217::SET_BAUDRATE, byteString({0x00, 0x00, 0x25, 0x80})) +
+                  comPortCommand(rfc2217::SET_DATASIZE, byteString({7})) +
+                  comPortCommand(rfc2217::SET_PARITY, byteString({rfc2217::PARITY_EVEN})) +
+                  comPortCommand(rfc2217::SET_STOPSIZE, byteString({rfc2217::STOPSIZE_1})) +
+                  comPortCommand(rfc2217::SET_PARITY, byteString({4})));
+    const uint8_t server = rfc2217::SERVER_OFFSET;
+    hal::LineConfig line = bridge.getLineSettings(2).config;
+    bool configured = rfc->output == comPortCommand(server + rfc2217::SET_BAUDRATE,
+                                                    byteString({0x00, 0x00, 0x25, 0x80})) +
+                                     comPortCommand(server + rfc2217::SET_DATASIZE, byteString({7})) +
+                                     comPortCommand(server + rfc2217::SET_PARITY, byteString({rfc2217::PARITY_EVEN})) +
+                                     comPortCommand(server + rfc2217::SET_STOPSIZE, byteString({rfc2217::STOPSIZE_1})) +
+                                     comPortCommand(server + rfc2217::SET_PARITY, byteString({rfc2217::PARITY_EVEN})) &&
+                      line.baud == 9600 && line.dataBits == 7 && line.parity == hal::Parity::Even && line.stopBits == 1;
+
+    // Typing waits for the raw port to fall silent, then moves the mux;
+    // IAC IAC is one 0xFF for the SBC
+    rfc->output.clear();
+    bool firstRefused = rig.send(rfc, "x").empty() && rfc->output.find("read-only") != std::string::npos;
+    rig.run(5000);
+    const std::string rfcTyped = "echo " + byteString({TELNET_IAC, TELNET_IAC}) + "\r";
+    bool rfcInput = firstRefused && rig.send(rfc, rfcTyped) == "echo " + byteString({0xFF}) + "\r" &&
+                    selectedChannel() == 2 && uart.line.baud == 9600 && uart.line.dataBits == 7;
+
+    // Output: 0xFF doubled for the Telnet client only
+    rfc->output.clear();
+    const std::string prompt = byteString({0xFF}) + " # ";
+    bool rfcOutput = rig.print(2, prompt) && rfc->output == byteString({0xFF, 0xFF}) + " # " &&
+                     raw->output == rawText;
+
+    // BREAK held on SBC3's line, input sent meanwhile waits for its end
+    rfc->output.clear();
+    std::string duringBreak = rig.send(rfc, comPortCommand(rfc2217::SET_CONTROL,
+                                                           byteString({rfc2217::CONTROL_BREAK_ON})) + "y");
+    bool held = uart.breakOn && selectedChannel() == 2;
+    rig.run(250);
+    held = held && uart.breakOn && selectedChannel() == 2;
+    std::string afterBreak = rig.send(rfc, comPortCommand(rfc2217::SET_CONTROL,
+                                                          byteString({rfc2217::CONTROL_BREAK_OFF})));
+    bool breakOk = held && duringBreak.empty() && afterBreak == "y" && !uart.breakOn && uart.breaks == 1 &&
+                   rfc->output == comPortCommand(server + rfc2217::SET_CONTROL,
+                                                 byteString({rfc2217::CONTROL_BREAK_ON})) +
+                                  comPortCommand(server + rfc2217::SET_CONTROL,
+                                                 byteString({rfc2217::CONTROL_BREAK_OFF}));
+
+    // Purge and signature, as pyserial sends them
+    rfc->output.clear();
+    rig.send(rfc, comPortCommand(rfc2217::PURGE_DATA, byteString({rfc2217::PURGE_RECEIVE})) +
+                  comPortCommand(rfc2217::SIGNATURE, ""));
+    const std::string purgeReply = comPortCommand(server + rfc2217::PURGE_DATA, byteString({rfc2217::PURGE_RECEIVE}));
+    bool purged = rfc->output.compare(0, purgeReply.size(), purgeReply) == 0 &&
+                  rfc->output.find("SBC3") != std::string::npos;
+
+    // One client per port
+    hal::native::FakeTcpConnection* second = rfcPort->queueConnection("");
+    rig.run(20);
+    bool busy = second->output == "SBC3 port in use\r\n" && !second->open && rig.ports.connectedClients() == 2;
+
+    // The port's write lock goes with its client
+    rfc->open = false;
+    rig.run(20);
+    webSocket->receiveText(0, "CHANNEL:2");
+    rig.run(20);
+    txBefore = uart.tx.size();
+    webSocket->receiveText(0, "ls\r");
+    rig.run(20);
+    bool released = std::string(uart.tx.begin() + txBefore, uart.tx.end()) == "ls\r" &&
+                    rig.ports.connectedClients() == 1;
+
+    printf("listeners        : %s (ports %u-%u)\n", started && rawPort && rfcPort ? "OK" : "FAIL",
+           (unsigned)PORT_BASE, (unsigned)(PORT_BASE + MAX_CHANNELS - 1));
+    printf("raw client       : %s\n", rawOk ? "OK" : "FAIL");
+    printf("browser blocked  : %s\n", browserReadOnly ? "OK" : "FAIL");
+    printf("rfc2217 options  : %s\n", negotiated ? "OK" : "FAIL");
+    printf("line settings    : %s (%lu %u%c%u)\n", configured ? "OK" : "FAIL", line.baud, line.dataBits,
+           line.parity == hal::Parity::Even ? 'E' : line.parity == hal::Parity::Odd ? 'O' : 'N', line.stopBits);
+    printf("rfc2217 input    : %s\n", rfcInput ? "OK" : "FAIL");
+    printf("rfc2217 output   : %s\n", rfcOutput ? "OK" : "FAIL");
+    printf("break            : %s\n", breakOk ? "OK" : "FAIL");
+    printf("purge, signature : %s\n", purged ? "OK" : "FAIL");
+    printf("busy port        : %s\n", busy ? "OK" : "FAIL");
+    printf("lock released    : %s\n", released ? "OK" : "FAIL");
+    printf("port bytes       : %lu sent, %lu received\n", rig.ports.getSentBytes(), rig.ports.getReceivedBytes());
+    bool ok = started && rawPort && rfcPort && rawOk && browserReadOnly && negotiated && configured && rfcInput &&
+              rfcOutput && breakOk && purged && busy && released;
+    return ok ? 0 : 1;
+}
+
+/**
+ * Counts the heap allocations made inside firmware calls, leaving out what
+ * the harness allocates between them
+ */
+struct AllocationMeter {
+    unsigned long allocations = 0;
+    unsigned long bytes = 0;
+
+    template <typename Call>
+    void run(Call call) {
+        unsigned long before = hal::native::heapAllocations();
+        unsigned long beforeBytes = hal::native::heapAllocatedBytes();
+        call();
+        allocations += hal::native::heapAllocations() - before;
+        bytes += hal::native::heapAllocatedBytes() - beforeBytes;
+    }
+};
+
+int runAlloc(const Options& options) {
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    PortServer ports;
+    SerialBridge& bridge = pipeline.serialBridge;
+    hal::native::FakeWebSocket& webSocket = *pipeline.webSocket;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    if (!ports.begin(&bridge, &pipeline.webSocketServer)) {
+        return 1;
+    }
+
+    // Every kind of client at once: terminal (0, the writer), channel
+    // protocol, compressed terminal, a raw TCP port and a keep-alive HTTP
+    // connection that fetches the page and /metrics in turn
+    webSocket.captureFrames = false;
+    webSocket.connect(1, "/?proto=1");
+    webSocket.connect(2, "/?compress=lz");
+    hal::native::FakeTcpConnection* page = hal::native::tcpServerOnPort(HTTP_PORT)->queueConnection("");
+    hal::native::FakeTcpConnection* raw = hal::native::tcpServerOnPort(PORT_BASE)->queueConnection("");
+    static const char* const REQUESTS[] = {
+        "GET / HTTP/1.1\r\nHost: sbcmux\r\n\r\n",
+        "GET /metrics HTTP/1.1\r\nHost: sbcmux\r\n\r\n",
+    };
+    static const char PACE[] = "PACE:0,0,0,0";
+    const std::string boot = syntheticBootLog(1 << 20);
+    const size_t bytesPerMs = options.baud / 10 / 1000;
+
+    AllocationMeter warmUp;
+    AllocationMeter steady;
+    size_t fed = 0;
+    size_t requests = 0;
+    size_t served = 0;
+    size_t commands = 0;
+    size_t keystrokes = 0;
+    unsigned long frames = 0;
+    unsigned long payload = 0;
+    size_t portBytes = 0;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    const unsigned long warmUpMs = 2000;
+    const unsigned long endMs = warmUpMs + options.seconds * 1000;
+
+    for (unsigned long now = clock.millis(); now < endMs; clock.delay(1), now = clock.millis()) {
+        AllocationMeter& meter = now < warmUpMs ? warmUp : steady;
+        if (now == warmUpMs) {
+            // Steady state from here on: the fakes' own buffers get room for
+            // the whole run so that only firmware allocations are counted
+            frames = webSocket.textFrames + webSocket.binaryFrames;
+            payload = webSocket.payloadBytes;
+            uart.tx.reserve(uart.tx.size() + options.seconds * 64);
+            uart.txDoneUs.reserve(uart.txDoneUs.size() + options.seconds * 64);
+            hal::native::fakeGpio().writes.reserve(hal::native::fakeGpio().writes.size() + 1024);
+            page->output.reserve(2 * page->output.capacity());
+            raw->output.reserve(2 * options.baud / 10);
+        }
+
+        size_t count = bytesPerMs;
+        size_t offset = fed % boot.size();
+        if (count > boot.size() - offset) count = boot.size() - offset;
+        uart.inject((const uint8_t*)boot.data() + offset, count);
+        fed += count;
+
+        if (now % 100 == 50) {
+            meter.run([&] { webSocket.receiveText(0, "a"); });
+            keystrokes++;
+        }
+        if (now % 1000 == 500) {
+            meter.run([&] { webSocket.receiveText(0, PACE); });
+            commands++;
+            std::vector<HttpResponse> responses = parseResponses(page->output);
+            if (responses.size() == 1 && responses[0].status == 200) served++;
+            portBytes += raw->output.size();
+            page->output.clear();
+            raw->output.clear();
+            const char* request = REQUESTS[requests++ % 2];
+            page->input.insert(page->input.end(), request, request + strlen(request));
+        }
+
+        if (now >= nextPumpMs) {
+            meter.run([&] { bridge.pump(); });
+            nextPumpMs = now + UART_TASK_PERIOD_MS;
+        }
+        if (now >= nextNetworkMs) {
+            meter.run([&] {
+                pipeline.webSocketServer.loop();
+                ports.loop();
+                bridge.forward();
+            });
+            nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+        }
+        logger().drain(hal::console());
+    }
+    portBytes += raw->output.size();
+    frames = webSocket.textFrames + webSocket.binaryFrames - frames;
+    payload = webSocket.payloadBytes - payload;
+    size_t typed = uart.tx.size();
+
+    // The last request is still being answered when the run ends
+    bool flowed = payload > 0 && portBytes > 0 && served + 1 >= requests && typed == keystrokes;
+    bool allocationFree = steady.allocations == 0;
+
+    printf("forwarded        : %zu bytes fed, %lu frames (%lu bytes) to 3 clients, %zu bytes to the TCP port\n", fed,
+           frames, payload, portBytes);
+    printf("requests         : %zu of %zu HTTP served, %zu commands, %zu keystrokes (%zu bytes typed), %s\n", served,
+           requests, commands, keystrokes, typed, flowed ? "OK" : "STALLED");
+    printf("warm-up          : %lu allocations, %lu bytes\n", warmUp.allocations, warmUp.bytes);
+    printf("steady state     : %lu allocations, %lu bytes in %lu s, %s\n", steady.allocations, steady.bytes,
+           options.seconds, allocationFree ? "OK" : "NOT ALLOCATION-FREE");
+    bool ok = flowed && allocationFree;
+    printf("alloc            : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Tiles the OLED model marked over one stretch of display refreshes
+ */
+struct ScreenPhase {
+    size_t tiles = 0;
+    bool header = false;
+    uint16_t columns = 0;
+    uint8_t peak[MAX_CHANNELS] = {};
+};
+
+/**
+ * Tile columns of a channel's activity bar
+ */
+uint16_t barColumns(uint8_t channel) {
+    uint16_t columns = 0;
+    for (unsigned x = StatusScreen::barX(channel); x < StatusScreen::barX(channel) + StatusScreen::barWidth(); x++) {
+        columns |= 1u << (x / 8);
+    }
+    return columns;
+}
+
+int runDisplay(const Options& options) {
+    if (MAX_CHANNELS < 3) {
+        fprintf(stderr, "the display mode needs 3 channels\n");
+        return 2;
+    }
+    Pipeline pipeline;
+    if (!pipeline.init(options.baud)) {
+        return 1;
+    }
+    SerialBridge& bridge = pipeline.serialBridge;
+    hal::native::FakeUart& uart = hal::native::fakeSbcUart();
+    hal::native::SimClock& clock = hal::native::simClock();
+    StatusScreen screen;
+    const std::string boot = syntheticBootLog(1 << 20);
+    size_t fed = 0;
+    size_t tiles = 0;
+    unsigned long nextPumpMs = 0;
+    unsigned long nextNetworkMs = 0;
+    unsigned long nextRefreshMs = 0;
+    unsigned long startMs = clock.millis();
+
+    // Task pipeline schedule with the display task refreshing the model;
+    // the interactive SBC prints bytesPerSecond meanwhile
+    auto phase = [&](unsigned long ms, unsigned long bytesPerSecond) {
+        ScreenPhase result;
+        unsigned long start = clock.millis();
+        size_t printed = 0;
+        for (unsigned long end = start + ms; clock.millis() < end; clock.delay(1)) {
+            unsigned long now = clock.millis();
+            size_t due = (size_t)((uint64_t)(now + 1 - start) * bytesPerSecond / 1000) - printed;
+            size_t count = std::min(due, boot.size() - fed % boot.size());
+            uart.inject((const uint8_t*)boot.data() + fed % boot.size(), count);
+            fed += count;
+            printed += count;
+            if (now >= nextPumpMs) {
+                bridge.pump();
+                nextPumpMs = now + UART_TASK_PERIOD_MS;
+            }
+            if (now >= nextNetworkMs) {
+                pipeline.webSocketServer.loop();
+                bridge.forward();
+                nextNetworkMs = now + NETWORK_TASK_PERIOD_MS;
+            }
+            if (now >= nextRefreshMs) {
+                unsigned long rxBytes[MAX_CHANNELS];
+                for (uint8_t i = 0; i < MAX_CHANNELS; i++) {
+                    rxBytes[i] = bridge.getChannelCounters(i).rxBytes;
+                }
+                screen.update("123", pipeline.webSocketServer.hasConnectedClients(),
+                              pipeline.webSocketServer.getCurrentChannel(), rxBytes, now);
+                result.tiles += screen.dirtyTiles();
+                result.header = result.header || screen.isHeaderDirty();
+                result.columns |= screen.getDirtyBarColumns();
+                for (uint8_t i = 0; i < MAX_CHANNELS; i++) {
+                    result.peak[i] = std::max(result.peak[i], screen.getBarHeight(i));
+                }
+                screen.markSent();
+                nextRefreshMs = now + DISPLAY_REFRESH_MS;
+            }
+        }
+        logger().drain(hal::console());
+        tiles += result.tiles;
+        return result;
+    };
+    const size_t allTiles = StatusScreen::TILE_COLUMNS * StatusScreen::TILE_ROWS;
+    const unsigned long lineRate = options.baud / 10;
+
+    // First refresh draws everything, then an idle box sends nothing
+    ScreenPhase first = phase(1000, 0);
+    ScreenPhase idle = phase(10000, 0);
+    bool idleOk = first.tiles == allTiles && idle.tiles == 0;
+
+    // SBC1 prints at line rate, then stops: only its bar's tiles change
+    ScreenPhase chatter = phase(5000, lineRate);
+    ScreenPhase quiet = phase(1000, 0);
+    uint8_t expected = StatusScreen::barHeight(lineRate);
+    bool chatterOk = !chatter.header && (chatter.columns & ~barColumns(0)) == 0 && chatter.peak[0] == expected &&
+                     screen.getBarHeight(0) == 0 && !quiet.header && (quiet.columns & ~barColumns(0)) == 0;
+
+    // Switching to SBC3 redraws the header and moves the marker
+    pipeline.webSocket->receiveText(0, "CHANNEL:2");
+    ScreenPhase switched = phase(1000, 0);
+    bool switchOk = switched.header && switched.columns == (barColumns(0) | barColumns(2));
+
+    // One prompt shows as a short blip on SBC3's bar
+    static const char PROMPT[] = "login: ";
+    uart.inject((const uint8_t*)PROMPT, strlen(PROMPT));
+    ScreenPhase prompt = phase(1000, 0);
+    bool promptOk = prompt.peak[2] > 0 && prompt.peak[2] < expected && !prompt.header &&
+                    (prompt.columns & ~barColumns(2)) == 0 && screen.getBarHeight(2) == 0;
+
+    unsigned long elapsedMs = clock.millis() - startMs;
+    size_t fullRedraws = elapsedMs / 800 * allTiles;
+
+    printf("idle             : %zu tiles on the first refresh, %zu in 10 s, %s\n", first.tiles, idle.tiles,
+           idleOk ? "OK" : "REDRAWN");
+    printf("chatter          : SBC1 bar %u (expected %u), %zu tiles, %zu tiles once quiet, %s\n", chatter.peak[0],
+           expected, chatter.tiles, quiet.tiles, chatterOk ? "OK" : "WRONG");
+    printf("switch           : %zu tiles, header %s, marker columns 0x%03x, %s\n", switched.tiles,
+           switched.header ? "redrawn" : "kept", switched.columns, switchOk ? "OK" : "WRONG");
+    printf("prompt           : SBC3 bar %u, %zu tiles, %s\n", prompt.peak[2], prompt.tiles, promptOk ? "OK" : "WRONG");
+    printf("I2C              : %zu tiles in %lu s, %zu with a full redraw every 800 ms\n", tiles, elapsedMs / 1000,
+           fullRedraws);
+    bool ok = idleOk && chatterOk && switchOk && promptOk;
+    printf("display          : %s\n", ok ? "OK" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int runUtf8Bench(const Options& options) {
+    std::string log = syntheticBootLog(options.bytes);
+    benchUtf8("synthetic boot log", log);
+
+    std::string ascii(options.bytes, 'x');
+    for (size_t i = 0; i < ascii.size(); i += 64) {
+        ascii[i] = '\n';
+    }
+    benchUtf8("plain ASCII", ascii);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    hal::native::stdoutConsole().muted = !options.verbose;
+
+    if (options.utf8Bench) {
+        return runUtf8Bench(options);
+    }
+    if (options.paste) {
+        return runPaste(options);
+    }
+    if (options.http) {
+        return runHttp(options);
+    }
+    if (options.muxPins) {
+        return runMuxPins();
+    }
+    if (options.switching) {
+        return runSwitch(options);
+    }
+    if (options.autoBaud) {
+        return runAutoBaud(options);
+    }
+    if (options.record) {
+        return runRecord(options);
+    }
+    if (options.metrics) {
+        return runMetrics(options);
+    }
+    if (options.trace) {
+        return runTrace(options);
+    }
+    if (options.triggers) {
+        return runTriggers(options);
+    }
+    if (options.compress) {
+        return runCompress(options);
+    }
+    if (options.ports) {
+        return runPorts();
+    }
+    if (options.alloc) {
+        return runAlloc(options);
+    }
+    if (options.display) {
+        return runDisplay(options);
+    }
+    return options.scan ? runScan(options) : runForward(options);
+}
@@ -1,3 +1,4 @@
+#include "logger.h"
 #include "oled_manager.h"
 
 bool OLEDManager::init() {
@@ -30,11 +31,11 @@ bool OLEDManager::init() {
     display->sendBuffer();
     
     initialized = true;
-    Serial.println("OLED display initialized with u8g2");
+    LOG_INFO("OLED display initialized with u8g2\r\n");
     return true;
 }
 
-void OLEDManager::displayIP(const String& ipLast3) {
+void OLEDManager::displayIP(const char* ipLast3) {
     if (!initialized || !display) {
         return;
     }
@@ -49,7 +50,7 @@ void OLEDManager::displayIP(const String& ipLast3) {
     
     // Display IP digits in larger font
     display->setFont(u8g2_font_10x20_tf);  // Larger font for IP
-    int ip_width = display->getStrWidth(ipLast3.c_str());
+    int ip_width = display->getStrWidth(ipLast3);
     display->setCursor((DISPLAY_WIDTH - ip_width) / 2, 35);
     display->print(ipLast3);
     
@@ -57,31 +58,80 @@ void OLEDManager::displayIP(const String& ipLast3) {
     display->setFont(u8g2_font_6x10_tf);
     
     display->sendBuffer();
+    screen.invalidate();
 }
 
-void OLEDManager::displayStatus(const String& ipLast3, bool wsConnected, int sbcChannel) {
+void OLEDManager::displayStatus(const char* ipLast3, bool wsConnected, int sbcChannel, const unsigned long* rxBytes) {
     if (!initialized || !display) {
         return;
     }
-    
-    display->clearBuffer();
-    
-    // Top: IP address last 3 digits (larger font)
+
+    // Unchanged screen: no I2C transfer at all
+    if (!screen.update(ipLast3, wsConnected, sbcChannel, rxBytes, millis())) {
+        return;
+    }
+
+    if (screen.isHeaderDirty()) {
+        drawHeader();
+        display->updateDisplayArea(0, 0, StatusScreen::TILE_COLUMNS, StatusScreen::HEADER_TILE_ROWS);
+    }
+
+    // Send each run of changed tile columns in the bar rows
+    uint16_t columns = screen.getDirtyBarColumns();
+    if (columns) {
+        drawBars();
+        uint8_t barRows = StatusScreen::TILE_ROWS - StatusScreen::HEADER_TILE_ROWS;
+        for (uint8_t column = 0; column < StatusScreen::TILE_COLUMNS;) {
+            if (!(columns & (1u << column))) {
+                column++;
+                continue;
+            }
+            uint8_t first = column;
+            while (column < StatusScreen::TILE_COLUMNS && (columns & (1u << column))) {
+                column++;
+            }
+            display->updateDisplayArea(first, StatusScreen::HEADER_TILE_ROWS, column - first, barRows);
+        }
+    }
+    screen.markSent();
+}
+
+void OLEDManager::drawHeader() {
+    display->setDrawColor(0);
+    display->drawBox(0, 0, DISPLAY_WIDTH, StatusScreen::BAR_TOP);
+    display->setDrawColor(1);
+
+    // IP address last 3 digits on the left, channel on the right (larger font)
     display->setFont(u8g2_font_10x20_tf);
-    int ip_width = display->getStrWidth(ipLast3.c_str());
-    display->setCursor((DISPLAY_WIDTH - ip_width) / 2, 20);
-    display->print(ipLast3);
-    
-    // Bottom: SBC status (larger font)
-    String statusText = wsConnected ? String(sbcChannel + 1) : "X";
-    int status_width = display->getStrWidth(statusText.c_str());
-    display->setCursor((DISPLAY_WIDTH - status_width) / 2, 38);
-    display->print(statusText);
-    
+    display->setCursor(0, 18);
+    display->print(screen.getIpText());
+    int status_width = display->getStrWidth(screen.getChannelText());
+    display->setCursor(DISPLAY_WIDTH - status_width, 18);
+    display->print(screen.getChannelText());
+
     // Reset to normal font
     display->setFont(u8g2_font_6x10_tf);
-    
-    display->sendBuffer();
+}
+
+void OLEDManager::drawBars() {
+    display->setDrawColor(0);
+    display->drawBox(0, StatusScreen::BAR_TOP, DISPLAY_WIDTH, DISPLAY_HEIGHT - StatusScreen::BAR_TOP);
+    display->setDrawColor(1);
+
+    // Marker row over the interactive channel, then a floor and a bar per channel
+    uint8_t width = StatusScreen::barWidth();
+    int interactive = screen.getInteractiveChannel();
+    if (interactive >= 0 && interactive < MAX_CHANNELS) {
+        display->drawHLine(StatusScreen::barX(interactive), StatusScreen::BAR_TOP, width);
+    }
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        uint8_t x = StatusScreen::barX(channel);
+        uint8_t height = screen.getBarHeight(channel);
+        display->drawHLine(x, DISPLAY_HEIGHT - 1, width);
+        if (height) {
+            display->drawBox(x, DISPLAY_HEIGHT - 1 - height, width, height);
+        }
+    }
 }
 
 void OLEDManager::clear() {
@@ -91,6 +141,7 @@ void OLEDManager::clear() {
     
     display->clearBuffer();
     display->sendBuffer();
+    screen.invalidate();
 }
 
 void OLEDManager::update() {
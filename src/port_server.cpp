@@ -0,0 +1,415 @@
+#include "port_server.h"
+#include "line_settings.h"
+#include "logger.h"
+#include "serial_bridge.h"
+#include "websocket_server.h"
+
+#include <mutex>
+#include <stdio.h>
+
+bool PortServer::begin(SerialBridge* bridge, WebSocketServer* server) {
+    this->bridge = bridge;
+    this->server = server;
+
+    bool started = true;
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        hal::TcpServer* listener = hal::createTcpServer(PORT_BASE + channel);
+        if (!listener || !listener->begin()) {
+            LOG_ERROR("TCP port %u failed to start\r\n", (unsigned)(PORT_BASE + channel));
+            started = false;
+            continue;
+        }
+        ports[channel].listener = listener;
+    }
+    LOG_INFO("TCP ports %u-%u serve SBC1-SBC%u (raw or RFC 2217)\r\n", (unsigned)PORT_BASE,
+             (unsigned)(PORT_BASE + MAX_CHANNELS - 1), (unsigned)MAX_CHANNELS);
+    return started;
+}
+
+void PortServer::loop() {
+    if (!bridge || !server) return;
+
+    unsigned long now = hal::clock().millis();
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        Port& port = ports[channel];
+        if (!port.listener) continue;
+
+        if (port.client && !port.client->connected()) {
+            close(channel);
+        }
+        hal::TcpConnection* incoming = port.listener->accept();
+        if (incoming) {
+            accept(channel, incoming);
+        }
+        if (!port.client) continue;
+
+        if (port.mode == Mode::Detecting && now - port.connectedAt >= PORT_DETECT_MS) {
+            port.mode = Mode::Raw;
+        }
+        receive(channel);
+        sendOutput(channel);
+    }
+}
+
+size_t PortServer::connectedClients() const {
+    size_t count = 0;
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        if (ports[channel].client) count++;
+    }
+    return count;
+}
+
+void PortServer::accept(uint8_t channel, hal::TcpConnection* connection) {
+    Port& port = ports[channel];
+    if (port.client) {
+        char notice[40];
+        int noticeLength = snprintf(notice, sizeof(notice), "SBC%u port in use\r\n", channel + 1);
+        connection->write((const uint8_t*)notice, noticeLength);
+        connection->stop();
+        return;
+    }
+
+    hal::TcpServer* listener = port.listener;
+    port = Port();
+    port.listener = listener;
+    port.client = connection;
+    port.connectedAt = hal::clock().millis();
+    {
+        std::lock_guard<SerialBridge> guard(*bridge);
+        port.sentSequence = bridge->getScrollback().endSequence(channel);
+    }
+    server->attachPort(channel);
+    LOG_INFO("TCP port %u: client connected to SBC%u\r\n", (unsigned)(PORT_BASE + channel), channel + 1);
+}
+
+void PortServer::close(uint8_t channel) {
+    Port& port = ports[channel];
+    port.client->stop();
+    port.client = nullptr;
+
+    // A BREAK must not outlive the client that started it
+    if (bridge->isBreakRequested(channel)) {
+        bridge->setBreak(channel, false);
+    }
+    server->detachPort(channel);
+    LOG_INFO("TCP port %u: client disconnected\r\n", (unsigned)(PORT_BASE + channel));
+}
+
+void PortServer::receive(uint8_t channel) {
+    Port& port = ports[channel];
+
+    // Read no more than the SBC's queue takes: what TCP holds back slows the
+    // client down instead of input being dropped
+    size_t room = TX_QUEUE_SIZE - bridge->pendingWrite(channel);
+    size_t limit = room < CHUNK_SIZE ? room : CHUNK_SIZE;
+    if (limit == 0) return;
+    size_t count = port.client->read(inputChunk, limit);
+    if (count == 0) return;
+
+    if (port.mode == Mode::Detecting) {
+        port.mode = inputChunk[0] == TELNET_IAC ? Mode::Telnet : Mode::Raw;
+        LOG_DEBUG("TCP port %u: %s client\r\n", (unsigned)(PORT_BASE + channel),
+                  port.mode == Mode::Telnet ? "RFC 2217" : "raw");
+    }
+    if (port.mode == Mode::Raw) {
+        queueInput(channel, inputChunk, count);
+        return;
+    }
+
+    // Data goes to the SBC in order with the commands between it (a BREAK
+    // or a new rate takes effect after the bytes sent before it)
+    size_t dataLength = 0;
+    for (size_t i = 0; i < count; i++) {
+        TelnetParser::Event event = port.parser.feed(inputChunk[i]);
+        if (event == TelnetParser::Event::None) continue;
+
+        if (event == TelnetParser::Event::Data) {
+            uint8_t data = port.parser.getData();
+            bool binary = (port.remoteOptions & OPTION_BINARY) != 0;
+            if (data == 0 && port.lastWasCr && !binary) {
+                port.lastWasCr = false;
+                continue;
+            }
+            port.lastWasCr = data == '\r';
+            dataChunk[dataLength++] = data;
+            continue;
+        }
+
+        queueInput(channel, dataChunk, dataLength);
+        dataLength = 0;
+        if (event == TelnetParser::Event::Option) {
+            handleOption(channel, port.parser.getVerb(), port.parser.getOption());
+        } else if (event == TelnetParser::Event::Subnegotiation &&
+                   port.parser.getOption() == TELNET_OPTION_COM_PORT) {
+            handleComPort(channel, port.parser.getSubnegotiation(), port.parser.getSubnegotiationLength());
+        }
+    }
+    queueInput(channel, dataChunk, dataLength);
+}
+
+void PortServer::queueInput(uint8_t channel, const uint8_t* data, size_t length) {
+    if (length == 0) return;
+
+    Port& port = ports[channel];
+    if (!server->claimForPort(channel)) {
+        if (!port.readOnlyNotified) {
+            port.readOnlyNotified = true;
+            char notice[64];
+            int noticeLength = snprintf(notice, sizeof(notice),
+                                        "\r\n[SBC%u is read-only: another client is typing]\r\n", channel + 1);
+            port.client->write((const uint8_t*)notice, noticeLength);
+        }
+        return;
+    }
+    port.readOnlyNotified = false;
+    receivedBytes += bridge->write(channel, data, length);
+}
+
+void PortServer::sendOutput(uint8_t channel) {
+    Port& port = ports[channel];
+    if (port.mode == Mode::Detecting || port.suspended) return;
+
+    for (size_t sent = 0; sent < OUTPUT_CHUNKS_PER_CALL && port.client->writable(); sent++) {
+        size_t count;
+        {
+            std::lock_guard<SerialBridge> guard(*bridge);
+            const Scrollback& history = bridge->getScrollback();
+            uint32_t start = history.endSequence(channel) - (uint32_t)history.size(channel);
+
+            // A client that fell behind by more than the history continues at its oldest byte
+            if ((int32_t)(port.sentSequence - start) < 0) {
+                port.sentSequence = start;
+            }
+            count = history.copy(channel, port.sentSequence - start, outputChunk, CHUNK_SIZE);
+        }
+        if (count == 0) return;
+
+        const uint8_t* data = outputChunk;
+        size_t length = count;
+        if (port.mode == Mode::Telnet) {
+            length = telnetEscape(outputChunk, count, escapedChunk);
+            data = escapedChunk;
+        }
+        // A short write means the connection failed: it is closed on the next call
+        port.client->write(data, length);
+        port.sentSequence += (uint32_t)count;
+        sentBytes += count;
+    }
+}
+
+void PortServer::handleOption(uint8_t channel, uint8_t verb, uint8_t option) {
+    Port& port = ports[channel];
+    uint8_t bit = option == TELNET_OPTION_BINARY ? OPTION_BINARY :
+                  option == TELNET_OPTION_SGA ? OPTION_SGA :
+                  option == TELNET_OPTION_COM_PORT ? OPTION_COM_PORT : 0;
+
+    // Only answer changes, so two peers never keep confirming each other
+    switch (verb) {
+        case TELNET_DO:
+            if (!bit) {
+                sendOption(channel, TELNET_WONT, option);
+            } else if (!(port.localOptions & bit)) {
+                port.localOptions |= bit;
+                sendOption(channel, TELNET_WILL, option);
+            }
+            break;
+        case TELNET_DONT:
+            if (port.localOptions & bit) {
+                port.localOptions &= ~bit;
+                sendOption(channel, TELNET_WONT, option);
+            }
+            break;
+        case TELNET_WILL:
+            if (!bit) {
+                sendOption(channel, TELNET_DONT, option);
+            } else if (!(port.remoteOptions & bit)) {
+                port.remoteOptions |= bit;
+                sendOption(channel, TELNET_DO, option);
+            }
+            break;
+        case TELNET_WONT:
+            if (port.remoteOptions & bit) {
+                port.remoteOptions &= ~bit;
+                sendOption(channel, TELNET_DONT, option);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void PortServer::handleComPort(uint8_t channel, const uint8_t* command, size_t length) {
+    if (length == 0) return;
+
+    Port& port = ports[channel];
+    const uint8_t code = command[0];
+    const uint8_t* value = command + 1;
+    const size_t valueLength = length - 1;
+    // Every command but the signature and the flow control suspension carries a value
+    if (valueLength == 0 && code != rfc2217::SIGNATURE && code != rfc2217::FLOWCONTROL_SUSPEND &&
+        code != rfc2217::FLOWCONTROL_RESUME) {
+        return;
+    }
+
+    // Values out of range, or settings the UART lacks (mark and space parity,
+    // 1.5 stop bits), leave the setting as it is: the reply tells the client
+    LineSettings settings = bridge->getLineSettings(channel);
+    hal::LineConfig& config = settings.config;
+    bool changed = false;
+    uint8_t reply[4];
+    size_t replyLength = 1;
+
+    switch (code) {
+        case rfc2217::SIGNATURE: {
+            if (valueLength > 0) return;  // The client's signature
+            char signature[32];
+            int signatureLength = snprintf(signature, sizeof(signature), "ESP32-C3 serial mux SBC%u", channel + 1);
+            sendSubnegotiation(channel, code, (const uint8_t*)signature, signatureLength);
+            return;
+        }
+
+        case rfc2217::SET_BAUDRATE: {
+            if (valueLength < 4) return;
+            unsigned long baud = ((unsigned long)value[0] << 24) | ((unsigned long)value[1] << 16) |
+                                 ((unsigned long)value[2] << 8) | value[3];
+            if (baud >= LINE_BAUD_MIN && baud <= LINE_BAUD_MAX) {
+                config.baud = baud;
+                settings.autoBaud = false;
+                changed = true;
+            }
+            reply[0] = (uint8_t)(config.baud >> 24);
+            reply[1] = (uint8_t)(config.baud >> 16);
+            reply[2] = (uint8_t)(config.baud >> 8);
+            reply[3] = (uint8_t)config.baud;
+            replyLength = 4;
+            break;
+        }
+
+        case rfc2217::SET_DATASIZE:
+            if (value[0] >= 5 && value[0] <= 8) {
+                config.dataBits = value[0];
+                changed = true;
+            }
+            reply[0] = config.dataBits;
+            break;
+
+        case rfc2217::SET_PARITY:
+            if (value[0] >= rfc2217::PARITY_NONE && value[0] <= rfc2217::PARITY_EVEN) {
+                config.parity = value[0] == rfc2217::PARITY_ODD ? hal::Parity::Odd :
+                                value[0] == rfc2217::PARITY_EVEN ? hal::Parity::Even : hal::Parity::None;
+                changed = true;
+            }
+            reply[0] = config.parity == hal::Parity::Odd ? rfc2217::PARITY_ODD :
+                    config.parity == hal::Parity::Even ? rfc2217::PARITY_EVEN : rfc2217::PARITY_NONE;
+            break;
+
+        case rfc2217::SET_STOPSIZE:
+            if (value[0] == rfc2217::STOPSIZE_1 || value[0] == rfc2217::STOPSIZE_2) {
+                config.stopBits = value[0];
+                changed = true;
+            }
+            reply[0] = config.stopBits == 2 ? rfc2217::STOPSIZE_2 : rfc2217::STOPSIZE_1;
+            break;
+
+        case rfc2217::SET_CONTROL:
+            reply[0] = handleControl(channel, value[0]);
+            break;
+
+        case rfc2217::NOTIFY_LINESTATE:
+            reply[0] = 0;  // No line errors to report
+            break;
+
+        case rfc2217::NOTIFY_MODEMSTATE:
+            reply[0] = MODEM_STATE;
+            break;
+
+        case rfc2217::FLOWCONTROL_SUSPEND:
+        case rfc2217::FLOWCONTROL_RESUME:
+            port.suspended = code == rfc2217::FLOWCONTROL_SUSPEND;
+            return;
+
+        case rfc2217::SET_LINESTATE_MASK:
+        case rfc2217::SET_MODEMSTATE_MASK:
+            reply[0] = value[0];  // Nothing is ever notified, whatever the mask
+            break;
+
+        case rfc2217::PURGE_DATA:
+            if (value[0] == rfc2217::PURGE_RECEIVE || value[0] == rfc2217::PURGE_BOTH) {
+                std::lock_guard<SerialBridge> guard(*bridge);
+                port.sentSequence = bridge->getScrollback().endSequence(channel);
+            }
+            if ((value[0] == rfc2217::PURGE_TRANSMIT || value[0] == rfc2217::PURGE_BOTH) &&
+                server->claimForPort(channel)) {
+                bridge->purgeWrite(channel);
+            }
+            reply[0] = value[0];
+            break;
+
+        default:
+            return;  // Unknown commands are ignored (RFC 2217)
+    }
+
+    if (changed) {
+        bridge->setLineSettings(channel, settings);
+    }
+    sendSubnegotiation(channel, code, reply, replyLength);
+}
+
+uint8_t PortServer::handleControl(uint8_t channel, uint8_t value) {
+    Port& port = ports[channel];
+    switch (value) {
+        case rfc2217::CONTROL_BREAK_REQUEST:
+            break;
+        case rfc2217::CONTROL_BREAK_ON:
+            // A BREAK is input: it needs the channel's write lock
+            if (server->claimForPort(channel)) {
+                bridge->setBreak(channel, true);
+            }
+            break;
+        case rfc2217::CONTROL_BREAK_OFF:
+            bridge->setBreak(channel, false);
+            break;
+
+        // The mux carries RX and TX only: DTR and RTS are remembered, not driven
+        case rfc2217::CONTROL_DTR_REQUEST:
+            return port.dtr ? rfc2217::CONTROL_DTR_ON : rfc2217::CONTROL_DTR_OFF;
+        case rfc2217::CONTROL_DTR_ON:
+        case rfc2217::CONTROL_DTR_OFF:
+            port.dtr = value == rfc2217::CONTROL_DTR_ON;
+            return value;
+        case rfc2217::CONTROL_RTS_REQUEST:
+            return port.rts ? rfc2217::CONTROL_RTS_ON : rfc2217::CONTROL_RTS_OFF;
+        case rfc2217::CONTROL_RTS_ON:
+        case rfc2217::CONTROL_RTS_OFF:
+            port.rts = value == rfc2217::CONTROL_RTS_ON;
+            return value;
+
+        default:
+            // No flow control in either direction
+            if (value >= rfc2217::CONTROL_INBOUND_REQUEST && value <= rfc2217::CONTROL_INBOUND_LAST) {
+                return rfc2217::CONTROL_INBOUND_NONE;
+            }
+            return rfc2217::CONTROL_FLOW_NONE;
+    }
+    return bridge->isBreakRequested(channel) ? rfc2217::CONTROL_BREAK_ON : rfc2217::CONTROL_BREAK_OFF;
+}
+
+void PortServer::sendSubnegotiation(uint8_t channel, uint8_t command, const uint8_t* value, size_t length) {
+    // IAC SB COM-PORT-OPTION <command>, the value (at most 32 bytes) escaped, IAC SE
+    uint8_t frame[4 + 2 * 32 + 2];
+    if (length > 32) length = 32;
+    size_t frameLength = 0;
+    frame[frameLength++] = TELNET_IAC;
+    frame[frameLength++] = TELNET_SB;
+    frame[frameLength++] = TELNET_OPTION_COM_PORT;
+    frame[frameLength++] = (uint8_t)(command + rfc2217::SERVER_OFFSET);
+    frameLength += telnetEscape(value, length, frame + frameLength);
+    frame[frameLength++] = TELNET_IAC;
+    frame[frameLength++] = TELNET_SE;
+    ports[channel].client->write(frame, frameLength);
+}
+
+void PortServer::sendOption(uint8_t channel, uint8_t verb, uint8_t option) {
+    const uint8_t frame[3] = {TELNET_IAC, verb, option};
+    ports[channel].client->write(frame, sizeof(frame));
+}
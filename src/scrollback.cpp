@@ -0,0 +1,22 @@
+#include "scrollback.h"
+
+void Scrollback::append(uint8_t channel, const uint8_t* data, size_t length) {
+    if (channel >= MAX_CHANNELS) return;
+    rings[channel].write(data, length);
+    appended[channel] += (uint32_t)length;
+}
+
+size_t Scrollback::size(uint8_t channel) const {
+    if (channel >= MAX_CHANNELS) return 0;
+    return rings[channel].size();
+}
+
+size_t Scrollback::copy(uint8_t channel, size_t offset, uint8_t* buffer, size_t length) const {
+    if (channel >= MAX_CHANNELS) return 0;
+    return rings[channel].copy(offset, buffer, length);
+}
+
+uint32_t Scrollback::endSequence(uint8_t channel) const {
+    if (channel >= MAX_CHANNELS) return 0;
+    return appended[channel];
+}
@@ -0,0 +1,697 @@
+#include "serial_bridge.h"
+#include "logger.h"
+#include "multiplexer.h"
+#include "websocket_server.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void SerialBridge::init(hal::Uart* uart, MultiplexerController* multiplexer, WebSocketServer* server) {
+    this->uart = uart;
+    this->multiplexer = multiplexer;
+    this->server = server;
+    lastOverrunCheck = hal::clock().millis();
+
+    static const unsigned long bootRates[MAX_CHANNELS] = CHANNEL_BAUD_RATES;
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        LineSettings settings;
+        settings.config.baud = UART_BAUD_RATE;
+        if (bootRates[channel] == UART_BAUD_AUTO) {
+            settings.autoBaud = true;
+        } else if (bootRates[channel] != 0) {
+            settings.config.baud = bootRates[channel];
+        }
+        setLineSettings(channel, settings);
+    }
+
+    static const char defaultTriggers[] = TRIGGER_PATTERNS;
+    if (!setTriggers(defaultTriggers, sizeof(defaultTriggers) - 1)) {
+        LOG_WARN("TRIGGER_PATTERNS exceed the matcher's limits, no triggers\r\n");
+    }
+}
+
+void SerialBridge::setRecorder(SessionRecorder* recorder) {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    this->recorder = recorder;
+}
+
+void SerialBridge::loop() {
+    pump();
+    forward();
+}
+
+size_t SerialBridge::pump() {
+    if (!uart || !multiplexer || !server) return 0;
+    pumpTimer.tick(hal::clock().micros());
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    if (!settled()) {
+        return 0;  // The UART drops everything until the fence is over
+    }
+    size_t received = drainUart();
+    applyBreak();
+    if (!breakActive) {
+        transmit(received == 0);
+    }
+
+    // Only move the mux once the UART is empty, so no byte is misattributed,
+    // and not while input for the interactive SBC, its echo or a BREAK is in flight
+    uint8_t interactive = multiplexer->getInteractiveChannel();
+    if (switchState == SwitchState::Live && uart->available() == 0 &&
+        txQueues[interactive].size() == 0 && echoState == EchoState::Idle &&
+        !breakRequested[interactive] && !breakActive && multiplexer->scan(received)) {
+        fenceSwitch();
+    }
+    return received;
+}
+
+void SerialBridge::forward() {
+    if (!uart || !multiplexer || !server) return;
+    forwardTimer.tick(hal::clock().micros());
+
+    size_t forwarded = forwardQueued();
+    server->flushIfDue(forwarded == 0);
+
+    unsigned long nowUs = hal::clock().micros();
+    if (tracer.awaitingFrame()) {
+        tracer.noteSent(server->getOutputStats().liveBytes, nowUs);
+    } else if (tracer.expired(nowUs)) {
+        std::lock_guard<std::recursive_mutex> guard(mutex);
+        tracer.abandon();
+    }
+
+    TriggerAlert alert;
+    for (size_t sent = 0; sent < ALERTS_PER_FORWARD && triggers.popAlert(alert); sent++) {
+        server->notifyTrigger(alert.channel, triggers.getPattern(alert.pattern));
+    }
+
+    unsigned long now = hal::clock().millis();
+    if (now - lastOverrunCheck > OVERRUN_CHECK_MS) {
+        lastOverrunCheck = now;
+        checkOverruns();
+    }
+}
+
+size_t SerialBridge::forwardQueued() {
+    if (forwardQueue.size() == 0) return 0;
+
+    // queuedAtUs is only rewritten once the queue has been emptied here
+    forwardLatency.record(hal::clock().micros() - queuedAtUs.load(std::memory_order_relaxed));
+
+    uint8_t chunk[READ_CHUNK_SIZE];
+    size_t count;
+    size_t total = 0;
+    while ((count = forwardQueue.pop(chunk, sizeof(chunk))) > 0) {
+        // Use buffering system for proper UTF-8 handling
+        for (size_t i = 0; i < count; i++) {
+            server->addToBuffer((char)chunk[i]);
+        }
+        total += count;
+    }
+    return total;
+}
+
+void SerialBridge::lock() {
+    mutex.lock();
+}
+
+void SerialBridge::unlock() {
+    mutex.unlock();
+}
+
+size_t SerialBridge::pendingForward(uint8_t channel) const {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    if (!multiplexer || channel != multiplexer->getInteractiveChannel()) {
+        return 0;
+    }
+    return forwardQueue.size();
+}
+
+void SerialBridge::checkOverruns() {
+    hal::UartStats stats = uart->getStats();
+    unsigned long overruns = stats.ringOverruns + stats.fifoOverflows;
+    if (overruns != reportedOverruns) {
+        LOG_WARN("UART overrun: %lu bytes dropped by the ring, %lu FIFO overflows\r\n",
+                 stats.ringOverruns, stats.fifoOverflows);
+        reportedOverruns = overruns;
+    }
+}
+
+size_t SerialBridge::drainUart() {
+    uint8_t channel = multiplexer->getCurrentChannel();
+    if (channel < MAX_CHANNELS && baudDetectors[channel].isDetecting()) {
+        // Nothing worth recording yet; the ring stays empty until the fence is over
+        if (settled()) {
+            detectBaud(channel);
+        }
+        return 0;
+    }
+    bool interactive = channel == multiplexer->getInteractiveChannel();
+    size_t total = 0;
+
+    uint8_t chunk[READ_CHUNK_SIZE];
+    while (uart->available()) {
+        // Back-pressure: interactive output waits in the UART receive ring
+        // while the network stage is behind, rather than being dropped here
+        size_t length = sizeof(chunk);
+        if (interactive) {
+            size_t space = forwardQueue.capacity() - forwardQueue.size();
+            if (space == 0) break;
+            length = space < length ? space : length;
+        }
+
+        size_t count = uart->read(chunk, length);
+        if (count == 0) break;
+        total += count;
+
+        // Debug: character codes help diagnose communication issues
+        if (interactive) {
+            LOG_TRACE_BYTES(chunk, count);
+        }
+
+        // Only exclude NULL (0) which can cause string termination issues
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (chunk[i] != 0) {
+                chunk[kept++] = chunk[i];
+            }
+        }
+
+        // Every channel is recorded; only the interactive one is forwarded live
+        scrollback.append(channel, chunk, kept);
+        triggers.feed(channel, chunk, kept);
+        if (channel < MAX_CHANNELS) {
+            channelRxBytes[channel].store(channelRxBytes[channel].load(std::memory_order_relaxed) + kept,
+                                          std::memory_order_relaxed);
+        }
+        if (recorder) {
+            recorder->record(channel, chunk, kept);
+        }
+        if (!interactive) {
+            continue;
+        }
+
+        // Follow the echo of the line we sent until the SBC prompts again
+        if (echoState != EchoState::Idle && kept > 0) {
+            if (echoState == EchoState::AwaitLineEnd && memchr(chunk, '\n', kept)) {
+                echoState = EchoState::AwaitPrompt;
+            }
+            lastEchoByte = chunk[kept - 1];
+        }
+
+        if (firstByteDue && kept > 0) {
+            firstByteDue = false;
+            unsigned long waited = hal::clock().micros() - switchStartUs;
+            if (waited < SWITCH_FIRST_BYTE_MS * 1000UL) {
+                switchLatency.record(waited);
+            }
+        }
+
+        // Hand the bytes to the network stage
+        if (forwardQueue.size() == 0) {
+            queuedAtUs.store(hal::clock().micros(), std::memory_order_relaxed);
+        }
+        if (kept > 0) {
+            tracer.noteReceived(channel, liveQueuedBytes, hal::clock().micros());
+        }
+        liveQueuedBytes += forwardQueue.push(chunk, kept);
+    }
+    return total;
+}
+
+bool SerialBridge::selectChannel(uint8_t channel) {
+    if (!multiplexer || !multiplexer->isValidChannel(channel)) {
+        return false;
+    }
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+
+    // Attribute pending bytes and frames to the channel being left
+    if (uart && server) {
+        do {
+            drainUart();
+            forwardQueued();
+        } while (uart->available());
+        server->flushBuffer();
+    }
+
+    // A BREAK ends with the channel's turn
+    uint8_t interactive = multiplexer->getInteractiveChannel();
+    if (channel != interactive) {
+        if (breakActive) {
+            uart->setBreak(false);
+            breakActive = false;
+        }
+        breakRequested[interactive] = false;
+    }
+
+    // Pacing state belongs to the channel being left
+    echoState = EchoState::Idle;
+    txLineDraining = false;
+    txNextUs = hal::clock().micros();
+
+    uint8_t previous = multiplexer->getCurrentChannel();
+    if (!multiplexer->selectChannel(channel)) {
+        return false;
+    }
+    if (uart && previous != channel) {
+        fenceSwitch();
+    }
+    switches++;
+    switchStartUs = hal::clock().micros();
+    firstByteDue = true;
+    return true;
+}
+
+void SerialBridge::fenceSwitch() {
+    // Bytes of the previous channel may still sit in the RX FIFO until it
+    // fills up to its threshold or the line stays idle for the timeout: the
+    // driver hands them over within that many character times, at the
+    // previous channel's rate, plus its wake-up latency
+    unsigned long charUs = uart->getLineConfig().charTimeUs();
+
+    uint8_t channel = multiplexer->getCurrentChannel();
+    if (channel < MAX_CHANNELS) {
+        hal::LineConfig config = lineSettings[channel].config;
+        if (baudDetectors[channel].isDetecting()) {
+            config.baud = baudDetectors[channel].getCandidate();
+        }
+        if (config != uart->getLineConfig()) {
+            uart->setLineConfig(config);
+        }
+    }
+    detectWindowOpen = false;
+
+    // The mux also cuts into the new line mid-character: the receiver takes
+    // a few of its character times to frame on a real start bit
+    unsigned long resyncUs = UART_RX_RESYNC_CHARS * uart->getLineConfig().charTimeUs();
+
+    settleUntilUs = hal::clock().micros() +
+                    (UART_RX_FIFO_THRESHOLD + UART_RX_TIMEOUT_SYMBOLS + 1) * charUs + resyncUs + UART_RX_DELIVERY_US;
+    uart->fenceUntil(settleUntilUs);
+    switchState = SwitchState::Settling;
+}
+
+void SerialBridge::detectBaud(uint8_t channel) {
+    BaudDetector& detector = baudDetectors[channel];
+    if (!detectWindowOpen) {
+        detectWindowOpen = true;
+        detectFramingBase = uart->getStats().framingErrors;
+        uart->startPulseMeasurement();
+    }
+
+    uint8_t chunk[READ_CHUNK_SIZE];
+    size_t count;
+    while ((count = uart->read(chunk, sizeof(chunk))) > 0) {
+        detector.feed(chunk, count);
+    }
+
+    unsigned long pulseNs = uart->getShortestPulseNs();
+    unsigned long framingErrors = uart->getStats().framingErrors - detectFramingBase;
+    switch (detector.evaluate(framingErrors, pulseNs ? 1000000000UL / pulseNs : 0)) {
+        case BaudDetector::Verdict::Listening:
+            break;
+        case BaudDetector::Verdict::Retune:
+            fenceSwitch();
+            break;
+        case BaudDetector::Verdict::Locked:
+            lineSettings[channel].config.baud = detector.getCandidate();
+            LOG_INFO("SBC%u: %lu baud detected after %lu windows\r\n", channel + 1, detector.getCandidate(),
+                     detector.getWindows());
+            if (uart->getLineConfig() != lineSettings[channel].config) {
+                fenceSwitch();
+            }
+            break;
+    }
+}
+
+void SerialBridge::setLineSettings(uint8_t channel, const LineSettings& settings) {
+    if (channel >= MAX_CHANNELS) return;
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    lineSettings[channel] = settings;
+    if (settings.autoBaud) {
+        baudDetectors[channel].start(settings.config.baud);
+    } else {
+        baudDetectors[channel].stop();
+    }
+
+    // Takes effect at once on the channel the mux is on
+    if (uart && multiplexer && multiplexer->getCurrentChannel() == channel &&
+        (settings.autoBaud || settings.config != uart->getLineConfig())) {
+        if (server) {
+            drainUart();
+        }
+        fenceSwitch();
+    }
+}
+
+LineSettings SerialBridge::getLineSettings(uint8_t channel) const {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    return channel < MAX_CHANNELS ? lineSettings[channel] : LineSettings();
+}
+
+void SerialBridge::setBreak(uint8_t channel, bool on) {
+    if (channel >= MAX_CHANNELS) return;
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    if (on && !breakRequested[channel]) {
+        breakMarks[channel] = txQueuedBytes[channel];
+    }
+    breakRequested[channel] = on;
+}
+
+bool SerialBridge::isBreakRequested(uint8_t channel) const {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    return channel < MAX_CHANNELS && breakRequested[channel];
+}
+
+bool SerialBridge::isDetectingBaud(uint8_t channel) const {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    return channel < MAX_CHANNELS && baudDetectors[channel].isDetecting();
+}
+
+bool SerialBridge::settled() {
+    if (switchState == SwitchState::Settling && (long)(hal::clock().micros() - settleUntilUs) >= 0) {
+        switchState = SwitchState::Live;
+    }
+    return switchState == SwitchState::Live;
+}
+
+size_t SerialBridge::write(uint8_t channel, const uint8_t* data, size_t length) {
+    if (!uart || channel >= MAX_CHANNELS) return 0;
+
+    // Single producer: only the network task queues input
+    size_t queued = txQueues[channel].push(data, length);
+    txQueuedBytes[channel] += queued;
+    return queued;
+}
+
+size_t SerialBridge::pendingWrite(uint8_t channel) const {
+    return channel < MAX_CHANNELS ? txQueues[channel].size() : 0;
+}
+
+size_t SerialBridge::purgeWrite(uint8_t channel) {
+    if (channel >= MAX_CHANNELS) return 0;
+
+    // The UART stage only reads the queue under the lock: taking its place
+    // as the consumer is safe while holding it
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    uint8_t chunk[TX_CHUNK_SIZE];
+    size_t count;
+    size_t dropped = 0;
+    while ((count = txQueues[channel].pop(chunk, sizeof(chunk))) > 0) {
+        dropped += count;
+    }
+    // Dropped bytes are no longer on their way: a BREAK must not wait for them
+    txQueuedBytes[channel] -= dropped;
+    if (breakRequested[channel] && (long)(breakMarks[channel] - txQueuedBytes[channel]) > 0) {
+        breakMarks[channel] = txQueuedBytes[channel];
+    }
+    return dropped;
+}
+
+void SerialBridge::traceNextWrite(uint8_t channel, uint32_t id) {
+    if (channel >= MAX_CHANNELS) return;
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    tracer.start(id, channel, txQueuedBytes[channel], hal::clock().micros());
+}
+
+void SerialBridge::setTxPacing(uint8_t channel, const TxPacing& pacing) {
+    if (channel >= MAX_CHANNELS) return;
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    txPacing[channel] = pacing;
+}
+
+TxPacing SerialBridge::getTxPacing(uint8_t channel) const {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    return channel < MAX_CHANNELS ? txPacing[channel] : TxPacing();
+}
+
+void SerialBridge::applyBreak() {
+    uint8_t channel = multiplexer->getInteractiveChannel();
+    if (breakRequested[channel] == breakActive) return;
+
+    if (breakActive) {
+        uart->setBreak(false);
+        breakActive = false;
+        txNextUs = hal::clock().micros();  // Pacing restarts after the BREAK
+        return;
+    }
+
+    // Input queued before the BREAK goes first, and the line must be ours
+    if (breakMarks[channel] != channelTxBytes[channel].load(std::memory_order_relaxed)) return;
+    if (multiplexer->getCurrentChannel() != channel) {
+        drainUart();
+        multiplexer->returnToInteractive();
+        fenceSwitch();
+        return;
+    }
+    if (!uart->txIdle()) return;
+    uart->setBreak(true);
+    breakActive = true;
+}
+
+size_t SerialBridge::transmit(bool lineQuiet) {
+    uint8_t channel = multiplexer->getInteractiveChannel();
+    SpscRing<TX_QUEUE_SIZE>& queue = txQueues[channel];
+    if (queue.size() == 0) return 0;
+
+    const TxPacing& pacing = txPacing[channel];
+    unsigned long nowUs = hal::clock().micros();
+    if (echoState != EchoState::Idle) {
+        bool prompt = echoState == EchoState::AwaitPrompt && lineQuiet &&
+                      lastEchoByte != '\r' && lastEchoByte != '\n';
+        if (!prompt) {
+            if (hal::clock().millis() - txEchoSince < TX_ECHO_TIMEOUT_MS) return 0;
+            txEchoTimeouts++;
+        }
+        echoState = EchoState::Idle;
+    }
+    if (txLineDraining) {
+        if (!uart->txIdle()) return 0;
+        txLineDraining = false;
+        txNextUs = nowUs + pacing.lineDelayMs * 1000UL;
+    }
+    if ((long)(nowUs - txNextUs) < 0) return 0;
+
+    // TX and RX muxes share the select lines: make sure the bytes reach the
+    // interactive SBC and that its echo is captured
+    // Send once the fence is over, so that the echo is not dropped with it
+    if (multiplexer->getCurrentChannel() != channel) {
+        drainUart();
+        multiplexer->returnToInteractive();
+        fenceSwitch();
+        return 0;
+    }
+
+    // The UART spaces the characters itself: what this task writes in one
+    // pass reaches the SBC char_us apart, not back-to-back
+    unsigned long charUs = uart->getLineConfig().charTimeUs();
+    unsigned long gapUs = pacing.charDelayUs > charUs ? pacing.charDelayUs - charUs : 0;
+    unsigned long gapInEffectUs = uart->setTxGap(gapUs);
+
+    size_t limit = uart->availableForWrite();
+    if (limit > TX_CHUNK_SIZE) limit = TX_CHUNK_SIZE;
+    unsigned long base = nowUs;
+    if (pacing.charDelayUs > 0) {
+        // Characters due since the last one, with at most one task period of credit
+        const unsigned long periodUs = UART_TASK_PERIOD_MS * 1000UL;
+        base = nowUs - txNextUs < periodUs ? txNextUs : nowUs - periodUs;
+        size_t due = 1 + (nowUs - base) / pacing.charDelayUs;
+        if (due < limit) limit = due;
+        // A gap longer than the UART can hold: one character at a time,
+        // the next one char_us after this one without credit
+        if (gapInEffectUs < gapUs) {
+            base = nowUs;
+            if (limit > 1) limit = 1;
+        }
+    }
+    // Input queued after a requested BREAK waits for its end
+    bool breakDue = breakRequested[channel];
+    if (breakDue) {
+        unsigned long beforeBreak = breakMarks[channel] - channelTxBytes[channel].load(std::memory_order_relaxed);
+        if (beforeBreak < limit) limit = beforeBreak;
+    }
+    if (limit == 0) return 0;
+
+    // Stop after a line end when lines are paced; the extra byte shows
+    // whether a CR is followed by LF, which belongs to the same line end
+    // (unless it would pass a BREAK)
+    uint8_t chunk[TX_CHUNK_SIZE + 1];
+    size_t count = queue.peek(chunk, breakDue ? limit : limit + 1);
+    bool lineEnd = false;
+    if (pacing.lineDelayMs > 0 || pacing.echoWait) {
+        for (size_t i = 0; i < count && i < limit; i++) {
+            if (chunk[i] == '\r' || chunk[i] == '\n') {
+                count = chunk[i] == '\r' && i + 1 < count && chunk[i + 1] == '\n' ? i + 2 : i + 1;
+                lineEnd = true;
+                break;
+            }
+        }
+    }
+    if (!lineEnd && count > limit) count = limit;
+
+    queue.pop(chunk, count);
+    uart->write(chunk, count);
+    txBytes += count;
+    unsigned long channelTotal = channelTxBytes[channel].load(std::memory_order_relaxed) + count;
+    channelTxBytes[channel].store(channelTotal, std::memory_order_relaxed);
+    tracer.noteTransmitted(channel, channelTotal, hal::clock().micros());
+
+    txNextUs = base + (unsigned long)count * pacing.charDelayUs;
+    if (lineEnd) {
+        txLineDraining = pacing.lineDelayMs > 0;
+        if (pacing.echoWait) {
+            echoState = EchoState::AwaitLineEnd;
+            txEchoSince = hal::clock().millis();
+        }
+    }
+    return count;
+}
+
+void SerialBridge::setScanMode(bool enabled) {
+    if (!multiplexer) return;
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    if (uart && server) {
+        drainUart();
+    }
+    uint8_t previous = multiplexer->getCurrentChannel();
+    multiplexer->setScanMode(enabled);
+    if (uart && multiplexer->getCurrentChannel() != previous) {
+        fenceSwitch();
+    }
+    LOG_INFO("Background scan %s\r\n", enabled ? "enabled" : "disabled");
+}
+
+size_t SerialBridge::formatScanReport(char* buffer, size_t size) const {
+    if (size == 0) return 0;
+    buffer[0] = '\0';
+    if (!multiplexer) return 0;
+
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    size_t length = 0;
+    int written = snprintf(buffer, size, "\r\nScan %s, viewing SBC%u\r\n",
+                           multiplexer->isScanning() ? "on" : "off",
+                           multiplexer->getInteractiveChannel() + 1);
+    if (written > 0) length += written;
+
+    for (uint8_t channel = 0; channel < MAX_CHANNELS && length < size; channel++) {
+        ChannelStats stats = multiplexer->getChannelStats(channel);
+        const LineSettings& line = lineSettings[channel];
+        char format[4];
+        formatLineFormat(format, line.config);
+        written = snprintf(buffer + length, size - length,
+                           "SBC%u dwell=%lums visits=%lu rx=%lu missed~%lu rate=%luB/s history=%u line=%lu %s%s\r\n",
+                           channel + 1, stats.dwellMs, stats.visits, stats.bytesCaptured,
+                           stats.bytesMissed, stats.bytesPerSecond,
+                           (unsigned)scrollback.size(channel), line.config.baud, format,
+                           baudDetectors[channel].isDetecting() ? " detecting" : line.autoBaud ? " auto" : "");
+        if (written > 0) length += written;
+    }
+    if (uart && length < size) {
+        hal::UartStats uartStats = uart->getStats();
+        written = snprintf(buffer + length, size - length,
+                           "UART rx=%lu overruns=%lu fifo=%lu framing=%lu ring peak=%u/%u\r\n",
+                           uartStats.rxBytes, uartStats.ringOverruns, uartStats.fifoOverflows,
+                           uartStats.framingErrors, (unsigned)uartStats.ringPeak,
+                           (unsigned)uartStats.ringCapacity);
+        if (written > 0) length += written;
+    }
+    if (server && length < size) {
+        OutputStats output = server->getOutputStats();
+        written = snprintf(buffer + length, size - length,
+                           "Output frames=%lu (%lu/s) avg=%luB target=%uB rate=%luB/s\r\n",
+                           output.frames, output.framesPerSecond,
+                           output.frames ? output.bytes / output.frames : 0,
+                           (unsigned)output.frameTarget, output.bytesPerSecond);
+        if (written > 0) length += written;
+    }
+    if (length < size) {
+        size_t queued = 0;
+        for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+            queued += txQueues[channel].size();
+        }
+        written = snprintf(buffer + length, size - length, "Input sent=%lu queued=%u echo timeouts=%lu\r\n",
+                           txBytes, (unsigned)queued, txEchoTimeouts);
+        if (written > 0) length += written;
+    }
+    if (uart && length < size) {
+        written = snprintf(buffer + length, size - length,
+                           "Switches=%lu first byte avg=%luus max=%luus (%lu sampled) fenced=%lu\r\n",
+                           switches, switchLatency.getMeanUs(), switchLatency.getMaxUs(),
+                           switchLatency.getCount(), uart->getStats().fencedBytes);
+        if (written > 0) length += written;
+    }
+    if (recorder && length < size) {
+        RecorderStats recording = recorder->getStats();
+        written = snprintf(buffer + length, size - length,
+                           "Recording rx=%lu dropped=%lu flash=%lu commits=%lu (deferred %lu) "
+                           "segment=%lu boot=%u errors=%lu\r\n",
+                           recording.recordedBytes, recording.droppedBytes, recording.storedBytes,
+                           recording.commits, recording.deferredCommits,
+                           recording.segment, recording.boot, recording.writeErrors);
+        if (written > 0) length += written;
+    }
+    if (length < size) {
+        const LatencyStats& pumpPeriods = getPumpPeriods();
+        const LatencyStats& forwardPeriods = getForwardPeriods();
+        written = snprintf(buffer + length, size - length,
+                           "Pipeline uart period avg=%luus max=%luus, net period avg=%luus max=%luus, "
+                           "forward latency avg=%luus max=%luus\r\n",
+                           pumpPeriods.getMeanUs(), pumpPeriods.getMaxUs(),
+                           forwardPeriods.getMeanUs(), forwardPeriods.getMaxUs(),
+                           forwardLatency.getMeanUs(), forwardLatency.getMaxUs());
+        if (written > 0) length += written;
+    }
+    return length < size ? length : size - 1;
+}
+
+const Scrollback& SerialBridge::getScrollback() const {
+    return scrollback;
+}
+
+const LatencyStats& SerialBridge::getPumpPeriods() const {
+    return pumpTimer.getPeriods();
+}
+
+const LatencyStats& SerialBridge::getForwardPeriods() const {
+    return forwardTimer.getPeriods();
+}
+
+const LatencyStats& SerialBridge::getForwardLatency() const {
+    return forwardLatency;
+}
+
+const LatencyStats& SerialBridge::getSwitchLatency() const {
+    return switchLatency;
+}
+
+const KeystrokeTracer& SerialBridge::getTracer() const {
+    return tracer;
+}
+
+bool SerialBridge::setTriggers(const char* list, size_t length) {
+    std::lock_guard<std::recursive_mutex> guard(mutex);
+    return triggers.compile(list, length);
+}
+
+const TriggerMatcher& SerialBridge::getTriggers() const {
+    return triggers;
+}
+
+ChannelCounters SerialBridge::getChannelCounters(uint8_t channel) const {
+    ChannelCounters counters;
+    if (channel < MAX_CHANNELS) {
+        counters.rxBytes = channelRxBytes[channel].load(std::memory_order_relaxed);
+        counters.txBytes = channelTxBytes[channel].load(std::memory_order_relaxed);
+    }
+    return counters;
+}
+
+hal::UartStats SerialBridge::getUartStats() const {
+    return uart ? uart->getStats() : hal::UartStats();
+}
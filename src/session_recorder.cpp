@@ -0,0 +1,725 @@
+#include "session_recorder.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// FNV-1a, 32 bits: catches a block torn by a reset or overwritten by rotation
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+static uint32_t fnv1a(const uint8_t* data, size_t length) {
+    uint32_t hash = FNV_OFFSET;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static void put16(uint8_t* out, uint16_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t* out, uint32_t value) {
+    put16(out, (uint16_t)value);
+    put16(out + 2, (uint16_t)(value >> 16));
+}
+
+static uint16_t get16(const uint8_t* in) {
+    return (uint16_t)(in[0] | (in[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* in) {
+    return get16(in) | ((uint32_t)get16(in + 2) << 16);
+}
+
+static size_t putVarint(uint8_t* out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static size_t varintSize(uint32_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+/**
+ * @return false if the varint runs past end or over 32 bits
+ */
+static bool getVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        if (in >= end) return false;
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Header: storedLength, rawLength, boot, flags, check, firstMs, lastMs, payloadHash
+static const size_t CHECK_OFFSET = 7;
+static const uint8_t CHECK_SEED = 0xA5;
+
+void RecordBlockHeader::encode(uint8_t* out) const {
+    put16(out, storedLength);
+    put16(out + 2, rawLength);
+    put16(out + 4, boot);
+    out[6] = flags;
+    put32(out + 8, firstMs);
+    put32(out + 12, lastMs);
+    put32(out + 16, payloadHash);
+
+    uint8_t check = CHECK_SEED;
+    for (size_t i = 0; i < SIZE; i++) {
+        if (i != CHECK_OFFSET) check ^= out[i];
+    }
+    out[CHECK_OFFSET] = check;
+}
+
+bool RecordBlockHeader::decode(const uint8_t* in) {
+    uint8_t check = CHECK_SEED;
+    for (size_t i = 0; i < SIZE; i++) {
+        if (i != CHECK_OFFSET) check ^= in[i];
+    }
+    if (check != in[CHECK_OFFSET]) return false;
+
+    storedLength = get16(in);
+    rawLength = get16(in + 2);
+    boot = get16(in + 4);
+    flags = in[6];
+    firstMs = get32(in + 8);
+    lastMs = get32(in + 12);
+    payloadHash = get32(in + 16);
+    return storedLength > 0 && storedLength <= RECORD_BLOCK_SIZE && rawLength <= RECORD_BLOCK_SIZE;
+}
+
+void RecordSegment::formatPath(char* buffer, size_t size, size_t slot) {
+    snprintf(buffer, size, "/rec%u.bin", (unsigned)slot);
+}
+
+void RecordSegment::encodeHeader(uint8_t* out, uint16_t boot, uint32_t sequence) {
+    memcpy(out, "SREC", 4);
+    out[4] = VERSION;
+    out[5] = 0;
+    put16(out + 6, boot);
+    put32(out + 8, sequence);
+}
+
+bool RecordSegment::decodeHeader(const uint8_t* in, uint16_t& boot, uint32_t& sequence) {
+    if (memcmp(in, "SREC", 4) != 0 || in[4] != VERSION) return false;
+    boot = get16(in + 6);
+    sequence = get32(in + 8);
+    return true;
+}
+
+bool SessionRecorder::begin(hal::FileSystem* files) {
+    this->files = files;
+
+    // The newest segment is continued
+    bool found = false;
+    uint16_t newestBoot = 0;
+    for (size_t slot = 0; slot < RECORD_SEGMENTS; slot++) {
+        char path[16];
+        RecordSegment::formatPath(path, sizeof(path), slot);
+        if (!files->exists(path)) continue;
+        hal::File* file = files->open(path, "r");
+        if (!file) continue;
+
+        uint8_t header[RecordSegment::HEADER_SIZE];
+        uint16_t segmentBoot;
+        uint32_t segmentSequence;
+        if (file->read(header, sizeof(header)) == sizeof(header) &&
+            RecordSegment::decodeHeader(header, segmentBoot, segmentSequence) &&
+            (!found || (int32_t)(segmentSequence - sequence) > 0)) {
+            found = true;
+            sequence = segmentSequence;
+            newestBoot = segmentBoot;
+        }
+        file->close();
+    }
+
+    if (!found) {
+        LOG_INFO("Recording: new log\r\n");
+        return true;
+    }
+
+    char path[16];
+    RecordSegment::formatPath(path, sizeof(path), sequence % RECORD_SEGMENTS);
+    uint16_t lastBoot = newestBoot;
+    size_t validSize = scanSegment(path, lastBoot);
+    hal::File* file = files->open(path, "r");
+    size_t fileSize = file ? file->size() : 0;
+    if (file) file->close();
+
+    boot = (uint16_t)(lastBoot + 1);
+    // A damaged tail would hide whatever is appended after it
+    segmentSize = validSize > 0 && validSize == fileSize ? validSize : RECORD_SEGMENT_BYTES;
+    LOG_INFO("Recording: boot %u, segment %lu at %u bytes\r\n", boot, (unsigned long)sequence, (unsigned)validSize);
+    return true;
+}
+
+size_t SessionRecorder::scanSegment(const char* path, uint16_t& lastBoot) {
+    hal::File* file = files->open(path, "r");
+    if (!file) return 0;
+
+    size_t position = RecordSegment::HEADER_SIZE;
+    size_t size = file->size();
+    uint8_t bytes[RecordBlockHeader::SIZE];
+    RecordBlockHeader header;
+    while (file->seek(position) && file->read(bytes, sizeof(bytes)) == sizeof(bytes) && header.decode(bytes) &&
+           position + sizeof(bytes) + header.storedLength <= size) {
+        lastBoot = header.boot;
+        position += sizeof(bytes) + header.storedLength;
+    }
+    file->close();
+    return position <= size ? position : 0;
+}
+
+void SessionRecorder::record(uint8_t channel, const uint8_t* data, size_t length) {
+    if (!files || length == 0) return;
+    unsigned long now = hal::clock().millis();
+    lastOutputMs.store(now, std::memory_order_relaxed);
+    bump(arrivedBytes, length);
+    if (channel >= 32 || !(channelMask.load(std::memory_order_relaxed) & (1UL << channel))) return;
+
+    while (length > 0) {
+        size_t count = length < ENTRY_MAX_DATA ? length : ENTRY_MAX_DATA;
+        // All or nothing: the consumer would take a partial entry for the
+        // start of the next one. Free space only grows meanwhile (single producer).
+        if (queue.capacity() - queue.size() < ENTRY_HEADER_SIZE + count) {
+            bump(droppedBytes, length);
+            gapChannels |= 1UL << channel;
+            return;
+        }
+        uint8_t header[ENTRY_HEADER_SIZE];
+        header[0] = channel;
+        if (gapChannels & (1UL << channel)) {
+            header[0] |= RecordBlockHeader::CHANNEL_GAP;
+            gapChannels &= ~(1UL << channel);
+        }
+        put32(header + 1, (uint32_t)now);
+        put16(header + 5, (uint16_t)count);
+        queue.push(header, sizeof(header));
+        queue.push(data, count);
+        bump(recordedBytes, count);
+        data += count;
+        length -= count;
+    }
+}
+
+void SessionRecorder::loop() {
+    if (!files) return;
+    unsigned long now = hal::clock().millis();
+    bool quiet = now - lastOutputMs.load(std::memory_order_relaxed) >= RECORD_QUIET_MS;
+    // Output slow enough for the RX FIFO, above its interrupt threshold, to
+    // hold what arrives while a commit halts the CPU
+    unsigned long arrived = arrivedBytes.load(std::memory_order_relaxed);
+    unsigned long elapsedMs = now - rateSinceMs;
+    bool slow = elapsedMs > 0 &&
+                (arrived - rateBytes) * RECORD_COMMIT_STALL_MS <= (UART_RX_FIFO_SIZE - UART_RX_FIFO_THRESHOLD) * elapsedMs;
+    rateBytes = arrived;
+    rateSinceMs = now;
+    bool mayCommit = quiet || slow;
+
+    drainQueue(mayCommit);
+
+    bool due = commitLength >= RECORD_COMMIT_BYTES || (pending && now - pendingSinceMs >= RECORD_FLUSH_MS);
+    if (!due) return;
+    if (!mayCommit) {
+        commitDeferred = true;
+        return;
+    }
+    if (blockLength > 0 && commitLength < RECORD_COMMIT_BYTES) {
+        sealBlock();  // Flush interval: take the partial block along
+    }
+    commit();
+}
+
+void SessionRecorder::flush() {
+    if (!files) return;
+    drainQueue(true);
+    if (blockLength > 0 && !sealBlock()) {
+        commit();
+        sealBlock();
+    }
+    commit();
+}
+
+void SessionRecorder::drainQueue(bool mayCommit) {
+    for (;;) {
+        if (!entryOpen) {
+            if (queue.size() < ENTRY_HEADER_SIZE) return;
+            uint8_t header[ENTRY_HEADER_SIZE];
+            queue.pop(header, sizeof(header));
+            entryChannel = header[0];
+            entryMs = get32(header + 1);
+            entryRemaining = get16(header + 5);
+            entryOpen = true;
+        }
+
+        // The record header and at least one byte must fit in the block
+        if (RECORD_BLOCK_SIZE - blockLength < RECORD_HEADER_MAX + 1 && !sealBlock()) {
+            if (!mayCommit) return;   // Wait in the queue, or be dropped when it fills
+            commit();
+            if (!sealBlock()) return;
+        }
+
+        size_t available = queue.size();
+        if (available == 0) return;   // The producer is still pushing the bytes
+        size_t count = entryRemaining;
+        if (count > available) count = available;
+        // Output of the same channel close behind the last record joins it
+        // (its length may gain a byte); UART reads are often tiny at low
+        // rates. An entry after a gap never does: its channel byte is marked.
+        bool join = recordOpen && entryChannel == recordChannel && entryMs - blockLastMs <= RECORD_MERGE_MS;
+        size_t room = RECORD_BLOCK_SIZE - blockLength - (join ? 1 : RECORD_HEADER_MAX);
+        if (count > room) count = room;
+
+        if (!pending) {
+            pending = true;
+            pendingSinceMs = hal::clock().millis();
+        }
+        if (join) {
+            size_t oldSize = varintSize((uint32_t)recordLength);
+            recordLength += count;
+            size_t newSize = varintSize((uint32_t)recordLength);
+            if (newSize != oldSize) {
+                memmove(block + recordOffset + newSize, block + recordOffset + oldSize,
+                        blockLength - recordOffset - oldSize);
+                blockLength += newSize - oldSize;
+            }
+            putVarint(block + recordOffset, (uint32_t)recordLength);
+        } else {
+            if (blockLength == 0) {
+                blockFirstMs = entryMs;
+                blockLastMs = entryMs;
+            }
+            block[blockLength++] = entryChannel;
+            blockLength += putVarint(block + blockLength, entryMs - blockLastMs);
+            entryChannel &= ~RecordBlockHeader::CHANNEL_GAP;   // Marked once, on the first record
+            recordOpen = true;
+            recordChannel = entryChannel;
+            recordOffset = blockLength;
+            recordLength = count;
+            blockLength += putVarint(block + blockLength, (uint32_t)count);
+            blockLastMs = entryMs;
+        }
+        blockLength += queue.pop(block + blockLength, count);
+
+        entryRemaining -= count;
+        entryOpen = entryRemaining > 0;
+    }
+}
+
+bool SessionRecorder::sealBlock() {
+    if (blockLength == 0) return true;
+    size_t room = COMMIT_BUFFER_SIZE - commitLength;
+    if (room < RecordBlockHeader::SIZE + blockLength) return false;
+
+    uint8_t* payload = commitBuffer + commitLength + RecordBlockHeader::SIZE;
+    RecordBlockHeader header;
+    // Stored as is unless compression saves something
+    size_t packed = lzCompress(block, blockLength, payload, blockLength - 1, hashTable);
+    if (packed > 0) {
+        header.flags = RecordBlockHeader::FLAG_COMPRESSED;
+        header.storedLength = (uint16_t)packed;
+    } else {
+        memcpy(payload, block, blockLength);
+        header.storedLength = (uint16_t)blockLength;
+    }
+    header.rawLength = (uint16_t)blockLength;
+    header.boot = boot;
+    header.firstMs = blockFirstMs;
+    header.lastMs = blockLastMs;
+    header.payloadHash = fnv1a(payload, header.storedLength);
+    header.encode(commitBuffer + commitLength);
+
+    commitLength += RecordBlockHeader::SIZE + header.storedLength;
+    blockLength = 0;
+    recordOpen = false;
+    bump(blocks);
+    return true;
+}
+
+void SessionRecorder::commit() {
+    // A block left open starts a new flush interval
+    pending = blockLength > 0;
+    pendingSinceMs = hal::clock().millis();
+    if (commitLength == 0) return;
+    if (commitDeferred) bump(deferredCommits);
+    commitDeferred = false;
+
+    char path[16];
+    hal::File* file = nullptr;
+    if (segmentSize == 0 || segmentSize + commitLength > RECORD_SEGMENT_BYTES) {
+        // Next segment, overwriting the oldest
+        if (segmentSize > 0) {
+            sequence++;
+            bump(rotations);
+        }
+        RecordSegment::formatPath(path, sizeof(path), sequence % RECORD_SEGMENTS);
+        file = files->open(path, "w");
+        uint8_t header[RecordSegment::HEADER_SIZE];
+        RecordSegment::encodeHeader(header, boot, sequence);
+        if (file && file->write(header, sizeof(header)) == sizeof(header)) {
+            segmentSize = sizeof(header);
+        } else if (file) {
+            file->close();
+            file = nullptr;
+        }
+    } else {
+        RecordSegment::formatPath(path, sizeof(path), sequence % RECORD_SEGMENTS);
+        file = files->open(path, "a");
+    }
+
+    size_t written = file ? file->write(commitBuffer, commitLength) : 0;
+    if (file) file->close();
+    if (written == commitLength) {
+        segmentSize += written;
+        bump(storedBytes, written);
+        bump(commits);
+    } else {
+        // Whatever reached the file is incomplete: start a fresh segment
+        bump(writeErrors);
+        segmentSize = RECORD_SEGMENT_BYTES;
+        LOG_WARN("Recording: write to %s failed, %u bytes lost\r\n", path, (unsigned)commitLength);
+    }
+    commitLength = 0;
+}
+
+RecorderStats SessionRecorder::getStats() const {
+    RecorderStats stats;
+    stats.recordedBytes = recordedBytes.load(std::memory_order_relaxed);
+    stats.droppedBytes = droppedBytes.load(std::memory_order_relaxed);
+    stats.storedBytes = storedBytes.load(std::memory_order_relaxed);
+    stats.blocks = blocks.load(std::memory_order_relaxed);
+    stats.commits = commits.load(std::memory_order_relaxed);
+    stats.deferredCommits = deferredCommits.load(std::memory_order_relaxed);
+    stats.rotations = rotations.load(std::memory_order_relaxed);
+    stats.writeErrors = writeErrors.load(std::memory_order_relaxed);
+    stats.segment = sequence;
+    stats.boot = boot;
+    return stats;
+}
+
+bool RecordingExport::begin(hal::FileSystem* files, uint8_t channel, unsigned long fromMs, unsigned long toMs) {
+    end();
+    fileSystem = files;
+    this->channel = channel;
+    this->fromMs = fromMs;
+    this->toMs = toMs == NO_LIMIT ? UINT64_MAX : toMs;
+
+    // Segments oldest first
+    slotCount = 0;
+    for (size_t slot = 0; slot < RECORD_SEGMENTS; slot++) {
+        char path[16];
+        RecordSegment::formatPath(path, sizeof(path), slot);
+        if (!files->exists(path)) continue;
+        hal::File* segment = files->open(path, "r");
+        if (!segment) continue;
+
+        uint8_t header[RecordSegment::HEADER_SIZE];
+        uint16_t segmentBoot;
+        uint32_t sequence;
+        if (segment->read(header, sizeof(header)) == sizeof(header) &&
+            RecordSegment::decodeHeader(header, segmentBoot, sequence)) {
+            size_t i = slotCount++;
+            while (i > 0 && (int32_t)(sequences[i - 1] - sequence) > 0) {
+                slots[i] = slots[i - 1];
+                sequences[i] = sequences[i - 1];
+                i--;
+            }
+            slots[i] = slot;
+            sequences[i] = sequence;
+        }
+        segment->close();
+    }
+    if (slotCount == 0) return false;
+
+    open = true;
+    finished = false;
+    headerSent = false;
+    nextSlot = 0;
+    bootKnown = false;
+    bootBaseMs = 0;
+    lastMs = 0;
+    originMs = this->fromMs;
+    originSet = fromMs > 0;
+    rawLength = 0;
+    rawPosition = 0;
+    data = nullptr;
+    carryLength = 0;
+    stagedLength = 0;
+    stagedPosition = 0;
+    return true;
+}
+
+void RecordingExport::end() {
+    closeFile();
+    open = false;
+}
+
+void RecordingExport::closeFile() {
+    if (file) {
+        file->close();
+        file = nullptr;
+    }
+}
+
+size_t RecordingExport::read(uint8_t* buffer, size_t size) {
+    size_t produced = 0;
+    while (open && produced < size) {
+        if (stagedPosition == stagedLength) {
+            stagedLength = 0;
+            stagedPosition = 0;
+            if (!stageNext()) break;
+        }
+        size_t count = stagedLength - stagedPosition;
+        if (count > size - produced) count = size - produced;
+        memcpy(buffer + produced, staged + stagedPosition, count);
+        stagedPosition += count;
+        produced += count;
+    }
+    return produced;
+}
+
+bool RecordingExport::stageNext() {
+    if (!headerSent) {
+        headerSent = true;
+        stagedLength = snprintf(staged, sizeof(staged), "{\"version\": 2, \"width\": %u, \"height\": %u}\n",
+                                TERMINAL_COLUMNS, TERMINAL_ROWS);
+        return true;
+    }
+    if (data) {
+        if (dataPosition < dataLength) {
+            stageData();
+        } else {
+            data = nullptr;
+            memcpy(staged, "\"]\n", 3);
+            stagedLength = 3;
+        }
+        return true;
+    }
+    if (finished || !nextRecord()) {
+        finished = true;
+        closeFile();
+        return false;
+    }
+
+    uint64_t ms = bootBaseMs + recordMs;
+    if (!originSet) {
+        originSet = true;
+        originMs = ms;
+    }
+    uint64_t elapsed = ms - originMs;
+    stagedLength = snprintf(staged, sizeof(staged), "[%lu.%03lu, \"o\", \"", (unsigned long)(elapsed / 1000),
+                            (unsigned long)(elapsed % 1000));
+    return true;
+}
+
+/**
+ * Check the UTF-8 sequence starting with the lead byte bytes[0] (0x80 or above).
+ * Strict like Utf8Validator: no overlong forms, surrogates or code points above U+10FFFF.
+ * @return Its length if well-formed, 0 if not, UTF8_INCOMPLETE if the bytes
+ *         end inside a sequence that is well-formed so far
+ */
+static const size_t UTF8_INCOMPLETE = (size_t)-1;
+static size_t utf8Sequence(const uint8_t* bytes, size_t available) {
+    uint8_t lead = bytes[0];
+    size_t length = (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 0;
+    if (length == 0 || lead < 0xC2 || lead > 0xF4) return 0;
+    for (size_t k = 1; k < length; k++) {
+        if (k >= available) return UTF8_INCOMPLETE;
+        uint8_t lower = 0x80, upper = 0xBF;
+        if (k == 1) {
+            if (lead == 0xE0) lower = 0xA0;
+            if (lead == 0xED) upper = 0x9F;
+            if (lead == 0xF0) lower = 0x90;
+            if (lead == 0xF4) upper = 0x8F;
+        }
+        if (bytes[k] < lower || bytes[k] > upper) return 0;
+    }
+    return length;
+}
+
+void RecordingExport::stageData() {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    // Room for the longest escape, a 4-byte character or \ufffd
+    while (dataPosition < dataLength && stagedLength + 6 <= sizeof(staged)) {
+        uint8_t c = data[dataPosition];
+        char* out = staged + stagedLength;
+        if (carryLength > 0) {
+            // A character split between two records: complete it from this one
+            uint8_t bytes[4];
+            memcpy(bytes, carry, carryLength);
+            size_t available = carryLength;
+            while (available < sizeof(bytes) && dataPosition + available - carryLength < dataLength) {
+                bytes[available] = data[dataPosition + available - carryLength];
+                available++;
+            }
+            // Not joined across output that was dropped in between
+            size_t length = gapBefore ? 0 : utf8Sequence(bytes, available);
+            if (length == UTF8_INCOMPLETE) {
+                memcpy(carry, bytes, available);
+                carryLength = available;
+                dataPosition = dataLength;
+                return;
+            }
+            if (length > 0) {
+                memcpy(out, bytes, length);
+                stagedLength += length;
+                dataPosition += length - carryLength;
+            } else {
+                memcpy(out, "\\ufffd", 6);   // This record's bytes are taken on their own
+                stagedLength += 6;
+            }
+            carryLength = 0;
+            continue;
+        }
+        if (c == '"' || c == '\\') {
+            out[0] = '\\';
+            out[1] = (char)c;
+            stagedLength += 2;
+        } else if (c == '\n') {
+            memcpy(out, "\\n", 2);
+            stagedLength += 2;
+        } else if (c == '\r') {
+            memcpy(out, "\\r", 2);
+            stagedLength += 2;
+        } else if (c < 0x20 || c == 0x7F) {
+            memcpy(out, "\\u00", 4);
+            out[4] = HEX_DIGITS[c >> 4];
+            out[5] = HEX_DIGITS[c & 0x0F];
+            stagedLength += 6;
+        } else if (c < 0x80) {
+            out[0] = (char)c;
+            stagedLength++;
+        } else {
+            // A whole, well-formed sequence is copied; anything else is U+FFFD
+            size_t length = utf8Sequence(data + dataPosition, dataLength - dataPosition);
+            if (length == UTF8_INCOMPLETE) {
+                carryLength = dataLength - dataPosition;   // Finished by the next record
+                memcpy(carry, data + dataPosition, carryLength);
+                dataPosition = dataLength;
+                return;
+            }
+            if (length > 0) {
+                memcpy(out, data + dataPosition, length);
+                stagedLength += length;
+                dataPosition += length;
+                continue;
+            }
+            memcpy(out, "\\ufffd", 6);
+            stagedLength += 6;
+        }
+        dataPosition++;
+    }
+}
+
+bool RecordingExport::nextRecord() {
+    for (;;) {
+        if (rawPosition >= rawLength) {
+            if (!loadBlock()) return false;
+        }
+
+        const uint8_t* in = raw + rawPosition;
+        const uint8_t* end = raw + rawLength;
+        uint8_t recordChannel = *in & ~RecordBlockHeader::CHANNEL_GAP;
+        bool gap = *in++ & RecordBlockHeader::CHANNEL_GAP;
+        uint32_t delta, length;
+        if (!getVarint(in, end, delta) || !getVarint(in, end, length) || length > (size_t)(end - in)) {
+            rawPosition = rawLength;    // Damaged block: skip the rest of it
+            continue;
+        }
+        recordMs += delta;
+        rawPosition = (size_t)(in - raw) + length;
+        lastMs = bootBaseMs + recordMs;
+
+        uint64_t ms = bootBaseMs + recordMs;
+        if (ms > toMs) return false;
+        if (recordChannel != channel || ms < fromMs || length == 0) continue;
+
+        gapBefore = gap;
+        data = in;
+        dataLength = length;
+        dataPosition = 0;
+        return true;
+    }
+}
+
+bool RecordingExport::loadBlock() {
+    for (;;) {
+        if (!file && !openNextSegment()) return false;
+
+        uint8_t bytes[RecordBlockHeader::SIZE];
+        RecordBlockHeader header;
+        if (!file->seek(filePosition) || file->read(bytes, sizeof(bytes)) != sizeof(bytes) ||
+            !header.decode(bytes)) {
+            closeFile();    // End of the segment, or its damaged tail
+            continue;
+        }
+        filePosition += sizeof(bytes) + header.storedLength;
+
+        // Each boot starts where the previous one stopped
+        if (!bootKnown || header.boot != boot) {
+            bootBaseMs = bootKnown ? lastMs : 0;
+            bootBaseMs -= bootBaseMs < header.firstMs ? bootBaseMs : header.firstMs;
+            boot = header.boot;
+            bootKnown = true;
+        }
+        if (bootBaseMs + header.firstMs > toMs) return false;
+        if (bootBaseMs + header.lastMs < fromMs) {
+            lastMs = bootBaseMs + header.lastMs;
+            continue;   // Before the start: not even read
+        }
+
+        if (file->read(stored, header.storedLength) != header.storedLength ||
+            fnv1a(stored, header.storedLength) != header.payloadHash) {
+            closeFile();
+            continue;
+        }
+        if (header.flags & RecordBlockHeader::FLAG_COMPRESSED) {
+            rawLength = lzDecompress(stored, header.storedLength, raw, sizeof(raw));
+            if (rawLength != header.rawLength) continue;
+        } else {
+            memcpy(raw, stored, header.storedLength);
+            rawLength = header.storedLength;
+        }
+        rawPosition = 0;
+        recordMs = header.firstMs;
+        return true;
+    }
+}
+
+bool RecordingExport::openNextSegment() {
+    while (nextSlot < slotCount) {
+        size_t index = nextSlot++;
+        char path[16];
+        RecordSegment::formatPath(path, sizeof(path), slots[index]);
+        file = fileSystem->open(path, "r");
+        if (!file) continue;
+
+        // Skip a segment that was reused for newer output meanwhile
+        uint8_t header[RecordSegment::HEADER_SIZE];
+        uint16_t segmentBoot;
+        uint32_t sequence;
+        if (file->read(header, sizeof(header)) == sizeof(header) &&
+            RecordSegment::decodeHeader(header, segmentBoot, sequence) && sequence == sequences[index]) {
+            filePosition = sizeof(header);
+            return true;
+        }
+        closeFile();
+    }
+    return false;
+}
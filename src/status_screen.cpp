@@ -0,0 +1,89 @@
+#include "status_screen.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool StatusScreen::update(const char* ipLast3, bool wsConnected, int channel, const unsigned long* rxBytes,
+                          unsigned long nowMs) {
+    char ip[TEXT_SIZE];
+    snprintf(ip, sizeof(ip), "%s", ipLast3);
+    char shown[TEXT_SIZE] = "X";
+    if (wsConnected && channel >= 0 && channel < MAX_CHANNELS) {
+        snprintf(shown, sizeof(shown), "%u", (uint8_t)(channel + 1));
+    }
+    if (strcmp(ip, ipText) != 0 || strcmp(shown, channelText) != 0) {
+        memcpy(ipText, ip, sizeof(ipText));
+        memcpy(channelText, shown, sizeof(channelText));
+        headerDirty = true;
+    }
+
+    if (channel != interactive) {
+        // The marker leaves the old channel's slot and lands on the new one
+        if (interactive >= 0 && interactive < MAX_CHANNELS) markBar((uint8_t)interactive);
+        if (channel >= 0 && channel < MAX_CHANNELS) markBar((uint8_t)channel);
+        interactive = channel;
+    }
+
+    // Rates over the time since the previous update; the first one only samples
+    unsigned long elapsedMs = nowMs - lastUpdateMs;
+    if (!sampled || elapsedMs > 0) {
+        for (uint8_t i = 0; i < MAX_CHANNELS; i++) {
+            unsigned long received = rxBytes[i] - lastRxBytes[i];
+            lastRxBytes[i] = rxBytes[i];
+            uint8_t height = sampled ? barHeight((unsigned long)((uint64_t)received * 1000 / elapsedMs)) : 0;
+            if (height != barHeights[i]) {
+                barHeights[i] = height;
+                markBar(i);
+            }
+        }
+        lastUpdateMs = nowMs;
+        sampled = true;
+    }
+    return headerDirty || dirtyBarColumns != 0;
+}
+
+void StatusScreen::invalidate() {
+    headerDirty = true;
+    dirtyBarColumns = (1u << TILE_COLUMNS) - 1;
+}
+
+void StatusScreen::markSent() {
+    headerDirty = false;
+    dirtyBarColumns = 0;
+}
+
+size_t StatusScreen::dirtyTiles() const {
+    size_t tiles = headerDirty ? (size_t)HEADER_TILE_ROWS * TILE_COLUMNS : 0;
+    for (uint8_t column = 0; column < TILE_COLUMNS; column++) {
+        if (dirtyBarColumns & (1u << column)) tiles += TILE_ROWS - HEADER_TILE_ROWS;
+    }
+    return tiles;
+}
+
+uint8_t StatusScreen::barX(uint8_t channel) {
+    uint8_t slot = DISPLAY_WIDTH / MAX_CHANNELS;
+    return (DISPLAY_WIDTH - slot * MAX_CHANNELS) / 2 + channel * slot;
+}
+
+uint8_t StatusScreen::barWidth() {
+    uint8_t slot = DISPLAY_WIDTH / MAX_CHANNELS;
+    return slot > 1 ? slot - 1 : 1;  // One pixel between bars
+}
+
+uint8_t StatusScreen::barHeight(unsigned long bytesPerSecond) {
+    if (bytesPerSecond == 0) return 0;
+    uint8_t bits = 0;
+    for (unsigned long rate = bytesPerSecond; rate; rate >>= 1) {
+        bits++;
+    }
+    if (bits <= BAR_RATE_SHIFT) return 1;
+    return bits - BAR_RATE_SHIFT < BAR_MAX_HEIGHT ? bits - BAR_RATE_SHIFT : BAR_MAX_HEIGHT;
+}
+
+void StatusScreen::markBar(uint8_t channel) {
+    uint8_t first = barX(channel) / 8;
+    uint8_t last = (barX(channel) + barWidth() - 1) / 8;
+    for (uint8_t column = first; column <= last; column++) {
+        dirtyBarColumns |= 1u << column;
+    }
+}
@@ -0,0 +1,79 @@
+#include "telnet.h"
+
+TelnetParser::Event TelnetParser::feed(uint8_t byte) {
+    switch (state) {
+        case State::Data:
+            if (byte == TELNET_IAC) {
+                state = State::Command;
+                return Event::None;
+            }
+            data = byte;
+            return Event::Data;
+
+        case State::Command:
+            state = State::Data;
+            if (byte == TELNET_IAC) {
+                data = byte;
+                return Event::Data;
+            }
+            if (byte >= TELNET_WILL && byte <= TELNET_DONT) {
+                verb = byte;
+                state = State::OptionCode;
+                return Event::None;
+            }
+            if (byte == TELNET_SB) {
+                state = State::SubOption;
+                return Event::None;
+            }
+            verb = byte;
+            return Event::Command;
+
+        case State::OptionCode:
+            option = byte;
+            state = State::Data;
+            return Event::Option;
+
+        case State::SubOption:
+            option = byte;
+            subnegotiationLength = 0;
+            state = State::SubData;
+            return Event::None;
+
+        case State::SubData:
+            if (byte == TELNET_IAC) {
+                state = State::SubCommand;
+            } else if (subnegotiationLength < MAX_SUBNEGOTIATION) {
+                subnegotiation[subnegotiationLength++] = byte;
+            }
+            return Event::None;
+
+        case State::SubCommand:
+            if (byte == TELNET_SE) {
+                state = State::Data;
+                return Event::Subnegotiation;
+            }
+            // IAC IAC is a 255 value byte; anything else is a broken subnegotiation
+            state = byte == TELNET_IAC ? State::SubData : State::Data;
+            if (byte == TELNET_IAC && subnegotiationLength < MAX_SUBNEGOTIATION) {
+                subnegotiation[subnegotiationLength++] = byte;
+            }
+            return Event::None;
+    }
+    return Event::None;
+}
+
+void TelnetParser::reset() {
+    state = State::Data;
+    subnegotiationLength = 0;
+}
+
+size_t telnetEscape(const uint8_t* data, size_t length, uint8_t* output) {
+    size_t written = 0;
+    for (size_t i = 0; i < length; i++) {
+        output[written++] = data[i];
+        if (data[i] == TELNET_IAC) {
+            output[written++] = TELNET_IAC;
+        }
+    }
+    return written;
+}
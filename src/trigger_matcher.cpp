@@ -0,0 +1,152 @@
+#include "trigger_matcher.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool TriggerMatcher::compile(const char* list, size_t length) {
+    // Split the list and check the limits before touching the tables
+    const char* starts[MAX_PATTERNS];
+    size_t lengths[MAX_PATTERNS];
+    size_t count = 0;
+    size_t totalLength = 0;
+    uint8_t classes[256] = {};
+    size_t classCount = 1;
+    size_t start = 0;
+    for (size_t i = 0; i <= length; i++) {
+        if (i < length && list[i] != '|') continue;
+
+        size_t patternLength = i - start;
+        if (patternLength > 0) {
+            if (count == MAX_PATTERNS || patternLength > MAX_PATTERN_LENGTH) return false;
+            starts[count] = list + start;
+            lengths[count] = patternLength;
+            count++;
+            totalLength += patternLength;
+            for (size_t j = start; j < i; j++) {
+                uint8_t byte = (uint8_t)list[j];
+                if (byte == 0) return false;    // The bridge never passes NUL on
+                if (classes[byte] == 0) {
+                    if (classCount == MAX_CLASSES) return false;
+                    classes[byte] = (uint8_t)classCount++;
+                }
+            }
+        }
+        start = i + 1;
+    }
+    if (totalLength >= MAX_STATES) return false;
+
+    // Trie of the patterns. State 0 is the root, which no edge leads back
+    // to, so 0 marks a missing edge until the links below fill it in.
+    memcpy(byteClasses, classes, sizeof(byteClasses));
+    memset(transitions, 0, sizeof(transitions));
+    memset(outputs, 0, sizeof(outputs));
+    size_t stateCount = 1;
+    for (size_t pattern = 0; pattern < count; pattern++) {
+        uint8_t state = 0;
+        for (size_t j = 0; j < lengths[pattern]; j++) {
+            uint8_t byteClass = classes[(uint8_t)starts[pattern][j]];
+            if (transitions[state][byteClass] == 0) {
+                transitions[state][byteClass] = (uint8_t)stateCount++;
+            }
+            state = transitions[state][byteClass];
+        }
+        outputs[state] |= (uint16_t)(1u << pattern);
+        memcpy(patterns[pattern], starts[pattern], lengths[pattern]);
+        patterns[pattern][lengths[pattern]] = '\0';
+    }
+    patternCount = count;
+
+    // Failure links, breadth first so a state's link (a shallower state) is
+    // complete before its children need it. A missing edge takes the edge of
+    // the failure link, which turns the trie into a full transition table.
+    uint8_t failures[MAX_STATES] = {};
+    uint8_t queue[MAX_STATES];
+    size_t head = 0;
+    size_t tail = 0;
+    for (size_t byteClass = 0; byteClass < classCount; byteClass++) {
+        if (transitions[0][byteClass] != 0) {
+            queue[tail++] = transitions[0][byteClass];
+        }
+    }
+    while (head < tail) {
+        uint8_t state = queue[head++];
+        for (size_t byteClass = 0; byteClass < classCount; byteClass++) {
+            uint8_t child = transitions[state][byteClass];
+            uint8_t fallback = transitions[failures[state]][byteClass];
+            if (child == 0) {
+                transitions[state][byteClass] = fallback;
+                continue;
+            }
+            failures[child] = fallback;
+            outputs[child] |= outputs[fallback];
+            queue[tail++] = child;
+        }
+    }
+
+    // Start over: alerts and counts refer to the previous patterns
+    memset(states, 0, sizeof(states));
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        for (size_t pattern = 0; pattern < MAX_PATTERNS; pattern++) {
+            matches[channel][pattern].store(0, std::memory_order_relaxed);
+        }
+    }
+    TriggerAlert alert;
+    while (popAlert(alert)) {
+    }
+    return true;
+}
+
+void TriggerMatcher::feed(uint8_t channel, const uint8_t* data, size_t length) {
+    if (channel >= MAX_CHANNELS || patternCount == 0) return;
+
+    uint8_t state = states[channel];
+    for (size_t i = 0; i < length; i++) {
+        state = transitions[state][byteClasses[data[i]]];
+        if (outputs[state]) {
+            report(channel, outputs[state]);
+        }
+    }
+    states[channel] = state;
+}
+
+void TriggerMatcher::report(uint8_t channel, uint16_t ended) {
+    for (size_t pattern = 0; ended != 0; pattern++, ended >>= 1) {
+        if ((ended & 1) == 0) continue;
+
+        std::atomic<unsigned long>& count = matches[channel][pattern];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (alerts.capacity() - alerts.size() >= 2) {
+            const uint8_t alert[2] = {channel, (uint8_t)pattern};
+            alerts.push(alert, sizeof(alert));
+        } else {
+            droppedAlerts.store(droppedAlerts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool TriggerMatcher::popAlert(TriggerAlert& alert) {
+    // Alerts are pushed whole, so the queue never holds half of one
+    uint8_t bytes[2];
+    if (alerts.pop(bytes, sizeof(bytes)) < sizeof(bytes)) return false;
+    alert.channel = bytes[0];
+    alert.pattern = bytes[1];
+    return true;
+}
+
+size_t TriggerMatcher::formatList(char* buffer, size_t size) const {
+    if (size == 0) return 0;
+    size_t length = 0;
+    buffer[0] = '\0';
+    for (size_t pattern = 0; pattern < patternCount; pattern++) {
+        int written = snprintf(buffer + length, size - length, "%s%s", pattern ? "|" : "", patterns[pattern]);
+        if (written < 0) break;
+        if ((size_t)written >= size - length) return size - 1;   // Cut short
+        length += written;
+    }
+    return length;
+}
+
+unsigned long TriggerMatcher::getMatches(uint8_t channel, size_t pattern) const {
+    if (channel >= MAX_CHANNELS || pattern >= MAX_PATTERNS) return 0;
+    return matches[channel][pattern].load(std::memory_order_relaxed);
+}
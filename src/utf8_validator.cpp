@@ -0,0 +1,89 @@
+#include "utf8_validator.h"
+
+#include <string.h>
+
+namespace {
+
+// One machine word of bytes with only their top bit set
+typedef unsigned long Word;
+const Word HIGH_BITS = (Word)-1 / 0xFF * 0x80;
+
+} // namespace
+
+void Utf8Validator::feed(const uint8_t* data, size_t length) {
+    size_t i = 0;
+    while (valid && i < length) {
+        if (needed == 0) {
+            // ASCII fast path: align, then test a whole word per step
+            while (i < length && ((uintptr_t)(data + i) & (sizeof(Word) - 1)) != 0 && data[i] < 0x80) {
+                i++;
+            }
+            while (i + sizeof(Word) <= length) {
+                Word word;
+                memcpy(&word, __builtin_assume_aligned(data + i, sizeof(Word)), sizeof(Word));
+                if (word & HIGH_BITS) break;
+                i += sizeof(Word);
+            }
+            while (i < length && data[i] < 0x80) {
+                i++;
+            }
+            if (i == length) break;
+
+            valid = startSequence(data[i++]);
+            continue;
+        }
+
+        uint8_t byte = data[i++];
+        if (byte < lower || byte > upper) {
+            valid = false;
+            break;
+        }
+        lower = 0x80;
+        upper = 0xBF;
+        partial = --needed == 0 ? 0 : partial + 1;
+    }
+}
+
+bool Utf8Validator::startSequence(uint8_t lead) {
+    // Ranges of the first continuation byte exclude overlong encodings,
+    // UTF-16 surrogates and code points above U+10FFFF
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        needed = 1;
+    } else if (lead == 0xE0) {
+        needed = 2;
+        lower = 0xA0;
+    } else if (lead == 0xED) {
+        needed = 2;
+        upper = 0x9F;
+    } else if (lead >= 0xE1 && lead <= 0xEF) {
+        needed = 2;
+    } else if (lead == 0xF0) {
+        needed = 3;
+        lower = 0x90;
+    } else if (lead >= 0xF1 && lead <= 0xF3) {
+        needed = 3;
+    } else if (lead == 0xF4) {
+        needed = 3;
+        upper = 0x8F;
+    } else {
+        return false;
+    }
+    partial = 1;
+    return true;
+}
+
+bool Utf8Validator::isValid() const {
+    return valid;
+}
+
+size_t Utf8Validator::pending() const {
+    return partial;
+}
+
+void Utf8Validator::reset() {
+    needed = 0;
+    partial = 0;
+    lower = 0x80;
+    upper = 0xBF;
+    valid = true;
+}
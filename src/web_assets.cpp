@@ -0,0 +1,48 @@
+#include "web_assets.h"
+
+#include <string.h>
+
+#if __has_include("web_assets_data.h")
+#include "web_assets_data.h"
+#define HAVE_WEB_ASSETS 1
+#else
+#define HAVE_WEB_ASSETS 0
+#endif
+
+#if HAVE_WEB_ASSETS
+// FNV-1a with the seed scripts/embed_assets.py found to give every path a
+// slot of its own
+static constexpr uint32_t FNV_PRIME = 16777619u;
+
+static constexpr uint32_t pathHash(const char* path, uint32_t seed) {
+    uint32_t hash = seed;
+    for (; *path; path++) {
+        hash = (hash ^ (uint8_t)*path) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static_assert((web_assets_data::TABLE_SIZE & (web_assets_data::TABLE_SIZE - 1)) == 0,
+              "TABLE_SIZE must be a power of two");
+#endif
+
+const WebAsset* findWebAsset(const char* path) {
+#if HAVE_WEB_ASSETS
+    using namespace web_assets_data;
+    int8_t slot = SLOTS[pathHash(path, HASH_SEED) & (TABLE_SIZE - 1)];
+    if (slot >= 0 && strcmp(ASSETS[slot].path, path) == 0) {
+        return &ASSETS[slot];
+    }
+#else
+    (void)path;
+#endif
+    return nullptr;
+}
+
+size_t webAssetCount() {
+#if HAVE_WEB_ASSETS
+    return sizeof(web_assets_data::ASSETS) / sizeof(web_assets_data::ASSETS[0]);
+#else
+    return 0;
+#endif
+}
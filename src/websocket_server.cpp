@@ -1,40 +1,94 @@
 #include "websocket_server.h"
+#include "logger.h"
 #include "multiplexer.h"
+#include "serial_bridge.h"
+
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
 
 // Static instance for callback
 static WebSocketServer* instance = nullptr;
 static MultiplexerController* multiplexerInstance = nullptr;
-static HardwareSerial* serialSBC = nullptr;
+static SerialBridge* serialBridge = nullptr;
+
+static const char CHANNEL_COMMAND[] = "CHANNEL:";
+static const size_t CHANNEL_COMMAND_LENGTH = sizeof(CHANNEL_COMMAND) - 1;
+static const char SCAN_COMMAND[] = "SCAN:";
+static const size_t SCAN_COMMAND_LENGTH = sizeof(SCAN_COMMAND) - 1;
+static const char SUBSCRIBE_COMMAND[] = "SUBSCRIBE:";
+static const size_t SUBSCRIBE_COMMAND_LENGTH = sizeof(SUBSCRIBE_COMMAND) - 1;
+static const char PACE_COMMAND[] = "PACE:";
+static const size_t PACE_COMMAND_LENGTH = sizeof(PACE_COMMAND) - 1;
+static const char LINE_COMMAND[] = "LINE:";
+static const size_t LINE_COMMAND_LENGTH = sizeof(LINE_COMMAND) - 1;
+static const char TRIGGERS_COMMAND[] = "TRIGGERS";
+static const size_t TRIGGERS_COMMAND_LENGTH = sizeof(TRIGGERS_COMMAND) - 1;
+static const char TRIGGER_NOTICE[] = "TRIGGER:";
+static const size_t TRIGGER_NOTICE_LENGTH = sizeof(TRIGGER_NOTICE) - 1;
+static const char TRACE_COMMAND[] = "TRACE:";
+static const size_t TRACE_COMMAND_LENGTH = sizeof(TRACE_COMMAND) - 1;
+static const char PROTOCOL_PARAMETER[] = "proto=";
+static const size_t PROTOCOL_PARAMETER_LENGTH = sizeof(PROTOCOL_PARAMETER) - 1;
+static const char COMPRESS_PARAMETER[] = "compress=lz";
+static const size_t COMPRESS_PARAMETER_LENGTH = sizeof(COMPRESS_PARAMETER) - 1;
+
+static bool startsWith(const uint8_t* data, size_t length, const char* prefix, size_t prefixLength) {
+    return length >= prefixLength && memcmp(data, prefix, prefixLength) == 0;
+}
+
+static bool contains(const uint8_t* data, size_t length, const char* text, size_t textLength) {
+    for (size_t i = 0; data && i + textLength <= length; i++) {
+        if (memcmp(data + i, text, textLength) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @return Length of data without a trailing incomplete UTF-8 sequence
+ */
+static size_t completeCharacters(const uint8_t* data, size_t length) {
+    for (size_t back = 1; back <= 3 && back < length; back++) {
+        uint8_t lead = data[length - back];
+        if ((lead & 0xC0) == 0x80) continue;  // Continuation byte, keep looking
+
+        size_t sequence = (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 1;
+        return sequence > back ? length - back : length;
+    }
+    return length;
+}
 
-void WebSocketServer::setReferences(MultiplexerController* multiplexer, HardwareSerial* serial) {
+void WebSocketServer::setReferences(MultiplexerController* multiplexer, SerialBridge* bridge) {
     multiplexerInstance = multiplexer;
-    serialSBC = serial;
+    serialBridge = bridge;
+    httpServer.setTracer(bridge ? &bridge->getTracer() : nullptr);
 }
 
 bool WebSocketServer::init() {
     instance = this;
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        writeOwners[channel] = NO_WRITER;
+    }
     
     // Initialize LittleFS
-    if (!LittleFS.begin()) {
-        Serial.println("LittleFS initialization failed!");
+    fileSystem = &hal::fileSystem();
+    if (!fileSystem->begin()) {
+        LOG_ERROR("LittleFS initialization failed!\r\n");
         return false;
     }
-    Serial.println("LittleFS initialized successfully");
+    LOG_INFO("LittleFS initialized successfully\r\n");
     
     // Initialize WebSocket server
-    webSocket = new WebSocketsServer(WEBSOCKET_PORT);
+    webSocket = hal::createWebSocketTransport(WEBSOCKET_PORT);
     webSocket->begin();
     webSocket->onEvent(webSocketEvent);
     
     // Initialize HTTP server
-    httpServer = new WiFiServer(HTTP_PORT);
-    httpServer->begin();
+    httpServer.begin(HTTP_PORT, fileSystem);
     
     initialized = true;
-    Serial.print("WebSocket server started on port ");
-    Serial.println(WEBSOCKET_PORT);
-    Serial.print("HTTP server started on port ");
-    Serial.println(HTTP_PORT);
+    LOG_INFO("WebSocket server started on port %d\r\n", WEBSOCKET_PORT);
+    LOG_INFO("HTTP server started on port %d\r\n", HTTP_PORT);
     return true;
 }
 
@@ -42,72 +96,118 @@ void WebSocketServer::loop() {
     if (!initialized) return;
     
     webSocket->loop();
-    handleHTTPClient();
+    httpServer.loop();
 }
 
 void WebSocketServer::setChannel(int channel) {
-    if (channel >= 0 && channel < MAX_CHANNELS && multiplexerInstance) {
-        if (multiplexerInstance->selectChannel(channel)) {
-            currentChannel = channel;
-            Serial.print("Switched to channel: ");
-            Serial.println(channel);
-        } else {
-            Serial.print("Failed to switch to channel: ");
-            Serial.println(channel);
+    if (channel < 0 || channel >= MAX_CHANNELS || !multiplexerInstance || !serialBridge) return;
+    if (channel == currentChannel && multiplexerInstance->getInteractiveChannel() == channel) {
+        return;
+    }
+
+    // No new output may be forwarded during the handover
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    int previous = currentChannel;
+    if (!serialBridge->selectChannel(channel)) {
+        LOG_ERROR("Failed to switch to channel: %d\r\n", channel);
+        return;
+    }
+    currentChannel = channel;
+
+    // selectChannel() sent everything captured so far to the live viewers of
+    // the previous channel: they continue from the end of its scrollback.
+    // Clients already viewing the new channel from the scrollback catch up
+    // before its live output reaches them.
+    const Scrollback& history = serialBridge->getScrollback();
+    for (uint8_t num = 0; num < MAX_CLIENTS; num++) {
+        if (clientProtocols[num] != ClientProtocol::Terminal) continue;
+
+        if (viewChannels[num] == previous) {
+            sentSequence[num][previous] = history.endSequence(previous);
+            pendingOutput[num] = false;
+        } else if (viewChannels[num] == channel) {
+            sendTerminalBacklog(num, true, true);
         }
     }
+    updateRouting();
+
+    char notice[16];
+    snprintf(notice, sizeof(notice), "ACTIVE:%d", channel);
+    notifyChannelClients(notice);
+    LOG_INFO("Switched to channel: %d\r\n", channel);
 }
 
-void WebSocketServer::broadcast(const String& data) {
+void WebSocketServer::broadcast(const uint8_t* data, size_t length) {
     if (!initialized) return;
     
     // Check if data contains non-ASCII characters that might cause UTF-8 issues
     bool hasNonASCII = false;
-    for (int i = 0; i < data.length(); i++) {
-        if ((unsigned char)data[i] > 127) {
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] > 127) {
             hasNonASCII = true;
             break;
         }
     }
     
-    if (hasNonASCII) {
-        // Send as binary frame to avoid UTF-8 validation issues
-        webSocket->broadcastBIN((uint8_t*)data.c_str(), data.length());
-    } else {
-        // Send as text frame for normal ASCII data
-        webSocket->broadcastTXT(data.c_str());
+    // Send as binary frame to avoid UTF-8 validation issues, text for plain ASCII
+    for (size_t offset = 0; offset < length; offset += BUFFER_SIZE) {
+        size_t chunk = length - offset < BUFFER_SIZE ? length - offset : BUFFER_SIZE;
+        sendTerminalData(ALL_CLIENTS, !hasNonASCII, data + offset, chunk);
     }
 }
 
-void WebSocketServer::webSocketEvent(uint8_t num, WStype_t type, uint8_t* payload, size_t length) {
+void WebSocketServer::webSocketEvent(uint8_t num, hal::WsEvent type, const uint8_t* payload, size_t length) {
     if (!instance) return;
     
     switch(type) {
-        case WStype_DISCONNECTED:
-            Serial.printf("WebSocket client %u disconnected\n", num);
+        case hal::WsEvent::Disconnected:
+            LOG_INFO("WebSocket client %u disconnected\r\n", num);
+            instance->releaseClient(num);
             break;
             
-        case WStype_CONNECTED:
-            Serial.printf("WebSocket client %u connected\n", num);
+        case hal::WsEvent::Connected:
+            LOG_INFO("WebSocket client %u connected\r\n", num);
+            instance->connectClient(num, payload, length);
+            break;
+
+        case hal::WsEvent::Binary:
+            // Keystrokes for any channel from channel-protocol clients
+            if (num < MAX_CLIENTS && instance->clientProtocols[num] == ClientProtocol::Channel) {
+                instance->handleChannelInput(num, payload, length);
+            }
             break;
             
-        case WStype_TEXT:
-            {
-                String message = String((char*)payload);
-                
-                // Handle channel commands
-                if (message.startsWith("CHANNEL:")) {
-                    instance->handleChannelCommand(message);
-                } else {
-                    // Forward character-by-character to serial SBC
-                    if (serialSBC && message.length() > 0) {
-                        // Send each character immediately
-                        for (int i = 0; i < message.length(); i++) {
-                            serialSBC->write(message[i]);
-                        }
-                        Serial.print("WS->SBC: ");
-                        Serial.print(message);
-                    }
+        case hal::WsEvent::Text:
+            if (num >= MAX_CLIENTS) break;
+
+            // Handle channel commands
+            if (startsWith(payload, length, CHANNEL_COMMAND, CHANNEL_COMMAND_LENGTH)) {
+                instance->handleChannelCommand(num, payload, length);
+            } else if (startsWith(payload, length, SCAN_COMMAND, SCAN_COMMAND_LENGTH)) {
+                instance->handleScanCommand(num, payload, length);
+            } else if (startsWith(payload, length, SUBSCRIBE_COMMAND, SUBSCRIBE_COMMAND_LENGTH)) {
+                instance->handleSubscribeCommand(num, payload, length);
+            } else if (startsWith(payload, length, PACE_COMMAND, PACE_COMMAND_LENGTH)) {
+                instance->handlePaceCommand(num, payload, length);
+            } else if (startsWith(payload, length, LINE_COMMAND, LINE_COMMAND_LENGTH)) {
+                instance->handleLineCommand(num, payload, length);
+            } else if (startsWith(payload, length, TRACE_COMMAND, TRACE_COMMAND_LENGTH)) {
+                instance->handleTraceCommand(num, payload, length);
+            } else if (startsWith(payload, length, TRIGGERS_COMMAND, TRIGGERS_COMMAND_LENGTH) &&
+                       (length == TRIGGERS_COMMAND_LENGTH || payload[TRIGGERS_COMMAND_LENGTH] == ':')) {
+                instance->handleTriggersCommand(num, payload, length);
+            } else {
+                // Terminal clients type on the channel they view
+                uint8_t channel = instance->clientProtocols[num] == ClientProtocol::Terminal ?
+                                  instance->viewChannels[num] : (uint8_t)instance->currentChannel;
+
+                // Queue keystrokes and pastes for the SBC, sent in bulk by the UART task
+                if (serialBridge && length > 0 && instance->claimChannel(num, channel)) {
+                    // The SBC's echo should be sent without coalescing delay
+                    instance->lastKeystrokeTime = hal::clock().millis();
+                    instance->keystrokeSeen = true;
+                    instance->startTrace(num, channel);
+                    instance->queueInput(num, channel, payload, length);
                 }
             }
             break;
@@ -117,116 +217,391 @@ void WebSocketServer::webSocketEvent(uint8_t num, WStype_t type, uint8_t* payloa
     }
 }
 
-void WebSocketServer::handleHTTPClient() {
-    WiFiClient client = httpServer->available();
-    if (client) {
-        String request = client.readStringUntil('\r');
-        client.flush();
-        
-        // Parse the requested path
-        String path = "/";
-        int pathStart = request.indexOf(' ') + 1;
-        int pathEnd = request.indexOf(' ', pathStart);
-        if (pathStart > 0 && pathEnd > pathStart) {
-            path = request.substring(pathStart, pathEnd);
+void WebSocketServer::handleChannelCommand(uint8_t num, const uint8_t* command, size_t length) {
+    // Parse the number after the "CHANNEL:" prefix (non-digits end the number)
+    int channel = 0;
+    for (size_t i = CHANNEL_COMMAND_LENGTH; i < length && command[i] >= '0' && command[i] <= '9'; i++) {
+        channel = channel * 10 + (command[i] - '0');
+    }
+    if (channel < MAX_CHANNELS) {
+        selectView(num, (uint8_t)channel);
+    }
+}
+
+void WebSocketServer::handleSubscribeCommand(uint8_t num, const uint8_t* command, size_t length) {
+    if (clientProtocols[num] != ClientProtocol::Channel || !serialBridge) return;
+
+    // Comma-separated channel numbers, or "*" for all
+    ChannelMask mask = 0;
+    if (length > SUBSCRIBE_COMMAND_LENGTH && command[SUBSCRIBE_COMMAND_LENGTH] == '*') {
+        mask = ALL_CHANNELS;
+    } else {
+        int channel = -1;
+        for (size_t i = SUBSCRIBE_COMMAND_LENGTH; i <= length; i++) {
+            if (i < length && command[i] >= '0' && command[i] <= '9') {
+                channel = (channel < 0 ? 0 : channel * 10) + (command[i] - '0');
+                if (channel >= MAX_CHANNELS) channel = MAX_CHANNELS;
+                continue;
+            }
+            if (channel >= 0 && channel < MAX_CHANNELS) {
+                mask |= (ChannelMask)1 << channel;
+            }
+            channel = -1;
+        }
+    }
+
+    // Newly subscribed channels start with the tail of their history
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        ChannelMask bit = (ChannelMask)1 << channel;
+        if ((mask & bit) && !(subscriptions[num] & bit)) {
+            startChannelStream(num, channel);
         }
-        
-        // Default to index.html for root path
-        if (path == "/") {
-            path = "/index.html";
+    }
+    subscriptions[num] = mask;
+
+    char reply[16 + MAX_CHANNELS * 3];
+    int replyLength = snprintf(reply, sizeof(reply), "SUBSCRIBED:");
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        if (mask & ((ChannelMask)1 << channel)) {
+            replyLength += snprintf(reply + replyLength, sizeof(reply) - replyLength, "%s%u",
+                                    reply[replyLength - 1] == ':' ? "" : ",", (unsigned)channel);
         }
-        
-        // Serve the requested file
-        serveFile(client, path);
-        
-        client.stop();
-        Serial.print("HTTP client served: ");
-        Serial.println(path);
     }
+    webSocket->sendText(num, (const uint8_t*)reply, replyLength);
 }
 
-void WebSocketServer::serveFile(WiFiClient& client, const String& path) {
-    // Find the actual file (may have .gz extension)
-    String actualPath = findFile(path);
-    
-    if (actualPath.isEmpty()) {
-        // File not found - send 404
-        client.println("HTTP/1.1 404 Not Found");
-        client.println("Content-Type: text/plain");
-        client.println("Connection: close");
-        client.println();
-        client.println("File not found");
-        return;
+void WebSocketServer::handlePaceCommand(uint8_t num, const uint8_t* command, size_t length) {
+    if (!serialBridge) return;
+
+    // PACE:<channel>[,<char_us>,<line_ms>,<echo>]: fields left out are kept
+    unsigned long fields[4] = {};
+    bool present[4] = {};
+    size_t field = 0;
+    for (size_t i = PACE_COMMAND_LENGTH; i < length && field < 4; i++) {
+        if (command[i] >= '0' && command[i] <= '9') {
+            fields[field] = fields[field] * 10 + (command[i] - '0');
+            present[field] = true;
+        } else if (command[i] == ',') {
+            field++;
+        } else {
+            break;
+        }
     }
-    
-    // Open the file
-    File file = LittleFS.open(actualPath, "r");
-    if (!file) {
-        client.println("HTTP/1.1 500 Internal Server Error");
-        client.println("Content-Type: text/plain");
-        client.println("Connection: close");
-        client.println();
-        client.println("Failed to open file");
-        return;
+    if (!present[0] || fields[0] >= MAX_CHANNELS) return;
+
+    uint8_t channel = (uint8_t)fields[0];
+    TxPacing pacing = serialBridge->getTxPacing(channel);
+    if (present[1]) pacing.charDelayUs = fields[1];
+    if (present[2]) pacing.lineDelayMs = fields[2];
+    if (present[3]) pacing.echoWait = fields[3] != 0;
+    serialBridge->setTxPacing(channel, pacing);
+
+    char reply[64];
+    int replyLength = snprintf(reply, sizeof(reply), "PACE:%u,%lu,%lu,%u", (unsigned)channel,
+                               pacing.charDelayUs, pacing.lineDelayMs, pacing.echoWait ? 1u : 0u);
+    if (clientProtocols[num] == ClientProtocol::Terminal) {
+        replyLength = snprintf(reply, sizeof(reply), "\r\n[SBC%u input: %lu us/char, %lu ms/line, echo wait %s]\r\n",
+                               channel + 1, pacing.charDelayUs, pacing.lineDelayMs, pacing.echoWait ? "on" : "off");
     }
-    
-    // Get MIME type
-    String mimeType = getMimeType(path);
-    bool isGzipped = actualPath.endsWith(".gz");
-    
-    // Send HTTP headers
-    client.println("HTTP/1.1 200 OK");
-    client.print("Content-Type: ");
-    client.println(mimeType);
-    client.print("Content-Length: ");
-    client.println(file.size());
-    
-    if (isGzipped) {
-        client.println("Content-Encoding: gzip");
+    webSocket->sendText(num, (const uint8_t*)reply, replyLength);
+}
+
+void WebSocketServer::handleLineCommand(uint8_t num, const uint8_t* command, size_t length) {
+    if (!serialBridge) return;
+
+    // LINE:<channel>[,<baud|AUTO>[,<format>]]
+    size_t i = LINE_COMMAND_LENGTH;
+    unsigned long channel = 0;
+    bool present = false;
+    for (; i < length && command[i] >= '0' && command[i] <= '9' && channel < MAX_CHANNELS; i++) {
+        channel = channel * 10 + (command[i] - '0');
+        present = true;
     }
-    
-    client.println("Cache-Control: max-age=86400"); // Cache for 24 hours
-    client.println("Connection: close");
-    client.println();
-    
-    // Send file content
-    while (file.available()) {
-        client.write(file.read());
+    if (!present || channel >= MAX_CHANNELS) return;
+
+    LineSettings settings = serialBridge->getLineSettings((uint8_t)channel);
+    if (i < length) {
+        if (command[i] != ',' ||
+            !parseLineSettings((const char*)command + i + 1, length - i - 1, settings)) {
+            static const char usage[] = "LINE:ERROR";
+            webSocket->sendText(num, (const uint8_t*)usage, sizeof(usage) - 1);
+            return;
+        }
+        serialBridge->setLineSettings((uint8_t)channel, settings);
     }
-    
-    file.close();
+
+    char format[4];
+    formatLineFormat(format, settings.config);
+    if (i < length) {
+        LOG_INFO("SBC%lu line: %s %s\r\n", channel + 1, settings.autoBaud ? "auto-baud" : "fixed", format);
+    }
+    bool detecting = serialBridge->isDetectingBaud((uint8_t)channel);
+    char reply[80];
+    int replyLength = snprintf(reply, sizeof(reply), "LINE:%lu,%lu,%s%s", channel, settings.config.baud, format,
+                               detecting ? ",DETECTING" : settings.autoBaud ? ",AUTO" : "");
+    if (clientProtocols[num] == ClientProtocol::Terminal) {
+        replyLength = snprintf(reply, sizeof(reply), "\r\n[SBC%lu line: %s%lu %s%s]\r\n", channel + 1,
+                               detecting ? "detecting, last " : "", settings.config.baud, format,
+                               settings.autoBaud && !detecting ? " (detected)" : "");
+    }
+    webSocket->sendText(num, (const uint8_t*)reply, replyLength);
 }
 
-String WebSocketServer::getMimeType(const String& filename) {
-    if (filename.endsWith(".html")) return "text/html";
-    if (filename.endsWith(".css")) return "text/css";
-    if (filename.endsWith(".js")) return "application/javascript";
-    if (filename.endsWith(".svg")) return "image/svg+xml";
-    if (filename.endsWith(".json")) return "application/json";
-    if (filename.endsWith(".txt")) return "text/plain";
-    if (filename.endsWith(".ico")) return "image/x-icon";
-    return "text/plain";
+void WebSocketServer::handleTriggersCommand(uint8_t num, const uint8_t* command, size_t length) {
+    if (!serialBridge) return;
+
+    // TRIGGERS reports the patterns, TRIGGERS:<pattern>|<pattern>... replaces them
+    bool valid = true;
+    if (length > TRIGGERS_COMMAND_LENGTH) {
+        const char* list = (const char*)command + TRIGGERS_COMMAND_LENGTH + 1;
+        valid = serialBridge->setTriggers(list, length - TRIGGERS_COMMAND_LENGTH - 1);
+        if (valid) {
+            LOG_INFO("Triggers: %.*s\r\n", (int)(length - TRIGGERS_COMMAND_LENGTH - 1), list);
+        }
+    }
+
+    const TriggerMatcher& triggers = serialBridge->getTriggers();
+    char list[TriggerMatcher::MAX_PATTERNS * (TriggerMatcher::MAX_PATTERN_LENGTH + 1)];
+    triggers.formatList(list, sizeof(list));
+    char reply[sizeof(list) + 64];
+    int replyLength;
+    if (clientProtocols[num] == ClientProtocol::Terminal) {
+        replyLength = valid ? snprintf(reply, sizeof(reply), "\r\n[Triggers: %s]\r\n", list)
+                            : snprintf(reply, sizeof(reply), "\r\n[Triggers unchanged: at most %u patterns of %u bytes]\r\n",
+                                       (unsigned)TriggerMatcher::MAX_PATTERNS,
+                                       (unsigned)TriggerMatcher::MAX_PATTERN_LENGTH);
+    } else {
+        replyLength = valid ? snprintf(reply, sizeof(reply), "TRIGGERS:%s", list)
+                            : snprintf(reply, sizeof(reply), "TRIGGERS:ERROR");
+    }
+    webSocket->sendText(num, (const uint8_t*)reply, replyLength);
 }
 
-String WebSocketServer::findFile(const String& path) {
-    // First try the exact path
-    if (LittleFS.exists(path)) {
-        return path;
+void WebSocketServer::notifyTrigger(uint8_t channel, const char* pattern) {
+    if (!initialized) return;
+
+    LOG_WARN("SBC%u: %s\r\n", channel + 1, pattern);
+    char notice[TriggerMatcher::MAX_PATTERN_LENGTH + 32];
+    int noticeLength = snprintf(notice, sizeof(notice), "%s%u,%s", TRIGGER_NOTICE, channel, pattern);
+
+    // Every client, whichever channel it views, beside its output
+    for (uint8_t num = 0; num < MAX_CLIENTS; num++) {
+        if (clientProtocols[num] != ClientProtocol::None) {
+            webSocket->sendText(num, (const uint8_t*)notice, noticeLength);
+        }
     }
-    
-    // Then try with .gz extension
-    String gzPath = path + ".gz";
-    if (LittleFS.exists(gzPath)) {
-        return gzPath;
+}
+
+void WebSocketServer::handleTraceCommand(uint8_t num, const uint8_t* command, size_t length) {
+    // TRACE:<id>: decimal, wraps at 32 bits
+    uint32_t id = 0;
+    bool present = false;
+    for (size_t i = TRACE_COMMAND_LENGTH; i < length && command[i] >= '0' && command[i] <= '9'; i++) {
+        id = id * 10 + (command[i] - '0');
+        present = true;
     }
-    
-    // File not found
-    return "";
+    traceIds[num] = id;
+    tracePending[num] = present;
+}
+
+void WebSocketServer::startTrace(uint8_t num, uint8_t channel) {
+    if (!tracePending[num]) return;
+    tracePending[num] = false;
+    serialBridge->traceNextWrite(channel, traceIds[num]);
+}
+
+void WebSocketServer::queueInput(uint8_t num, uint8_t channel, const uint8_t* data, size_t length) {
+    size_t queued = serialBridge->write(channel, data, length);
+    LOG_DEBUG("WS->SBC%u: %u bytes\r\n", channel + 1, (unsigned)queued);
+    if (queued == length) return;
+
+    // A paste larger than the free queue space: tell the client what was lost
+    char notice[80];
+    int noticeLength;
+    if (clientProtocols[num] == ClientProtocol::Channel) {
+        noticeLength = snprintf(notice, sizeof(notice), "TXFULL:%u,%u", (unsigned)channel, (unsigned)(length - queued));
+    } else {
+        noticeLength = snprintf(notice, sizeof(notice), "\r\n[SBC%u input queue full: %u bytes dropped]\r\n",
+                                channel + 1, (unsigned)(length - queued));
+    }
+    webSocket->sendText(num, (const uint8_t*)notice, noticeLength);
+}
+
+void WebSocketServer::selectView(uint8_t num, uint8_t channel) {
+    if (num >= MAX_CLIENTS || channel >= MAX_CHANNELS || !serialBridge) return;
+
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    unsigned long now = hal::clock().millis();
+    bool terminal = clientProtocols[num] == ClientProtocol::Terminal;
+    uint8_t previous = viewChannels[num];
+
+    // Leaving a channel hands its console to the next client that types
+    if (terminal && previous != channel) {
+        if (writeOwners[previous] == (int8_t)num) {
+            writeOwners[previous] = NO_WRITER;
+        }
+        readOnlyNotified[num] = false;
+    }
+
+    // The mux follows unless another client is working on the interactive channel
+    if (channel != currentChannel && !lockedByOther((int8_t)num, (uint8_t)currentChannel, WRITE_LOCK_IDLE_MS, now)) {
+        setChannel(channel);
+    }
+
+    // Re-selecting the viewed channel (e.g. a client reconnecting) must not
+    // replay its history a second time
+    if (!terminal || previous == channel) return;
+
+    viewChannels[num] = channel;
+    updateRouting();
+    replayScrollback(channel, num);
+    if (channel != currentChannel) {
+        // The replay ran up to the end of the history: continue from there
+        sentSequence[num][channel] = serialBridge->getScrollback().endSequence(channel);
+        pendingOutput[num] = false;
+    }
+}
+
+bool WebSocketServer::claimChannel(uint8_t num, uint8_t channel) {
+    if (num >= MAX_CLIENTS || channel >= MAX_CHANNELS || !serialBridge) return false;
+
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    int blocking = -1;
+    if (!acquireConsole((int8_t)num, channel, blocking)) {
+        if (!readOnlyNotified[num]) {
+            readOnlyNotified[num] = true;
+            char notice[80];
+            int noticeLength;
+            int8_t owner = writeOwners[blocking];
+            if (clientProtocols[num] == ClientProtocol::Channel) {
+                noticeLength = snprintf(notice, sizeof(notice), "READONLY:%u", (unsigned)channel);
+            } else if (owner >= MAX_CLIENTS) {
+                noticeLength = snprintf(notice, sizeof(notice),
+                                        "\r\n[SBC%u is read-only: TCP port %u is typing on SBC%d]\r\n", channel + 1,
+                                        (unsigned)(PORT_BASE + owner - MAX_CLIENTS), blocking + 1);
+            } else {
+                noticeLength = snprintf(notice, sizeof(notice), "\r\n[SBC%u is read-only: client %d is typing on SBC%d]\r\n",
+                                        channel + 1, owner, blocking + 1);
+            }
+            webSocket->sendText(num, (const uint8_t*)notice, noticeLength);
+        }
+        return false;
+    }
+    readOnlyNotified[num] = false;
+    return channel == currentChannel;
 }
 
-void WebSocketServer::handleChannelCommand(const String& command) {
-    int channel = command.substring(8).toInt(); // Remove "CHANNEL:" prefix
-    setChannel(channel);
+bool WebSocketServer::acquireConsole(int8_t owner, uint8_t channel, int& blocking) {
+    unsigned long now = hal::clock().millis();
+
+    // The channel must be free, and the shared mux must not be in use by
+    // another writer typing on a different channel
+    blocking = -1;
+    if (lockedByOther(owner, channel, WRITE_LOCK_IDLE_MS, now)) {
+        blocking = channel;
+    } else if (channel != currentChannel && lockedByOther(owner, (uint8_t)currentChannel, MUX_HOLD_MS, now)) {
+        blocking = currentChannel;
+    }
+    if (blocking >= 0) return false;
+
+    if (writeOwners[channel] != owner) {
+        writeOwners[channel] = owner;
+        if (owner >= MAX_CLIENTS) {
+            LOG_INFO("TCP port %u has the console of SBC%u\r\n", (unsigned)(PORT_BASE + channel), channel + 1);
+        } else {
+            LOG_INFO("WebSocket client %d has the console of SBC%u\r\n", owner, channel + 1);
+        }
+    }
+    lastWriteTime[channel] = now;
+
+    if (channel != currentChannel) {
+        setChannel(channel);
+    }
+    return true;
+}
+
+bool WebSocketServer::lockedByOther(int8_t owner, uint8_t channel, unsigned long heldMs, unsigned long now) const {
+    int8_t holder = writeOwners[channel];
+    return holder != NO_WRITER && holder != owner && now - lastWriteTime[channel] < heldMs;
+}
+
+void WebSocketServer::attachPort(uint8_t channel) {
+    if (channel >= MAX_CHANNELS || !serialBridge) return;
+
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    unsigned long now = hal::clock().millis();
+    if (channel != currentChannel &&
+        !lockedByOther(portOwner(channel), (uint8_t)currentChannel, WRITE_LOCK_IDLE_MS, now)) {
+        setChannel(channel);
+    }
+}
+
+bool WebSocketServer::claimForPort(uint8_t channel) {
+    if (channel >= MAX_CHANNELS || !serialBridge) return false;
+
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    int blocking = -1;
+    return acquireConsole(portOwner(channel), channel, blocking) && channel == currentChannel;
+}
+
+void WebSocketServer::detachPort(uint8_t channel) {
+    if (channel >= MAX_CHANNELS || !serialBridge) return;
+
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    if (writeOwners[channel] == portOwner(channel)) {
+        writeOwners[channel] = NO_WRITER;
+    }
+}
+
+void WebSocketServer::releaseClient(uint8_t num) {
+    if (num >= MAX_CLIENTS) return;
+
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        if (writeOwners[channel] == (int8_t)num) {
+            writeOwners[channel] = NO_WRITER;
+        }
+    }
+    if (clientProtocols[num] == ClientProtocol::Channel) {
+        channelClients--;
+    }
+    if (compressOutput[num]) {
+        compressOutput[num] = false;
+        compressClients--;
+    }
+    clientProtocols[num] = ClientProtocol::None;
+    subscriptions[num] = 0;
+    readOnlyNotified[num] = false;
+    tracePending[num] = false;
+    updateRouting();
+}
+
+void WebSocketServer::updateRouting() {
+    broadcastLive = true;
+    for (uint8_t num = 0; num < MAX_CLIENTS; num++) {
+        if (clientProtocols[num] == ClientProtocol::Channel ||
+            (clientProtocols[num] == ClientProtocol::Terminal && viewChannels[num] != currentChannel)) {
+            broadcastLive = false;
+        }
+    }
+}
+
+void WebSocketServer::handleScanCommand(uint8_t num, const uint8_t* command, size_t length) {
+    if (!serialBridge) return;
+
+    const uint8_t* argument = command + SCAN_COMMAND_LENGTH;
+    size_t argumentLength = length - SCAN_COMMAND_LENGTH;
+
+    if (startsWith(argument, argumentLength, "ON", 2)) {
+        serialBridge->setScanMode(true);
+    } else if (startsWith(argument, argumentLength, "OFF", 3)) {
+        serialBridge->setScanMode(false);
+    } else if (startsWith(argument, argumentLength, "STATS", 5)) {
+        char report[SCAN_REPORT_SIZE];
+        size_t reportLength = serialBridge->formatScanReport(report, sizeof(report));
+        webSocket->sendText(num, (const uint8_t*)report, reportLength);
+        LOG_INFO_TEXT(report, reportLength);
+    }
 }
 
 bool WebSocketServer::hasConnectedClients() {
@@ -240,54 +615,467 @@ int WebSocketServer::getCurrentChannel() {
 
 void WebSocketServer::addToBuffer(char c) {
     charBuffer[bufferPos++] = (uint8_t)c;
+    rateWindowBytes++;
     if (bufferPos == 1) {
-        lastBufferTime = millis();
+        lastBufferTime = hal::clock().millis();
     }
     
-    // Check if buffer is full or timeout has elapsed
-    if (bufferPos >= BUFFER_SIZE || (millis() - lastBufferTime > BUFFER_TIMEOUT_MS)) {
-        flushBuffer();
+    // Check if the frame reached its target size or latency bound
+    if (bufferPos >= frameTarget || bufferPos >= BUFFER_SIZE ||
+        (hal::clock().millis() - lastBufferTime >= OUTPUT_LATENCY_MAX_MS)) {
+        flushBuffer(true);
     }
 }
 
-void WebSocketServer::flushBuffer() {
+void WebSocketServer::flushIfDue(bool lineIdle) {
+    unsigned long now = hal::clock().millis();
+    updateFrameTarget(now);
+
+    // Nagle-like: keep coalescing only while output is still streaming in
+    // and nobody is waiting for an echo
+    if (bufferPos > 0 &&
+        (echoExpected(now) || lineIdle || now - lastBufferTime >= OUTPUT_LATENCY_MAX_MS)) {
+        flushBuffer(true);
+    }
+
+    serviceChannelClients(lineIdle);
+}
+
+void WebSocketServer::updateFrameTarget(unsigned long now) {
+    unsigned long elapsed = now - rateWindowStart;
+    if (elapsed < RATE_WINDOW_MS) return;
+
+    // Follow a rising rate at once, let a falling one decay
+    unsigned long rate = rateWindowBytes * 1000 / elapsed;
+    unsigned long smoothed = outputStats.bytesPerSecond;
+    outputStats.bytesPerSecond = rate >= smoothed ? rate : (smoothed + rate) / 2;
+    outputStats.framesPerSecond = rateWindowFrames * 1000 / elapsed;
+
+    size_t target = (size_t)(outputStats.bytesPerSecond * OUTPUT_LATENCY_MAX_MS / 1000);
+    frameTarget = target < MIN_FRAME_TARGET ? MIN_FRAME_TARGET : target > BUFFER_SIZE ? BUFFER_SIZE : target;
+
+    rateWindowStart = now;
+    rateWindowBytes = 0;
+    rateWindowFrames = 0;
+}
+
+bool WebSocketServer::echoExpected(unsigned long now) const {
+    return keystrokeSeen && now - lastKeystrokeTime < ECHO_WINDOW_MS;
+}
+
+OutputStats WebSocketServer::getOutputStats() const {
+    OutputStats stats = outputStats;
+    stats.frameTarget = frameTarget;
+    return stats;
+}
+
+size_t WebSocketServer::getTerminalClients() const {
+    size_t count = 0;
+    for (ClientProtocol protocol : clientProtocols) {
+        if (protocol == ClientProtocol::Terminal) count++;
+    }
+    return count;
+}
+
+void WebSocketServer::flushBuffer(bool holdPartial) {
     if (bufferPos > 0) {
-        sendBufferedData();
-        bufferPos = 0;
+        sendBufferedData(holdPartial);
     }
 }
 
-void WebSocketServer::sendBufferedData() {
+void WebSocketServer::sendBufferedData(bool holdPartial) {
     if (!initialized || bufferPos == 0) return;
-    
-    // Check if buffer contains valid UTF-8 sequence
-    if (isValidUTF8Sequence(charBuffer, bufferPos)) {
-        // Send as text frame for valid UTF-8
-        webSocket->broadcastTXT(charBuffer, bufferPos);
-    } else {
-        // Send as binary frame for invalid UTF-8 to prevent decode errors
-        webSocket->broadcastBIN(charBuffer, bufferPos);
+
+    // Only the bytes added since the last frame are validated
+    utf8.feed(charBuffer + validatedPos, bufferPos - validatedPos);
+    validatedPos = bufferPos;
+
+    size_t length = bufferPos;
+    bool text = utf8.isValid() && utf8.pending() == 0;
+    if (utf8.isValid() && utf8.pending() > 0) {
+        unsigned long age = hal::clock().millis() - lastBufferTime;
+        if (holdPartial && (bufferPos > utf8.pending() || age < OUTPUT_LATENCY_MAX_MS)) {
+            // Send the complete characters, the rest starts the next frame
+            length = bufferPos - utf8.pending();
+            text = true;
+        }
+    }
+
+    if (length > 0) {
+        // Text frame for valid UTF-8, binary for invalid UTF-8 to prevent decode errors
+        sendTerminalData(ALL_CLIENTS, text, charBuffer, length);
+        outputStats.frames++;
+        if (text) {
+            outputStats.textFrames++;
+        } else {
+            outputStats.binaryFrames++;
+        }
+        outputStats.bytes += length;
+        outputStats.liveBytes += length;
+        frameSizes.record(length);
+        rateWindowFrames++;
+    }
+
+    size_t kept = bufferPos - length;
+    if (kept > 0 && length > 0) {
+        memmove(charBuffer, charBuffer + length, kept);
+        lastBufferTime = hal::clock().millis();
+    } else if (kept == 0) {
+        utf8.reset();
     }
+    bufferPos = kept;
+    validatedPos = kept;
 }
 
 bool WebSocketServer::isValidUTF8Sequence(const uint8_t* data, size_t length) {
-    for (size_t i = 0; i < length; ) {
-        uint8_t byte = data[i];
-        
-        if (byte <= 0x7F) {
-            i++; // ASCII
-        } else if ((byte & 0xE0) == 0xC0) {
-            if (i + 1 >= length || (data[i + 1] & 0xC0) != 0x80) return false;
-            i += 2; // 2-byte sequence
-        } else if ((byte & 0xF0) == 0xE0) {
-            if (i + 2 >= length || (data[i + 1] & 0xC0) != 0x80 || (data[i + 2] & 0xC0) != 0x80) return false;
-            i += 3; // 3-byte sequence
-        } else if ((byte & 0xF8) == 0xF0) {
-            if (i + 3 >= length || (data[i + 1] & 0xC0) != 0x80 || (data[i + 2] & 0xC0) != 0x80 || (data[i + 3] & 0xC0) != 0x80) return false;
-            i += 4; // 4-byte sequence
+    Utf8Validator validator;
+    validator.feed(data, length);
+    return validator.isValid() && validator.pending() == 0;
+}
+
+void WebSocketServer::replayScrollback(uint8_t channel, int num) {
+    if (!initialized || !serialBridge) return;
+
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    const Scrollback& history = serialBridge->getScrollback();
+    size_t size = history.size(channel);
+
+    // Output still on its way to the clients is sent live after the replay
+    size_t pending = serialBridge->pendingForward(channel);
+    if ((int)channel == currentChannel) {
+        pending += bufferPos;
+    }
+    size = pending < size ? size - pending : 0;
+    size_t offset = size > REPLAY_TAIL_BYTES ? size - REPLAY_TAIL_BYTES : 0;
+
+    // Start on a character boundary, not in the middle of a UTF-8 sequence
+    uint8_t byte;
+    while (offset < size && history.copy(channel, offset, &byte, 1) == 1 && (byte & 0xC0) == 0x80) {
+        offset++;
+    }
+
+    while (offset < size) {
+        size_t length = history.copy(channel, offset, replayFrame, REPLAY_FRAME_SIZE);
+        if (length == 0) break;
+
+        // Keep a multi-byte character that straddles the frame end for the next frame
+        if (offset + length < size) {
+            length = completeCharacters(replayFrame, length);
+        }
+
+        sendTerminalData(num, isValidUTF8Sequence(replayFrame, length), replayFrame, length);
+        offset += length;
+    }
+}
+
+void WebSocketServer::sendTerminalData(int num, bool text, const uint8_t* data, size_t length) {
+    // A text frame starting with TRIGGER: is a trigger notice, never output
+    if (text && startsWith(data, length, TRIGGER_NOTICE, TRIGGER_NOTICE_LENGTH)) {
+        text = false;
+    }
+
+    // Compressed once, whichever clients it goes to
+    bool packing = num != ALL_CLIENTS && compressOutput[num];
+    for (uint8_t client = 0; num == ALL_CLIENTS && client < MAX_CLIENTS; client++) {
+        packing = packing || (compressOutput[client] && viewChannels[client] == currentChannel);
+    }
+    size_t packedLength = packing ? packTerminalData(text, data, length) : 0;
+
+    if (num != ALL_CLIENTS) {
+        sendTerminalFrame((uint8_t)num, text, data, length, packedLength);
+        return;
+    }
+
+    // Broadcast unless some clients view another channel or use the channel
+    // protocol, or only some of them get the packed frame
+    if (broadcastLive && (packedLength == 0 || compressClients == 0)) {
+        if (text) {
+            webSocket->broadcastText(data, length);
         } else {
-            return false; // Invalid UTF-8 start byte
+            webSocket->broadcastBinary(data, length);
         }
+        return;
     }
-    return true;
-}
\ No newline at end of file
+    if (broadcastLive && compressClients == getTerminalClients()) {
+        webSocket->broadcastBinary(packedFrame, packedLength);
+        return;
+    }
+
+    for (uint8_t client = 0; client < MAX_CLIENTS; client++) {
+        if (clientProtocols[client] == ClientProtocol::Terminal && viewChannels[client] == currentChannel) {
+            sendTerminalFrame(client, text, data, length, packedLength);
+        }
+    }
+}
+
+size_t WebSocketServer::packTerminalData(bool text, const uint8_t* data, size_t length) {
+    if (length > PACKED_FRAME_SIZE - PACKED_HEADER) return 0;
+
+    if (length >= OUTPUT_COMPRESS_MIN && length > PACKED_HEADER + LZ_MIN_MATCH) {
+        // Room for less than the raw bytes, so output that does not shrink fails early
+        unsigned long started = hal::clock().micros();
+        size_t compressed = lzCompress(data, length, packedFrame + PACKED_HEADER, length - PACKED_HEADER - 1, lzTable);
+        outputStats.compressUs += hal::clock().micros() - started;
+        outputStats.compressInputBytes += length;
+
+        if (compressed > 0) {
+            packedFrame[0] = PACKED_LZ;
+            packedFrame[1] = (uint8_t)length;
+            packedFrame[2] = (uint8_t)(length >> 8);
+            outputStats.compressedFrames++;
+            outputStats.compressOutputBytes += PACKED_HEADER + compressed;
+            return PACKED_HEADER + compressed;
+        }
+        outputStats.compressOutputBytes += text ? length : 1 + length;
+    }
+    if (text) return 0;
+
+    packedFrame[0] = PACKED_RAW;
+    memcpy(packedFrame + 1, data, length);
+    return 1 + length;
+}
+
+void WebSocketServer::sendTerminalFrame(uint8_t num, bool text, const uint8_t* data, size_t length,
+                                        size_t packedLength) {
+    if (compressOutput[num] && packedLength > 0) {
+        webSocket->sendBinary(num, packedFrame, packedLength);
+    } else if (text) {
+        webSocket->sendText(num, data, length);
+    } else {
+        webSocket->sendBinary(num, data, length);
+    }
+}
+
+void WebSocketServer::connectClient(uint8_t num, const uint8_t* path, size_t length) {
+    if (num >= MAX_CLIENTS) return;
+    releaseClient(num);
+
+    // Look for "proto=<version>" in the request path
+    unsigned version = 0;
+    for (size_t i = 0; path && i + PROTOCOL_PARAMETER_LENGTH <= length; i++) {
+        if (startsWith(path + i, length - i, PROTOCOL_PARAMETER, PROTOCOL_PARAMETER_LENGTH)) {
+            for (size_t j = i + PROTOCOL_PARAMETER_LENGTH; j < length && path[j] >= '0' && path[j] <= '9'; j++) {
+                version = version * 10 + (path[j] - '0');
+            }
+            break;
+        }
+    }
+
+    if (version != CHANNEL_FRAME_VERSION || !serialBridge) {
+        // Terminal clients start on the interactive channel
+        clientProtocols[num] = ClientProtocol::Terminal;
+        compressOutput[num] = contains(path, length, COMPRESS_PARAMETER, COMPRESS_PARAMETER_LENGTH);
+        if (compressOutput[num]) {
+            compressClients++;
+        }
+        viewChannels[num] = (uint8_t)currentChannel;
+        updateRouting();
+        replayScrollback(currentChannel, num);
+        return;
+    }
+
+    clientProtocols[num] = ClientProtocol::Channel;
+    channelClients++;
+    pendingOutput[num] = false;
+    subscriptions[num] = ALL_CHANNELS;
+    updateRouting();
+    for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+        startChannelStream(num, channel);
+    }
+
+    char reply[48];
+    int replyLength = snprintf(reply, sizeof(reply), "PROTO:%u CHANNELS:%u ACTIVE:%d",
+                               (unsigned)CHANNEL_FRAME_VERSION, (unsigned)MAX_CHANNELS, currentChannel);
+    webSocket->sendText(num, (const uint8_t*)reply, replyLength);
+}
+
+void WebSocketServer::startChannelStream(uint8_t num, uint8_t channel) {
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    const Scrollback& history = serialBridge->getScrollback();
+
+    // Start at the tail of the history, on a character boundary
+    size_t size = history.size(channel);
+    size_t offset = size > REPLAY_TAIL_BYTES ? size - REPLAY_TAIL_BYTES : 0;
+    uint8_t byte;
+    while (offset < size && history.copy(channel, offset, &byte, 1) == 1 && (byte & 0xC0) == 0x80) {
+        offset++;
+    }
+
+    uint32_t end = history.endSequence(channel);
+    sentSequence[num][channel] = end - (uint32_t)(size - offset);
+    replayEnd[num][channel] = end;
+}
+
+void WebSocketServer::notifyChannelClients(const char* text) {
+    if (channelClients == 0) return;
+
+    for (uint8_t client = 0; client < MAX_CLIENTS; client++) {
+        if (clientProtocols[client] == ClientProtocol::Channel) {
+            webSocket->sendText(client, (const uint8_t*)text, strlen(text));
+        }
+    }
+}
+
+void WebSocketServer::serviceChannelClients(bool lineIdle) {
+    if (broadcastLive || !serialBridge) return;
+
+    unsigned long now = hal::clock().millis();
+    for (uint8_t num = 0; num < MAX_CLIENTS; num++) {
+        if (clientProtocols[num] == ClientProtocol::Terminal && viewChannels[num] != currentChannel) {
+            sendTerminalBacklog(num, lineIdle, false);
+            continue;
+        }
+        if (clientProtocols[num] != ClientProtocol::Channel) continue;
+
+        for (int frame = 0; frame < MAX_CHANNEL_FRAMES_PER_CALL; frame++) {
+            size_t length = 0;
+            {
+                std::lock_guard<SerialBridge> guard(*serialBridge);
+                const Scrollback& history = serialBridge->getScrollback();
+                uint32_t pending = 0;
+                for (uint8_t channel = 0; channel < MAX_CHANNELS; channel++) {
+                    if (subscriptions[num] & ((ChannelMask)1 << channel)) {
+                        pending += history.endSequence(channel) - sentSequence[num][channel];
+                    }
+                }
+                if (pending == 0) {
+                    pendingOutput[num] = false;
+                    break;
+                }
+                if (!pendingOutput[num]) {
+                    pendingOutput[num] = true;
+                    pendingSince[num] = now;
+                }
+
+                // Same policy as the terminal buffer; a backlog is sent back to back
+                bool due = frame > 0 || pending >= frameTarget || lineIdle || echoExpected(now) ||
+                           now - pendingSince[num] >= OUTPUT_LATENCY_MAX_MS;
+                if (!due) break;
+
+                length = buildChannelFrame(num);
+            }
+            if (length == 0) break;
+
+            webSocket->sendBinary(num, channelFrame, length);
+            pendingOutput[num] = false;
+            outputStats.frames++;
+            outputStats.bytes += length;
+            rateWindowFrames++;
+        }
+    }
+}
+
+size_t WebSocketServer::buildChannelFrame(uint8_t num) {
+    const Scrollback& history = serialBridge->getScrollback();
+    int interactive = multiplexerInstance ? multiplexerInstance->getInteractiveChannel() : currentChannel;
+
+    ChannelFrameWriter writer;
+    writer.begin(channelFrame, sizeof(channelFrame));
+
+    for (uint8_t i = 0; i < MAX_CHANNELS; i++) {
+        uint8_t channel = (firstChannel[num] + i) % MAX_CHANNELS;
+        if (!(subscriptions[num] & ((ChannelMask)1 << channel))) continue;
+
+        uint32_t end = history.endSequence(channel);
+        uint32_t start = end - (uint32_t)history.size(channel);
+        uint32_t& sequence = sentSequence[num][channel];
+
+        uint8_t flags = channel == interactive ? CHANNEL_FLAG_INTERACTIVE : 0;
+        if (sequence - start > end - start) {
+            // The client fell behind and the oldest unsent output was overwritten
+            sequence = start;
+            flags |= CHANNEL_FLAG_GAP;
+        }
+
+        while (sequence != end) {
+            uint8_t recordFlags = flags;
+            uint32_t available = end - sequence;
+            int32_t replayLeft = (int32_t)(replayEnd[num][channel] - sequence);
+            if (replayLeft > 0) {
+                recordFlags |= CHANNEL_FLAG_REPLAY;
+                available = (uint32_t)replayLeft < available ? (uint32_t)replayLeft : available;
+            }
+
+            size_t room;
+            uint8_t* payload = writer.beginRecord(channel, recordFlags, sequence, room);
+            if (!payload) {
+                // Frame full: continue with this channel next time
+                firstChannel[num] = channel;
+                return writer.size();
+            }
+
+            size_t count = history.copy(channel, sequence - start, payload, available < room ? available : room);
+            writer.endRecord(count);
+            sequence += (uint32_t)count;
+            flags &= ~CHANNEL_FLAG_GAP;
+            if (count == 0) break;
+        }
+    }
+
+    firstChannel[num] = (firstChannel[num] + 1) % MAX_CHANNELS;
+    return writer.hasRecords() ? writer.size() : 0;
+}
+
+void WebSocketServer::handleChannelInput(uint8_t num, const uint8_t* frame, size_t length) {
+    if (!serialBridge) return;
+
+    ChannelFrameReader reader(frame, length);
+    ChannelRecord record;
+    while (reader.next(record)) {
+        if (record.channel >= MAX_CHANNELS || record.length == 0) continue;
+
+        // Keystrokes go to the interactive channel: take the target's write
+        // lock and switch to it first
+        if (!claimChannel(num, record.channel)) continue;
+
+        lastKeystrokeTime = hal::clock().millis();
+        keystrokeSeen = true;
+        startTrace(num, record.channel);
+        queueInput(num, record.channel, record.payload, record.length);
+    }
+}
+
+void WebSocketServer::sendTerminalBacklog(uint8_t num, bool lineIdle, bool all) {
+    std::lock_guard<SerialBridge> guard(*serialBridge);
+    const Scrollback& history = serialBridge->getScrollback();
+    uint8_t channel = viewChannels[num];
+    uint32_t end = history.endSequence(channel);
+    uint32_t start = end - (uint32_t)history.size(channel);
+    uint32_t& sequence = sentSequence[num][channel];
+
+    if (sequence - start > end - start) {
+        // The client fell behind and the oldest unsent output was overwritten
+        sequence = start;
+    }
+    if (sequence == end) {
+        pendingOutput[num] = false;
+        return;
+    }
+
+    unsigned long now = hal::clock().millis();
+    if (!pendingOutput[num]) {
+        pendingOutput[num] = true;
+        pendingSince[num] = now;
+    }
+
+    // Same policy as the live buffer; a character cut by the end of the
+    // captured output waits for its remaining bytes up to the latency bound
+    bool stale = now - pendingSince[num] >= OUTPUT_LATENCY_MAX_MS;
+    if (!all && !stale && !lineIdle && end - sequence < frameTarget) return;
+
+    for (int frame = 0; sequence != end && (all || frame < MAX_CHANNEL_FRAMES_PER_CALL); frame++) {
+        size_t length = history.copy(channel, sequence - start, replayFrame, REPLAY_FRAME_SIZE);
+        if (!all && !stale) {
+            length = completeCharacters(replayFrame, length);
+        }
+        if (length == 0) break;
+
+        sendTerminalData(num, isValidUTF8Sequence(replayFrame, length), replayFrame, length);
+        sequence += (uint32_t)length;
+        pendingSince[num] = now;
+        outputStats.frames++;
+        outputStats.bytes += length;
+        rateWindowFrames++;
+    }
+    pendingOutput[num] = sequence != end;
+}
@@ -1,29 +1,29 @@
 #include "wifi_manager.h"
 #include "credentials.h"
+#include "logger.h"
 
 bool WiFiManager::init() {
     WiFi.mode(WIFI_STA);
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
     
-    Serial.print("Connecting to WiFi");
+    LOG_INFO("Connecting to WiFi");
     int attempts = 0;
     const int timeout = 100;  // 10 seconds timeout (100 * 100ms)
     
     while (WiFi.status() != WL_CONNECTED && attempts < timeout) {
         delay(100);
-        Serial.print(".");
+        LOG_INFO(".");
         attempts++;
     }
     
     if (WiFi.status() == WL_CONNECTED) {
         connected = true;
-        Serial.println();
-        Serial.print("WiFi connected! IP: ");
-        Serial.println(WiFi.localIP());
+        char ip[IP_ADDRESS_SIZE];
+        getIPAddress(ip, sizeof(ip));
+        LOG_INFO("\r\nWiFi connected! IP: %s\r\n", ip);
         return true;
     } else {
-        Serial.println();
-        Serial.println("WiFi connection failed");
+        LOG_ERROR("\r\nWiFi connection failed\r\n");
         connected = false;
         return false;
     }
@@ -33,19 +33,15 @@ bool WiFiManager::isConnected() const {
     return connected && WiFi.status() == WL_CONNECTED;
 }
 
-String WiFiManager::getIPAddress() const {
-    return WiFi.localIP().toString();
+void WiFiManager::getIPAddress(char* buffer, size_t size) const {
+    IPAddress ip = WiFi.localIP();
+    snprintf(buffer, size, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
 }
 
-String WiFiManager::getIPLast3Digits() const {
+void WiFiManager::getIPLast3Digits(char* buffer, size_t size) const {
     if (!isConnected()) {
-        return "---";
+        snprintf(buffer, size, "---");
+        return;
     }
-    
-    String ip = WiFi.localIP().toString();
-    int lastDot = ip.lastIndexOf('.');
-    if (lastDot != -1) {
-        return ip.substring(lastDot + 1);
-    }
-    return "---";
-}
\ No newline at end of file
+    snprintf(buffer, size, "%u", WiFi.localIP()[3]);
+}